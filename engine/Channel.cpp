@@ -79,6 +79,85 @@ static bool checkRetry(Lock& lock)
     return ok;
 }
 
+namespace TelEngine {
+
+// Routing pool counters kept for each driver, referenced by its jobs
+class RouterStats : public RefObject
+{
+public:
+    inline RouterStats(Driver* driver)
+	: m_driver(driver), m_queued(0), m_running(0),
+	  m_jobs(0), m_waitTotal(0), m_waitMax(0)
+	{ }
+    Driver* m_driver;
+    int m_queued;
+    int m_running;
+    unsigned int m_jobs;
+    u_int64_t m_waitTotal;
+    u_int64_t m_waitMax;
+};
+
+// Call routing request waiting in the routing pool queue
+class RouterJob : public GenObject
+{
+public:
+    inline RouterJob(Driver* driver, const String& id, Message* msg, RouterStats* stats)
+	: m_driver(driver), m_id(id), m_msg(msg), m_stats(stats), m_queued(Time::now())
+	{ m_stats->ref(); }
+    virtual ~RouterJob()
+	{ TelEngine::destruct(m_msg); TelEngine::destruct(m_stats); }
+    Driver* m_driver;
+    String m_id;
+    Message* m_msg;
+    RouterStats* m_stats;
+    u_int64_t m_queued;
+};
+
+// Pooled thread routing the queued calls
+class RouterThread : public Thread
+{
+public:
+    inline RouterThread()
+	: Thread("Call Router"), m_job(0), m_counted(true)
+	{ }
+    virtual void run();
+    virtual void cleanup();
+    RouterJob* m_job;
+    bool m_counted;
+};
+
+// Bounded pool of call routing threads shared by all drivers
+class RouterPool
+{
+public:
+    static bool queue(Driver* driver, const String& id, Message* msg);
+    static bool route(Driver* driver, const String& id, Message* msg);
+    static void work(RouterThread* thread);
+    static void setup(int threads, int idleMs);
+    static void status(const Driver* driver, String& str);
+    static void forget(const Driver* driver);
+    static void drain();
+private:
+    static RouterStats* stats(Driver* driver);
+    static RouterJob* get();
+    static void done(RouterJob* job, bool ok);
+    static inline bool runnable(const RouterStats* st)
+	{ return !st->m_driver->m_maxrouters || (st->m_running < st->m_driver->m_maxrouters); }
+};
+
+}; // namespace TelEngine
+
+static Mutex s_poolMutex(false,"RouterPool");
+static Semaphore s_poolSem(0x7fffffff,"RouterPool",0);
+static ObjList s_poolJobs;
+static ObjList* s_poolTail = &s_poolJobs;
+static ObjList s_poolStats;
+static int s_poolThreads = 0;
+static int s_poolWaiting = 0;
+static int s_poolSignals = 0;
+static int s_poolMax = 128;
+static u_int64_t s_poolIdle = 5000000;
+
 
 CallEndpoint::CallEndpoint(const char* id)
     : m_peer(0), m_lastPeer(0), m_id(id), m_mutex(0)
@@ -385,13 +464,22 @@ static const String s_disconnected("chan.disconnected");
 // Mutex used to lock disconnect parameters during access
 static Mutex s_paramMutex(true,"ChannelParams");
 
+// Mutex protecting the timer wheels of all drivers, no other lock is taken while holding it
+static Mutex s_timerMutex(false,"ChannelTimers");
+
+// Number of one second slots in a driver's timer wheel
+#define TIMER_SLOTS 64
+
+// Size of the hash of channels by id in a driver
+#define CHAN_INDEX_SIZE 251
+
 // Mutex used to protect channel data
 Mutex Channel::s_chanDataMutex(false,"ChannelData");
 
 Channel::Channel(Driver* driver, const char* id, bool outgoing)
     : CallEndpoint(id),
       m_parameters(""), m_chanParams(0), m_driver(driver), m_outgoing(outgoing),
-      m_timeout(0), m_maxcall(0), m_maxPDD(0), m_dtmfTime(0),
+      m_timeout(0), m_maxcall(0), m_maxPDD(0), m_timerDue(0), m_dtmfTime(0),
       m_toutAns(0), m_dtmfSeq(0), m_answered(false)
 {
     init();
@@ -400,7 +488,7 @@ Channel::Channel(Driver* driver, const char* id, bool outgoing)
 Channel::Channel(Driver& driver, const char* id, bool outgoing)
     : CallEndpoint(id),
       m_parameters(""), m_chanParams(0), m_driver(&driver), m_outgoing(outgoing),
-      m_timeout(0), m_maxcall(0), m_maxPDD(0), m_dtmfTime(0),
+      m_timeout(0), m_maxcall(0), m_maxPDD(0), m_timerDue(0), m_dtmfTime(0),
       m_toutAns(0), m_dtmfSeq(0), m_answered(false)
 {
     init();
@@ -487,6 +575,7 @@ void Channel::initChan()
     m_driver->m_total++;
     m_driver->m_chanCount++;
     m_driver->channels().append(this);
+    m_driver->m_chanIndex.append(this)->setDelete(false);
     m_driver->changed();
 }
 
@@ -502,6 +591,12 @@ void Channel::dropChan()
 	    m_driver->m_chanCount--;
 	m_driver->changed();
     }
+    m_driver->m_chanIndex.remove(this,false,true);
+    s_timerMutex.lock();
+    if (m_timerDue && m_driver->m_timers)
+	m_driver->m_timers[(m_timerDue / 1000000) % TIMER_SLOTS].remove(this,false);
+    m_timerDue = 0;
+    s_timerMutex.unlock();
     m_driver->unlock();
 }
 
@@ -564,7 +659,13 @@ void Channel::dispatched(const Message& msg, bool handled)
 void Channel::setId(const char* newId)
 {
     debugName(0);
+    // keep the driver's hash of channels in sync with the new id
+    Lock lck(m_driver);
+    bool indexed = m_driver && m_driver->m_chanIndex.remove(this,false,true);
     CallEndpoint::setId(newId);
+    if (indexed)
+	m_driver->m_chanIndex.append(this)->setDelete(false);
+    lck.drop();
     debugName(id());
 }
 
@@ -628,6 +729,37 @@ void Channel::setMaxcall(const Message* msg, int defTout)
     }
 }
 
+void Channel::scheduleTimers(u_int64_t when)
+{
+    if (!when) {
+	when = m_timeout;
+	if (m_maxcall && (!when || (m_maxcall < when)))
+	    when = m_maxcall;
+	if (m_maxPDD && (!when || (m_maxPDD < when)))
+	    when = m_maxPDD;
+	if (!when)
+	    return;
+    }
+    Driver* drv = m_driver;
+    if (!(drv && alive()))
+	return;
+    Lock lck(s_timerMutex);
+    if (!drv->m_timers) {
+	drv->m_timers = new ObjList[TIMER_SLOTS];
+	drv->m_timerSec = Time::secNow();
+    }
+    // past times go in the slot checked next
+    if (when < drv->m_timerSec * 1000000)
+	when = drv->m_timerSec * 1000000;
+    if (m_timerDue) {
+	if (m_timerDue <= when)
+	    return;
+	drv->m_timers[(m_timerDue / 1000000) % TIMER_SLOTS].remove(this,false);
+    }
+    m_timerDue = when;
+    drv->m_timers[(when / 1000000) % TIMER_SLOTS].append(this)->setDelete(false);
+}
+
 void Channel::setMaxPDD(const Message& msg)
 {
     if (m_answered) {
@@ -704,10 +836,8 @@ bool Channel::startRouter(Message* msg)
     if (!msg)
 	return false;
     if (m_driver) {
-	Router* r = new Router(m_driver,id(),msg);
-	if (r->startup())
+	if (RouterPool::queue(m_driver,id(),msg))
 	    return true;
-	delete r;
     }
     else
 	TelEngine::destruct(msg);
@@ -1377,9 +1507,10 @@ bool Module::filterDebug(const String& item) const
 Driver::Driver(const char* name, const char* type)
     : Module(name,type),
       m_init(false), m_varchan(true),
+      m_chanIndex(CHAN_INDEX_SIZE), m_timers(0), m_timerSec(0),
       m_routing(0), m_routed(0), m_total(0),
       m_nextid(0), m_timeout(0),
-      m_maxroute(0), m_maxchans(0), m_chanCount(0),
+      m_maxroute(0), m_maxrouters(0), m_maxchans(0), m_chanCount(0),
       m_dtmfDups(false), m_doExpire(true)
 {
     m_prefix << name << "/";
@@ -1427,10 +1558,19 @@ bool Driver::isBusy() const
     return (m_routing || m_chanCount);
 }
 
+Driver::~Driver()
+{
+    s_timerMutex.lock();
+    ObjList* timers = m_timers;
+    m_timers = 0;
+    s_timerMutex.unlock();
+    delete[] timers;
+    RouterPool::forget(this);
+}
+
 Channel* Driver::find(const String& id) const
 {
-    const ObjList* pos = m_chans.find(id);
-    return pos ? static_cast<Channel*>(pos->get()) : 0;
+    return static_cast<Channel*>(m_chanIndex[id]);
 }
 
 bool Driver::received(Message &msg, int id)
@@ -1441,25 +1581,45 @@ bool Driver::received(Message &msg, int id)
     String dest;
     switch (id) {
 	case Timer:
-	    if (m_doExpire && lock(950000)) {
-		if (m_doExpire) {
+	    if (m_doExpire && m_timers) {
+		// collect channels from the wheel slots that became due
+		ObjList due;
+		Time t;
+		s_timerMutex.lock();
+		bool expire = m_doExpire && m_timers;
+		if (expire) {
 		    m_doExpire = false;
-		    // check each channel for timeouts
-		    ListIterator iter(m_chans);
-		    Time t;
-		    for (;;) {
-			RefPointer<Channel> c = static_cast<Channel*>(iter.get());
-			unlock();
-			if (!c)
-			    break;
+		    u_int64_t sec = t.sec();
+		    u_int64_t first = m_timerSec;
+		    if (sec >= first + TIMER_SLOTS)
+			first = sec - TIMER_SLOTS + 1;
+		    for (; first <= sec; first++) {
+			ObjList* l = m_timers[first % TIMER_SLOTS].skipNull();
+			while (l) {
+			    Channel* c = static_cast<Channel*>(l->get());
+			    if (c->m_timerDue >= t) {
+				l = l->skipNext();
+				continue;
+			    }
+			    c->m_timerDue = 0;
+			    l->remove(false);
+			    if (c->ref())
+				due.append(c);
+			    l = l->skipNull();
+			}
+		    }
+		    m_timerSec = sec;
+		}
+		s_timerMutex.unlock();
+		if (expire) {
+		    for (ObjList* l = due.skipNull(); l; l = l->skipNext()) {
+			Channel* c = static_cast<Channel*>(l->get());
 			c->checkTimers(msg,t);
-			c = 0;
-			lock();
+			c->scheduleTimers();
 		    }
+		    due.clear();
 		    m_doExpire = true;
 		}
-		else
-		    unlock();
 	    }
 	    return Module::received(msg,id);
 	case Status:
@@ -1646,6 +1806,7 @@ void Driver::statusParams(String& str)
     str << ",routing=" << m_routing;
     str << ",total=" << m_total;
     str << ",chans=" << m_chanCount;
+    RouterPool::status(this,str);
 }
 
 void Driver::statusDetail(String& str)
@@ -1707,6 +1868,9 @@ void Driver::loadLimits()
 {
     timeout(Engine::config().getIntValue(YSTRING("telephony"),"timeout"));
     maxRoute(Engine::config().getIntValue(YSTRING("telephony"),"maxroute"));
+    maxRouters(Engine::config().getIntValue(YSTRING("telephony"),"maxrouters",0,0));
+    RouterPool::setup(Engine::config().getIntValue(YSTRING("telephony"),"routethreads",128,1),
+	Engine::config().getIntValue(YSTRING("telephony"),"routeidle",5000,100));
     maxChans(Engine::config().getIntValue(YSTRING("telephony"),"maxchans"));
     dtmfDups(Engine::config().getBoolValue(YSTRING("telephony"),"dtmfdups"));
 }
@@ -1744,94 +1908,104 @@ void Router::run()
 
 bool Router::route()
 {
-    DDebug(m_driver,DebugAll,"Routing thread for '%s' [%p]",m_id.c_str(),this);
+    return RouterPool::route(m_driver,m_id,m_msg);
+}
+
+void Router::cleanup()
+{
+    destruct(m_msg);
+}
+
+bool RouterPool::route(Driver* driver, const String& id, Message* msg)
+{
+    DDebug(driver,DebugAll,"Routing '%s' [%p]",id.c_str(),msg);
 
     RefPointer<Channel> chan;
-    String tmp(m_msg->getValue(YSTRING("callto")));
+    String tmp(msg->getValue(YSTRING("callto")));
     bool ok = !tmp.null();
     if (ok)
-	m_msg->retValue() = tmp;
+	msg->retValue() = tmp;
     else {
-	if (*m_msg == YSTRING("call.preroute")) {
-	    ok = Engine::dispatch(m_msg);
-	    m_driver->lock();
-	    chan = m_driver->find(m_id);
-	    m_driver->unlock();
+	if (*msg == YSTRING("call.preroute")) {
+	    ok = Engine::dispatch(msg);
+	    driver->lock();
+	    chan = driver->find(id);
+	    driver->unlock();
 	    if (!chan) {
-		Debug(m_driver,DebugInfo,"Connection '%s' vanished while prerouting!",m_id.c_str());
+		Debug(driver,DebugInfo,"Connection '%s' vanished while prerouting!",id.c_str());
 		return false;
 	    }
-	    const String* cp = m_msg->getParam(s_copyParams);
+	    const String* cp = msg->getParam(s_copyParams);
 	    if (!TelEngine::null(cp)) {
 		Channel::paramMutex().lock();
-		chan->parameters().copyParams(*m_msg,*cp);
+		chan->parameters().copyParams(*msg,*cp);
 		Channel::paramMutex().unlock();
 	    }
-	    bool dropCall = ok && ((m_msg->retValue() == YSTRING("-")) || (m_msg->retValue() == YSTRING("error")));
+	    bool dropCall = ok && ((msg->retValue() == YSTRING("-")) || (msg->retValue() == YSTRING("error")));
 	    if (dropCall)
-		chan->callRejected(m_msg->getValue(YSTRING("error"),"unknown"),
-		    m_msg->getValue(YSTRING("reason")),m_msg);
+		chan->callRejected(msg->getValue(YSTRING("error"),"unknown"),
+		    msg->getValue(YSTRING("reason")),msg);
 	    else
-		dropCall = !chan->callPrerouted(*m_msg,ok);
+		dropCall = !chan->callPrerouted(*msg,ok);
 	    if (dropCall) {
 		// get rid of the dynamic chans
-		if (m_driver->varchan())
+		if (driver->varchan())
 		    chan->deref();
 		return false;
 	    }
 	    chan = 0;
-	    *m_msg = "call.route";
-	    m_msg->retValue().clear();
+	    *msg = "call.route";
+	    msg->retValue().clear();
 	    if (Engine::trackParam())
-		m_msg->clearParam(Engine::trackParam());
-	    m_msg->msgTime() = Time::now();
+		msg->clearParam(Engine::trackParam());
+	    msg->msgTime() = Time::now();
 	}
-	ok = Engine::dispatch(m_msg);
+	ok = Engine::dispatch(msg);
     }
 
-    m_driver->lock();
-    chan = m_driver->find(m_id);
-    m_driver->unlock();
+    driver->lock();
+    chan = driver->find(id);
+    driver->unlock();
 
     if (!chan) {
-	Debug(m_driver,DebugInfo,"Connection '%s' vanished while routing!",m_id.c_str());
+	Debug(driver,DebugInfo,"Connection '%s' vanished while routing!",id.c_str());
 	return false;
     }
     // chan will keep it referenced even if message user data is changed
-    m_msg->userData(chan);
+    msg->userData(chan);
 
     static const char s_noroute[] = "noroute";
     static const char s_looping[] = "looping";
     static const char s_noconn[] = "noconn";
 
-    if (ok && m_msg->retValue().trimSpaces()) {
-	if ((m_msg->retValue() == YSTRING("-")) || (m_msg->retValue() == YSTRING("error")))
-	    chan->callRejected(m_msg->getValue(YSTRING("error"),"unknown"),
-		m_msg->getValue("reason"),m_msg);
-	else if (m_msg->getIntValue(YSTRING("antiloop"),1) <= 0) {
-	    const char* error = m_msg->getValue(YSTRING("error"),s_looping);
-	    chan->callRejected(error,m_msg->getValue(YSTRING("reason"),
-		((s_looping == error) ? "Call is looping" : (const char*)0)),m_msg);
+    if (ok && msg->retValue().trimSpaces()) {
+	if ((msg->retValue() == YSTRING("-")) || (msg->retValue() == YSTRING("error")))
+	    chan->callRejected(msg->getValue(YSTRING("error"),"unknown"),
+		msg->getValue("reason"),msg);
+	else if (msg->getIntValue(YSTRING("antiloop"),1) <= 0) {
+	    const char* error = msg->getValue(YSTRING("error"),s_looping);
+	    chan->callRejected(error,msg->getValue(YSTRING("reason"),
+		((s_looping == error) ? "Call is looping" : (const char*)0)),msg);
 	}
-	else if (chan->callRouted(*m_msg)) {
-	    *m_msg = "call.execute";
-	    m_msg->setParam("callto",m_msg->retValue());
-	    m_msg->clearParam(YSTRING("error"));
-	    m_msg->retValue().clear();
+	else if (chan->callRouted(*msg)) {
+	    *msg = "call.execute";
+	    msg->setParam("callto",msg->retValue());
+	    msg->clearParam(YSTRING("error"));
+	    msg->retValue().clear();
 	    if (Engine::trackParam())
-		m_msg->clearParam(Engine::trackParam());
-	    m_msg->msgTime() = Time::now();
-	    ok = Engine::dispatch(m_msg);
+		msg->clearParam(Engine::trackParam());
+	    msg->msgTime() = Time::now();
+	    ok = Engine::dispatch(msg);
 	    if (ok)
-		chan->callAccept(*m_msg);
+		chan->callAccept(*msg);
 	    else {
-		const char* error = m_msg->getValue(YSTRING("error"),s_noconn);
-		const char* reason = m_msg->getValue(YSTRING("reason"),
+		const char* error = msg->getValue(YSTRING("error"),s_noconn);
+		const char* reason = msg->getValue(YSTRING("reason"),
 		    ((s_noconn == error) ? "Could not connect to target" : (const char*)0));
 		Message m(s_disconnected);
-		const String* cp = m_msg->getParam(s_copyParams);
+		const String* cp = msg->getParam(s_copyParams);
 		if (!TelEngine::null(cp))
-		    m.copyParams(*m_msg,*cp);
+		    m.copyParams(*msg,*cp);
 		chan->complete(m);
 		m.setParam("error",error);
 		m.setParam("reason",reason);
@@ -1839,25 +2013,246 @@ bool Router::route()
 		m.userData(chan);
 		m.setNotify();
 		if (!Engine::dispatch(m))
-		    chan->callRejected(error,reason,m_msg);
+		    chan->callRejected(error,reason,msg);
 	    }
 	}
     }
     else {
-	const char* error = m_msg->getValue(YSTRING("error"),s_noroute);
-	chan->callRejected(error,m_msg->getValue(YSTRING("reason"),
-	    ((s_noroute == error) ? "No route to call target" : (const char*)0)),m_msg);
+	const char* error = msg->getValue(YSTRING("error"),s_noroute);
+	chan->callRejected(error,msg->getValue(YSTRING("reason"),
+	    ((s_noroute == error) ? "No route to call target" : (const char*)0)),msg);
     }
 
     // dereference again if the channel is dynamic
-    if (m_driver->varchan())
+    if (driver->varchan())
 	chan->deref();
     return ok;
 }
 
-void Router::cleanup()
+void RouterThread::run()
 {
-    destruct(m_msg);
+    RouterPool::work(this);
+}
+
+void RouterThread::cleanup()
+{
+    if (m_counted) {
+	s_poolMutex.lock();
+	m_counted = false;
+	if (!--s_poolThreads && Engine::exiting())
+	    RouterPool::drain();
+	else
+	    s_poolMutex.unlock();
+    }
+    TelEngine::destruct(m_job);
+}
+
+
+void RouterPool::setup(int threads, int idleMs)
+{
+    Lock mylock(s_poolMutex);
+    s_poolMax = threads;
+    s_poolIdle = 1000 * (u_int64_t)idleMs;
+}
+
+RouterStats* RouterPool::stats(Driver* driver)
+{
+    for (ObjList* l = s_poolStats.skipNull(); l; l = l->skipNext()) {
+	RouterStats* st = static_cast<RouterStats*>(l->get());
+	if (st->m_driver == driver)
+	    return st;
+    }
+    RouterStats* st = new RouterStats(driver);
+    s_poolStats.append(st);
+    return st;
+}
+
+// Drop the calls of a driver that is going away, running jobs keep their stats
+void RouterPool::forget(const Driver* driver)
+{
+    ObjList dropped;
+    Lock mylock(s_poolMutex);
+    for (ObjList* l = s_poolJobs.skipNull(); l; ) {
+	if (static_cast<RouterJob*>(l->get())->m_driver == driver) {
+	    dropped.append(l->remove(false));
+	    l = l->skipNull();
+	}
+	else
+	    l = l->skipNext();
+    }
+    s_poolTail = s_poolJobs.last();
+    for (ObjList* l = s_poolStats.skipNull(); l; l = l->skipNext()) {
+	if (static_cast<RouterStats*>(l->get())->m_driver == driver) {
+	    l->remove();
+	    break;
+	}
+    }
+    mylock.drop();
+    if (dropped.skipNull())
+	Debug(DebugMild,"Dropped %u queued calls of a removed driver",dropped.count());
+}
+
+void RouterPool::status(const Driver* driver, String& str)
+{
+    Lock mylock(s_poolMutex);
+    for (ObjList* l = s_poolStats.skipNull(); l; l = l->skipNext()) {
+	const RouterStats* st = static_cast<const RouterStats*>(l->get());
+	if (st->m_driver != driver)
+	    continue;
+	str << ",routequeue=" << st->m_queued;
+	str << ",routewait=" << (unsigned int)(st->m_jobs ? (st->m_waitTotal / st->m_jobs / 1000) : 0);
+	str << ",routewaitmax=" << (unsigned int)(st->m_waitMax / 1000);
+	return;
+    }
+    str << ",routequeue=0,routewait=0,routewaitmax=0";
+}
+
+// Queue a call for routing, the routing counter includes queued calls
+bool RouterPool::queue(Driver* driver, const String& id, Message* msg)
+{
+    driver->lock();
+    driver->m_routing++;
+    driver->changed();
+    driver->unlock();
+    Lock mylock(s_poolMutex);
+    RouterStats* st = stats(driver);
+    RouterJob* job = new RouterJob(driver,id,msg,st);
+    s_poolTail = s_poolTail->append(job);
+    st->m_queued++;
+    // prefer waking up an idle thread, create a new one only if allowed
+    if (s_poolWaiting > s_poolSignals) {
+	s_poolSignals++;
+	s_poolSem.unlock();
+	return true;
+    }
+    // no new thread if the driver's queued calls already fill its limit
+    if ((s_poolThreads >= s_poolMax) || (st->m_driver->m_maxrouters &&
+	    (st->m_running + st->m_queued > st->m_driver->m_maxrouters)))
+	return true;
+    RouterThread* t = new RouterThread;
+    if (t->startup()) {
+	s_poolThreads++;
+	return true;
+    }
+    t->m_counted = false;
+    delete t;
+    // busy threads will pick up the job later
+    if (s_poolThreads)
+	return true;
+    Debug(driver,DebugWarn,"Could not start a routing thread for '%s'",id.c_str());
+    st->m_queued--;
+    s_poolJobs.remove(job,false);
+    s_poolTail = s_poolJobs.last();
+    mylock.drop();
+    TelEngine::destruct(job);
+    driver->lock();
+    driver->m_routing--;
+    driver->changed();
+    driver->unlock();
+    return false;
+}
+
+// Take the oldest queued job whose driver is below its routing threads limit
+// Must be called with the pool mutex locked
+RouterJob* RouterPool::get()
+{
+    for (ObjList* l = s_poolJobs.skipNull(); l; l = l->skipNext()) {
+	RouterJob* job = static_cast<RouterJob*>(l->get());
+	RouterStats* st = job->m_stats;
+	if (!runnable(st))
+	    continue;
+	l->remove(false);
+	if (!l->next())
+	    s_poolTail = l;
+	st->m_queued--;
+	st->m_running++;
+	u_int64_t wait = Time::now() - job->m_queued;
+	st->m_jobs++;
+	st->m_waitTotal += wait;
+	if (st->m_waitMax < wait)
+	    st->m_waitMax = wait;
+	return job;
+    }
+    return 0;
+}
+
+void RouterPool::done(RouterJob* job, bool ok)
+{
+    Driver* driver = job->m_driver;
+    s_poolMutex.lock();
+    job->m_stats->m_running--;
+    s_poolMutex.unlock();
+    TelEngine::destruct(job);
+    driver->lock();
+    driver->m_routing--;
+    if (ok)
+	driver->m_routed++;
+    driver->changed();
+    driver->unlock();
+}
+
+// Drop all queued jobs when the last routing thread exits on cancel
+// Must be called with the pool mutex locked, returns with it unlocked
+void RouterPool::drain()
+{
+    ObjList jobs;
+    while (ObjList* l = s_poolJobs.skipNull())
+	jobs.append(l->remove(false));
+    s_poolTail = &s_poolJobs;
+    for (ObjList* l = jobs.skipNull(); l; l = l->skipNext())
+	static_cast<RouterJob*>(l->get())->m_stats->m_queued--;
+    s_poolMutex.unlock();
+    while (ObjList* l = jobs.skipNull()) {
+	RouterJob* job = static_cast<RouterJob*>(l->remove(false));
+	Driver* driver = job->m_driver;
+	Debug(driver,DebugMild,"Dropping queued call '%s' on exit",job->m_id.c_str());
+	TelEngine::destruct(job);
+	driver->lock();
+	driver->m_routing--;
+	driver->changed();
+	driver->unlock();
+    }
+}
+
+// Routing thread loop, exits after staying idle for the configured interval
+void RouterPool::work(RouterThread* thread)
+{
+    u_int64_t idleSince = Time::now();
+    for (;;) {
+	s_poolMutex.lock();
+	thread->m_job = get();
+	if (!thread->m_job) {
+	    u_int64_t now = Time::now();
+	    bool cancel = Thread::check(false);
+	    if ((now >= idleSince + s_poolIdle) || (s_poolThreads > s_poolMax) || cancel) {
+		thread->m_counted = false;
+		if (!--s_poolThreads && (cancel || Engine::exiting()))
+		    drain();
+		else
+		    s_poolMutex.unlock();
+		return;
+	    }
+	    s_poolWaiting++;
+	    s_poolMutex.unlock();
+	    // wake up periodically so the thread can be cancelled on exit
+	    u_int64_t wait = idleSince + s_poolIdle - now;
+	    if (wait > 500000)
+		wait = 500000;
+	    bool signaled = s_poolSem.lock((long)wait);
+	    s_poolMutex.lock();
+	    s_poolWaiting--;
+	    if (signaled && (s_poolSignals > 0))
+		s_poolSignals--;
+	    s_poolMutex.unlock();
+	    continue;
+	}
+	s_poolMutex.unlock();
+	RouterJob* job = thread->m_job;
+	bool ok = route(job->m_driver,job->m_id,job->m_msg);
+	thread->m_job = 0;
+	done(job,ok);
+	idleSince = Time::now();
+    }
 }
 
 
@@ -22,6 +22,14 @@
 #include <string.h>
 #include <stdlib.h>
 
+// AVX2 G.711 kernels are built for x86 and selected at runtime
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || \
+    (defined(__GNUC__) && ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)))))
+#define G711_AVX2
+#include <immintrin.h>
+#define AVX2_KERNEL __attribute__((target("avx2")))
+#endif
+
 using namespace TelEngine;
 
 namespace { // anonymous
@@ -32,10 +40,18 @@ extern "C" {
 #include "u2a.h"
 #include "u2s.h"
 
-static unsigned char s2a[65536];
-static unsigned char s2u[65536];
+// extra 3 bytes allow 32 bit gathers from the last entry
+static unsigned char s2a[65536 + 3];
+static unsigned char s2u[65536 + 3];
 }
 
+#ifdef G711_AVX2
+static bool s_avx2 = false;
+// copies of the A-law / mu-law tables padded for gathers
+static unsigned char s_a2u[256 + 3];
+static unsigned char s_u2a[256 + 3];
+#endif
+
 class InitG711
 {
 public:
@@ -68,11 +84,131 @@ public:
 		val = (--v) ^ 0xd5;
 	    s2a[i] = val;
 	}
+#ifdef G711_AVX2
+	__builtin_cpu_init();
+	s_avx2 = __builtin_cpu_supports("avx2");
+	::memcpy(s_a2u,a2u,256);
+	::memcpy(s_u2a,u2a,256);
+#endif
     }
 };
 
 static InitG711 s_initG711;
 
+#ifdef G711_AVX2
+// The kernels below compute exactly the same values as the conversion tables
+// Linear values are processed as 8 lanes of 32 bits
+
+// Pack two vectors of 32 bit lanes into 16 ordered 16 bit values
+static inline AVX2_KERNEL __m256i avxPack16(__m256i a, __m256i b)
+{
+    return _mm256_permute4x64_epi64(_mm256_packs_epi32(a,b),0xd8);
+}
+
+// Negate the lanes where mask is set
+static inline AVX2_KERNEL __m256i avxNegate(__m256i v, __m256i mask)
+{
+    return _mm256_sub_epi32(_mm256_xor_si256(v,mask),mask);
+}
+
+// Magnitude decoded from a 7 bit A-law code
+static inline AVX2_KERNEL __m256i avxLevelA(__m256i k)
+{
+    __m256i e = _mm256_srli_epi32(k,4);
+    __m256i t = _mm256_add_epi32(_mm256_slli_epi32(_mm256_and_si256(k,_mm256_set1_epi32(15)),4),
+	_mm256_set1_epi32(8));
+    // segments above first add the leading bit and shift by segment - 1
+    __m256i nz = _mm256_cmpgt_epi32(e,_mm256_setzero_si256());
+    t = _mm256_add_epi32(t,_mm256_and_si256(nz,_mm256_set1_epi32(0x100)));
+    return _mm256_sllv_epi32(t,_mm256_add_epi32(e,nz));
+}
+
+// Magnitude decoded from a 7 bit mu-law code
+static inline AVX2_KERNEL __m256i avxLevelU(__m256i k)
+{
+    __m256i t = _mm256_add_epi32(_mm256_slli_epi32(_mm256_and_si256(k,_mm256_set1_epi32(15)),3),
+	_mm256_set1_epi32(0x84));
+    return _mm256_sub_epi32(_mm256_sllv_epi32(t,_mm256_srli_epi32(k,4)),_mm256_set1_epi32(0x84));
+}
+
+static inline AVX2_KERNEL __m256i avxDecodeA(__m256i a)
+{
+    __m256i x = _mm256_xor_si256(a,_mm256_set1_epi32(0x55));
+    __m256i t = avxLevelA(_mm256_and_si256(x,_mm256_set1_epi32(0x7f)));
+    // sign bit clear means negative
+    return avxNegate(t,_mm256_cmpeq_epi32(_mm256_and_si256(x,_mm256_set1_epi32(0x80)),
+	_mm256_setzero_si256()));
+}
+
+static inline AVX2_KERNEL __m256i avxDecodeU(__m256i u)
+{
+    __m256i x = _mm256_xor_si256(u,_mm256_set1_epi32(0xff));
+    __m256i t = avxLevelU(_mm256_and_si256(x,_mm256_set1_epi32(0x7f)));
+    __m256i sign = _mm256_set1_epi32(0x80);
+    return avxNegate(t,_mm256_cmpeq_epi32(_mm256_and_si256(x,sign),sign));
+}
+
+// Each kernel converts blocks of samples and returns how many it processed
+
+static AVX2_KERNEL unsigned int avxLawToSlin(const unsigned char* s, short* d, unsigned int len, bool alaw)
+{
+    unsigned int n = len & ~15;
+    for (unsigned int i = 0; i < n; i += 16) {
+	__m128i v = _mm_loadu_si128((const __m128i*)(s + i));
+	__m256i a = _mm256_cvtepu8_epi32(v);
+	__m256i b = _mm256_cvtepu8_epi32(_mm_srli_si128(v,8));
+	if (alaw) {
+	    a = avxDecodeA(a);
+	    b = avxDecodeA(b);
+	}
+	else {
+	    a = avxDecodeU(a);
+	    b = avxDecodeU(b);
+	}
+	_mm256_storeu_si256((__m256i*)(d + i),avxPack16(a,b));
+    }
+    return n;
+}
+
+// Gather 8 bytes from a table padded with 3 extra bytes
+static inline AVX2_KERNEL __m256i avxLookup(const unsigned char* table, __m256i index)
+{
+    return _mm256_and_si256(_mm256_i32gather_epi32((const int*)table,index,1),_mm256_set1_epi32(0xff));
+}
+
+// Store 16 byte values held in two vectors of 32 bit lanes
+static inline AVX2_KERNEL void avxStoreBytes(unsigned char* d, __m256i a, __m256i b)
+{
+    __m256i p = avxPack16(a,b);
+    _mm_storeu_si128((__m128i*)d,_mm_packus_epi16(_mm256_castsi256_si128(p),
+	_mm256_extracti128_si256(p,1)));
+}
+
+static AVX2_KERNEL unsigned int avxSlinToLaw(const short* s, unsigned char* d, unsigned int len,
+    const unsigned char* table)
+{
+    unsigned int n = len & ~15;
+    for (unsigned int i = 0; i < n; i += 16) {
+	__m256i v = _mm256_loadu_si256((const __m256i*)(s + i));
+	avxStoreBytes(d + i,avxLookup(table,_mm256_cvtepu16_epi32(_mm256_castsi256_si128(v))),
+	    avxLookup(table,_mm256_cvtepu16_epi32(_mm256_extracti128_si256(v,1))));
+    }
+    return n;
+}
+
+static AVX2_KERNEL unsigned int avxLawToLaw(const unsigned char* s, unsigned char* d, unsigned int len,
+    const unsigned char* table)
+{
+    unsigned int n = len & ~15;
+    for (unsigned int i = 0; i < n; i += 16) {
+	__m128i v = _mm_loadu_si128((const __m128i*)(s + i));
+	avxStoreBytes(d + i,avxLookup(table,_mm256_cvtepu8_epi32(v)),
+	    avxLookup(table,_mm256_cvtepu8_epi32(_mm_srli_si128(v,8))));
+    }
+    return n;
+}
+#endif
+
 }; // anonymous namespace
 
 static const DataBlock s_empty;
@@ -334,11 +470,22 @@ bool DataBlock::convert(const DataBlock& src, const String& sFormat,
 	clear();
 	return true;
     }
-    resize(len * dl);
+    // keep the current buffer if large enough, it's overwritten anyway
+    resize(len * dl,false,false);
+#ifdef G711_AVX2
+    unsigned int done = 0;
+#endif
     if ((sl == 1) && (dl == 1)) {
 	unsigned char *s = (unsigned char *) src.data();
 	unsigned char *d = (unsigned char *) data();
 	unsigned char *c = (unsigned char *) ctable;
+#ifdef G711_AVX2
+	if (s_avx2)
+	    done = avxLawToLaw(s,d,len,(c == a2u) ? s_a2u : s_u2a);
+	s += done;
+	d += done;
+	len -= done;
+#endif
 	while (len--)
 	    *d++ = c[*s++];
     }
@@ -346,6 +493,13 @@ bool DataBlock::convert(const DataBlock& src, const String& sFormat,
 	unsigned char *s = (unsigned char *) src.data();
 	unsigned short *d = (unsigned short *) data();
 	unsigned short *c = (unsigned short *) ctable;
+#ifdef G711_AVX2
+	if (s_avx2)
+	    done = avxLawToSlin(s,(short*)d,len,(c == a2s));
+	s += done;
+	d += done;
+	len -= done;
+#endif
 	while (len--)
 	    *d++ = c[*s++];
     }
@@ -353,6 +507,13 @@ bool DataBlock::convert(const DataBlock& src, const String& sFormat,
 	unsigned short *s = (unsigned short *) src.data();
 	unsigned char *d = (unsigned char *) data();
 	unsigned char *c = (unsigned char *) ctable;
+#ifdef G711_AVX2
+	if (s_avx2)
+	    done = avxSlinToLaw((const short*)s,d,len,c);
+	s += done;
+	d += done;
+	len -= done;
+#endif
 	while (len--)
 	    *d++ = c[*s++];
     }
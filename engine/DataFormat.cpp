@@ -21,6 +21,21 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// AVX2 filter kernel is built for x86 and selected at runtime
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || \
+    (defined(__GNUC__) && ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)))))
+#define POLY_AVX2
+#include <immintrin.h>
+#define AVX2_KERNEL __attribute__((target("avx2")))
+#endif
 
 namespace TelEngine {
 
@@ -46,6 +61,8 @@ static const FormatInfo s_formats[] = {
     FormatInfo("g729", 10, 10000),
     FormatInfo("plain", 0, 0, "text", 0),
     FormatInfo("raw", 0, 0, "data", 0),
+    FormatInfo("slin/44100", 882, 10000, "audio", 44100, 1, true),
+    FormatInfo("slin/48000", 960, 10000, "audio", 48000, 1, true),
 };
 
 // FIXME: put proper conversion costs everywhere below
@@ -96,6 +113,30 @@ static TranslatorCaps s_resampCaps[] = {
     { 0, 0, 0 }
 };
 
+static TranslatorCaps s_polyCaps[] = {
+    { s_formats+0, s_formats+3, 1 },
+    { s_formats+0, s_formats+6, 1 },
+    { s_formats+0, s_formats+20, 1 },
+    { s_formats+0, s_formats+21, 1 },
+    { s_formats+3, s_formats+0, 1 },
+    { s_formats+3, s_formats+6, 1 },
+    { s_formats+3, s_formats+20, 1 },
+    { s_formats+3, s_formats+21, 1 },
+    { s_formats+6, s_formats+0, 1 },
+    { s_formats+6, s_formats+3, 1 },
+    { s_formats+6, s_formats+20, 1 },
+    { s_formats+6, s_formats+21, 1 },
+    { s_formats+20, s_formats+0, 1 },
+    { s_formats+20, s_formats+3, 1 },
+    { s_formats+20, s_formats+6, 1 },
+    { s_formats+20, s_formats+21, 1 },
+    { s_formats+21, s_formats+0, 1 },
+    { s_formats+21, s_formats+3, 1 },
+    { s_formats+21, s_formats+6, 1 },
+    { s_formats+21, s_formats+20, 1 },
+    { 0, 0, 0 }
+};
+
 static TranslatorCaps s_stereoCaps[] = {
     { s_formats+0, s_formats+9, 1 },
     { s_formats+9, s_formats+0, 2 },
@@ -246,6 +287,262 @@ public:
 	}
 };
 
+// Number of fractional bits of the polyphase filter coefficients
+#define POLY_SHIFT 14
+// Filter taps per phase for each integer step of decimation, multiple of 16
+#define POLY_TAPS 16
+
+// Multiply-accumulate one filter phase, taps must be a multiple of 8
+static inline int polyDot(const short* coef, const short* data, unsigned int taps)
+{
+#ifdef __SSE2__
+    __m128i acc = _mm_setzero_si128();
+    for (unsigned int i = 0; i < taps; i += 8)
+	acc = _mm_add_epi32(acc,_mm_madd_epi16(_mm_loadu_si128((const __m128i*)(coef + i)),
+	    _mm_loadu_si128((const __m128i*)(data + i))));
+    acc = _mm_add_epi32(acc,_mm_shuffle_epi32(acc,_MM_SHUFFLE(1,0,3,2)));
+    acc = _mm_add_epi32(acc,_mm_shuffle_epi32(acc,_MM_SHUFFLE(2,3,0,1)));
+    return _mm_cvtsi128_si32(acc);
+#elif defined(__ARM_NEON)
+    int32x4_t acc = vdupq_n_s32(0);
+    for (unsigned int i = 0; i < taps; i += 4)
+	acc = vmlal_s16(acc,vld1_s16(coef + i),vld1_s16(data + i));
+    return vgetq_lane_s32(acc,0) + vgetq_lane_s32(acc,1) +
+	vgetq_lane_s32(acc,2) + vgetq_lane_s32(acc,3);
+#else
+    int acc = 0;
+    for (unsigned int i = 0; i < taps; i++)
+	acc += (int)coef[i] * data[i];
+    return acc;
+#endif
+}
+
+// Round, scale and saturate a filter result
+static inline short polyResult(int v)
+{
+    v = (v + (1 << (POLY_SHIFT - 1))) >> POLY_SHIFT;
+    if (v > 32767)
+	return 32767;
+    if (v < -32768)
+	return -32768;
+    return v;
+}
+
+#ifdef POLY_AVX2
+static bool s_polyAvx2 = false;
+
+// Multiply-accumulate one filter phase, taps must be a multiple of 16
+static inline AVX2_KERNEL int polyDotAvx2(const short* coef, const short* data, unsigned int taps)
+{
+    __m256i acc = _mm256_setzero_si256();
+    for (unsigned int i = 0; i < taps; i += 16)
+	acc = _mm256_add_epi32(acc,_mm256_madd_epi16(_mm256_loadu_si256((const __m256i*)(coef + i)),
+	    _mm256_loadu_si256((const __m256i*)(data + i))));
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc),_mm256_extracti128_si256(acc,1));
+    sum = _mm_add_epi32(sum,_mm_shuffle_epi32(sum,_MM_SHUFFLE(1,0,3,2)));
+    sum = _mm_add_epi32(sum,_mm_shuffle_epi32(sum,_MM_SHUFFLE(2,3,0,1)));
+    return _mm_cvtsi128_si32(sum);
+}
+#endif
+
+// Zero order modified Bessel function, used for the Kaiser window
+static double besselI0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 50; k++) {
+	term *= (x / (2 * k)) * (x / (2 * k));
+	sum += term;
+	if (term < sum * 1e-12)
+	    break;
+    }
+    return sum;
+}
+
+// Kaiser windowed sinc lowpass filter split in phases, shared by all
+//  resamplers converting with the same rate ratio
+class PolyphaseFilter : public GenObject
+{
+public:
+    PolyphaseFilter(unsigned int up, unsigned int down);
+    virtual ~PolyphaseFilter()
+	{ delete[] m_coefs; }
+    inline unsigned int up() const
+	{ return m_up; }
+    inline unsigned int down() const
+	{ return m_down; }
+    inline unsigned int taps() const
+	{ return m_taps; }
+    // Coefficients of a phase, stored in reverse order
+    inline const short* phase(unsigned int index) const
+	{ return m_coefs + index * m_taps; }
+    static const PolyphaseFilter* get(int sRate, int dRate);
+private:
+    unsigned int m_up;
+    unsigned int m_down;
+    unsigned int m_taps;
+    short* m_coefs;
+};
+
+static ObjList s_polyFilters;
+static Mutex s_polyMutex(false,"PolyphaseFilter");
+
+PolyphaseFilter::PolyphaseFilter(unsigned int up, unsigned int down)
+    : m_up(up), m_down(down), m_taps(POLY_TAPS), m_coefs(0)
+{
+    // keep the same filter span in output samples when decimating
+    if (down > up)
+	m_taps *= (down + up - 1) / up;
+    unsigned int len = m_taps * up;
+    double* h = new double[len];
+    // cutoff slightly below the lowest Nyquist frequency, in upsampled rate
+    double fc = 0.46 / ((up > down) ? up : down);
+    const double beta = 7.0;
+    double norm = besselI0(beta);
+    double center = (len - 1) / 2.0;
+    double sum = 0;
+    for (unsigned int n = 0; n < len; n++) {
+	double x = n - center;
+	double v = (x == 0) ? (2 * fc) : (::sin(2 * M_PI * fc * x) / (M_PI * x));
+	double r = x / center;
+	v *= besselI0(beta * ::sqrt(1.0 - r * r)) / norm;
+	h[n] = v;
+	sum += v;
+    }
+    // unity gain for each phase after upsampling
+    double scale = (1 << POLY_SHIFT) * up / sum;
+    m_coefs = new short[len];
+    for (unsigned int p = 0; p < up; p++) {
+	short* c = m_coefs + p * m_taps;
+	for (unsigned int k = 0; k < m_taps; k++) {
+	    double v = ::floor(h[p + k * up] * scale + 0.5);
+	    if (v > 32767)
+		v = 32767;
+	    else if (v < -32768)
+		v = -32768;
+	    c[m_taps - 1 - k] = (short)v;
+	}
+    }
+    delete[] h;
+}
+
+const PolyphaseFilter* PolyphaseFilter::get(int sRate, int dRate)
+{
+    if ((sRate <= 0) || (dRate <= 0) || (sRate == dRate))
+	return 0;
+    unsigned int a = sRate;
+    unsigned int b = dRate;
+    while (b) {
+	unsigned int t = a % b;
+	a = b;
+	b = t;
+    }
+    unsigned int up = dRate / a;
+    unsigned int down = sRate / a;
+    Lock mylock(s_polyMutex);
+    for (ObjList* l = s_polyFilters.skipNull(); l; l = l->skipNext()) {
+	const PolyphaseFilter* f = static_cast<const PolyphaseFilter*>(l->get());
+	if ((f->up() == up) && (f->down() == down))
+	    return f;
+    }
+    PolyphaseFilter* f = new PolyphaseFilter(up,down);
+    s_polyFilters.append(f);
+    return f;
+}
+
+// slin polyphase FIR mono resampler
+class PolyphaseTranslator : public DataTranslator
+{
+private:
+    const PolyphaseFilter* m_filter;
+    int m_sRate, m_dRate;
+    unsigned int m_pos;
+    unsigned int m_hist;
+    u_int64_t m_tsRem;
+    DataBlock m_work;
+    DataBlock m_buffer;
+public:
+    PolyphaseTranslator(const DataFormat& sFormat, const DataFormat& dFormat, const PolyphaseFilter* filter)
+	: DataTranslator(sFormat,dFormat), m_filter(filter),
+	m_sRate(sFormat.sampleRate()), m_dRate(dFormat.sampleRate()),
+	m_pos(0), m_hist(filter->taps() - 1), m_tsRem(0)
+	{
+	    // start with a history of silence
+	    m_work.assign(0,2 * m_hist);
+	    m_pos = m_hist * filter->up();
+	}
+    virtual unsigned long Consume(const DataBlock& data, unsigned long tStamp, unsigned long flags)
+	{
+	    unsigned int n = data.length();
+	    if (!n || (n & 1) || !ref())
+		return 0;
+	    unsigned long len = 0;
+	    n /= 2;
+	    DataSource* src = getTransSource();
+	    if (src) {
+		unsigned int up = m_filter->up();
+		unsigned int down = m_filter->down();
+		unsigned int taps = m_filter->taps();
+		// append the new samples to the ones kept from previous packets
+		unsigned int total = m_hist + n;
+		m_work.resize(2 * total,true,false);
+		short* s = (short*) m_work.data();
+		::memcpy(s + m_hist,data.data(),2 * n);
+		unsigned int end = total * up;
+		unsigned int cnt = (m_pos < end) ? ((end - 1 - m_pos) / down + 1) : 0;
+		m_buffer.resize(2 * cnt,false,false);
+		short* d = (short*) m_buffer.data();
+#ifdef POLY_AVX2
+		if (s_polyAvx2)
+		    m_pos = filterAvx2(s,d,cnt);
+		else
+#endif
+		for (unsigned int i = 0; i < cnt; i++) {
+		    *d++ = polyResult(polyDot(m_filter->phase(m_pos % up),s + (m_pos / up) + 1 - taps,taps));
+		    m_pos += down;
+		}
+		// keep only the samples still needed by the filter
+		unsigned int used = (m_pos / up) + 1 - taps;
+		if (used > total)
+		    used = total;
+		m_hist = total - used;
+		if (m_hist && used)
+		    ::memmove(s,s + used,2 * m_hist);
+		m_pos -= used * up;
+		long delta = tStamp - m_timestamp;
+		if (delta > 0) {
+		    u_int64_t t = m_tsRem + (u_int64_t)delta * m_dRate;
+		    delta = (long)(t / m_sRate);
+		    m_tsRem = t % m_sRate;
+		}
+		else
+		    delta = (long)(((int64_t)delta * m_dRate) / m_sRate);
+		if (src->timeStamp() != invalidStamp())
+		    delta += src->timeStamp();
+		if (cnt)
+		    len = src->Forward(m_buffer,delta,flags);
+	    }
+	    deref();
+	    return len;
+	}
+private:
+#ifdef POLY_AVX2
+    // Compute output samples starting at the current position, return the new one
+    AVX2_KERNEL unsigned int filterAvx2(const short* s, short* d, unsigned int cnt) const
+	{
+	    unsigned int up = m_filter->up();
+	    unsigned int down = m_filter->down();
+	    unsigned int taps = m_filter->taps();
+	    unsigned int pos = m_pos;
+	    for (unsigned int i = 0; i < cnt; i++) {
+		*d++ = polyResult(polyDotAvx2(m_filter->phase(pos % up),s + (pos / up) + 1 - taps,taps));
+		pos += down;
+	    }
+	    return pos;
+	}
+#endif
+};
+
 // slin simple mono-stereo converter
 class StereoTranslator : public DataTranslator
 {
@@ -324,6 +621,27 @@ public:
 	{ return s_resampCaps; }
 };
 
+class PolyphaseFactory : public TranslatorFactory
+{
+public:
+    PolyphaseFactory() : TranslatorFactory("polyphase")
+	{
+#ifdef POLY_AVX2
+	    __builtin_cpu_init();
+	    s_polyAvx2 = __builtin_cpu_supports("avx2");
+#endif
+	}
+    virtual DataTranslator* create(const DataFormat& sFormat, const DataFormat& dFormat)
+	{
+	    if (!converts(sFormat,dFormat))
+		return 0;
+	    const PolyphaseFilter* filter = PolyphaseFilter::get(sFormat.sampleRate(),dFormat.sampleRate());
+	    return filter ? new PolyphaseTranslator(sFormat,dFormat,filter) : 0;
+	}
+    virtual const TranslatorCaps* getCapabilities() const
+	{ return s_polyCaps; }
+};
+
 class StereoFactory : public TranslatorFactory
 {
 public:
@@ -387,6 +705,7 @@ typedef struct _flist {
 } flist;
 
 static flist* s_flist = 0;
+static unsigned int s_flistCount = 0;
 
 const FormatInfo* FormatRepository::getFormat(const String& name)
 {
@@ -430,6 +749,7 @@ const FormatInfo* FormatRepository::addFormat(const String& name, int fsize, int
     l->info = f;
     l->next = s_flist;
     s_flist = l;
+    s_flistCount++;
     return f;
 }
 
@@ -1205,10 +1525,100 @@ static ObjList s_compose;
 static SimpleFactory s_sFactory(s_simpleCaps,"g711");
 static SimpleFactory s_sFactory16k(s_simpleCaps16k,"g711wb");
 static SimpleFactory s_sFactory32k(s_simpleCaps32k,"g711uwb");
+// installed first so it is preferred over the basic resampler
+static PolyphaseFactory s_pFactory;
 // FIXME
 static ResampFactory s_rFactory;
 static StereoFactory s_stereoFactory;
 
+// Cell of the conversion cost matrix: cheapest cost of converting between
+//  two formats and the first factory in install order that converts them
+struct TranslatorPlan
+{
+    TranslatorFactory* factory;
+    int cost;
+};
+
+// Matrix over all known formats, rebuilt when factories or formats change
+static const unsigned int s_planStatic = sizeof(s_formats)/sizeof(FormatInfo);
+static TranslatorPlan* s_plans = 0;
+static const FormatInfo** s_planFormats = 0;
+static unsigned int s_planSize = 0;
+static bool s_planValid = false;
+static u_int64_t s_planHits = 0;
+static u_int64_t s_planMisses = 0;
+static u_int64_t s_planBuilds = 0;
+
+static int planIndex(const FormatInfo* fi)
+{
+    if ((fi >= s_formats) && (fi < (s_formats + s_planStatic)))
+	return fi - s_formats;
+    for (unsigned int i = s_planStatic; i < s_planSize; i++)
+	if (s_planFormats[i] == fi)
+	    return i;
+    return -1;
+}
+
+// Retrieve the plan of a format pair, must be called with the matrix built
+// Only lookups finding a factory are counted as hits
+static const TranslatorPlan* findPlan(const FormatInfo* src, const FormatInfo* dest)
+{
+    int s = planIndex(src);
+    int d = planIndex(dest);
+    if ((s < 0) || (d < 0)) {
+	s_planMisses++;
+	return 0;
+    }
+    const TranslatorPlan* p = s_plans + (s * s_planSize + d);
+    if (p->factory)
+	s_planHits++;
+    else
+	s_planMisses++;
+    return p;
+}
+
+// Reports the translator plans as their own engine.status entry
+class TranslatorStatusHandler : public MessageHandler
+{
+public:
+    inline TranslatorStatusHandler()
+	: MessageHandler("engine.status",90,"translators")
+	{ }
+    virtual bool received(Message& msg);
+};
+
+static Mutex s_statusMutex(false,"TranslatorStatus");
+static TranslatorStatusHandler* s_statusHandler = 0;
+
+bool TranslatorStatusHandler::received(Message& msg)
+{
+    const String& sel = msg[YSTRING("module")];
+    if (sel && (sel != YSTRING("translators")))
+	return false;
+    unsigned int formats = 0;
+    u_int64_t hits = 0;
+    u_int64_t misses = 0;
+    u_int64_t builds = 0;
+    DataTranslator::planStats(formats,hits,misses,builds);
+    msg.retValue() << "name=translators,type=system;formats=" << formats;
+    msg.retValue() << ",builds=" << builds << ",hits=" << hits << ",misses=" << misses;
+    msg.retValue() << ",hitrate=" << (unsigned int)((hits + misses) ? (hits * 100 / (hits + misses)) : 0);
+    msg.retValue() << "\r\n";
+    return !sel.null();
+}
+
+// Install the status handler once translators are used in a running engine
+static void installStatus()
+{
+    if (s_statusHandler || !Engine::self())
+	return;
+    Lock lock(s_statusMutex);
+    if (s_statusHandler)
+	return;
+    s_statusHandler = new TranslatorStatusHandler;
+    Engine::install(s_statusHandler);
+}
+
 void DataTranslator::setMaxChain(unsigned int maxChain)
 {
     if (maxChain < 1)
@@ -1227,6 +1637,7 @@ void DataTranslator::install(TranslatorFactory* factory)
 	return;
     s_factories.append(factory)->setDelete(false);
     s_compose.append(factory)->setDelete(false);
+    s_planValid = false;
 }
 
 void DataTranslator::compose()
@@ -1330,6 +1741,7 @@ void DataTranslator::uninstall(TranslatorFactory* factory)
     s_mutex.lock();
     s_compose.remove(factory,false);
     s_factories.remove(factory,false);
+    s_planValid = false;
     // notify chained factories about the removal
     ListIterator iter(s_factories);
     while (TranslatorFactory* f = static_cast<TranslatorFactory*>(iter.get()))
@@ -1337,6 +1749,59 @@ void DataTranslator::uninstall(TranslatorFactory* factory)
     s_mutex.unlock();
 }
 
+void DataTranslator::buildPlans()
+{
+    unsigned int n = s_planStatic + s_flistCount;
+    if (s_planValid && (n == s_planSize))
+	return;
+    s_planBuilds++;
+    if (n != s_planSize) {
+	delete[] s_plans;
+	delete[] s_planFormats;
+	s_plans = new TranslatorPlan[n * n];
+	s_planFormats = new const FormatInfo*[n];
+	s_planSize = n;
+    }
+    unsigned int i = 0;
+    for (; i < s_planStatic; i++)
+	s_planFormats[i] = s_formats + i;
+    for (flist* l = s_flist; l && (i < n); l = l->next)
+	s_planFormats[i++] = l->info;
+    for (i = 0; i < n * n; i++) {
+	s_plans[i].factory = 0;
+	s_plans[i].cost = -1;
+    }
+    // chained factories are already composed so the cheapest listed cost
+    //  is the shortest path within the allowed chain length
+    for (ObjList* l = s_factories.skipNull(); l; l = l->skipNext()) {
+	TranslatorFactory* f = static_cast<TranslatorFactory*>(l->get());
+	const TranslatorCaps* caps = f->getCapabilities();
+	for (; caps && caps->src && caps->dest; caps++) {
+	    int src = planIndex(caps->src);
+	    int dest = planIndex(caps->dest);
+	    if ((src < 0) || (dest < 0))
+		continue;
+	    TranslatorPlan& p = s_plans[src * n + dest];
+	    if (!p.factory)
+		p.factory = f;
+	    if ((p.cost < 0) || (p.cost > caps->cost))
+		p.cost = caps->cost;
+	}
+    }
+    s_planValid = true;
+    DDebug(DebugInfo,"Built translator plans for %u formats",n);
+}
+
+void DataTranslator::planStats(unsigned int& formats, u_int64_t& hits, u_int64_t& misses,
+    u_int64_t& builds)
+{
+    Lock lock(s_mutex);
+    formats = s_planSize;
+    hits = s_planHits;
+    misses = s_planMisses;
+    builds = s_planBuilds;
+}
+
 ObjList* DataTranslator::srcFormats(const DataFormat& dFormat, int maxCost, unsigned int maxLen, ObjList* lst)
 {
     const FormatInfo* fi = dFormat.getInfo();
@@ -1479,9 +1944,13 @@ bool DataTranslator::canConvert(const DataFormat& fmt1, const DataFormat& fmt2)
     const FormatInfo* fi2 = fmt2.getInfo();
     if (!(fi1 && fi2))
 	return false;
+    installStatus();
     Lock lock(s_mutex);
     compose();
-    return canConvert(fi1,fi2);
+    buildPlans();
+    const TranslatorPlan* p1 = findPlan(fi1,fi2);
+    const TranslatorPlan* p2 = findPlan(fi2,fi1);
+    return p1 && p1->factory && p2 && p2->factory;
 }
 
 bool DataTranslator::canConvert(const FormatInfo* fmt1, const FormatInfo* fmt2)
@@ -1512,19 +1981,13 @@ int DataTranslator::cost(const DataFormat& sFormat, const DataFormat& dFormat)
     const FormatInfo* dest = dFormat.getInfo();
     if (!(src && dest))
 	return c;
+    installStatus();
     s_mutex.lock();
     compose();
-    ObjList* l = s_factories.skipNull();
-    for (; l; l=l->skipNext()) {
-	TranslatorFactory* f = static_cast<TranslatorFactory*>(l->get());
-	const TranslatorCaps* caps = f->getCapabilities();
-	for (; caps && caps->src && caps->dest; caps++) {
-	    if ((c == -1) || (c > caps->cost)) {
-		if ((caps->src == src) && (caps->dest == dest))
-		    c = caps->cost;
-	    }
-	}
-    }
+    buildPlans();
+    const TranslatorPlan* p = findPlan(src,dest);
+    if (p)
+	c = p->cost;
     s_mutex.unlock();
     return c;
 }
@@ -1540,20 +2003,39 @@ DataTranslator* DataTranslator::create(const DataFormat& sFormat, const DataForm
     bool counting = getObjCounting();
     NamedCounter* saved = Thread::getCurrentObjCounter(counting);
 
+    installStatus();
     s_mutex.lock();
     compose();
-    ObjList *l = s_factories.skipNull();
-    for (; l; l=l->skipNext()) {
-	TranslatorFactory* f = static_cast<TranslatorFactory*>(l->get());
+    buildPlans();
+    const TranslatorPlan* p = findPlan(sFormat.getInfo(),dFormat.getInfo());
+    TranslatorFactory* planned = p ? p->factory : 0;
+    TranslatorFactory* f = planned;
+    if (f) {
 	if (counting)
 	    Thread::setCurrentObjCounter(f->objectsCounter());
 	trans = f->create(sFormat,dFormat);
-	if (trans) {
-	    Debug(DebugAll,"Created DataTranslator %p for '%s' -> '%s' by factory %p (len=%u)",
-		trans,sFormat.c_str(),dFormat.c_str(),f,f->length());
-	    break;
+	if (!trans) {
+	    s_planHits--;
+	    s_planMisses++;
+	}
+    }
+    if (!trans) {
+	// nothing planned or the planned factory refused, ask all the others
+	//  as some factories may create translators they don't list in caps
+	for (ObjList* l = s_factories.skipNull(); l; l = l->skipNext()) {
+	    f = static_cast<TranslatorFactory*>(l->get());
+	    if (f == planned)
+		continue;
+	    if (counting)
+		Thread::setCurrentObjCounter(f->objectsCounter());
+	    trans = f->create(sFormat,dFormat);
+	    if (trans)
+		break;
 	}
     }
+    if (trans)
+	Debug(DebugAll,"Created DataTranslator %p for '%s' -> '%s' by factory %p (len=%u)",
+	    trans,sFormat.c_str(),dFormat.c_str(),f,f->length());
     s_mutex.unlock();
     if (counting)
 	Thread::setCurrentObjCounter(saved);
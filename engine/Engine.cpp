@@ -87,16 +87,49 @@ static int s_childsig = 0;
 
 namespace TelEngine {
 
+// Per worker state of the optional message dispatching pool
+class EngineWorkSlot
+{
+public:
+    inline EngineWorkSlot()
+	: m_mutex(false,"EngineWorkSlot"), m_park(1,"EngineWorkPark"),
+	  m_append(&m_queue), m_count(0), m_parked(false), m_thread(0), m_cpu(-1),
+	  m_dispatched(0), m_steals(0), m_parks(0), m_parkTime(0)
+	{ }
+    void push(Message* msg);
+    Message* pop();
+    Mutex m_mutex;
+    Semaphore m_park;
+    ObjList m_queue;
+    ObjList* m_append;
+    volatile unsigned int m_count;
+    volatile bool m_parked;
+    Thread* m_thread;
+    int m_cpu;
+    u_int64_t m_dispatched;
+    u_int64_t m_steals;
+    u_int64_t m_parks;
+    u_int64_t m_parkTime;
+};
+
 class EnginePrivate : public Thread
 {
 public:
-    EnginePrivate()
-	: Thread("Engine Worker")
+    EnginePrivate(EngineWorkSlot* slot = 0)
+	: Thread("Engine Worker"), m_slot(slot)
 	{ count++; }
     ~EnginePrivate()
 	{ count--; }
     virtual void run();
+    static bool poolEnqueue(Message* msg);
+    static void poolWake();
+    static void poolDrain();
+    static void poolGrow();
     static int count;
+private:
+    void runPool();
+    Message* steal();
+    EngineWorkSlot* m_slot;
 };
 
 class EngineCommand : public MessageHandler
@@ -315,6 +348,11 @@ static EngineSharedPrivate s_vars;
 static Mutex s_hooksMutex(true,"HooksList");
 static ObjList s_hooks;
 static Semaphore* s_semWorkers = 0;
+static EngineWorkSlot* s_pool = 0;
+static unsigned int s_poolSize = 0;
+static unsigned int s_poolMax = 0;
+static unsigned int s_poolNext = 0;
+static AtomicUInt s_poolParked;
 static NamedCounter* s_counter = 0;
 static NamedCounter* s_workCnt = 0;
 static String s_applicationStatus;
@@ -610,6 +648,16 @@ bool EngineStatusHandler::received(Message &msg)
 #endif
     msg.retValue() << ",threads=" << Thread::count();
     msg.retValue() << ",workers=" << EnginePrivate::count;
+    if (s_pool) {
+	u_int64_t steals = 0;
+	u_int64_t parkTime = 0;
+	for (unsigned int i = 0; i < s_poolSize; i++) {
+	    steals += s_pool[i].m_steals;
+	    parkTime += s_pool[i].m_parkTime;
+	}
+	msg.retValue() << ",poolworkers=" << s_poolSize << ",parked=" << s_poolParked.value();
+	msg.retValue() << ",steals=" << steals << ",parktime=" << (parkTime / 1000);
+    }
     msg.retValue() << ",mutexes=" << Mutex::count();
     int locks = Mutex::locks();
     if (locks >= 0)
@@ -631,6 +679,13 @@ bool EngineStatusHandler::received(Message &msg)
 	    msg.retValue() << sep << p->name() << "=" << *p;
 	    sep = ',';
 	}
+	// per worker queued|dispatched|steals|parks|parktime
+	for (unsigned int i = 0; s_pool && i < s_poolSize; i++) {
+	    const EngineWorkSlot& w = s_pool[i];
+	    msg.retValue() << sep << "worker" << i << "=" << w.m_count << "|" << w.m_dispatched
+		<< "|" << w.m_steals << "|" << w.m_parks << "|" << (w.m_parkTime / 1000);
+	    sep = ',';
+	}
     }
     msg.retValue() << "\r\n";
     if (getObjCounting() && sel.null())
@@ -1111,6 +1166,10 @@ bool EngineHelp::received(Message &msg)
 void EnginePrivate::run()
 {
     setCurrentObjCounter(s_workCnt);
+    if (m_slot) {
+	runPool();
+	return;
+    }
     for (;;) {
 	s_makeworker = false;
 	Semaphore* s = s_semWorkers;
@@ -1127,6 +1186,201 @@ void EnginePrivate::run()
     }
 }
 
+// Pool worker loop: local queue first, then the global queue, then steal
+void EnginePrivate::runPool()
+{
+    if (m_slot->m_cpu >= 0) {
+	DataBlock mask(0,(m_slot->m_cpu >> 3) + 1);
+	mask.data(0,mask.length())[m_slot->m_cpu >> 3] = 1 << (m_slot->m_cpu & 7);
+	int err = Thread::setCurrentAffinity(mask);
+	if (err)
+	    Debug(DebugWarn,"Failed to bind worker %u to CPU %d, error=%s(%d)",
+		(unsigned int)(m_slot - s_pool),m_slot->m_cpu,strerror(err),err);
+    }
+    m_slot->m_thread = this;
+    MessageDispatcher& disp = Engine::self()->m_dispatcher;
+    for (;;) {
+	bool done = false;
+	Message* msg = m_slot->pop();
+	if (!msg) {
+	    done = disp.dequeueOne();
+	    if (!done)
+		msg = steal();
+	}
+	if (msg) {
+	    disp.dispatchQueued(msg);
+	    done = true;
+	}
+	if (done) {
+	    m_slot->m_dispatched++;
+	    Thread::check(true);
+	    continue;
+	}
+	if (Engine::exiting()) {
+	    Thread::idle(true);
+	    continue;
+	}
+	// nothing to do, park until woken or timed out
+	m_slot->m_parked = true;
+	s_poolParked.inc();
+	// check again after advertising we are parked so no wakeup is lost
+	if (!(m_slot->m_count || disp.hasMessages())) {
+	    u_int64_t t = Time::now();
+	    m_slot->m_park.lock(WORKER_SLEEP);
+	    m_slot->m_parkTime += Time::now() - t;
+	    m_slot->m_parks++;
+	}
+	m_slot->m_parked = false;
+	s_poolParked.dec();
+	Thread::check(true);
+    }
+}
+
+// Take a message from the first other worker that has some queued
+Message* EnginePrivate::steal()
+{
+    unsigned int idx = m_slot - s_pool;
+    for (unsigned int i = 1; i < s_poolSize; i++) {
+	EngineWorkSlot& victim = s_pool[(idx + i) % s_poolSize];
+	if (!victim.m_count)
+	    continue;
+	Message* msg = victim.pop();
+	if (msg) {
+	    m_slot->m_steals++;
+	    return msg;
+	}
+    }
+    return 0;
+}
+
+// Queue a message enqueued by a pool worker to its own local queue
+bool EnginePrivate::poolEnqueue(Message* msg)
+{
+    if (!s_pool)
+	return false;
+    Thread* crt = Thread::current();
+    if (!crt)
+	return false;
+    for (unsigned int i = 0; i < s_poolSize; i++) {
+	if (s_pool[i].m_thread != crt)
+	    continue;
+	if (Engine::self()->m_dispatcher.trackQueued(msg))
+	    s_pool[i].push(msg);
+	else
+	    return false;
+	// the owner may be blocked in a handler so let a parked worker steal it
+	poolWake();
+	return true;
+    }
+    return false;
+}
+
+// Wake up a single parked worker, if any
+void EnginePrivate::poolWake()
+{
+    if (!(s_pool && s_poolParked.value()))
+	return;
+    unsigned int start = s_poolNext++;
+    for (unsigned int i = 0; i < s_poolSize; i++) {
+	EngineWorkSlot& slot = s_pool[(start + i) % s_poolSize];
+	if (slot.m_parked) {
+	    slot.m_park.unlock();
+	    return;
+	}
+    }
+}
+
+// Add workers to the pool if none is parked and messages are waiting
+void EnginePrivate::poolGrow()
+{
+    if (!s_pool || s_poolParked.value())
+	return;
+    unsigned int max = s_poolMax;
+    if (max > (unsigned int)s_maxworkers)
+	max = s_maxworkers;
+    if (s_poolSize >= max)
+	return;
+    bool busy = Engine::self()->m_dispatcher.hasMessages();
+    for (unsigned int i = 0; !busy && i < s_poolSize; i++)
+	busy = (0 != s_pool[i].m_count);
+    if (!busy)
+	return;
+    unsigned int build = max - s_poolSize;
+    if (build > (unsigned int)s_addworkers)
+	build = s_addworkers;
+    Alarm("engine","performance",DebugMild,
+	"Adding %u message dispatching threads to the pool (%u running)",
+	build,s_poolSize);
+    // slots are preallocated, publish each one only after its thread started
+    while (build--) {
+	(new EnginePrivate(s_pool + s_poolSize))->startup();
+	s_poolSize++;
+    }
+}
+
+// Dispatch all messages left in workers' local queues
+void EnginePrivate::poolDrain()
+{
+    for (unsigned int i = 0; i < s_poolSize; i++) {
+	while (Message* msg = s_pool[i].pop())
+	    Engine::self()->m_dispatcher.dispatchQueued(msg);
+    }
+}
+
+// Retrieve the CPUs allowed in an affinity mask
+static unsigned int maskCpus(const DataBlock& mask, int* cpus = 0, unsigned int len = 0)
+{
+    unsigned int n = 0;
+    for (unsigned int i = 0; i < (mask.length() << 3); i++) {
+	if (!(mask.at(i >> 3) & (1 << (i & 7))))
+	    continue;
+	if (cpus && n < len)
+	    cpus[n] = i;
+	n++;
+    }
+    return n;
+}
+
+// Create the initial pool workers, optionally binding each to a CPU
+// Slots are allocated for the most workers the pool may grow to
+static void startPool()
+{
+    s_pool = new EngineWorkSlot[s_poolMax];
+    if (s_cfg.getBoolValue("general","poolaffinity")) {
+	DataBlock mask;
+	int* cpus = new int[s_poolMax];
+	unsigned int n = Thread::getCurrentAffinity(mask) ? 0 : maskCpus(mask,cpus,s_poolMax);
+	if (n > s_poolMax)
+	    n = s_poolMax;
+	for (unsigned int i = 0; n && i < s_poolMax; i++)
+	    s_pool[i].m_cpu = cpus[i % n];
+	delete[] cpus;
+    }
+    Debug(DebugInfo,"Creating pool of %u message dispatching threads",s_poolSize);
+    for (unsigned int i = 0; i < s_poolSize; i++)
+	(new EnginePrivate(s_pool + i))->startup();
+}
+
+void EngineWorkSlot::push(Message* msg)
+{
+    Lock mylock(m_mutex);
+    m_append = m_append->append(msg);
+    m_count++;
+}
+
+Message* EngineWorkSlot::pop()
+{
+    if (!m_count)
+	return 0;
+    Lock mylock(m_mutex);
+    if (m_queue.next() == m_append)
+	m_append = &m_queue;
+    Message* msg = static_cast<Message*>(m_queue.remove(false));
+    if (msg)
+	m_count--;
+    return msg;
+}
+
 
 static bool logFileOpen()
 {
@@ -1713,6 +1967,7 @@ int Engine::engineInit()
     CapturedEvent::capturing(s_capture);
     s_cfg = configFile(s_cfgfile);
     s_cfg.loadMain();
+    MemoryPool::enable(s_cfg.getBoolValue("general","mempool",MemoryPool::enabled()));
     s_capture = s_cfg.getBoolValue("general","startevents",s_capture);
     CapturedEvent::capturing(s_capture);
     if (s_capture && s_startMsg)
@@ -1765,6 +2020,20 @@ int Engine::engineInit()
     s_minworkers = s_cfg.getIntValue("general","minworkers",s_minworkers,1,500);
     s_maxworkers = s_cfg.getIntValue("general","maxworkers",s_maxworkers,s_minworkers,1000);
     s_addworkers = s_cfg.getIntValue("general","addworkers",s_addworkers,1,10);
+    if (s_cfg.getBoolValue("general","workerpool")) {
+	s_poolSize = s_cfg.getIntValue("general","poolworkers",0,0,256);
+	if (!s_poolSize) {
+	    DataBlock mask;
+	    if (!Thread::getCurrentAffinity(mask))
+		s_poolSize = maskCpus(mask);
+	    if (!s_poolSize)
+		s_poolSize = s_minworkers;
+	}
+	// the pool starts within the worker limits and may grow up to maxworkers
+	if (s_poolSize > (unsigned int)s_maxworkers)
+	    s_poolSize = s_maxworkers;
+	s_poolMax = s_maxworkers;
+    }
     s_maxmsgrate = s_cfg.getIntValue("general","maxmsgrate",s_maxmsgrate,0,50000);
     s_maxmsgage = s_cfg.getIntValue("general","maxmsgage",s_maxmsgage,0,5000);
     s_maxqueued = s_cfg.getIntValue("general","maxqueued",s_maxqueued,0,10000);
@@ -1807,6 +2076,8 @@ int Engine::engineInit()
     s_params.addParam("minworkers",String(s_minworkers));
     s_params.addParam("maxworkers",String(s_maxworkers));
     s_params.addParam("addworkers",String(s_addworkers));
+    if (s_poolSize)
+	s_params.addParam("poolworkers",String(s_poolSize));
     s_params.addParam("maxmsgrate",String(s_maxmsgrate));
     s_params.addParam("maxmsgage",String(s_maxmsgage));
     s_params.addParam("maxqueued",String(s_maxqueued));
@@ -1849,7 +2120,7 @@ int Engine::engineInit()
 	ObjList* ver = version.skipNull();
 	String prefix = (*app)[YSTRING("prefix")];
 	prefix = prefix.safe("application_");
-	for (ObjList* o = app->paramList()->skipNull(); o; o = o->skipNext()) {
+	for (ObjList* o = static_cast<const NamedList*>(app)->paramList()->skipNull(); o; o = o->skipNext()) {
 	    NamedString* ns = static_cast<NamedString*>(o->get());
 	    if (ns->name() == YSTRING("report_version")
 		|| ns->name() == YSTRING("report_status")
@@ -2018,7 +2289,7 @@ int Engine::run()
 	if (s_debug) {
 	    // one-time sending of debug setup messages
 	    s_debug = false;
-	    for (ObjList* o = s_debugInit.paramList()->skipNull(); o; o = o->skipNext()) {
+	    for (ObjList* o = static_cast<const NamedList&>(s_debugInit).paramList()->skipNull(); o; o = o->skipNext()) {
 		const NamedString* str = static_cast<NamedString*>(o->get());
 		if (!(str->name() && *str))
 		    continue;
@@ -2041,7 +2312,15 @@ int Engine::run()
 
 	// Create worker thread if we didn't hear about any of them in a while
 	int build = s_maxworkers - EnginePrivate::count;
-	if (s_makeworker && (build > 0)) {
+	if (s_poolSize) {
+	    if (!s_pool)
+		startPool();
+	    else {
+		EnginePrivate::poolWake();
+		EnginePrivate::poolGrow();
+	    }
+	}
+	else if (s_makeworker && (build > 0)) {
 	    if (EnginePrivate::count) {
 		if (build > s_addworkers)
 		    build = s_addworkers;
@@ -2163,6 +2442,8 @@ int Engine::engineCleanup()
 	for (int i = EnginePrivate::count; i > 0; i--)
 	    s->unlock();
     }
+    for (unsigned int i = 0; i < s_poolSize && s_pool; i++)
+	s_pool[i].m_park.unlock();
     Thread::msleep(200);
     m_dispatcher.dequeue();
     checkPoint();
@@ -2170,6 +2451,7 @@ int Engine::engineCleanup()
     abortOnBug(s_sigabrt && s_lateabrt);
     Thread::killall();
     checkPoint();
+    EnginePrivate::poolDrain();
     m_dispatcher.dequeue();
     ::signal(SIGTERM,SIG_DFL);
 #ifndef _WINDOWS
@@ -2544,10 +2826,18 @@ bool Engine::enqueue(Message* msg, bool skipHooks)
 	    return true;
 	}
     }
-    if (s_self && s_self->m_dispatcher.enqueue(msg)) {
-	Semaphore*s = s_semWorkers;
-	if (s)
-	    s->unlock();
+    if (!s_self)
+	return false;
+    if (EnginePrivate::poolEnqueue(msg))
+	return true;
+    if (s_self->m_dispatcher.enqueue(msg)) {
+	if (s_pool)
+	    EnginePrivate::poolWake();
+	else {
+	    Semaphore*s = s_semWorkers;
+	    if (s)
+		s->unlock();
+	}
 	return true;
     }
     return false;
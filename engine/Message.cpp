@@ -35,10 +35,179 @@ private:
     RefPointer<MessageQueue> m_queue;
 };
 
+#ifdef YATOMIC_BUILTIN
+// Size of the lock free part of the dispatcher queue, must be a power of 2
+#define MSG_RING_SIZE 8192
+
+// Bounded lock free multiple producer / multiple consumer queue of messages
+// Each cell holds a sequence number telling producers and consumers
+//  if the cell is free for the position they have reserved
+class TelEngine::MessageRing
+{
+public:
+    MessageRing();
+    ~MessageRing();
+    bool push(Message* msg);
+    Message* pop();
+private:
+    struct Cell {
+	volatile unsigned int seq;
+	Message* msg;
+    };
+    static inline unsigned int load(volatile unsigned int& val)
+	{ unsigned int tmp = val; __sync_synchronize(); return tmp; }
+    static inline void store(volatile unsigned int& val, unsigned int tmp)
+	{ __sync_synchronize(); val = tmp; }
+    Cell* m_cells;
+    // keep producer and consumer positions in separate cache lines
+    char m_pad1[64];
+    volatile unsigned int m_pushPos;
+    char m_pad2[64];
+    volatile unsigned int m_popPos;
+    char m_pad3[64];
+};
+
+MessageRing::MessageRing()
+    : m_cells(new Cell[MSG_RING_SIZE]), m_pushPos(0), m_popPos(0)
+{
+    for (unsigned int i = 0; i < MSG_RING_SIZE; i++) {
+	m_cells[i].seq = i;
+	m_cells[i].msg = 0;
+    }
+    __sync_synchronize();
+}
+
+MessageRing::~MessageRing()
+{
+    delete[] m_cells;
+}
+
+// Append a message, return false if the ring is full
+bool MessageRing::push(Message* msg)
+{
+    unsigned int pos = load(m_pushPos);
+    Cell* cell = 0;
+    for (;;) {
+	cell = m_cells + (pos & (MSG_RING_SIZE - 1));
+	int dif = (int)(load(cell->seq) - pos);
+	if (!dif) {
+	    if (__sync_bool_compare_and_swap(&m_pushPos,pos,pos + 1))
+		break;
+	}
+	else if (dif < 0)
+	    return false;
+	pos = load(m_pushPos);
+    }
+    cell->msg = msg;
+    store(cell->seq,pos + 1);
+    return true;
+}
+
+// Remove the oldest message, return NULL if the ring is empty
+Message* MessageRing::pop()
+{
+    unsigned int pos = load(m_popPos);
+    Cell* cell = 0;
+    for (;;) {
+	cell = m_cells + (pos & (MSG_RING_SIZE - 1));
+	int dif = (int)(load(cell->seq) - (pos + 1));
+	if (!dif) {
+	    if (__sync_bool_compare_and_swap(&m_popPos,pos,pos + 1))
+		break;
+	}
+	else if (dif < 0)
+	    return 0;
+	pos = load(m_popPos);
+    }
+    Message* msg = cell->msg;
+    cell->msg = 0;
+    store(cell->seq,pos + MSG_RING_SIZE);
+    return msg;
+}
+#endif
+
+// Holds the handlers installed for a specific message name
+class HandlerGroup : public String
+{
+public:
+    inline HandlerGroup(const String& name)
+	: String(name)
+	{}
+    inline ObjList& handlers()
+	{ return m_handlers; }
+private:
+    ObjList m_handlers;
+};
+
+// Check if a handler is sorted after a priority and handler pair
+static inline bool handlerAfter(const MessageHandler* h, unsigned int p, const MessageHandler* ref)
+{
+    return (h->priority() > p) || ((h->priority() == p) && (h > ref));
+}
+
+// Insert a handler in a list in ascending priority order
+static void insertHandler(ObjList& list, MessageHandler* handler, bool autoDelete)
+{
+    unsigned int p = handler->priority();
+    ObjList* l = &list;
+    for (; l; l = l->next()) {
+	MessageHandler* h = static_cast<MessageHandler*>(l->get());
+	if (!h)
+	    continue;
+	if (h->priority() < p)
+	    continue;
+	if (h->priority() > p)
+	    break;
+	// at the same priority we sort them in pointer address order
+	if (h > handler)
+	    break;
+    }
+    if (l) {
+	XDebug(DebugAll,"Inserting handler [%p] in list [%p]",handler,&list);
+	l = l->insert(handler);
+    }
+    else {
+	XDebug(DebugAll,"Appending handler [%p] to list [%p]",handler,&list);
+	l = list.append(handler);
+    }
+    l->setDelete(autoDelete);
+}
+
+// Remove a handler from the name index, drop the name if no handlers are left
+static void removeIndexed(HashList& index, MessageHandler* handler)
+{
+    HandlerGroup* grp = static_cast<HandlerGroup*>(index[*handler]);
+    if (!(grp && grp->handlers().remove(handler,false))) {
+	// handler name was changed after installing, search all groups
+	grp = 0;
+	for (unsigned int i = 0; !grp && i < index.length(); i++) {
+	    for (ObjList* l = index.getList(i); l; l = l->next()) {
+		HandlerGroup* g = static_cast<HandlerGroup*>(l->get());
+		if (g && g->handlers().remove(handler,false)) {
+		    grp = g;
+		    break;
+		}
+	    }
+	}
+    }
+    if (grp && !grp->handlers().skipNull())
+	index.remove(grp);
+}
+
+// Find first handler sorted after a priority and handler pair
+static ObjList* skipHandlers(ObjList* l, unsigned int p, const MessageHandler* h)
+{
+    for (; l; l = l->skipNext()) {
+	if (handlerAfter(static_cast<MessageHandler*>(l->get()),p,h))
+	    break;
+    }
+    return l;
+}
+
 Message::Message(const char* name, const char* retval, bool broadcast)
     : NamedList(name),
       m_return(retval), m_timeEnqueue((uint64_t)0), m_timeDispatch((uint64_t)0),
-      m_data(0), m_notify(false), m_broadcast(broadcast)
+      m_data(0), m_notify(false), m_broadcast(broadcast), m_queued(0)
 {
     XDebug(DebugAll,"Message::Message(\"%s\",\"%s\",%s) [%p]",
 	name,retval,String::boolText(broadcast),this);
@@ -49,7 +218,7 @@ Message::Message(const Message& original)
       m_return(original.retValue()), m_time(original.msgTime()),
       m_timeEnqueue(original.m_timeEnqueue), m_timeDispatch(original.m_timeDispatch),
       m_data(0),
-      m_notify(false), m_broadcast(original.broadcast())
+      m_notify(false), m_broadcast(original.broadcast()), m_queued(0)
 {
     XDebug(DebugAll,"Message::Message(&%p) [%p]",&original,this);
 }
@@ -59,7 +228,7 @@ Message::Message(const Message& original, bool broadcast)
       m_return(original.retValue()), m_time(original.msgTime()),
       m_timeEnqueue(original.m_timeEnqueue), m_timeDispatch(original.m_timeDispatch),
       m_data(0),
-      m_notify(false), m_broadcast(broadcast)
+      m_notify(false), m_broadcast(broadcast), m_queued(0)
 {
     XDebug(DebugAll,"Message::Message(&%p,%s) [%p]",
 	&original,String::boolText(broadcast),this);
@@ -322,24 +491,35 @@ MessageDispatcher::MessageDispatcher(const char* trackParam)
     : m_handlersLock("DispatcherHandlers"), m_messagesLock("DispatcherMsgs"), 
       m_hooksLock("DispatcherHooks"),
       m_msgAppend(&m_messages), m_hookAppend(&m_hooks),
-      m_trackParam(trackParam), m_changes(0), m_warnTime(0),
+      m_msgRing(0), m_msgOverflow(0), m_trackParam(trackParam), m_changes(0), m_warnTime(0),
       m_enqueueCount(0), m_dequeueCount(0), m_dispatchCount(0),
       m_queuedMax(0), m_msgAvgAge(0),
       m_traceTime(false), m_traceHandlerTime(false),
-      m_hookCount(0), m_hookHole(false)
+      m_hookCount(0), m_hookHole(false), m_handlersByName(127)
 {
     XDebug(DebugInfo,"MessageDispatcher::MessageDispatcher('%s') [%p]",trackParam,this);
+#ifdef YATOMIC_BUILTIN
+    m_msgRing = new MessageRing;
+#endif
 }
 
 MessageDispatcher::~MessageDispatcher()
 {
     XDebug(DebugInfo,"MessageDispatcher::~MessageDispatcher() [%p]",this);
     clear();
+#ifdef YATOMIC_BUILTIN
+    while (Message* msg = m_msgRing->pop())
+	msg->destruct();
+    delete m_msgRing;
+    m_msgRing = 0;
+#endif
 }
 
 void MessageDispatcher::clear()
 {
     WLock lck(m_handlersLock);
+    m_handlersByName.clear();
+    m_handlersAny.clear();
     m_handlers.clear();
     lck.acquire(m_hooksLock);
     m_hookAppend = &m_hooks;
@@ -355,28 +535,17 @@ bool MessageDispatcher::install(MessageHandler* handler)
     ObjList *l = m_handlers.find(handler);
     if (l)
 	return false;
-    unsigned p = handler->priority();
-    int pos = 0;
-    for (l=&m_handlers; l; l=l->next(),pos++) {
-	MessageHandler *h = static_cast<MessageHandler *>(l->get());
-	if (!h)
-	    continue;
-	if (h->priority() < p)
-	    continue;
-	if (h->priority() > p)
-	    break;
-	// at the same priority we sort them in pointer address order
-	if (h > handler)
-	    break;
-    }
     m_changes++;
-    if (l) {
-	XDebug(DebugAll,"Inserting handler [%p] on place #%d",handler,pos);
-	l->insert(handler);
-    }
+    insertHandler(m_handlers,handler,true);
+    if (handler->null())
+	insertHandler(m_handlersAny,handler,false);
     else {
-	XDebug(DebugAll,"Appending handler [%p] on place #%d",handler,pos);
-	m_handlers.append(handler);
+	HandlerGroup* grp = static_cast<HandlerGroup*>(m_handlersByName[*handler]);
+	if (!grp) {
+	    grp = new HandlerGroup(*handler);
+	    m_handlersByName.append(grp);
+	}
+	insertHandler(grp->handlers(),handler,false);
     }
     handler->m_dispatcher = this;
     if (handler->null())
@@ -391,6 +560,8 @@ bool MessageDispatcher::uninstall(MessageHandler* handler)
     handler = static_cast<MessageHandler *>(m_handlers.remove(handler,false));
     if (handler) {
 	m_changes++;
+	if (!m_handlersAny.remove(handler,false))
+	    removeIndexed(m_handlersByName,handler);
 	if (handler->m_unsafe > 0) {
 	    DDebug(DebugNote,"Waiting for unsafe MessageHandler %p '%s'",
 		handler,handler->c_str());
@@ -429,95 +600,92 @@ bool MessageDispatcher::dispatch(Message& msg)
     String hTrackName;
     unsigned int hTrackPos = 0;
     bool hTrackTime = m_traceHandlerTime;
-    ObjList *l = &m_handlers;
     RLock lck(m_handlersLock);
     m_dispatchCount++;
-    for (; l; l=l->next()) {
-	MessageHandler *h = static_cast<MessageHandler*>(l->get());
-	if (h && (h->null() || *h == msg)) {
-	    if (h->filter() && !h->filter()->matchListParam(msg))
-		continue;
-	    if (counting)
-		Thread::setCurrentObjCounter(h->objectsCounter());
-
-	    unsigned int c = m_changes;
-	    unsigned int p = h->priority();
-	    if (trackParam() && h->trackName()) {
-		NamedString* tracked = msg.getParam(trackParam());
-		if (tracked)
-		    tracked->append(h->trackName(),",");
-		else
-		    msg.addParam(trackParam(),h->trackName());
-		if (hTrackTime) {
-		    hTrackName = h->trackName();
-		    hTrackPos = tracked ? tracked->length() : hTrackName.length();
-		}
+    // merge handlers registered for this name with the ones catching all messages
+    HandlerGroup* grp = static_cast<HandlerGroup*>(m_handlersByName[msg]);
+    ObjList* ln = grp ? grp->handlers().skipNull() : 0;
+    ObjList* la = m_handlersAny.skipNull();
+    while (ln || la) {
+	MessageHandler *h = 0;
+	if (ln) {
+	    h = static_cast<MessageHandler*>(ln->get());
+	    if (la) {
+		MessageHandler *a = static_cast<MessageHandler*>(la->get());
+		if (handlerAfter(h,a->priority(),a))
+		    h = 0;
 	    }
-	    // mark handler as unsafe to destroy / uninstall
-	    h->m_unsafe++;
-	    lck.drop();
+	}
+	if (h)
+	    ln = ln->skipNext();
+	else {
+	    h = static_cast<MessageHandler*>(la->get());
+	    la = la->skipNext();
+	}
+	if (h->filter() && !h->filter()->matchListParam(msg))
+	    continue;
+	if (counting)
+	    Thread::setCurrentObjCounter(h->objectsCounter());
+
+	unsigned int c = m_changes;
+	unsigned int p = h->priority();
+	if (trackParam() && h->trackName()) {
+	    NamedString* tracked = msg.getParam(trackParam());
+	    if (tracked)
+		tracked->append(h->trackName(),",");
+	    else
+		msg.addParam(trackParam(),h->trackName());
+	    if (hTrackTime) {
+		hTrackName = h->trackName();
+		hTrackPos = tracked ? tracked->length() : hTrackName.length();
+	    }
+	}
+	// mark handler as unsafe to destroy / uninstall
+	h->m_unsafe++;
+	lck.drop();
 
-	    u_int64_t tm = (m_warnTime || hTrackTime) ? Time::now() : 0;
+	u_int64_t tm = (m_warnTime || hTrackTime) ? Time::now() : 0;
 
-	    retv = h->receivedInternal(msg) || retv;
+	retv = h->receivedInternal(msg) || retv;
 
-	    if (tm) {
-		tm = Time::now() - tm;
-		if (m_warnTime && tm > m_warnTime) {
-		    lck.acquire(m_handlersLock);
-		    const char* name = (c == m_changes) ? h->trackName().c_str() : 0;
-		    Debug(DebugInfo,"Message '%s' [%p] passed through %p%s%s%s in " FMT64U " usec",
-			msg.c_str(),&msg,h,
-			(name ? " '" : ""),(name ? name : ""),(name ? "'" : ""),tm);
-		}
-		if (hTrackTime && hTrackName) {
-		    NamedString* tracked = msg.getParam(trackParam());
-		    unsigned int start = hTrackPos - hTrackName.length();
-		    if (tracked && start < tracked->length()) {
-			if (0 == ::strncmp(tracked->c_str() + start,hTrackName.c_str(),hTrackName.length())) {
-			    String buf;
-			    buf.printf("#%u.%03u",(unsigned int)(tm / 1000),
-				(unsigned int)(tm % 1000));
-			    char c = (*tracked)[hTrackPos];
-			    if (!c)
-				*tracked << buf;
-			    else if (',' == c) // Message re-dispatched. New handler name added
-				tracked->insert(hTrackPos,buf,buf.length());
-			}
-		    }
-		}
+	if (tm) {
+	    tm = Time::now() - tm;
+	    if (m_warnTime && tm > m_warnTime) {
+		lck.acquire(m_handlersLock);
+		const char* name = (c == m_changes) ? h->trackName().c_str() : 0;
+		Debug(DebugInfo,"Message '%s' [%p] passed through %p%s%s%s in " FMT64U " usec",
+		    msg.c_str(),&msg,h,
+		    (name ? " '" : ""),(name ? name : ""),(name ? "'" : ""),tm);
 	    }
-
-	    if (retv && !msg.broadcast())
-		break;
-	    lck.acquire(m_handlersLock);
-	    if (c == m_changes)
-		continue;
-	    // the handler list has changed - find again
-	    NDebug(DebugAll,"Rescanning handler list for '%s' [%p] at priority %u",
-		msg.c_str(),&msg,p);
-	    ObjList* l2 = &m_handlers;
-	    for (l = l2; l; l=l->next()) {
-		MessageHandler *mh = static_cast<MessageHandler*>(l->get());
-		if (!mh)
-		    continue;
-		if (mh == h)
-		    // exact match - silently continue where we left
-		    break;
-
-		// gone past last handler priority - exit with last handler
-		if ((mh->priority() > p) || ((mh->priority() == p) && (mh > h))) {
-		    Debug(DebugAll,"Handler list for '%s' [%p] changed, skipping from %p (%u) to %p (%u)",
-			msg.c_str(),&msg,h,p,mh,mh->priority());
-		    // l will advance in the outer for loop so use previous
-		    l = l2;
-		    break;
+	    if (hTrackTime && hTrackName) {
+		NamedString* tracked = msg.getParam(trackParam());
+		unsigned int start = hTrackPos - hTrackName.length();
+		if (tracked && start < tracked->length()) {
+		    if (0 == ::strncmp(tracked->c_str() + start,hTrackName.c_str(),hTrackName.length())) {
+			String buf;
+			buf.printf("#%u.%03u",(unsigned int)(tm / 1000),
+			    (unsigned int)(tm % 1000));
+			char c = (*tracked)[hTrackPos];
+			if (!c)
+			    *tracked << buf;
+			else if (',' == c) // Message re-dispatched. New handler name added
+			    tracked->insert(hTrackPos,buf,buf.length());
+		    }
 		}
-		l2 = l;
 	    }
-	    if (!l)
-		break;
 	}
+
+	if (retv && !msg.broadcast())
+	    break;
+	lck.acquire(m_handlersLock);
+	if ((c == m_changes) && (grp ? (*grp == msg) : !m_handlersByName[msg]))
+	    continue;
+	// the handler lists or the message name have changed - find again where we left
+	NDebug(DebugAll,"Rescanning handler list for '%s' [%p] at priority %u",
+	    msg.c_str(),&msg,p);
+	grp = static_cast<HandlerGroup*>(m_handlersByName[msg]);
+	ln = skipHandlers(grp ? grp->handlers().skipNull() : 0,p,h);
+	la = skipHandlers(m_handlersAny.skipNull(),p,h);
     }
     lck.drop();
     if (counting)
@@ -545,7 +713,7 @@ bool MessageDispatcher::dispatch(Message& msg)
     lck.acquire(m_hooksLock);
     if (m_hookHole && !m_hookCount) {
 	// compact the list, remove the holes
-	for (l = &m_hooks; l; l = l->next()) {
+	for (ObjList* l = &m_hooks; l; l = l->next()) {
 	    while (!l->get()) {
 		if (!l->next())
 		    break;
@@ -557,7 +725,7 @@ bool MessageDispatcher::dispatch(Message& msg)
 	m_hookHole = false;
     }
     m_hookCount++;
-    for (l = m_hooks.skipNull(); l; l = l->skipNext()) {
+    for (ObjList* l = m_hooks.skipNull(); l; l = l->skipNext()) {
 	RefPointer<MessagePostHook> ph = static_cast<MessagePostHook*>(l->get());
 	if (ph) {
 	    lck.drop();
@@ -580,34 +748,80 @@ bool MessageDispatcher::dispatch(Message& msg)
 
 bool MessageDispatcher::enqueue(Message* msg)
 {
+    if (!trackQueued(msg))
+	return false;
+#ifdef YATOMIC_BUILTIN
+    // once the ring is full keep using the overflow list until emptied
+    if (!m_msgOverflow && m_msgRing->push(msg))
+	return true;
+#endif
+    WLock lck(m_messagesLock);
+    m_msgAppend = m_msgAppend->append(msg);
+    m_msgOverflow++;
+    return true;
+}
+
+bool MessageDispatcher::dequeueOne()
+{
+    Message* msg = 0;
+#ifdef YATOMIC_BUILTIN
+    msg = m_msgRing->pop();
+#endif
+    if (!msg && m_msgOverflow) {
+	WLock lck(m_messagesLock);
+	if (m_messages.next() == m_msgAppend)
+	    m_msgAppend = &m_messages;
+	msg = static_cast<Message *>(m_messages.remove(false));
+	if (msg)
+	    m_msgOverflow--;
+    }
+    if (!msg)
+	return false;
+    dispatchQueued(msg);
+    return true;
+}
+
+bool MessageDispatcher::trackQueued(Message* msg)
+{
+    if (!msg)
+	return false;
+    // the queued flag replaces searching the message in queue
+#ifdef YATOMIC_BUILTIN
+    if (!__sync_bool_compare_and_swap(&msg->m_queued,0,1))
+	return false;
+#else
     WLock lck(m_messagesLock);
-    if (!msg || m_messages.find(msg))
+    if (msg->m_queued)
 	return false;
+    msg->m_queued = 1;
+    lck.drop();
+#endif
     if (m_traceTime)
 	msg->m_timeEnqueue = Time::now();
-    m_msgAppend = m_msgAppend->append(msg);
-    u_int64_t count = (++m_enqueueCount) - m_dequeueCount;
+    u_int64_t count = m_enqueueCount.inc() - m_dequeueCount.valueAtomic();
+    // statistics only, a lost update here is harmless
     if (m_queuedMax < count)
 	m_queuedMax = count;
     return true;
 }
 
-bool MessageDispatcher::dequeueOne()
+void MessageDispatcher::dispatchQueued(Message* msg)
 {
-    WLock lck(m_messagesLock);
-    if (m_messages.next() == m_msgAppend)
-	m_msgAppend = &m_messages;
-    Message* msg = static_cast<Message *>(m_messages.remove(false));
     if (!msg)
-	return false;
-    m_dequeueCount++;
+	return;
+#ifdef YATOMIC_BUILTIN
+    __sync_lock_release(&msg->m_queued);
+#else
+    WLock lck(m_messagesLock);
+    msg->m_queued = 0;
+    lck.drop();
+#endif
+    m_dequeueCount.inc();
     uint64_t age = Time::now() - msg->msgTime();
     if (age < 60000000)
 	m_msgAvgAge = (3 * m_msgAvgAge + age) >> 2;
-    lck.drop();
     dispatch(*msg);
     msg->destruct();
-    return true;
 }
 
 void MessageDispatcher::dequeue()
@@ -618,8 +832,7 @@ void MessageDispatcher::dequeue()
 
 unsigned int MessageDispatcher::messageCount()
 {
-    RLock lck(m_messagesLock);
-    return (unsigned int)(m_enqueueCount - m_dequeueCount);
+    return (unsigned int)(m_enqueueCount.valueAtomic() - m_dequeueCount.valueAtomic());
 }
 
 unsigned int MessageDispatcher::handlerCount()
@@ -636,11 +849,10 @@ unsigned int MessageDispatcher::postHookCount()
 
 void MessageDispatcher::getStats(u_int64_t& enqueued, u_int64_t& dequeued, u_int64_t& dispatched, u_int64_t& queueMax)
 {
-    RLock lck(m_messagesLock);
-    enqueued = m_enqueueCount;
-    dequeued = m_dequeueCount;
+    dequeued = m_dequeueCount.valueAtomic();
+    enqueued = m_enqueueCount.valueAtomic();
     queueMax = m_queuedMax;
-    lck.acquire(m_handlersLock);
+    RLock lck(m_handlersLock);
     dispatched = m_dispatchCount;
 }
 
@@ -28,6 +28,36 @@ static bool isContinuationBlank(char c)
     return ((c == ' ') || (c == '\t'));
 }
 
+// Utility function, skips blanks at both ends of a buffer range
+static inline void trimRange(const char* buf, int& start, int& end)
+{
+    while ((start < end) && isContinuationBlank(buf[start]))
+	start++;
+    while ((end > start) && isContinuationBlank(buf[end - 1]))
+	end--;
+}
+
+// Utility function, appends a header parameter from a range of the header value
+// Name and value are copied straight from the range without temporary strings
+static void addParam(ObjList& params, const char* buf, int start, int end, int eq)
+{
+    int ne = (eq >= 0) ? eq : end;
+    trimRange(buf,start,ne);
+    String pname(buf + start,ne - start);
+    if (pname.null())
+	return;
+    if (eq < 0) {
+	XDebug(DebugAll,"hdr param name='%s' (no value)",pname.c_str());
+	params.append(new NamedString(pname));
+	return;
+    }
+    int vs = eq + 1;
+    trimRange(buf,vs,end);
+    NamedString* param = new NamedString(pname,buf + vs,end - vs);
+    XDebug(DebugAll,"hdr param name='%s' value='%s'",pname.c_str(),param->c_str());
+    params.append(param);
+}
+
 /**
  * MimeHeaderLine
  */
@@ -42,31 +72,16 @@ MimeHeaderLine::MimeHeaderLine(const char* name, const String& value, char sep)
 	assign(value);
 	return;
     }
-    assign(value,sp);
-    trimBlanks();
+    int start = 0;
+    int end = sp;
+    trimRange(value.c_str(),start,end);
+    assign(value.c_str() + start,end - start);
     while (sp < (int)value.length()) {
 	int ep = findSep(value,m_separator,sp+1);
 	if (ep <= sp)
 	    ep = value.length();
 	int eq = value.find('=',sp+1);
-	if ((eq > 0) && (eq < ep)) {
-	    String pname(value.substr(sp+1,eq-sp-1));
-	    String pvalue(value.substr(eq+1,ep-eq-1));
-	    pname.trimBlanks();
-	    pvalue.trimBlanks();
-	    if (!pname.null()) {
-		XDebug(DebugAll,"hdr param name='%s' value='%s'",pname.c_str(),pvalue.c_str());
-		m_params.append(new NamedString(pname,pvalue));
-	    }
-	}
-	else {
-	    String pname(value.substr(sp+1,ep-sp-1));
-	    pname.trimBlanks();
-	    if (!pname.null()) {
-		XDebug(DebugAll,"hdr param name='%s' (no value)",pname.c_str());
-		m_params.append(new NamedString(pname));
-	    }
-	}
+	addParam(m_params,value.c_str(),sp + 1,ep,((eq > 0) && (eq < ep)) ? eq : -1);
 	sp = ep;
     }
 }
@@ -273,8 +288,10 @@ MimeAuthLine::MimeAuthLine(const char* name, const String& value)
 	assign(value);
 	return;
     }
-    assign(value,sp);
-    trimBlanks();
+    int start = 0;
+    int end = sp;
+    trimRange(value.c_str(),start,end);
+    assign(value.c_str() + start,end - start);
     while (sp < (int)value.length()) {
 	int ep = value.find(m_separator,sp+1);
 	int quot = value.find('"',sp+1);
@@ -286,24 +303,7 @@ MimeAuthLine::MimeAuthLine(const char* name, const String& value)
 	if (ep <= sp)
 	    ep = value.length();
 	int eq = value.find('=',sp+1);
-	if ((eq > 0) && (eq < ep)) {
-	    String pname(value.substr(sp+1,eq-sp-1));
-	    String pvalue(value.substr(eq+1,ep-eq-1));
-	    pname.trimBlanks();
-	    pvalue.trimBlanks();
-	    if (!pname.null()) {
-		XDebug(DebugAll,"auth param name='%s' value='%s'",pname.c_str(),pvalue.c_str());
-		m_params.append(new NamedString(pname,pvalue));
-	    }
-	}
-	else {
-	    String pname(value.substr(sp+1,ep-sp-1));
-	    pname.trimBlanks();
-	    if (!pname.null()) {
-		XDebug(DebugAll,"auth param name='%s' (no value)",pname.c_str());
-		m_params.append(new NamedString(pname));
-	    }
-	}
+	addParam(m_params,value.c_str(),sp + 1,ep,((eq > 0) && (eq < ep)) ? eq : -1);
 	sp = ep;
     }
 }
@@ -496,10 +496,7 @@ String* MimeBody::getUnfoldedLine(const char*& buf, int& len)
 	    case '\n':
 		++b;
 		--l;
-		{
-		    String line(s,e);
-		    *res << line;
-		}
+		res->append(s,e);
 		// Skip over any continuation characters at start of next line
 		goOut = true;
 		while ((l > 0) && *res && isContinuationBlank(b[0])) {
@@ -548,11 +545,11 @@ String* MimeBody::getUnfoldedLine(const char*& buf, int& len)
     buf = b;
     len = l;
     // Collect any leftover characters
-    if (e) {
-	String line(s,e);
-	*res << line;
-    }
-    res->trimBlanks();
+    if (e)
+	res->append(s,e);
+    unsigned int n = res->length();
+    if (n && (isContinuationBlank(res->at(0)) || isContinuationBlank(res->at(n - 1))))
+	res->trimBlanks();
     return res;
 }
 
@@ -993,7 +990,7 @@ void MimeSdpBody::buildLines(const char* buf, int len)
         String* line = getUnfoldedLine(buf,len);
 	int eq = line->find('=');
 	if (eq > 0)
-	    addLine(line->substr(0,eq),line->substr(eq+1));
+	    addLine(String(line->c_str(),eq),line->c_str() + eq + 1);
 	line->destruct();
     }
 }
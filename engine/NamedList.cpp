@@ -20,8 +20,145 @@
 #include "yateclass.h"
 #include "yatexml.h"
 
+#include <stdlib.h>
+
+// Minimum number of parameters walked before a lookup index is built
+#define INDEX_MIN 16
+
+namespace TelEngine {
+
+// Open addressing hash index holding the list node of the first parameter
+//  of each name so it can be replaced or removed without walking the list
+class NamedListIndex
+{
+public:
+    static NamedListIndex* build(const ObjList& params);
+    ObjList* find(const String& name) const;
+    bool add(ObjList* node);
+    void replace(const String& name, ObjList* node);
+    void remove(const String& name);
+    inline bool unique() const
+	{ return !m_dups; }
+private:
+    static inline const String& name(const ObjList* node)
+	{ return static_cast<const NamedString*>(node->get())->name(); }
+    unsigned int m_mask;
+    unsigned int m_used;
+    unsigned int m_dups;
+    ObjList* m_slots[1];
+};
+
+}; // namespace TelEngine
+
 using namespace TelEngine;
 
+NamedListIndex* NamedListIndex::build(const ObjList& params)
+{
+    unsigned int size = 64;
+    while (size < 2 * params.count())
+	size <<= 1;
+    NamedListIndex* idx = (NamedListIndex*)::calloc(1,sizeof(NamedListIndex) +
+	(size - 1) * sizeof(ObjList*));
+    if (!idx)
+	return 0;
+    idx->m_mask = size - 1;
+    for (const ObjList* l = params.skipNull(); l; l = l->skipNext()) {
+	if (!idx->add(const_cast<ObjList*>(l))) {
+	    ::free(idx);
+	    return 0;
+	}
+    }
+    return idx;
+}
+
+ObjList* NamedListIndex::find(const String& name) const
+{
+    for (unsigned int i = name.hash() & m_mask; m_slots[i]; i = (i + 1) & m_mask) {
+	if (NamedListIndex::name(m_slots[i]) == name)
+	    return m_slots[i];
+    }
+    return 0;
+}
+
+// Add a parameter node unless one with the same name is already indexed
+// Return false if the index is too full to add it
+bool NamedListIndex::add(ObjList* node)
+{
+    const String& n = name(node);
+    unsigned int i = n.hash() & m_mask;
+    for (; m_slots[i]; i = (i + 1) & m_mask) {
+	if (name(m_slots[i]) == n) {
+	    // the list may hold more parameters with this name from now on
+	    m_dups++;
+	    return true;
+	}
+    }
+    if (2 * (m_used + 1) > m_mask + 1)
+	return false;
+    m_slots[i] = node;
+    m_used++;
+    return true;
+}
+
+// Replace the indexed node of a name
+void NamedListIndex::replace(const String& name, ObjList* node)
+{
+    for (unsigned int i = name.hash() & m_mask; m_slots[i]; i = (i + 1) & m_mask) {
+	if (NamedListIndex::name(m_slots[i]) == name) {
+	    m_slots[i] = node;
+	    return;
+	}
+    }
+}
+
+// Remove a name, shift back the following entries of the probe sequence
+void NamedListIndex::remove(const String& name)
+{
+    unsigned int i = name.hash() & m_mask;
+    for (; m_slots[i]; i = (i + 1) & m_mask) {
+	if (NamedListIndex::name(m_slots[i]) == name)
+	    break;
+    }
+    if (!m_slots[i])
+	return;
+    m_slots[i] = 0;
+    m_used--;
+    for (unsigned int j = (i + 1) & m_mask; m_slots[j]; j = (j + 1) & m_mask) {
+	unsigned int k = NamedListIndex::name(m_slots[j]).hash() & m_mask;
+	// leave in place entries whose home slot is cyclically in (i,j]
+	if ((i < j) ? (k > i && k <= j) : (k > i || k <= j))
+	    continue;
+	m_slots[i] = m_slots[j];
+	m_slots[j] = 0;
+	i = j;
+    }
+}
+
+// Remove a list item keeping the index valid
+// ObjList::remove() moves the following item into the removed item's node
+static inline GenObject* nlRemove(NamedListIndex* idx, ObjList* o, bool delobj = true)
+{
+    if (idx) {
+	const String& name = static_cast<NamedString*>(o->get())->name();
+	ObjList* next = o->next();
+	if (idx->find(name) == o) {
+	    ObjList* f = idx->unique() ? 0 : o->skipNext();
+	    while (f && (static_cast<NamedString*>(f->get())->name() != name))
+		f = f->skipNext();
+	    if (!f)
+		idx->remove(name);
+	    else if (f != next)
+		idx->replace(name,f);
+	}
+	if (next && next->get()) {
+	    const String& moved = static_cast<NamedString*>(next->get())->name();
+	    if (idx->find(moved) == next)
+		idx->replace(moved,o);
+	}
+    }
+    return o->remove(delobj);
+}
+
 static inline const String* validName(const String& str, String& tmp)
 {
     if (!str)
@@ -77,22 +214,30 @@ const NamedList& NamedList::empty()
 }
 
 NamedList::NamedList(const char* name)
-    : String(name)
+    : String(name),
+      m_index(0), m_noIndex(false)
 {
 }
 
 NamedList::NamedList(const NamedList& original)
-    : String(original)
+    : String(original),
+      m_index(0), m_noIndex(false)
 {
     copyParams(false,original);
 }
 
 NamedList::NamedList(const char* name, const NamedList& original, const String& prefix)
-    : String(name)
+    : String(name),
+      m_index(0), m_noIndex(false)
 {
     copySubParams(original,prefix);
 }
 
+NamedList::~NamedList()
+{
+    clearIndex();
+}
+
 NamedList& NamedList::operator=(const NamedList& value)
 {
     String::operator=(value);
@@ -112,7 +257,7 @@ NamedList& NamedList::addParam(NamedString* param)
     XDebug(DebugInfo,"NamedList::addParam(%p) [\"%s\",\"%s\"]",
         param,(param ? param->name().c_str() : ""),TelEngine::c_safe(param));
     if (param)
-	m_params.append(param);
+	indexAdd(m_params.append(param));
     return *this;
 }
 
@@ -120,17 +265,17 @@ NamedList& NamedList::addParam(const char* name, const char* value, bool emptyOK
 {
     XDebug(DebugInfo,"NamedList::addParam(\"%s\",\"%s\",%s)",name,value,String::boolText(emptyOK));
     if (emptyOK || !TelEngine::null(value))
-	m_params.append(new NamedString(name, value, -1, prefix));
+	indexAdd(m_params.append(new NamedString(name, value, -1, prefix)));
     return *this;
 }
 
-static inline void nlClearParam(const String& name, ObjList* lst)
+static inline void nlClearParam(const String& name, ObjList* lst, NamedListIndex* idx = 0)
 {
     lst = lst ? lst->skipNull() : 0;
     while (lst) {
         NamedString* ns = static_cast<NamedString*>(lst->get());
         if (ns->name() == name) {
-	    lst->remove();
+	    nlRemove(idx,lst);
 	    lst = lst->skipNull();
 	}
 	else
@@ -143,6 +288,18 @@ NamedList& NamedList::setParam(NamedString* param, bool clearOther)
     XDebug(DebugAll,"NamedList::setParam(%p) [%p]",param,this);
     if (!param)
 	return *this;
+    if (liveIndex()) {
+	ObjList* o = liveIndex()->find(param->name());
+	if (!o) {
+	    indexAdd(m_params.append(param));
+	    return *this;
+	}
+	// the indexed node keeps the same name
+	o->set(param);
+	if (clearOther && !liveIndex()->unique())
+	    nlClearParam(param->name(),o->skipNext(),liveIndex());
+	return *this;
+    }
     ObjList* o = m_params.skipNull();
     while (o) {
         NamedString* s = static_cast<NamedString*>(o->get());
@@ -165,11 +322,22 @@ NamedList& NamedList::setParam(NamedString* param, bool clearOther)
     return *this;
 }
 
-static inline NamedString* nlSetParamCreate(NamedList& list, const String& name, bool clearOther)
+// Find the first parameter with a given name, create it at the end if missing
+NamedString* NamedList::createParam(const String& name, bool clearOther)
 {
-    ObjList* append = list.paramList()->skipNull();
+    if (liveIndex()) {
+	ObjList* o = liveIndex()->find(name);
+	if (!o) {
+	    o = m_params.append(new NamedString(name));
+	    indexAdd(o);
+	}
+	else if (clearOther && !liveIndex()->unique())
+	    nlClearParam(name,o->skipNext(),liveIndex());
+	return static_cast<NamedString*>(o->get());
+    }
+    ObjList* append = m_params.skipNull();
     if (!append)
-	return static_cast<NamedString*>(list.paramList()->append(new NamedString(name))->get());
+	return static_cast<NamedString*>(m_params.append(new NamedString(name))->get());
     while (true) {
         NamedString* ns = static_cast<NamedString*>(append->get());
         if (ns->name() == name) {
@@ -190,7 +358,7 @@ NamedList& NamedList::setParam(const String& name, unsigned int flags, const Tok
 {
     XDebug(DebugAll,"NamedList::setParam(%s) flags=%u tokens=%p unkFlag=%u [%p]",
 	name.safe(),flags,tokens,unknownFlag,this);
-    NamedString* ns = nlSetParamCreate(*this,name,clearOther);
+    NamedString* ns = createParam(name,clearOther);
     *static_cast<String*>(ns) = "";
     ns->decodeFlags(flags,tokens,unknownFlag);
     return *this;
@@ -201,7 +369,7 @@ NamedList& NamedList::setParam(const String& name, uint64_t flags, const TokenDi
 {
     XDebug(DebugAll,"NamedList::setParam(%s) flags64=" FMT64U " tokens=%p unkFlag=%u [%p]",
 	name.safe(),flags,tokens,unknownFlag,this);
-    NamedString* ns = nlSetParamCreate(*this,name,clearOther);
+    NamedString* ns = createParam(name,clearOther);
     *static_cast<String*>(ns) = "";
     ns->decodeFlags(flags,tokens,unknownFlag);
     return *this;
@@ -211,13 +379,13 @@ NamedList& NamedList::setParamHex(const String& name, const void* buf, unsigned
     bool upCase, bool clearOther)
 {
     XDebug(DebugAll,"NamedList::setParamHex(%s,%p,%u,%c) [%p]",name.safe(),buf,len,sep,this);
-    NamedString* ns = nlSetParamCreate(*this,name,clearOther);
+    NamedString* ns = createParam(name,clearOther);
     ns->hexify((void*)buf,len,sep,upCase);
     return *this;
 }
 
 #define nlSetParamValue(name,value,clearOther) { \
-    NamedString* ns = nlSetParamCreate(*this,name,clearOther); \
+    NamedString* ns = createParam(name,clearOther); \
     *static_cast<String*>(ns) = value; \
     return *this; \
 }
@@ -261,7 +429,7 @@ NamedList& NamedList::setParam(const String& name, double value, bool clearOther
 NamedString& NamedList::setParamRet(const String& name, const char* value, bool clearOther)
 {
     XDebug(DebugAll,"NamedList::setParamRet(%s,%s) [%p]",name.safe(),TelEngine::c_safe(value),this);
-    NamedString* ns = nlSetParamCreate(*this,name,clearOther);
+    NamedString* ns = createParam(name,clearOther);
     ns->assign(value);
     return *ns;
 }
@@ -271,11 +439,27 @@ NamedList& NamedList::clearParam(const String& name, char childSep, const String
     XDebug(DebugInfo,"NamedList::clearParam(\"%s\",'%.1s',(%p)'%s')",
 	name.c_str(),&childSep,value,TelEngine::c_safe(value));
     ObjList* p = &m_params;
+    if (liveIndex() && !childSep) {
+	// start from the first parameter with this name
+	p = liveIndex()->find(name);
+	if (!p)
+	    return *this;
+	if (liveIndex()->unique()) {
+	    if (!value || value->matches(*static_cast<NamedString*>(p->get())))
+		nlRemove(liveIndex(),p);
+	    return *this;
+	}
+	if (!value) {
+	    liveIndex()->remove(name);
+	    nlClearParam(name,p,liveIndex());
+	    return *this;
+	}
+    }
     if (childSep) {
 	while (p) {
 	    NamedString* s = static_cast<NamedString*>(p->get());
 	    if (s && isNameSep(name,s->name(),childSep) && (!value || value->matches(*s)))
-		p->remove();
+		nlRemove(liveIndex(),p);
 	    else
 		p = p->next();
 	}
@@ -284,7 +468,7 @@ NamedList& NamedList::clearParam(const String& name, char childSep, const String
 	while (p) {
 	    NamedString* s = static_cast<NamedString*>(p->get());
 	    if (s && (s->name() == name) && value->matches(*s))
-		p->remove();
+		nlRemove(liveIndex(),p);
 	    else
 		p = p->next();
 	}
@@ -302,7 +486,7 @@ NamedList& NamedList::clearParamMatch(const Regexp& name, const String* value)
     while (p) {
 	NamedString* s = static_cast<NamedString*>(p->get());
 	if (s && name.matches(s->name()) && (!value || value->matches(*s)))
-	    p->remove();
+	    nlRemove(liveIndex(),p);
 	else
 	    p = p->next();
     }
@@ -314,9 +498,10 @@ NamedList& NamedList::clearParam(NamedString* param, bool delParam)
 {
     if (!param)
 	return *this;
-    ObjList* o = m_params.find(param);
+    ObjList* o = liveIndex() ? liveIndex()->find(param->name()) : 0;
+    o = (o ? o : &m_params)->find(param);
     if (o)
-	o->remove(delParam);
+	nlRemove(liveIndex(),o,delParam);
     XDebug(DebugInfo,"NamedList::clearParam(%p) found=%p",param,o);
     return *this;
 }
@@ -332,16 +517,20 @@ NamedList& NamedList::copyParam(const NamedList& original, const String& name, c
 	    if (replace)
 		setParam(name,*s);
 	    else
-		listAddParam(m_params,name,*s);
+		addParam(name,*s);
 	}
 	else if (replace && clearMissing)
 	    clearParam(name);
     }
-    else if (!replace)
-	listAddSubParams(m_params,original,name,childSep);
-    else if (clearMissing) {
-	clearParam(name,childSep);
-	listAddSubParams(m_params,original,name,childSep);
+    else if (!replace || clearMissing) {
+	if (replace)
+	    clearParam(name,childSep);
+	ObjList* o = m_params.last();
+	listAddSubParams(*o,original,name,childSep);
+	if (liveIndex()) {
+	    for (o = o->skipNull(); o; o = o->skipNext())
+		indexAdd(o);
+	}
     }
     else {
 	// Replace existing, append all other
@@ -361,10 +550,14 @@ NamedList& NamedList::copyParams(bool replace, const NamedList& original, const
     ObjList* append = replace ? 0 : &m_params;
     if (addPrefix && !*addPrefix)
 	addPrefix = 0;
+    if (addPrefix && !append)
+	clearIndex();
     for (const ObjList* l = original.m_params.skipNull(); l; l = l->skipNext()) {
 	const NamedString* p = static_cast<const NamedString*>(l->get());
-	if (append)
+	if (append) {
 	    append = append->append(new NamedString(p->name(),*p,p->length(),addPrefix));
+	    indexAdd(append);
+	}
 	else if (!addPrefix)
 	    setParam(p->name(),*p);
 	else {
@@ -400,7 +593,8 @@ NamedList& NamedList::copyParams(const NamedList& original, ObjList* list, char
     if (!list)
 	return *this;
     String tmp;
-    ObjList* append = replace ? 0 : &m_params;
+    ObjList* append = replace ? 0 : m_params.last();
+    ObjList* first = append;
     for (; list; list = list->next()) {
 	GenObject* obj = list->get();
 	if (!obj)
@@ -418,6 +612,10 @@ NamedList& NamedList::copyParams(const NamedList& original, ObjList* list, char
 	else
 	    append = listAddSubParams(*append,original,*name,childSep);
     }
+    if (first && liveIndex()) {
+	for (first = first->skipNull(); first; first = first->skipNext())
+	    indexAdd(first);
+    }
     return *this;
 }
 
@@ -450,8 +648,10 @@ NamedList& NamedList::copySubParams(const NamedList& original, const String& pre
 		const char* name = s->name().c_str() + offs;
 		if (!*name)
 		    continue;
-		if (dest)
+		if (dest) {
 		    dest = dest->append(new NamedString(name,*s));
+		    indexAdd(dest);
+		}
 		else if (offs)
 		    setParam(name,*s);
 		else
@@ -565,12 +765,26 @@ int NamedList::getIndex(const String& name) const
 NamedString* NamedList::getParam(const String& name) const
 {
     XDebug(DebugInfo,"NamedList::getParam(\"%s\")",name.c_str());
+    // pairs with the release in buildIndex() done by a concurrent reader
+    const NamedListIndex* idx = __atomic_load_n(&m_index,__ATOMIC_ACQUIRE);
+    // an index left over after paramList() gave out the list may be stale
+    if (idx && !__atomic_load_n(&m_noIndex,__ATOMIC_RELAXED)) {
+	const ObjList* o = idx->find(name);
+	return o ? static_cast<NamedString*>(o->get()) : 0;
+    }
+    unsigned int n = 0;
     const ObjList *p = m_params.skipNull();
     for (; p; p=p->skipNext()) {
         NamedString *s = static_cast<NamedString *>(p->get());
-        if (s->name() == name)
+        if (s->name() == name) {
+	    if (n >= INDEX_MIN)
+		buildIndex();
             return s;
+	}
+	n++;
     }
+    if (n >= INDEX_MIN)
+	buildIndex();
     return 0;
 }
 
@@ -699,13 +913,48 @@ int NamedList::replaceParams(String& str, bool sqlEsc, char extraEsc) const
     return cnt;
 }
 
+// Build the lookup index of a large list, may be called concurrently by readers
+void NamedList::buildIndex() const
+{
+    if (m_noIndex)
+	return;
+    NamedListIndex* idx = NamedListIndex::build(m_params);
+    if (idx && !__sync_bool_compare_and_swap(&m_index,(NamedListIndex*)0,idx))
+	::free(idx);
+}
+
+void NamedList::indexAdd(ObjList* node)
+{
+    NamedListIndex* idx = liveIndex();
+    if (idx && !idx->add(node))
+	clearIndex();
+}
+
+// Retrieve the index for an update, drop it if the list was given out for changes
+NamedListIndex* NamedList::liveIndex()
+{
+    if (m_noIndex && m_index)
+	clearIndex();
+    return m_index;
+}
+
+void NamedList::clearIndex()
+{
+    if (!m_index)
+	return;
+    ::free(m_index);
+    m_index = 0;
+}
+
 NamedList& NamedList::moveParamsReplace(NamedList& dest, bool replaceAllExisting)
 {
+    clearIndex();
+    dest.clearIndex();
     NamedString* mark = new NamedString("");
-    ObjList* append = dest.paramList()->append(mark);
-    for (ObjList* o = paramList()->skipNull(); o; o = o->skipNull()) {
+    ObjList* append = dest.m_params.append(mark);
+    for (ObjList* o = m_params.skipNull(); o; o = o->skipNull()) {
 	NamedString* ns = static_cast<NamedString*>(o->remove(false));
-	for (ObjList* oDest = dest.paramList()->skipNull(); oDest; ) {
+	for (ObjList* oDest = dest.m_params.skipNull(); oDest; ) {
 	    NamedString* nsMsg = static_cast<NamedString*>(oDest->get());
 	    if (nsMsg == mark)
 		break;
@@ -41,6 +41,13 @@
 
 #undef HAS_AF_UNIX
 
+#ifdef MSG_WAITFORONE
+// recvmmsg() and sendmmsg() are available
+#define HAVE_MMSG
+#endif
+// Maximum number of messages handled by a multiple message operation
+#define MAX_MMSG 32
+
 #ifndef _WINDOWS
 
 #include <net/if.h>
@@ -2055,6 +2062,101 @@ int Socket::recvFrom(void* buffer, int length, SocketAddr& addr, int flags)
     return res;
 }
 
+int Socket::recvFromMulti(void* buffer, int length, int* lengths, SocketAddr* addrs,
+    int count, int flags)
+{
+    if (!(buffer && lengths) || (length <= 0) || (count <= 0))
+	return 0;
+    if (count > MAX_MMSG)
+	count = MAX_MMSG;
+    char* buf = (char*)buffer;
+#ifdef HAVE_MMSG
+    struct mmsghdr msgs[MAX_MMSG];
+    struct iovec iov[MAX_MMSG];
+    struct sockaddr_storage names[MAX_MMSG];
+    for (int i = 0; i < count; i++) {
+	iov[i].iov_base = buf + i * length;
+	iov[i].iov_len = length;
+	::memset(&msgs[i],0,sizeof(struct mmsghdr));
+	msgs[i].msg_hdr.msg_name = &names[i];
+	msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+	msgs[i].msg_hdr.msg_iov = &iov[i];
+	msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    int res = ::recvmmsg(m_handle,msgs,count,flags,0);
+    if (!checkError(res,true))
+	return res;
+    for (int i = 0; i < res; i++) {
+	const struct sockaddr* addr = (const struct sockaddr*)&names[i];
+	socklen_t adrlen = msgs[i].msg_hdr.msg_namelen;
+	lengths[i] = msgs[i].msg_len;
+	if (addrs)
+	    addrs[i].assign(addr,adrlen);
+	if (applyFilters(buf + i * length,lengths[i],flags,addr,adrlen))
+	    lengths[i] = 0;
+    }
+    return res;
+#else
+    char name[MAX_SOCKLEN];
+    int n = 0;
+    for (; n < count; n++) {
+	char* data = buf + n * length;
+	socklen_t adrlen = sizeof(name);
+	int res = ::recvfrom(m_handle,data,length,flags,(struct sockaddr*)name,&adrlen);
+	if (!checkError(res,true)) {
+	    if (!n)
+		return res;
+	    break;
+	}
+	lengths[n] = res;
+	if (addrs)
+	    addrs[n].assign((struct sockaddr*)name,adrlen);
+	if (applyFilters(data,res,flags,(struct sockaddr*)name,adrlen))
+	    lengths[n] = 0;
+    }
+    return n;
+#endif
+}
+
+int Socket::sendToMulti(const void* const* buffers, const int* lengths, int count,
+    const SocketAddr& addr, int flags)
+{
+    if (!(buffers && lengths) || (count <= 0))
+	return 0;
+#ifdef HAVE_MMSG
+    if (count > MAX_MMSG)
+	count = MAX_MMSG;
+    struct mmsghdr msgs[MAX_MMSG];
+    struct iovec iov[MAX_MMSG];
+    for (int i = 0; i < count; i++) {
+	iov[i].iov_base = (void*)buffers[i];
+	iov[i].iov_len = buffers[i] ? lengths[i] : 0;
+	::memset(&msgs[i],0,sizeof(struct mmsghdr));
+	msgs[i].msg_hdr.msg_name = (void*)addr.address();
+	msgs[i].msg_hdr.msg_namelen = addr.length();
+	msgs[i].msg_hdr.msg_iov = &iov[i];
+	msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    int res = ::sendmmsg(m_handle,msgs,count,flags);
+    if (!checkError(res,true))
+	return res;
+    for (int i = 0; i < res; i++)
+	applyFilters(buffers[i],msgs[i].msg_len,flags,addr.address(),addr.length(),false);
+    return res;
+#else
+    int n = 0;
+    for (; n < count; n++) {
+	int res = sendTo(buffers[n],lengths[n],addr,flags);
+	if (res == socketError()) {
+	    if (!n)
+		return res;
+	    break;
+	}
+    }
+    return n;
+#endif
+}
+
 int Socket::recv(void* buffer, int length, int flags)
 {
     if (!buffer)
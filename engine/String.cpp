@@ -20,6 +20,7 @@
 #include "yateclass.h"
 
 #include <errno.h>
+#include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -601,30 +602,38 @@ String::String(const String& value)
 {
     XDebug(DebugAll,"String::String(%p) [%p]",&value,this);
     if (!value.null()) {
-	m_string = ::strdup(value.c_str());
-	if (!m_string)
-	    Debug("String",DebugFail,"strdup() returned NULL!");
-	else
-	    m_length = value.length();
-	changed();
+	char* data = allocData(value.length(),0);
+	if (data) {
+	    ::memcpy(data,value.c_str(),value.length());
+	    changeStringData(data,value.length());
+	    // same value so the hash, if already computed, is the same
+	    m_hash = value.m_hash;
+	}
     }
 }
 
+#if __cplusplus >= 201103L
+String::String(String&& value)
+    : GenObject(),
+      m_string(0), m_length(0), m_hash(YSTRING_INIT_HASH), m_matches(0)
+{
+    XDebug(DebugAll,"String::String(&&%p) [%p]",&value,this);
+    takeData(value);
+}
+
+String& String::operator=(String&& value)
+{
+    if (&value != this)
+	takeData(value);
+    return *this;
+}
+#endif
+
 String::String(char value, unsigned int repeat)
     : m_string(0), m_length(0), m_hash(YSTRING_INIT_HASH), m_matches(0)
 {
     XDebug(DebugAll,"String::String('%c',%d) [%p]",value,repeat,this);
-    if (value && repeat) {
-	m_string = (char *) ::malloc(repeat+1);
-	if (m_string) {
-	    ::memset(m_string,value,repeat);
-	    m_string[repeat] = 0;
-	    m_length = repeat;
-	}
-	else
-	    Debug("String",DebugFail,"malloc(%d) returned NULL!",repeat+1);
-	changed();
-    }
+    assign(value,repeat);
 }
 
 String::String(int32_t value)
@@ -633,10 +642,7 @@ String::String(int32_t value)
     XDebug(DebugAll,"String::String(%d) [%p]",value,this);
     char buf[16];
     ::sprintf(buf,"%d",value);
-    m_string = ::strdup(buf);
-    if (!m_string)
-	Debug("String",DebugFail,"strdup() returned NULL!");
-    changed();
+    assign(buf);
 }
 
 String::String(int64_t value)
@@ -645,10 +651,7 @@ String::String(int64_t value)
     XDebug(DebugAll,"String::String(" FMT64 ") [%p]",value,this);
     char buf[24];
     ::sprintf(buf,FMT64,value);
-    m_string = ::strdup(buf);
-    if (!m_string)
-	Debug("String",DebugFail,"strdup() returned NULL!");
-    changed();
+    assign(buf);
 }
 
 String::String(uint32_t value)
@@ -657,10 +660,7 @@ String::String(uint32_t value)
     XDebug(DebugAll,"String::String(%u) [%p]",value,this);
     char buf[16];
     ::sprintf(buf,"%u",value);
-    m_string = ::strdup(buf);
-    if (!m_string)
-	Debug("String",DebugFail,"strdup() returned NULL!");
-    changed();
+    assign(buf);
 }
 
 String::String(uint64_t value)
@@ -669,20 +669,14 @@ String::String(uint64_t value)
     XDebug(DebugAll,"String::String(" FMT64U ") [%p]",value,this);
     char buf[24];
     ::sprintf(buf,FMT64U,value);
-    m_string = ::strdup(buf);
-    if (!m_string)
-	Debug("String",DebugFail,"strdup() returned NULL!");
-    changed();
+    assign(buf);
 }
 
 String::String(bool value)
     : m_string(0), m_length(0), m_hash(YSTRING_INIT_HASH), m_matches(0)
 {
     XDebug(DebugAll,"String::String(%u) [%p]",value,this);
-    m_string = ::strdup(boolText(value));
-    if (!m_string)
-	Debug("String",DebugFail,"strdup() returned NULL!");
-    changed();
+    assign(boolText(value));
 }
 
 String::String(double value)
@@ -691,10 +685,7 @@ String::String(double value)
     XDebug(DebugAll,"String::String(%g) [%p]",value,this);
     char buf[80];
     ::sprintf(buf,"%g",value);
-    m_string = ::strdup(buf);
-    if (!m_string)
-	Debug("String",DebugFail,"strdup() returned NULL!");
-    changed();
+    assign(buf);
 }
 
 String::String(const String* value)
@@ -702,12 +693,12 @@ String::String(const String* value)
 {
     XDebug(DebugAll,"String::String(%p) [%p]",&value,this);
     if (value && !value->null()) {
-	m_string = ::strdup(value->c_str());
-	if (!m_string)
-	    Debug("String",DebugFail,"strdup() returned NULL!");
-	else
-	    m_length = value->length();
-	changed();
+	char* data = allocData(value->length(),0);
+	if (data) {
+	    ::memcpy(data,value->c_str(),value->length());
+	    changeStringData(data,value->length());
+	    m_hash = value->m_hash;
+	}
     }
 }
 
@@ -723,7 +714,8 @@ String::~String()
 	char *odata = m_string;
 	m_length = 0;
 	m_string = 0;
-	::free(odata);
+	if (odata != m_inline)
+	    ::free(odata);
     }
 }
 
@@ -747,21 +739,14 @@ String& String::assign(const char* value, int len, const char* extraVal, int ext
 	else
 	    extraLen = 0;
 	if (value != m_string || len != (int)m_length || extraLen) {
-	    char* data = (char*) ::malloc(len+1);
+	    char tmp[YSTRING_INLINE];
+	    char* data = allocData(len,tmp);
 	    if (data) {
 		::memcpy(data,value,len - extraLen);
 		if (extraVal)
 		    ::memcpy(data + len - extraLen,extraVal,extraLen);
-		data[len] = 0;
-		char* odata = m_string;
-		m_string = data;
-		m_length = len;
-		changed();
-		if (odata)
-		    ::free(odata);
+		changeStringData(data,len,tmp);
 	    }
-	    else
-		Debug("String",DebugFail,"malloc(%d) returned NULL!",len+1);
 	}
     }
     else
@@ -772,19 +757,12 @@ String& String::assign(const char* value, int len, const char* extraVal, int ext
 String& String::assign(char value, unsigned int repeat)
 {
     if (repeat && value) {
-	char* data = (char*) ::malloc(repeat+1);
+	char tmp[YSTRING_INLINE];
+	char* data = allocData(repeat,tmp);
 	if (data) {
 	    ::memset(data,value,repeat);
-	    data[repeat] = 0;
-	    char* odata = m_string;
-	    m_string = data;
-	    m_length = repeat;
-	    changed();
-	    if (odata)
-		::free(odata);
+	    changeStringData(data,repeat,tmp);
 	}
-	else
-	    Debug("String",DebugFail,"malloc(%d) returned NULL!",repeat+1);
     }
     else
 	clear();
@@ -798,7 +776,8 @@ String& String::hexify(const void* data, unsigned int len, char sep, bool upCase
 	const unsigned char* s = (const unsigned char*) data;
 	unsigned int repeat = sep ? 3*len-1 : 2*len;
 	// I know it's ugly to reuse but... copy/paste...
-	char* data = (char*) ::malloc(repeat+1);
+	char tmp[YSTRING_INLINE];
+	char* data = allocData(repeat,tmp);
 	if (data) {
 	    char* d = data;
 	    while (len--) {
@@ -811,16 +790,8 @@ String& String::hexify(const void* data, unsigned int len, char sep, bool upCase
 	    // wrote one too many - go back...
 	    if (sep)
 		d--;
-	    *d = '\0';
-	    char* odata = m_string;
-	    m_string = data;
-	    m_length = repeat;
-	    changed();
-	    if (odata)
-		::free(odata);
+	    changeStringData(data,repeat,tmp);
 	}
-	else
-	    Debug("String",DebugFail,"malloc(%d) returned NULL!",repeat+1);
     }
     else
 	clear();
@@ -843,7 +814,8 @@ void String::clear()
 	char *odata = m_string;
 	m_string = 0;
 	changed();
-	::free(odata);
+	if (odata != m_inline)
+	    ::free(odata);
     }
 }
 
@@ -1086,14 +1058,10 @@ String& String::operator=(const char* value)
     if (value && !*value)
 	value = 0;
     if (value != c_str()) {
-	char *tmp = m_string;
-	m_string = value ? ::strdup(value) : 0;
-	m_length = 0;
-	if (value && !m_string)
-	    Debug("String",DebugFail,"strdup() returned NULL!");
-	changed();
-	if (tmp)
-	    ::free(tmp);
+	if (value)
+	    assign(value);
+	else
+	    clear();
     }
     return *this;
 }
@@ -1270,33 +1238,18 @@ String& String::operator>>(bool& store)
 String& String::append(const char* value, int len)
 {
     if (len && value && *value) {
-	if (len < 0) {
-	    if (!m_string) {
-		m_string = ::strdup(value);
-		m_length = 0;
-		if (!m_string)
-		    Debug("String",DebugFail,"strdup() returned NULL!");
-		changed();
-		return *this;
-	    }
+	if (len < 0)
 	    len = ::strlen(value);
-	}
 	int olen = length();
 	len += olen;
-	char *tmp1 = m_string;
-	char *tmp2 = (char *) ::malloc(len+1);
-	if (tmp2) {
+	char tmp[YSTRING_INLINE];
+	char* data = allocData(len,tmp);
+	if (data) {
 	    if (m_string)
-		::strncpy(tmp2,m_string,olen);
-	    ::strncpy(tmp2+olen,value,len-olen);
-	    tmp2[len] = 0;
-	    m_string = tmp2;
-	    m_length = len;
-	    ::free(tmp1);
+		::memcpy(data,m_string,olen);
+	    ::strncpy(data+olen,value,len-olen);
+	    changeStringData(data,len,tmp);
 	}
-	else
-	    Debug("String",DebugFail,"malloc(%d) returned NULL!",len+1);
-	changed();
     }
     return *this;
 }
@@ -1328,12 +1281,10 @@ String& String::append(const ObjList* list, const char* separator, bool force)
     }
     if (!len)
 	return *this;
-    char* oldStr = m_string;
-    char* newStr = (char*)::malloc(olen + len + 1);
-    if (!newStr) {
-	Debug("String",DebugFail,"malloc(%d) returned NULL!",olen + len + 1);
+    char tmp[YSTRING_INLINE];
+    char* newStr = allocData(olen + len,tmp);
+    if (!newStr)
 	return *this;
-    }
     if (m_string)
 	::memcpy(newStr,m_string,olen);
     for (list = list->skipNull(); list; list = list->skipNext()) {
@@ -1345,12 +1296,7 @@ String& String::append(const ObjList* list, const char* separator, bool force)
 	::memcpy(newStr + olen,src.c_str(),src.length());
 	olen += src.length();
     }
-    newStr[olen] = 0;
-    m_string = newStr;
-    m_length = olen;
-    ::free(oldStr);
-    changed();
-    return *this;
+    return changeStringData(newStr,olen,tmp);
 }
 
 String& String::append(double value, unsigned int decimals)
@@ -1375,12 +1321,10 @@ String& String::insert(unsigned int pos, const char* value, int len)
 
     int olen = length();
     int sLen = len + olen;
-    char* tmp1 = m_string;
-    char* tmp2 = (char*)::malloc(sLen + 1);
-    if (!tmp2) {
-	Debug("String",DebugFail,"malloc(%d) returned NULL!",sLen + 1);
+    char tmp[YSTRING_INLINE];
+    char* tmp2 = allocData(sLen,tmp);
+    if (!tmp2)
 	return *this;
-    }
     if (!pos) {
 	::strncpy(tmp2,value,len);
 	::strncpy(tmp2 + len,m_string,olen);
@@ -1390,12 +1334,7 @@ String& String::insert(unsigned int pos, const char* value, int len)
 	::strncpy(tmp2 + pos,value,len);
 	::strncpy(tmp2 + pos + len,m_string + pos,olen - pos);
     }
-    tmp2[sLen] = 0;
-    m_string = tmp2;
-    m_length = sLen;
-    ::free(tmp1);
-    changed();
-    return *this;
+    return changeStringData(tmp2,sLen,tmp);
 }
 
 // Insert characters in string into current string
@@ -1407,24 +1346,25 @@ String& String::insert(unsigned int pos, char value, unsigned int len)
     if (pos > m_length)
 	pos = m_length;
     unsigned int newLen = len + m_length;
-    char* data = strAlloc(newLen,pos < m_length ? 0 : m_string);
-    if (!data)
-	return *this;
-    if (m_string) {
-	if (!pos)
-	    // Insert before existing, copy old data after it
-	    ::memcpy(data + len,m_string,m_length);
-	else if (pos == m_length)
-	    // Data reallocated. Reset held pointer
+    char tmp[YSTRING_INLINE];
+    char* data = 0;
+    if (pos == m_length && m_string && m_string != m_inline && newLen >= YSTRING_INLINE) {
+	// Append to allocated data, reallocate it and reset held pointer
+	data = strAlloc(newLen,m_string);
+	if (data)
 	    m_string = 0;
-	else {
-	    // Insert middle
+    }
+    else {
+	data = allocData(newLen,tmp);
+	if (data && m_string) {
 	    ::memcpy(data,m_string,pos);
 	    ::memcpy(data + pos + len,m_string + pos,m_length - pos);
 	}
     }
+    if (!data)
+	return *this;
     ::memset(data + pos,value,len);
-    return changeStringData(data,newLen);
+    return changeStringData(data,newLen,tmp);
 }
 
 static char* string_printf(unsigned int& length, const char* format, va_list& va)
@@ -1484,12 +1424,7 @@ String& String::printf(unsigned int length, const char* format,  ...)
 	clear();
 	return *this;
     }
-    char* old = m_string;
-    m_string = buf;
-    m_length = length;
-    ::free(old);
-    changed();
-    return *this;
+    return changeStringData(buf,length);
 }
 
 String& String::printf(const char* format, ...)
@@ -1503,12 +1438,7 @@ String& String::printf(const char* format, ...)
 	clear();
 	return *this;
     }
-    char* old = m_string;
-    m_string = buf;
-    m_length = len;
-    ::free(old);
-    changed();
-    return *this;
+    return changeStringData(buf,len);
 }
 
 String& String::printfAppend(unsigned int length, const char* format,  ...)
@@ -2449,6 +2379,882 @@ char* String::c_replace_chars(const char* str, const char* what, const char* rep
 }
 
 
+// Linear time matcher used for the expressions it can handle: the pattern is
+//  compiled to a Thompson NFA that is run in lockstep over the subject (Pike VM)
+// Expressions using backreferences or other extensions are left to regexec()
+// Build with NO_LINEAR_REGEXP defined to always use regexec()
+
+// Maximum number of instructions of a compiled expression
+#define REX_MAX_CODE 8192
+// Maximum repeat count in a {m,n} interval
+#define REX_MAX_DUP 255
+// Number of entries in the compiled expressions cache
+#define REX_CACHE 256
+
+namespace { // anonymous
+
+enum RexOp {
+    RexChar = 0,
+    RexAny,
+    RexClass,
+    RexBol,
+    RexEol,
+    RexJmp,
+    RexSplit,
+    RexSave,
+    RexMatch
+};
+
+// One NFA instruction, jump targets are relative to the instruction
+struct RexInst
+{
+    unsigned char op;
+    unsigned char c;
+    int x;
+    int y;
+};
+
+// Compiled program of an expression, shared by all Regexp with the same text
+class RexProgram : public RefObject
+{
+public:
+    RexProgram(const String& pattern, int flags);
+    ~RexProgram();
+    bool exec(const char* str, int nmatch, regmatch_t* rmatch) const;
+    inline const String& pattern() const
+	{ return m_pattern; }
+    inline int flags() const
+	{ return m_flags; }
+    inline bool valid() const
+	{ return m_code != 0; }
+private:
+    friend class RexCompiler;
+    inline bool inClass(int cls, unsigned char c) const
+	{ return (m_classes[cls * 32 + (c >> 3)] & (1 << (c & 7))) != 0; }
+    void addThread(int* pcs, int* caps, int& count, int pc, int* work, int ncap,
+	int* stack, int* mark, int pos, bool atEnd) const;
+    String m_pattern;
+    int m_flags;
+    RexInst* m_code;
+    int m_length;
+    unsigned char* m_classes;
+    int m_groups;
+    bool m_anchored;
+};
+
+// Recursive descent compiler of POSIX basic (GNU flavor) and extended expressions
+class RexCompiler
+{
+public:
+    RexCompiler(const char* pattern, int flags);
+    ~RexCompiler();
+    bool compile(RexProgram& prog);
+private:
+    bool parseAlt(int depth);
+    bool parseBranch(int depth);
+    bool parseBracket();
+    bool parseInterval(int& minVal, int& maxVal);
+    bool repeat(int start, int minVal, int maxVal);
+    int emit(int op, int c = 0, int x = 0, int y = 0);
+    bool insert(int pos, int op, int x = 0, int y = 0);
+    bool copy(int start, int len);
+    bool emptyGroup(int start, int len) const;
+    bool variableGroup(int start, int len) const;
+    bool branchEnd() const;
+    inline char cur() const
+	{ return m_pat[m_pos]; }
+    inline char peek(int offs = 1) const
+	{ return m_pat[m_pos] ? m_pat[m_pos + offs] : 0; }
+    const char* m_pat;
+    int m_pos;
+    bool m_extended;
+    bool m_icase;
+    RexInst* m_code;
+    int m_length;
+    int m_alloc;
+    unsigned char* m_classes;
+    int m_numClasses;
+    int m_groups;
+};
+
+// Compiled form of a Regexp
+class RegexpData
+{
+public:
+    RexProgram* linear;
+    regex_t posix;
+};
+
+}; // anonymous namespace
+
+static RexProgram* s_rexCache[REX_CACHE];
+static Mutex s_rexMutex(false,"Regexp");
+
+RexCompiler::RexCompiler(const char* pattern, int flags)
+    : m_pat(pattern), m_pos(0),
+      m_extended(0 != (flags & REG_EXTENDED)), m_icase(0 != (flags & REG_ICASE)),
+      m_code(0), m_length(0), m_alloc(0),
+      m_classes(0), m_numClasses(0), m_groups(0)
+{
+}
+
+RexCompiler::~RexCompiler()
+{
+    delete[] m_code;
+    ::free(m_classes);
+}
+
+int RexCompiler::emit(int op, int c, int x, int y)
+{
+    if (m_length >= m_alloc) {
+	if (m_length >= REX_MAX_CODE)
+	    return -1;
+	m_alloc = m_alloc ? 2 * m_alloc : 32;
+	RexInst* tmp = new RexInst[m_alloc];
+	if (m_length)
+	    ::memcpy(tmp,m_code,m_length * sizeof(RexInst));
+	delete[] m_code;
+	m_code = tmp;
+    }
+    RexInst& i = m_code[m_length];
+    i.op = op;
+    i.c = c;
+    i.x = x;
+    i.y = y;
+    return m_length++;
+}
+
+// insert an instruction before a self contained code fragment
+bool RexCompiler::insert(int pos, int op, int x, int y)
+{
+    if (emit(op) < 0)
+	return false;
+    ::memmove(m_code + pos + 1,m_code + pos,(m_length - pos - 1) * sizeof(RexInst));
+    RexInst& i = m_code[pos];
+    i.op = op;
+    i.c = 0;
+    i.x = x;
+    i.y = y;
+    return true;
+}
+
+// append a copy of a self contained code fragment
+bool RexCompiler::copy(int start, int len)
+{
+    for (int i = 0; i < len; i++) {
+	const RexInst& src = m_code[start + i];
+	if (emit(src.op,src.c,src.x,src.y) < 0)
+	    return false;
+    }
+    return true;
+}
+
+// check if a fragment holding captures can match the empty string,
+//  POSIX rules for repeating such groups are left to the system library
+bool RexCompiler::emptyGroup(int start, int len) const
+{
+    bool save = false;
+    for (int i = start; i < start + len; i++)
+	if (m_code[i].op == RexSave)
+	    save = true;
+    if (!save)
+	return false;
+    bool empty = false;
+    char* seen = new char[len];
+    ::memset(seen,0,len);
+    int* stack = new int[2 * len + 1];
+    int sp = 0;
+    stack[sp++] = 0;
+    while (sp) {
+	int pc = stack[--sp];
+	if (pc == len) {
+	    empty = true;
+	    break;
+	}
+	if (pc < 0 || pc > len || seen[pc])
+	    continue;
+	seen[pc] = 1;
+	const RexInst& i = m_code[start + pc];
+	switch (i.op) {
+	    case RexJmp:
+		stack[sp++] = pc + i.x;
+		break;
+	    case RexSplit:
+		stack[sp++] = pc + i.x;
+		stack[sp++] = pc + i.y;
+		break;
+	    case RexSave:
+	    case RexBol:
+	    case RexEol:
+		stack[sp++] = pc + 1;
+		break;
+	}
+    }
+    delete[] stack;
+    delete[] seen;
+    return empty;
+}
+
+// check if a fragment holding captures can match strings of different lengths,
+//  POSIX picks the subexpressions of such repeated groups by rules that
+//  the NFA thread priorities do not follow so they are left to regexec()
+bool RexCompiler::variableGroup(int start, int len) const
+{
+    bool save = false;
+    bool split = false;
+    for (int i = start; i < start + len; i++) {
+	if (m_code[i].op == RexSave)
+	    save = true;
+	else if (m_code[i].op == RexSplit)
+	    split = true;
+    }
+    return save && split;
+}
+
+// apply a repeat to the fragment that starts at given position
+bool RexCompiler::repeat(int start, int minVal, int maxVal)
+{
+    int len = m_length - start;
+    if ((maxVal < 0 || maxVal > minVal) && emptyGroup(start,len))
+	return false;
+    if ((maxVal != minVal || minVal > 1) && variableGroup(start,len))
+	return false;
+    if (maxVal < 0 && minVal <= 1) {
+	if (minVal) {
+	    // x+ : x SPLIT(x,next)
+	    return emit(RexSplit,0,-len,1) >= 0;
+	}
+	// x* : SPLIT(x,next) x JMP(split)
+	if (!insert(start,RexSplit,1,len + 2))
+	    return false;
+	return emit(RexJmp,0,-(len + 1)) >= 0;
+    }
+    if (maxVal >= 0 && minVal > maxVal)
+	return false;
+    if ((minVal > 1 || maxVal > 1) && ((maxVal >= 0 ? maxVal : minVal + 1) * (len + 1) > REX_MAX_CODE))
+	return false;
+    int opt = (maxVal < 0) ? 0 : maxVal - minVal;
+    if (!minVal) {
+	// first copy becomes optional, remove it from the mandatory code
+	if (maxVal < 0)
+	    return repeat(start,0,-1);
+	if (!maxVal) {
+	    // x{0} matches the empty string
+	    m_length = start;
+	    return true;
+	}
+	if (!insert(start,RexSplit,1,len + 1))
+	    return false;
+	// relocate so the fragment is at start + 1
+	start++;
+	opt--;
+	int end = start + len + opt * (len + 1);
+	m_code[start - 1].y = end - (start - 1);
+	for (int i = 0; i < opt; i++) {
+	    int pos = emit(RexSplit,0,1,0);
+	    if (pos < 0 || !copy(start,len))
+		return false;
+	    m_code[pos].y = end - pos;
+	}
+	return true;
+    }
+    for (int i = 1; i < minVal; i++) {
+	if (!copy(start,len))
+	    return false;
+    }
+    if (maxVal < 0) {
+	// x{m,} : last copy is repeated
+	return emit(RexSplit,0,-len,1) >= 0;
+    }
+    int end = m_length + opt * (len + 1);
+    for (int i = 0; i < opt; i++) {
+	int pos = emit(RexSplit,0,1,0);
+	if (pos < 0 || !copy(start,len))
+	    return false;
+	m_code[pos].y = end - pos;
+    }
+    return true;
+}
+
+// parse the content of a {m,n} or \{m,n\} interval
+bool RexCompiler::parseInterval(int& minVal, int& maxVal)
+{
+    if (cur() < '0' || cur() > '9')
+	return false;
+    minVal = 0;
+    while (cur() >= '0' && cur() <= '9') {
+	minVal = minVal * 10 + cur() - '0';
+	if (minVal > REX_MAX_DUP)
+	    return false;
+	m_pos++;
+    }
+    maxVal = minVal;
+    if (cur() == ',') {
+	m_pos++;
+	if (cur() >= '0' && cur() <= '9') {
+	    maxVal = 0;
+	    while (cur() >= '0' && cur() <= '9') {
+		maxVal = maxVal * 10 + cur() - '0';
+		if (maxVal > REX_MAX_DUP)
+		    return false;
+		m_pos++;
+	    }
+	    if (maxVal < minVal)
+		return false;
+	}
+	else
+	    maxVal = -1;
+    }
+    if (!m_extended) {
+	if (cur() != '\\')
+	    return false;
+	m_pos++;
+    }
+    if (cur() != '}')
+	return false;
+    m_pos++;
+    return true;
+}
+
+// parse a [ ] bracket expression into a character set
+bool RexCompiler::parseBracket()
+{
+    static const struct {
+	const char* name;
+	int (*check)(int);
+    } s_classes[] = {
+	{ "alpha", ::isalpha },
+	{ "digit", ::isdigit },
+	{ "alnum", ::isalnum },
+	{ "upper", ::isupper },
+	{ "lower", ::islower },
+	{ "space", ::isspace },
+	{ "blank", ::isblank },
+	{ "punct", ::ispunct },
+	{ "print", ::isprint },
+	{ "graph", ::isgraph },
+	{ "cntrl", ::iscntrl },
+	{ "xdigit", ::isxdigit },
+	{ 0, 0 }
+    };
+    unsigned char set[32];
+    ::memset(set,0,sizeof(set));
+    bool negate = false;
+    if (cur() == '^') {
+	negate = true;
+	m_pos++;
+    }
+    bool first = true;
+    while (first || cur() != ']') {
+	first = false;
+	unsigned char c = cur();
+	if (!c)
+	    return false;
+	if (c == '[') {
+	    char t = peek();
+	    if (t == '=' || t == '.')
+		return false;
+	    if (t == ':') {
+		const char* name = m_pat + m_pos + 2;
+		const char* end = ::strstr(name,":]");
+		if (!end)
+		    return false;
+		int i = 0;
+		for (; s_classes[i].name; i++) {
+		    if ((int)::strlen(s_classes[i].name) == (end - name)
+			    && !::strncmp(s_classes[i].name,name,end - name))
+			break;
+		}
+		if (!s_classes[i].name)
+		    return false;
+		for (int b = 1; b < 256; b++)
+		    if (s_classes[i].check(b))
+			set[b >> 3] |= (1 << (b & 7));
+		m_pos = end + 2 - m_pat;
+		continue;
+	    }
+	}
+	m_pos++;
+	unsigned char last = c;
+	if (cur() == '-' && peek() && peek() != ']') {
+	    last = peek();
+	    if (last == '[' || last < c)
+		return false;
+	    m_pos += 2;
+	}
+	for (int b = c; b <= last; b++)
+	    set[b >> 3] |= (1 << (b & 7));
+    }
+    m_pos++;
+    if (m_icase) {
+	for (int b = 'a'; b <= 'z'; b++) {
+	    int u = b - 'a' + 'A';
+	    if (set[b >> 3] & (1 << (b & 7)))
+		set[u >> 3] |= (1 << (u & 7));
+	    else if (set[u >> 3] & (1 << (u & 7)))
+		set[b >> 3] |= (1 << (b & 7));
+	}
+    }
+    if (negate) {
+	for (int i = 0; i < 32; i++)
+	    set[i] = ~set[i];
+	// the string terminator can never match
+	set[0] &= 0xfe;
+    }
+    if ((m_numClasses % 8) == 0) {
+	unsigned char* tmp = (unsigned char*)::realloc(m_classes,(m_numClasses + 8) * 32);
+	if (!tmp)
+	    return false;
+	m_classes = tmp;
+    }
+    ::memcpy(m_classes + m_numClasses * 32,set,32);
+    return emit(RexClass,0,m_numClasses++) >= 0;
+}
+
+// check if the parser is at the end of an alternative
+bool RexCompiler::branchEnd() const
+{
+    char c = cur();
+    if (!c)
+	return true;
+    if (m_extended)
+	return (c == '|' || c == ')');
+    return (c == '\\' && (peek() == '|' || peek() == ')'));
+}
+
+bool RexCompiler::parseBranch(int depth)
+{
+    bool first = true;
+    while (!branchEnd()) {
+	int start = m_length;
+	unsigned char c = cur();
+	bool atom = true;
+	if (m_extended) {
+	    switch (c) {
+		case '(':
+		    {
+			m_pos++;
+			int grp = ++m_groups;
+			if (emit(RexSave,0,2 * grp) < 0 || !parseAlt(depth + 1))
+			    return false;
+			if (cur() != ')')
+			    return false;
+			m_pos++;
+			if (emit(RexSave,0,2 * grp + 1) < 0)
+			    return false;
+		    }
+		    break;
+		case '.':
+		    m_pos++;
+		    if (emit(RexAny) < 0)
+			return false;
+		    break;
+		case '[':
+		    m_pos++;
+		    if (!parseBracket())
+			return false;
+		    break;
+		case '^':
+		case '$':
+		    m_pos++;
+		    if (emit((c == '^') ? RexBol : RexEol) < 0)
+			return false;
+		    atom = false;
+		    break;
+		case '*':
+		case '+':
+		case '?':
+		case '{':
+		    return false;
+		case '\\':
+		    c = peek();
+		    if (!c || ::isalnum(c) || ::strchr("<>`'",c))
+			return false;
+		    m_pos += 2;
+		    if (emit(RexChar,m_icase ? ::tolower(c) : c) < 0)
+			return false;
+		    break;
+		default:
+		    m_pos++;
+		    if (emit(RexChar,m_icase ? ::tolower(c) : c) < 0)
+			return false;
+	    }
+	}
+	else {
+	    switch (c) {
+		case '\\':
+		    c = peek();
+		    if (c == '(') {
+			m_pos += 2;
+			int grp = ++m_groups;
+			if (emit(RexSave,0,2 * grp) < 0 || !parseAlt(depth + 1))
+			    return false;
+			if (cur() != '\\' || peek() != ')')
+			    return false;
+			m_pos += 2;
+			if (emit(RexSave,0,2 * grp + 1) < 0)
+			    return false;
+			break;
+		    }
+		    if (!c || ::isalnum(c) || ::strchr("<>`'{}+?",c))
+			return false;
+		    m_pos += 2;
+		    if (emit(RexChar,m_icase ? ::tolower(c) : c) < 0)
+			return false;
+		    break;
+		case '.':
+		    m_pos++;
+		    if (emit(RexAny) < 0)
+			return false;
+		    break;
+		case '[':
+		    m_pos++;
+		    if (!parseBracket())
+			return false;
+		    break;
+		case '^':
+		    m_pos++;
+		    if (m_pos == 1) {
+			// anchor at the very start of the expression
+			if (emit(RexBol) < 0)
+			    return false;
+			// a following '*' is a literal
+			continue;
+		    }
+		    // leave anchors in groups or alternatives to the system library
+		    if (first)
+			return false;
+		    if (emit(RexChar,c) < 0)
+			return false;
+		    break;
+		case '$':
+		    m_pos++;
+		    if (branchEnd() && !depth && !cur()) {
+			if (emit(RexEol) < 0)
+			    return false;
+			atom = false;
+			break;
+		    }
+		    if (branchEnd())
+			return false;
+		    if (emit(RexChar,c) < 0)
+			return false;
+		    break;
+		case '*':
+		    if (!first)
+			return false;
+		    // leading '*' is a literal
+		    m_pos++;
+		    if (emit(RexChar,c) < 0)
+			return false;
+		    break;
+		default:
+		    m_pos++;
+		    if (emit(RexChar,m_icase ? ::tolower(c) : c) < 0)
+			return false;
+	    }
+	}
+	first = false;
+	// process the quantifier following the atom, leave stacked ones to the library
+	for (bool quant = false; ; quant = true) {
+	    int minVal = 0;
+	    int maxVal = -1;
+	    c = cur();
+	    if (m_extended) {
+		if (c == '*' || c == '+' || c == '?') {
+		    m_pos++;
+		    minVal = (c == '+') ? 1 : 0;
+		    maxVal = (c == '?') ? 1 : -1;
+		}
+		else if (c == '{') {
+		    m_pos++;
+		    if (!parseInterval(minVal,maxVal))
+			return false;
+		}
+		else
+		    break;
+	    }
+	    else {
+		if (c == '*')
+		    m_pos++;
+		else if (c == '\\' && (peek() == '+' || peek() == '?')) {
+		    minVal = (peek() == '+') ? 1 : 0;
+		    maxVal = (peek() == '?') ? 1 : -1;
+		    m_pos += 2;
+		}
+		else if (c == '\\' && peek() == '{') {
+		    m_pos += 2;
+		    if (!parseInterval(minVal,maxVal))
+			return false;
+		}
+		else
+		    break;
+	    }
+	    if (quant || !atom || !repeat(start,minVal,maxVal))
+		return false;
+	}
+    }
+    return true;
+}
+
+// parse alternatives, each but the last is preceded by a SPLIT to the next one
+//  and followed by a JMP to the end, JMPs are chained until the end is known
+bool RexCompiler::parseAlt(int depth)
+{
+    int start = m_length;
+    if (!parseBranch(depth))
+	return false;
+    int jmp = -1;
+    while (true) {
+	if (m_extended) {
+	    if (cur() != '|')
+		break;
+	    m_pos++;
+	}
+	else {
+	    if (cur() != '\\' || peek() != '|')
+		break;
+	    m_pos += 2;
+	}
+	if (!insert(start,RexSplit,1,0))
+	    return false;
+	if (jmp >= start)
+	    jmp++;
+	int pos = emit(RexJmp,0,jmp);
+	if (pos < 0)
+	    return false;
+	jmp = pos;
+	m_code[start].y = m_length - start;
+	start = m_length;
+	if (!parseBranch(depth))
+	    return false;
+    }
+    while (jmp >= 0) {
+	int prev = m_code[jmp].x;
+	m_code[jmp].x = m_length - jmp;
+	jmp = prev;
+    }
+    return true;
+}
+
+bool RexCompiler::compile(RexProgram& prog)
+{
+    if (emit(RexSave,0,0) < 0 || !parseAlt(0) || cur())
+	return false;
+    if (emit(RexSave,0,1) < 0 || emit(RexMatch) < 0)
+	return false;
+    prog.m_code = m_code;
+    prog.m_length = m_length;
+    prog.m_classes = m_classes;
+    prog.m_groups = m_groups;
+    prog.m_anchored = (m_code[1].op == RexBol);
+    m_code = 0;
+    m_classes = 0;
+    return true;
+}
+
+RexProgram::RexProgram(const String& pattern, int flags)
+    : m_pattern(pattern), m_flags(flags),
+      m_code(0), m_length(0), m_classes(0), m_groups(0), m_anchored(false)
+{
+    RexCompiler comp(pattern,flags);
+    if (!comp.compile(*this))
+	XDebug(DebugAll,"Regexp '%s' left to the system library",pattern.c_str());
+}
+
+RexProgram::~RexProgram()
+{
+    delete[] m_code;
+    ::free(m_classes);
+}
+
+// follow all empty transitions from an instruction, add the reached
+//  character consuming instructions to the thread list
+void RexProgram::addThread(int* pcs, int* caps, int& count, int pc, int* work, int ncap,
+    int* stack, int* mark, int pos, bool atEnd) const
+{
+    // stack holds triplets of (pc, capture index, capture value)
+    int sp = 0;
+    stack[sp++] = pc;
+    stack[sp++] = -1;
+    stack[sp++] = 0;
+    while (sp) {
+	sp -= 3;
+	pc = stack[sp];
+	if (stack[sp + 1] >= 0) {
+	    // restore a capture after exploring the path that changed it
+	    work[stack[sp + 1]] = stack[sp + 2];
+	    continue;
+	}
+	if (mark[pc] == pos)
+	    continue;
+	mark[pc] = pos;
+	const RexInst& i = m_code[pc];
+	switch (i.op) {
+	    case RexJmp:
+		stack[sp++] = pc + i.x;
+		stack[sp++] = -1;
+		stack[sp++] = 0;
+		break;
+	    case RexSplit:
+		// preferred branch is pushed last so it's explored first
+		stack[sp++] = pc + i.y;
+		stack[sp++] = -1;
+		stack[sp++] = 0;
+		stack[sp++] = pc + i.x;
+		stack[sp++] = -1;
+		stack[sp++] = 0;
+		break;
+	    case RexSave:
+		if (i.x < ncap) {
+		    stack[sp++] = pc;
+		    stack[sp++] = i.x;
+		    stack[sp++] = work[i.x];
+		    work[i.x] = pos;
+		}
+		stack[sp++] = pc + 1;
+		stack[sp++] = -1;
+		stack[sp++] = 0;
+		break;
+	    case RexBol:
+		if (!pos) {
+		    stack[sp++] = pc + 1;
+		    stack[sp++] = -1;
+		    stack[sp++] = 0;
+		}
+		break;
+	    case RexEol:
+		if (atEnd) {
+		    stack[sp++] = pc + 1;
+		    stack[sp++] = -1;
+		    stack[sp++] = 0;
+		}
+		break;
+	    default:
+		pcs[count] = pc;
+		if (ncap)
+		    ::memcpy(caps + count * ncap,work,ncap * sizeof(int));
+		count++;
+	}
+    }
+}
+
+// run the program, matches are leftmost-longest like POSIX regexec()
+bool RexProgram::exec(const char* str, int nmatch, regmatch_t* rmatch) const
+{
+    int ncap = 0;
+    if (rmatch && nmatch > 0) {
+	ncap = 2 * (m_groups + 1);
+	if (ncap > 2 * nmatch)
+	    ncap = 2 * nmatch;
+    }
+    // two thread lists, a visit marker and the follow stack for each instruction
+    int size = 2 * m_length * (1 + ncap) + m_length + 9 * m_length + 3 * ncap;
+    int buf[2048];
+    int* mem = (size <= 2048) ? buf : new int[size];
+    int* cpcs = mem;
+    int* ccaps = cpcs + m_length;
+    int* npcs = ccaps + m_length * ncap;
+    int* ncaps = npcs + m_length;
+    int* mark = ncaps + m_length * ncap;
+    int* stack = mark + m_length;
+    int* work = stack + 9 * m_length;
+    int* best = work + ncap;
+    for (int i = 0; i < m_length; i++)
+	mark[i] = -1;
+    int ccount = 0;
+    bool matched = false;
+    for (int pos = 0; ; pos++) {
+	unsigned char c = str[pos];
+	if (!matched && (!pos || !m_anchored)) {
+	    // start a new lowest priority thread at this position
+	    for (int i = 0; i < ncap; i++)
+		work[i] = -1;
+	    addThread(cpcs,ccaps,ccount,0,work,ncap,stack,mark,pos,!c);
+	}
+	if (!ccount && (matched || m_anchored))
+	    break;
+	if (c && (m_flags & REG_ICASE))
+	    c = ::tolower(c);
+	int ncount = 0;
+	for (int t = 0; t < ccount; t++) {
+	    int pc = cpcs[t];
+	    int* tcaps = ccaps + t * ncap;
+	    const RexInst& i = m_code[pc];
+	    bool step = false;
+	    switch (i.op) {
+		case RexMatch:
+		    if (!ncap) {
+			matched = true;
+			break;
+		    }
+		    // keep the leftmost start, then the longest match
+		    if (!matched || tcaps[0] < best[0] || (tcaps[0] == best[0] && tcaps[1] > best[1]))
+			::memcpy(best,tcaps,ncap * sizeof(int));
+		    matched = true;
+		    break;
+		case RexChar:
+		    step = c && (c == i.c);
+		    break;
+		case RexAny:
+		    step = (c != 0);
+		    break;
+		case RexClass:
+		    step = c && inClass(i.x,c);
+		    break;
+	    }
+	    if (matched && !ncap)
+		break;
+	    if (step)
+		addThread(npcs,ncaps,ncount,pc + 1,tcaps,ncap,stack,mark,pos + 1,!str[pos + 1]);
+	}
+	if ((matched && !ncap) || !c)
+	    break;
+	int* tmp = cpcs;
+	cpcs = npcs;
+	npcs = tmp;
+	tmp = ccaps;
+	ccaps = ncaps;
+	ncaps = tmp;
+	ccount = ncount;
+    }
+    if (matched) {
+	for (int i = 0; i < nmatch && rmatch; i++) {
+	    if (2 * i + 1 < ncap && best[2 * i] >= 0 && best[2 * i + 1] >= 0) {
+		rmatch[i].rm_so = best[2 * i];
+		rmatch[i].rm_eo = best[2 * i + 1];
+	    }
+	    else {
+		rmatch[i].rm_so = -1;
+		rmatch[i].rm_eo = -1;
+	    }
+	}
+    }
+    if (mem != buf)
+	delete[] mem;
+    return matched;
+}
+
+// get a compiled program from the cache, compile and cache it if missing
+static RexProgram* rexProgram(const String& pattern, int flags)
+{
+    unsigned int idx = (pattern.hash() + flags) % REX_CACHE;
+    Lock lck(s_rexMutex);
+    RexProgram* p = s_rexCache[idx];
+    if (p && p->flags() == flags && p->pattern() == pattern && p->ref())
+	return p;
+    lck.drop();
+    p = new RexProgram(pattern,flags);
+    p->ref();
+    lck.acquire(s_rexMutex);
+    RexProgram* old = s_rexCache[idx];
+    s_rexCache[idx] = p;
+    lck.drop();
+    TelEngine::destruct(old);
+    return p;
+}
+
+
 Regexp::Regexp()
     : m_regexp(0), m_compile(true), m_flags(0)
 {
@@ -2484,7 +3290,10 @@ bool Regexp::matches(const char* value, StringMatchPrivate* matchlist) const
 	return false;
     int mm = matchlist ? MAX_MATCH : 0;
     regmatch_t *mt = matchlist ? (matchlist->rmatch)+1 : 0;
-    return !::regexec((regex_t *)m_regexp,value,mm,mt,0);
+    const RegexpData* data = static_cast<const RegexpData*>(m_regexp);
+    if (data->linear)
+	return data->linear->exec(value,mm,mt);
+    return !::regexec(&data->posix,value,mm,mt,0);
 }
 
 bool Regexp::matches(const char* value) const
@@ -2503,18 +3312,24 @@ bool Regexp::doCompile() const
     XDebug(DebugInfo,"Regexp::compile()");
     m_compile = false;
     if (c_str() && !m_regexp) {
-	regex_t *data = (regex_t *) ::malloc(sizeof(regex_t));
-	if (!data) {
-	    Debug("Regexp",DebugFail,"malloc(%d) returned NULL!",(int)sizeof(regex_t));
-	    return false;
+	RegexpData* data = new RegexpData;
+	data->linear = 0;
+#ifndef NO_LINEAR_REGEXP
+	RexProgram* prog = rexProgram(*this,m_flags);
+	if (prog->valid()) {
+	    data->linear = prog;
+	    m_regexp = data;
+	    return true;
 	}
-	if (::regcomp(data,c_str(),m_flags)) {
+	TelEngine::destruct(prog);
+#endif
+	if (::regcomp(&data->posix,c_str(),m_flags)) {
 	    Debug(DebugWarn,"Regexp::compile() \"%s\" failed",c_str());
-	    ::regfree(data);
-	    ::free(data);
+	    ::regfree(&data->posix);
+	    delete data;
 	}
 	else
-	    m_regexp = (void *)data;
+	    m_regexp = data;
     }
     return (m_regexp != 0);
 }
@@ -2523,10 +3338,13 @@ void Regexp::cleanup()
 {
     XDebug(DebugInfo,"Regexp::cleanup()");
     if (m_regexp) {
-	regex_t *data = (regex_t *)m_regexp;
+	RegexpData* data = static_cast<RegexpData*>(m_regexp);
 	m_regexp = 0;
-	::regfree(data);
-	::free(data);
+	if (data->linear)
+	    TelEngine::destruct(data->linear);
+	else
+	    ::regfree(&data->posix);
+	delete data;
     }
     m_compile = true;
 }
@@ -2690,17 +3508,62 @@ String& String::decodeFlags(uint64_t flags, const TokenDict64* tokens, bool unkn
     return *this;
 }
 
-String& String::changeStringData(char* data, unsigned int len)
+// Get a buffer to build a new value of given length.
+// Short values are built in the inline storage or, if it holds the current
+//  value, in a temporary buffer of YSTRING_INLINE size provided by caller
+char* String::allocData(unsigned int len, char* tmp)
 {
-    char* tmp = m_string;
-    if (data)
+    if (len < YSTRING_INLINE)
+	return (m_string == m_inline) ? tmp : m_inline;
+    char* data = (char*)::malloc(len + 1);
+    if (!data)
+	Debug("String",DebugFail,"malloc(%u) returned NULL!",len + 1);
+    return data;
+}
+
+// Set a new value, release the old one if allocated
+String& String::changeStringData(char* data, unsigned int len, const char* tmp)
+{
+    char* old = m_string;
+    if (data) {
+	if (data == tmp) {
+	    ::memcpy(m_inline,data,len);
+	    data = m_inline;
+	}
 	data[len] = 0;
+    }
     m_string = data;
     m_length = len;
-    if (tmp)
-	::free(tmp);
+    if (old && old != data && old != m_inline)
+	::free(old);
     changed();
     return *this;
 }
 
+// Take over the value of another String, leave it empty
+void String::takeData(String& value)
+{
+    if (!value.m_string) {
+	clear();
+	return;
+    }
+    unsigned int hash = value.m_hash;
+    if (value.m_string == value.m_inline) {
+	char tmp[YSTRING_INLINE];
+	char* data = allocData(value.m_length,tmp);
+	::memcpy(data,value.m_string,value.m_length);
+	changeStringData(data,value.m_length,tmp);
+	value.clear();
+    }
+    else {
+	char* data = value.m_string;
+	unsigned int len = value.m_length;
+	// detach the buffer so clearing the other String will not release it
+	value.m_string = 0;
+	value.changed();
+	changeStringData(data,len);
+    }
+    m_hash = hash;
+}
+
 /* vi: set ts=8 sw=4 sts=4 noet: */
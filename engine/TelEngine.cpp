@@ -77,6 +77,7 @@ static int _localtime_s(struct tm* _tm, const time_t* time)
 
 #else // !_WINDOWS
 #include <sys/resource.h>
+#include <pthread.h>
 #endif
 
 namespace { // anonymous
@@ -120,6 +121,18 @@ namespace TelEngine {
 #define REFOBJECT_MUTEX_COUNT 47
 #endif
 
+// Memory pool size classes granularity and largest pooled block
+#define POOL_GRAIN 16
+#define POOL_MAX 512
+#define POOL_CLASSES (POOL_MAX / POOL_GRAIN)
+// Blocks cached by each thread and kept in the shared depot per size class
+#define POOL_THREAD 64
+#define POOL_SHARED 4096
+
+#if defined(__GNUC__) && !defined(_WINDOWS)
+#define POOL_CACHE
+#endif
+
 // Number of seconds from 1900 to 1970
 #define SECONDS_1900_TO_1970 2208988800u // 0x83AA7E80
 // UNIX time of NTP time 07 Feb. 2036 6h 28m 16s
@@ -1261,6 +1274,189 @@ void Random::srandom(unsigned int seed)
 }
 
 
+// A chain of released memory blocks of the same size class
+struct PoolChain
+{
+    void* head;
+    unsigned int count;
+};
+
+static inline void*& poolNext(void* block)
+{
+    return static_cast<void**>(block)[0];
+}
+
+static inline void poolPush(PoolChain& chain, void* block)
+{
+    poolNext(block) = chain.head;
+    chain.head = block;
+    chain.count++;
+}
+
+static inline void* poolPop(PoolChain& chain)
+{
+    void* block = chain.head;
+    if (block) {
+	chain.head = poolNext(block);
+	chain.count--;
+    }
+    return block;
+}
+
+static bool s_poolEnabled = true;
+
+#ifdef POOL_CACHE
+// Blocks are moved between threads in batches of this size
+#define POOL_BATCH (POOL_THREAD / 2)
+
+// Shared depot of a size class, a stack of batches linked by their first block
+struct PoolDepot
+{
+    void* batches;
+    unsigned int count;
+};
+
+static inline void*& poolNextBatch(void* block)
+{
+    return static_cast<void**>(block)[1];
+}
+
+// Raw mutex as the pool can be used before any Mutex is constructed
+static pthread_mutex_t s_poolMutex = PTHREAD_MUTEX_INITIALIZER;
+static PoolDepot s_poolShared[POOL_CLASSES];
+static pthread_key_t s_poolKey;
+static pthread_once_t s_poolOnce = PTHREAD_ONCE_INIT;
+// Per thread cache, set to an invalid address after the thread released it
+static __thread PoolChain* s_poolCache = 0;
+#define POOL_DEAD ((PoolChain*)1)
+
+// Move a batch of blocks from a thread cache to the shared depot
+static void poolFlush(PoolChain& chain, unsigned int idx)
+{
+    void* batch = chain.head;
+    void* last = batch;
+    for (unsigned int n = POOL_BATCH - 1; n; n--)
+	last = poolNext(last);
+    chain.head = poolNext(last);
+    chain.count -= POOL_BATCH;
+    poolNext(last) = 0;
+    PoolDepot& depot = s_poolShared[idx];
+    ::pthread_mutex_lock(&s_poolMutex);
+    bool keep = depot.count < POOL_SHARED / POOL_BATCH;
+    if (keep) {
+	poolNextBatch(batch) = depot.batches;
+	depot.batches = batch;
+	depot.count++;
+    }
+    ::pthread_mutex_unlock(&s_poolMutex);
+    while (!keep && batch) {
+	void* next = poolNext(batch);
+	::free(batch);
+	batch = next;
+    }
+}
+
+// Move a batch of blocks from the shared depot to an empty thread cache
+static void poolRefill(PoolChain& chain, unsigned int idx)
+{
+    PoolDepot& depot = s_poolShared[idx];
+    ::pthread_mutex_lock(&s_poolMutex);
+    void* batch = depot.batches;
+    if (batch) {
+	depot.batches = poolNextBatch(batch);
+	depot.count--;
+    }
+    ::pthread_mutex_unlock(&s_poolMutex);
+    if (batch) {
+	chain.head = batch;
+	chain.count = POOL_BATCH;
+    }
+}
+
+// Called when a thread terminates to give back its cached blocks
+static void poolThreadExit(void* arg)
+{
+    PoolChain* cache = static_cast<PoolChain*>(arg);
+    s_poolCache = POOL_DEAD;
+    for (unsigned int i = 0; i < POOL_CLASSES; i++) {
+	while (cache[i].count >= POOL_BATCH)
+	    poolFlush(cache[i],i);
+	while (cache[i].head)
+	    ::free(poolPop(cache[i]));
+    }
+    ::free(cache);
+}
+
+static void poolInitKey()
+{
+    ::pthread_key_create(&s_poolKey,poolThreadExit);
+}
+
+static PoolChain* poolCache()
+{
+    PoolChain* cache = s_poolCache;
+    if (cache)
+	return (cache == POOL_DEAD) ? 0 : cache;
+    ::pthread_once(&s_poolOnce,poolInitKey);
+    cache = static_cast<PoolChain*>(::calloc(POOL_CLASSES,sizeof(PoolChain)));
+    if (!cache)
+	return 0;
+    ::pthread_setspecific(s_poolKey,cache);
+    s_poolCache = cache;
+    return cache;
+}
+#endif
+
+void* MemoryPool::alloc(size_t size)
+{
+#ifdef POOL_CACHE
+    if (size && size <= POOL_MAX) {
+	unsigned int idx = (size - 1) / POOL_GRAIN;
+	PoolChain* cache = s_poolEnabled ? poolCache() : 0;
+	if (cache) {
+	    if (!cache[idx].head)
+		poolRefill(cache[idx],idx);
+	    void* block = poolPop(cache[idx]);
+	    if (block)
+		return block;
+	}
+	// always allocate the full size class so the block can be recycled
+	return ::malloc((idx + 1) * POOL_GRAIN);
+    }
+#endif
+    return ::malloc(size ? size : 1);
+}
+
+void MemoryPool::release(void* ptr, size_t size)
+{
+    if (!ptr)
+	return;
+#ifdef POOL_CACHE
+    if (size && size <= POOL_MAX && s_poolEnabled) {
+	PoolChain* cache = poolCache();
+	if (cache) {
+	    unsigned int idx = (size - 1) / POOL_GRAIN;
+	    if (cache[idx].count >= POOL_THREAD)
+		poolFlush(cache[idx],idx);
+	    poolPush(cache[idx],ptr);
+	    return;
+	}
+    }
+#endif
+    ::free(ptr);
+}
+
+void MemoryPool::enable(bool enable)
+{
+    s_poolEnabled = enable;
+}
+
+bool MemoryPool::enabled()
+{
+    return s_poolEnabled;
+}
+
+
 bool GenObject::s_counting = false;
 static ObjCounterList s_counters;
 static Mutex s_countersMutex(false,"Counters");
@@ -2206,7 +2206,8 @@ bool XmlElement::setXmlns(const String& name, bool addAttr, const String& value)
 void XmlElement::replaceParams(const NamedList& params)
 {
     m_children.replaceParams(params);
-    for (ObjList* o = m_element.paramList()->skipNull(); o; o = o->skipNext())
+    // values are replaced in place, the names and the lookup index stay valid
+    for (ObjList* o = static_cast<const NamedList&>(m_element).paramList()->skipNull(); o; o = o->skipNext())
 	params.replaceParams(*static_cast<String*>(o->get()));
 }
 
@@ -19,19 +19,24 @@
  */
 
 #include <yatertp.h>
+#include <string.h>
+#include <stdlib.h>
 
-using namespace TelEngine;
+// Number of packets the dejitter ring can hold
+#define RING_SIZE 128
 
-namespace { // anonymous
+namespace TelEngine {
 
-class RTPDelayedData : public DataBlock
+// A slot of the dejitter ring, the payload storage is kept and reused
+class RTPDelayedData
 {
 public:
-    inline RTPDelayedData(u_int64_t when, bool mark, int payload,
-	unsigned int tstamp, const void* data, int len)
-	: DataBlock(const_cast<void*>(data),len), m_scheduled(when),
-	  m_marker(mark), m_payload(payload), m_timestamp(tstamp)
+    inline RTPDelayedData()
+	: m_scheduled(0), m_marker(false), m_payload(0), m_timestamp(0),
+	  m_data(0), m_length(0), m_alloc(0)
 	{ }
+    inline ~RTPDelayedData()
+	{ ::free(m_data); }
     inline u_int64_t scheduled() const
 	{ return m_scheduled; }
     inline bool marker() const
@@ -40,21 +45,84 @@ public:
 	{ return m_payload; }
     inline unsigned int timestamp() const
 	{ return m_timestamp; }
+    inline const void* data() const
+	{ return m_data; }
+    inline unsigned int length() const
+	{ return m_length; }
+    bool assign(u_int64_t when, bool mark, int payload,
+	unsigned int tstamp, const void* data, int len);
+    void exchange(RTPDelayedData& other);
 private:
     u_int64_t m_scheduled;
     bool m_marker;
     int m_payload;
     unsigned int m_timestamp;
+    unsigned char* m_data;
+    unsigned int m_length;
+    unsigned int m_alloc;
 };
 
-}; // anonymous namespace
+}; // namespace TelEngine
+
+using namespace TelEngine;
+
+bool RTPDelayedData::assign(u_int64_t when, bool mark, int payload,
+    unsigned int tstamp, const void* data, int len)
+{
+    if (len < 0)
+	len = 0;
+    if ((unsigned int)len > m_alloc) {
+	// grow only, storage is recycled for the following packets
+	void* tmp = ::realloc(m_data,len);
+	if (!tmp)
+	    return false;
+	m_data = (unsigned char*)tmp;
+	m_alloc = len;
+    }
+    if (len)
+	::memcpy(m_data,data,len);
+    m_length = len;
+    m_scheduled = when;
+    m_marker = mark;
+    m_payload = payload;
+    m_timestamp = tstamp;
+    return true;
+}
+
+void RTPDelayedData::exchange(RTPDelayedData& other)
+{
+    u_int64_t scheduled = m_scheduled;
+    m_scheduled = other.m_scheduled;
+    other.m_scheduled = scheduled;
+    bool marker = m_marker;
+    m_marker = other.m_marker;
+    other.m_marker = marker;
+    int payload = m_payload;
+    m_payload = other.m_payload;
+    other.m_payload = payload;
+    unsigned int tmp = m_timestamp;
+    m_timestamp = other.m_timestamp;
+    other.m_timestamp = tmp;
+    tmp = m_length;
+    m_length = other.m_length;
+    other.m_length = tmp;
+    tmp = m_alloc;
+    m_alloc = other.m_alloc;
+    other.m_alloc = tmp;
+    unsigned char* data = m_data;
+    m_data = other.m_data;
+    other.m_data = data;
+}
 
 
 RTPDejitter::RTPDejitter(RTPReceiver* receiver, unsigned int mindelay, unsigned int maxdelay,
     DebugEnabler* dbg, const char* traceId)
     : RTPProcessor(dbg,traceId),
       m_receiver(receiver), m_minDelay(mindelay), m_maxDelay(maxdelay),
-      m_headStamp(0), m_tailStamp(0), m_headTime(0), m_sampRate(125000), m_fastRate(10)
+      m_headStamp(0), m_tailStamp(0), m_headTime(0), m_sampRate(125000), m_fastRate(10),
+      m_ring(new RTPDelayedData[RING_SIZE]), m_first(0), m_count(0),
+      m_arrival(0), m_arrivalStamp(0), m_jitter(0),
+      m_late(0), m_duplicate(0), m_reorder(0)
 {
     if (m_maxDelay > 1000000)
 	m_maxDelay = 1000000;
@@ -64,35 +132,74 @@ RTPDejitter::RTPDejitter(RTPReceiver* receiver, unsigned int mindelay, unsigned
 	m_minDelay = 5000;
     if (m_minDelay > m_maxDelay - 30000)
 	m_minDelay = m_maxDelay - 30000;
+    m_delay = m_minDelay;
 }
 
 RTPDejitter::~RTPDejitter()
 {
-    DDebug(dbg(),DebugInfo,"Dejitter destroyed with %u packets [%p]",m_packets.count(),this);
+    DDebug(dbg(),DebugInfo,"Dejitter destroyed with %u packets, jitter %u us, late %u, duplicate %u, reordered %u [%p]",
+	m_count,jitter(),m_late,m_duplicate,m_reorder,this);
+    delete[] m_ring;
+}
+
+inline RTPDelayedData& RTPDejitter::slot(unsigned int index)
+{
+    return m_ring[(m_first + index) % RING_SIZE];
 }
 
 void RTPDejitter::clear()
 {
-    m_packets.clear();
+    m_first = m_count = 0;
     m_headStamp = m_tailStamp = 0;
+    m_arrival = 0;
+    m_jitter = 0;
+    m_delay = m_minDelay;
+}
+
+// Update the RFC 3550 interarrival jitter and the buffer delay that follows it
+void RTPDejitter::updateJitter(unsigned int timestamp, u_int64_t now)
+{
+    if (m_arrival) {
+	int64_t d = (int64_t)(now - m_arrival) -
+	    (int64_t)((int)(timestamp - m_arrivalStamp)) * (int64_t)m_sampRate / 1000;
+	if (d < 0)
+	    d = -d;
+	if (d > m_maxDelay)
+	    d = m_maxDelay;
+	// jitter is kept scaled by 16 as in RFC 3550 A.8
+	m_jitter += d - ((m_jitter + 8) >> 4);
+	// hold about 4 times the jitter, within configured bounds
+	unsigned int delay = (unsigned int)(m_jitter >> 2);
+	if (delay < m_minDelay)
+	    delay = m_minDelay;
+	else if (delay > m_maxDelay - 30000)
+	    delay = m_maxDelay - 30000;
+	m_delay = delay;
+    }
+    m_arrival = now;
+    m_arrivalStamp = timestamp;
 }
 
 bool RTPDejitter::rtpRecv(bool marker, int payload, unsigned int timestamp, const void* data, int len)
 {
+    u_int64_t now = Time::now();
+    updateJitter(timestamp,now);
     u_int64_t when = 0;
     bool insert = false;
 
     if (m_headStamp) {
 	// at least one packet got out of the queue
 	int dTs = timestamp - m_headStamp;
-	if (dTs == 0)
+	if (dTs == 0) {
+	    m_duplicate++;
 	    return true;
+	}
 	else if (dTs < 0) {
 	    DDebug(dbg(),DebugNote,"Dejitter dropping TS %u, last delivered was %u [%p]",
 		timestamp,m_headStamp,this);
+	    m_late++;
 	    return false;
 	}
-	u_int64_t now = Time::now();
 	int64_t rate = 1000 * (now - m_headTime) / dTs;
 	if (rate > 0) {
 	    if (m_sampRate) {
@@ -113,12 +220,14 @@ bool RTPDejitter::rtpRecv(bool marker, int payload, unsigned int timestamp, cons
 	else
 	    rate = m_sampRate;
 	if (rate > 0)
-	    when = m_headTime + (dTs * rate / 1000) + m_minDelay;
+	    when = m_headTime + (dTs * rate / 1000) + m_delay;
 	else
-	    when = now + m_minDelay;
+	    when = now + m_delay;
 	if (m_tailStamp) {
-	    if (timestamp == m_tailStamp)
+	    if (timestamp == m_tailStamp) {
+		m_duplicate++;
 		return true;
+	    }
 	    if (((int)(timestamp - m_tailStamp)) < 0)
 		insert = true;
 	    else if (when > now + m_maxDelay) {
@@ -131,59 +240,84 @@ bool RTPDejitter::rtpRecv(bool marker, int payload, unsigned int timestamp, cons
 	if (m_tailStamp && ((int)(timestamp - m_tailStamp)) < 0) {
 	    // until we get some statistics don't attempt to reorder packets
 	    DDebug(dbg(),DebugNote,"Dejitter got TS %u while last queued was %u [%p]",timestamp,m_tailStamp,this);
+	    m_late++;
 	    return false;
 	}
 	// we got no packets out yet so use a fixed interval
-	when = Time::now() + m_minDelay;
+	when = now + m_delay;
     }
 
+    if (m_count >= RING_SIZE) {
+	DDebug(dbg(),DebugNote,"Dejitter buffer full, dropping TS %u [%p]",timestamp,this);
+	return false;
+    }
+    unsigned int pos = m_count;
     if (insert) {
-	for (ObjList* l = m_packets.skipNull(); l; l = l->skipNext()) {
-	    RTPDelayedData* pkt = static_cast<RTPDelayedData*>(l->get());
-	    if (pkt->timestamp() == timestamp)
-		return true;
-	    if (pkt->timestamp() > timestamp && pkt->scheduled() > when) {
-		l->insert(new RTPDelayedData(when,marker,payload,timestamp,data,len));
+	// walk back from the tail, reordering is usually just a few packets deep
+	for (; pos; pos--) {
+	    const RTPDelayedData& pkt = slot(pos - 1);
+	    if (pkt.timestamp() == timestamp) {
+		m_duplicate++;
 		return true;
 	    }
+	    if (((int)(pkt.timestamp() - timestamp)) < 0)
+		break;
 	}
+	// never schedule after the packet that must follow
+	if ((pos < m_count) && (when > slot(pos).scheduled()))
+	    when = slot(pos).scheduled();
+	m_reorder++;
+    }
+    // shift the tail by exchanging slots so payload storage stays recycled
+    for (unsigned int i = m_count; i > pos; i--)
+	slot(i).exchange(slot(i - 1));
+    if (!slot(pos).assign(when,marker,payload,timestamp,data,len)) {
+	for (unsigned int i = pos; i < m_count; i++)
+	    slot(i).exchange(slot(i + 1));
+	return false;
     }
-    m_tailStamp = timestamp;
-    m_packets.append(new RTPDelayedData(when,marker,payload,timestamp,data,len));
+    if (!insert)
+	m_tailStamp = timestamp;
+    m_count++;
     return true;
 }
 
 void RTPDejitter::timerTick(const Time& when)
 {
-    RTPDelayedData* packet = static_cast<RTPDelayedData*>(m_packets.get());
-    if (!packet) {
+    if (!m_count) {
 	m_tailStamp = 0;
 	if (m_headStamp && (m_headTime + m_maxDelay < when))
 	    m_headStamp = 0;
 	return;
     }
+    RTPDelayedData* packet = &slot(0);
     if (packet->scheduled() > when)
 	return;
-    m_packets.remove(packet,false);
+    // take the packet out of the ring, its storage stays valid until next insert
+    m_first = (m_first + 1) % RING_SIZE;
+    m_count--;
     // remember the last delivered
     m_headStamp = packet->timestamp();
     m_headTime = packet->scheduled();
     if (m_receiver)
 	m_receiver->rtpRecv(packet->marker(),packet->payload(),
 	    packet->timestamp(),packet->data(),packet->length());
-    TelEngine::destruct(packet);
     unsigned int count = 0;
-    while ((packet = static_cast<RTPDelayedData*>(m_packets.get()))) {
+    while (m_count) {
+	packet = &slot(0);
 	long int delayed = (long int)(when - packet->scheduled());
-	if (delayed <= 0 || delayed <= (long)m_minDelay)
+	if (delayed <= 0 || delayed <= (long)m_delay)
 	    break;
 	// we are too delayed - probably rtpRecv() took too long to complete...
-	m_packets.remove(packet,true);
+	m_first = (m_first + 1) % RING_SIZE;
+	m_count--;
 	count++;
     }
-    if (count)
+    if (count) {
+	m_late += count;
 	TraceDebug(m_traceId,dbg(),(count > 1) ? DebugMild : DebugNote,
 	    "Dropped %u delayed packet%s from buffer [%p]",count,((count > 1) ? "s" : ""),this);
+    }
 }
 
 /* vi: set ts=8 sw=4 sts=4 noet: */
@@ -481,6 +481,13 @@ void RTPReceiver::stats(NamedList& stat) const
     stat.setParam("synclost",String(m_syncLost));
     stat.setParam("wrongssrc",String(m_wrongSSRC));
     stat.setParam("seqslost",String(m_seqLost));
+    if (m_dejitter) {
+	stat.setParam("jitter",String(m_dejitter->jitter()));
+	stat.setParam("jitterdelay",String(m_dejitter->delay()));
+	stat.setParam("latepkts",String(m_dejitter->latePackets()));
+	stat.setParam("duppkts",String(m_dejitter->duplicatePackets()));
+	stat.setParam("reorderpkts",String(m_dejitter->reorderedPackets()));
+    }
 }
 
 
@@ -21,11 +21,48 @@
 #include <yatertp.h>
 #include <string.h>
 
+#if defined(__linux__)
+#include <unistd.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#define RTP_EPOLL
+#endif
+
 #define BUF_SIZE 1500
+// Maximum number of socket events handled in one wait
+#define MAX_EVENTS 64
+// Maximum number of packets read or written in one socket operation
+#define MAX_BATCH 16
+
+namespace TelEngine {
+
+// Socket I/O buffers of a RTP group, used only while holding the group lock
+class RTPBatch
+{
+public:
+    inline RTPBatch()
+	: m_txCount(0)
+	{
+	    for (int i = 0; i < MAX_BATCH; i++)
+		m_txData[i] = m_txBuf + i * BUF_SIZE;
+	}
+    char m_rxBuf[MAX_BATCH * BUF_SIZE];
+    int m_rxLen[MAX_BATCH];
+    SocketAddr m_rxAddr[MAX_BATCH];
+    char m_txBuf[MAX_BATCH * BUF_SIZE];
+    const void* m_txData[MAX_BATCH];
+    int m_txLen[MAX_BATCH];
+    RTPTransport* m_txTrans[MAX_BATCH];
+    bool m_txRtcp[MAX_BATCH];
+    int m_txCount;
+};
+
+}; // namespace TelEngine
 
 using namespace TelEngine;
 
 static unsigned long s_sleep = 5;
+static bool s_events = false;
 
 // Set IPv6 sin6_scope_id for remote addresses from local address
 // recvFrom() will set the sin6_scope_id of the remote socket address
@@ -45,7 +82,8 @@ static inline void setScopeId(const SocketAddr& local, SocketAddr& sa1,
 
 RTPGroup::RTPGroup(int msec, Priority prio, const String& affinity)
     : Mutex(true,"RTPGroup"),
-      Thread("RTP Group",prio), m_listChanged(false)
+      Thread("RTP Group",prio), m_listChanged(false), m_poller(-1),
+      m_batch(new RTPBatch)
 {
     DDebug(DebugInfo,"RTPGroup::RTPGroup() [%p]",this);
     if (msec < 1)
@@ -53,6 +91,14 @@ RTPGroup::RTPGroup(int msec, Priority prio, const String& affinity)
     if (msec > 50)
 	msec = 50;
     m_sleep = msec;
+#ifdef RTP_EPOLL
+    if (s_events) {
+	m_poller = ::epoll_create(MAX_EVENTS);
+	if (m_poller < 0)
+	    Debug(DebugWarn,"Failed to create event poller, error=%s(%d), using polling [%p]",
+		::strerror(errno),errno,this);
+    }
+#endif
     if (affinity) {
 	int err = setAffinity(affinity);
 	if (err)
@@ -64,6 +110,11 @@ RTPGroup::RTPGroup(int msec, Priority prio, const String& affinity)
 RTPGroup::~RTPGroup()
 {
     DDebug(DebugInfo,"RTPGroup::~RTPGroup() [%p]",this);
+#ifdef RTP_EPOLL
+    if (m_poller >= 0)
+	::close(m_poller);
+#endif
+    delete m_batch;
 }
 
 void RTPGroup::cleanup()
@@ -88,6 +139,10 @@ void RTPGroup::cleanup()
 void RTPGroup::run()
 {
     DDebug(DebugInfo,"RTPGroup::run() [%p]",this);
+    if (eventDriven()) {
+	runEvents();
+	return;
+    }
     bool ok = true;
     while (ok) {
 	unsigned long msec = m_sleep;
@@ -109,18 +164,73 @@ void RTPGroup::run()
 		    break;
 	    }
 	}
+	flushSend();
 	unlock();
 	Thread::msleep(msec,true);
     }
     DDebug(DebugInfo,"RTPGroup::run() ran out of processors [%p]",this);
 }
 
+// Event driven loop: wait for sockets to become readable until next tick
+void RTPGroup::runEvents()
+{
+#ifdef RTP_EPOLL
+    struct epoll_event events[MAX_EVENTS];
+    u_int64_t tick = Time::now();
+    bool ok = true;
+    lock();
+    while (ok) {
+	m_listChanged = false;
+	unlock();
+	unsigned long msec = m_sleep;
+	if (msec < s_sleep)
+	    msec = s_sleep;
+	Thread::check();
+	u_int64_t now = Time::now();
+	int wait = (tick > now) ? (int)((tick - now + 999) / 1000) : 0;
+	int n = ::epoll_wait(m_poller,events,MAX_EVENTS,wait);
+	lock();
+	// if a processor left while we were waiting its events may be stale,
+	//  sockets are level triggered so skip them and pick up data later
+	for (int i = 0; (i < n) && !m_listChanged; i++) {
+	    u_int64_t data = events[i].data.u64;
+	    RTPTransport* trans = reinterpret_cast<RTPTransport*>((unsigned long)(data & ~(u_int64_t)1));
+	    if (data & 1)
+		trans->rtcpReceive();
+	    else
+		trans->rtpReceive();
+	}
+	flushSend();
+	Time t;
+	if (t.usec() < tick)
+	    continue;
+	tick = t.usec() + 1000 * msec;
+	ObjList* l = &m_processors;
+	m_listChanged = false;
+	for (ok = false;l;l = l->next()) {
+	    RTPProcessor* p = static_cast<RTPProcessor*>(l->get());
+	    if (p) {
+		ok = true;
+		p->timerTick(t);
+		if (m_listChanged)
+		    break;
+	    }
+	}
+	flushSend();
+    }
+    unlock();
+    DDebug(DebugInfo,"RTPGroup::runEvents() ran out of processors [%p]",this);
+#endif
+}
+
 void RTPGroup::join(RTPProcessor* proc)
 {
     DDebug(DebugAll,"RTPGroup::join(%p) [%p]",proc,this);
     lock();
     m_listChanged = true;
     m_processors.append(proc)->setDelete(false);
+    if (eventDriven())
+	proc->watchSockets(this,true);
     startup();
     unlock();
 }
@@ -130,10 +240,65 @@ void RTPGroup::part(RTPProcessor* proc)
     DDebug(DebugAll,"RTPGroup::part(%p) [%p]",proc,this);
     lock();
     m_listChanged = true;
+    if (eventDriven())
+	proc->watchSockets(this,false);
+    // packets queued by the leaving processor must not outlive it
+    flushSend();
     m_processors.remove(proc,false);
     unlock();
 }
 
+void RTPGroup::watchSocket(Socket& sock, RTPTransport* trans, bool rtcp, bool watch)
+{
+#ifdef RTP_EPOLL
+    if ((m_poller < 0) || !sock.valid())
+	return;
+    struct epoll_event ev;
+    ::memset(&ev,0,sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = (u_int64_t)(unsigned long)trans;
+    if (rtcp)
+	ev.data.u64 |= 1;
+    if (::epoll_ctl(m_poller,(watch ? EPOLL_CTL_ADD : EPOLL_CTL_DEL),sock.handle(),&ev)
+	&& (errno != (watch ? EEXIST : ENOENT)))
+	Debug(DebugMild,"Failed to %s %s socket %d, error=%s(%d) [%p]",
+	    (watch ? "watch" : "unwatch"),(rtcp ? "RTCP" : "RTP"),sock.handle(),
+	    ::strerror(errno),errno,this);
+#endif
+}
+
+// Queue a packet to be sent at the end of the current group pass
+bool RTPGroup::queueSend(RTPTransport* trans, bool rtcp, const void* data, int len)
+{
+    if ((len <= 0) || (len > BUF_SIZE))
+	return false;
+    if (m_batch->m_txCount >= MAX_BATCH)
+	flushSend();
+    int i = m_batch->m_txCount++;
+    ::memcpy(m_batch->m_txBuf + i * BUF_SIZE,data,len);
+    m_batch->m_txLen[i] = len;
+    m_batch->m_txTrans[i] = trans;
+    m_batch->m_txRtcp[i] = rtcp;
+    return true;
+}
+
+// Send queued packets, consecutive ones for the same socket in one operation
+void RTPGroup::flushSend()
+{
+    RTPBatch& b = *m_batch;
+    int i = 0;
+    while (i < b.m_txCount) {
+	RTPTransport* trans = b.m_txTrans[i];
+	bool rtcp = b.m_txRtcp[i];
+	int n = 1;
+	while ((i + n < b.m_txCount) && (b.m_txTrans[i + n] == trans) && (b.m_txRtcp[i + n] == rtcp))
+	    n++;
+	trans->sendBatch(b.m_txData + i,b.m_txLen + i,n,rtcp);
+	i += n;
+    }
+    b.m_txCount = 0;
+}
+
 void RTPGroup::setMinSleep(int msec)
 {
     if (msec < 1)
@@ -143,6 +308,11 @@ void RTPGroup::setMinSleep(int msec)
     s_sleep = msec;
 }
 
+void RTPGroup::setEventDriven(bool events)
+{
+    s_events = events;
+}
+
 
 RTPProcessor::RTPProcessor(DebugEnabler* dbg, const char* traceId)
     : RTPDebug(dbg,traceId),
@@ -173,6 +343,10 @@ void RTPProcessor::rtpData(const void* data, int len)
 {
 }
 
+void RTPProcessor::watchSockets(RTPGroup* grp, bool watch)
+{
+}
+
 void RTPProcessor::rtcpData(const void* data, int len)
 {
 }
@@ -212,67 +386,114 @@ void RTPTransport::destruct()
 void RTPTransport::timerTick(const Time& when)
 {
     XDebug(dbg(),DebugAll,"RTPTransport::timerTick() group=%p [%p]",group(),this);
+    // in event driven groups sockets are read only when data is available
+    bool poll = !(group() && group()->eventDriven());
     if (m_rtpSock.valid()) {
-	char buf[BUF_SIZE];
-	int len;
-	while ((len = m_rtpSock.recvFrom(buf,sizeof(buf),m_rxAddrRTP)) > 0) {
-	    XDebug(dbg(),DebugAll,"RTP/UDPTL from '%s:%d' length %d [%p]",
-		m_rxAddrRTP.host().c_str(),m_rxAddrRTP.port(),len,this);
-	    switch (m_type) {
-		case RTP:
-		    if (len < 12)
-			continue;
-		    if (((unsigned char)buf[0] & 0xc0) != 0x80)
-			continue;
-		    break;
-		case UDPTL:
-		    if (len < 6)
-			continue;
-		    break;
-		default:
-		    break;
-	    }
-	    if (!m_remoteAddr.valid())
-		continue;
-	    // looks like it's RTP or UDPTL, at least by length and version
-	    bool preferred = false;
-	    if ((m_autoRemote || (preferred = (m_rxAddrRTP == m_remotePref))) && (m_rxAddrRTP != m_remoteAddr)) {
-		TraceDebug(m_traceId,dbg(),DebugInfo,"Auto changing RTP address from %s:%d to%s %s:%d",
-		    m_remoteAddr.host().c_str(),m_remoteAddr.port(),
-		    (preferred ? " preferred" : ""),
-		    m_rxAddrRTP.host().c_str(),m_rxAddrRTP.port());
-		// if we received from the preferred address don't auto change any more
-		if (preferred)
-		    m_remotePref.clear();
-		remoteAddr(m_rxAddrRTP);
-	    }
-	    m_autoRemote = false;
-	    if (m_rxAddrRTP == m_remoteAddr) {
-		if (m_processor)
-		    m_processor->rtpData(buf,len);
-		if (m_monitor)
-		    m_monitor->rtpData(buf,len);
-	    }
-	    else if (m_processor)
-		m_processor->incWrongSrc();
-	}
+	if (poll)
+	    rtpReceive();
 	m_rtpSock.timerTick(when);
     }
     if (m_rtcpSock.valid()) {
-	char buf[BUF_SIZE];
-	int len;
-	while (((len = m_rtcpSock.recvFrom(buf,sizeof(buf),m_rxAddrRTCP)) >= 8) && (m_rxAddrRTCP == m_remoteRTCP)) {
+	if (poll)
+	    rtcpReceive();
+	m_rtcpSock.timerTick(when);
+    }
+}
+
+void RTPTransport::rtpReceive()
+{
+    RTPGroup* grp = group();
+    if (!(grp && m_rtpSock.valid()))
+	return;
+    RTPBatch& b = *grp->m_batch;
+    int n;
+    while ((n = m_rtpSock.recvFromMulti(b.m_rxBuf,BUF_SIZE,b.m_rxLen,b.m_rxAddr,MAX_BATCH)) > 0) {
+	for (int i = 0; i < n; i++)
+	    rtpPacket(b.m_rxBuf + i * BUF_SIZE,b.m_rxLen[i],b.m_rxAddr[i]);
+	// a short batch means the socket was drained
+	if (n < MAX_BATCH)
+	    break;
+    }
+}
+
+void RTPTransport::rtpPacket(const char* data, int len, SocketAddr& from)
+{
+    if (len <= 0)
+	return;
+    XDebug(dbg(),DebugAll,"RTP/UDPTL from '%s:%d' length %d [%p]",
+	from.host().c_str(),from.port(),len,this);
+    switch (m_type) {
+	case RTP:
+	    if (len < 12)
+		return;
+	    if (((unsigned char)data[0] & 0xc0) != 0x80)
+		return;
+	    break;
+	case UDPTL:
+	    if (len < 6)
+		return;
+	    break;
+	default:
+	    break;
+    }
+    if (!m_remoteAddr.valid())
+	return;
+    // looks like it's RTP or UDPTL, at least by length and version
+    bool preferred = false;
+    if ((m_autoRemote || (preferred = (from == m_remotePref))) && (from != m_remoteAddr)) {
+	TraceDebug(m_traceId,dbg(),DebugInfo,"Auto changing RTP address from %s:%d to%s %s:%d",
+	    m_remoteAddr.host().c_str(),m_remoteAddr.port(),
+	    (preferred ? " preferred" : ""),
+	    from.host().c_str(),from.port());
+	// if we received from the preferred address don't auto change any more
+	if (preferred)
+	    m_remotePref.clear();
+	remoteAddr(from);
+    }
+    m_autoRemote = false;
+    if (from == m_remoteAddr) {
+	if (m_processor)
+	    m_processor->rtpData(data,len);
+	if (m_monitor)
+	    m_monitor->rtpData(data,len);
+    }
+    else if (m_processor)
+	m_processor->incWrongSrc();
+}
+
+void RTPTransport::rtcpReceive()
+{
+    RTPGroup* grp = group();
+    if (!(grp && m_rtcpSock.valid()))
+	return;
+    RTPBatch& b = *grp->m_batch;
+    int n;
+    while ((n = m_rtcpSock.recvFromMulti(b.m_rxBuf,BUF_SIZE,b.m_rxLen,b.m_rxAddr,MAX_BATCH)) > 0) {
+	for (int i = 0; i < n; i++) {
+	    int len = b.m_rxLen[i];
+	    if ((len < 8) || (b.m_rxAddr[i] != m_remoteRTCP))
+		continue;
+	    const char* data = b.m_rxBuf + i * BUF_SIZE;
 	    XDebug(dbg(),DebugAll,"RTCP from '%s:%d' length %d [%p]",
-		m_rxAddrRTCP.host().c_str(),m_rxAddrRTCP.port(),len,this);
+		b.m_rxAddr[i].host().c_str(),b.m_rxAddr[i].port(),len,this);
 	    if (m_processor)
-		m_processor->rtcpData(buf,len);
+		m_processor->rtcpData(data,len);
 	    if (m_monitor)
-		m_monitor->rtcpData(buf,len);
+		m_monitor->rtcpData(data,len);
 	}
-	m_rtcpSock.timerTick(when);
+	if (n < MAX_BATCH)
+	    break;
     }
 }
 
+void RTPTransport::watchSockets(RTPGroup* grp, bool watch)
+{
+    if (!grp)
+	return;
+    grp->watchSocket(m_rtpSock,this,false,watch);
+    grp->watchSocket(m_rtcpSock,this,true,watch);
+}
+
 // Send data to remote party
 // Put a debug message on failure
 // Return true if all bytes were sent
@@ -292,20 +513,59 @@ bool RTPTransport::sendData(Socket& sock, const SocketAddr& to, const void* data
 	return false;
     }
     int wr = sock.sendTo(data,len,to);
-    if (wr == Socket::socketError() && flag && !sock.canRetry()) {
-	flag = false;
-	// Retrieve the error before calling getSockName() to avoid reset
-	String s;
-	int e = sock.error();
-	Thread::errorString(s,e);
-	SocketAddr local;
-	sock.getSockName(local);
-	TraceDebug(m_traceId,dbg(),DebugNote,"%s send failed (local=%s remote=%s): %d %s",
-	    what,local.addr().c_str(),to.addr().c_str(),e,s.c_str());
-    }
+    if (wr == Socket::socketError())
+	sendFailed(sock,to,what,flag);
     return wr == len;
 }
 
+// Put a debug message once after a socket send error
+void RTPTransport::sendFailed(Socket& sock, const SocketAddr& to, const char* what, bool& flag)
+{
+    if (!flag || sock.canRetry())
+	return;
+    flag = false;
+    // Retrieve the error before calling getSockName() to avoid reset
+    String s;
+    int e = sock.error();
+    Thread::errorString(s,e);
+    SocketAddr local;
+    sock.getSockName(local);
+    TraceDebug(m_traceId,dbg(),DebugNote,"%s send failed (local=%s remote=%s): %d %s",
+	what,local.addr().c_str(),to.addr().c_str(),e,s.c_str());
+}
+
+// Queue data to be sent in a batch if called from our group's thread
+// Return true if the data was queued
+bool RTPTransport::queueData(const void* data, int len, bool rtcp)
+{
+    RTPGroup* grp = group();
+    if (!grp || (Thread::current() != grp))
+	return false;
+    if (rtcp ? !(m_rtcpSock.valid() && m_remoteRTCP.valid()) : !(m_rtpSock.valid() && m_remoteAddr.valid()))
+	return false;
+    return grp->queueSend(this,rtcp,data,len);
+}
+
+// Send a batch of queued packets, skip over any that fail
+void RTPTransport::sendBatch(const void* const* data, const int* lengths, int count, bool rtcp)
+{
+    Socket& sock = rtcp ? m_rtcpSock : m_rtpSock;
+    const SocketAddr& to = rtcp ? m_remoteRTCP : m_remoteAddr;
+    while ((count > 0) && sock.valid()) {
+	int n = sock.sendToMulti(data,lengths,count,to);
+	if (n <= 0) {
+	    if (rtcp)
+		sendFailed(sock,to,"RTCP",m_warnSendErrorRtcp);
+	    else
+		sendFailed(sock,to,"RTP",m_warnSendErrorRtp);
+	    n = 1;
+	}
+	data += n;
+	lengths += n;
+	count -= n;
+    }
+}
+
 void RTPTransport::rtpData(const void* data, int len)
 {
     if (!data)
@@ -322,14 +582,16 @@ void RTPTransport::rtpData(const void* data, int len)
 	default:
 	    break;
     }
-    sendData(m_rtpSock,m_remoteAddr,data,len,"RTP",m_warnSendErrorRtp);
+    if (!queueData(data,len,false))
+	sendData(m_rtpSock,m_remoteAddr,data,len,"RTP",m_warnSendErrorRtp);
 }
 
 void RTPTransport::rtcpData(const void* data, int len)
 {
     if ((len < 8) || !data)
 	return;
-    sendData(m_rtcpSock,m_remoteRTCP,data,len,"RTCP",m_warnSendErrorRtcp);
+    if (!queueData(data,len,true))
+	sendData(m_rtcpSock,m_remoteRTCP,data,len,"RTCP",m_warnSendErrorRtcp);
 }
 
 void RTPTransport::setProcessor(RTPProcessor* processor)
@@ -367,6 +629,7 @@ bool RTPTransport::localAddr(SocketAddr& addr, bool rtcp)
 	    m_rtpSock.getSockName(addr);
 	    m_localAddr = addr;
 	    setScopeId(m_localAddr,m_remoteAddr,m_remotePref);
+	    watchSockets(group(),true);
 	    return true;
 	}
 	if (!p) {
@@ -380,6 +643,7 @@ bool RTPTransport::localAddr(SocketAddr& addr, bool rtcp)
 		    m_rtpSock.setBlocking(false);
 		    m_localAddr = addr;
 		    setScopeId(m_localAddr,m_remoteAddr,m_remoteRTCP,&m_remotePref);
+		    watchSockets(group(),true);
 		    return true;
 		}
 		DDebug(dbg(),DebugMild,"RTP Socket failed with code %d",m_rtpSock.error());
@@ -394,6 +658,7 @@ bool RTPTransport::localAddr(SocketAddr& addr, bool rtcp)
 	    addr.port(p);
 	    m_localAddr = addr;
 	    setScopeId(m_localAddr,m_remoteAddr,m_remoteRTCP,&m_remotePref);
+	    watchSockets(group(),true);
 	    return true;
 	}
 #ifdef DEBUG
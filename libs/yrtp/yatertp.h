@@ -45,6 +45,8 @@
 namespace TelEngine {
 
 class RTPGroup;
+class RTPBatch;
+class RTPDelayedData;
 class RTPTransport;
 class RTPSession;
 class RTPSender;
@@ -182,6 +184,14 @@ protected:
      */
     virtual void timerTick(const Time& when) = 0;
 
+    /**
+     * Method called by an event driven group when this processor joins or
+     *  leaves it so sockets can be added or removed from the group's poller
+     * @param grp RTP group that was joined or left
+     * @param watch True if the group was joined, false if it was left
+     */
+    virtual void watchSockets(RTPGroup* grp, bool watch);
+
     unsigned int m_wrongSrc;
 
 private:
@@ -227,6 +237,22 @@ public:
      */
     static void setMinSleep(int msec);
 
+    /**
+     * Set the system global event driven mode for groups created later.
+     * In event driven mode sockets are waited upon by the kernel and read
+     *  only when data is available instead of polling them on each tick.
+     * This mode is ignored on systems that do not support it.
+     * @param events True to create event driven groups
+     */
+    static void setEventDriven(bool events);
+
+    /**
+     * Check if this group waits for socket events instead of polling
+     * @return True if the group is event driven
+     */
+    inline bool eventDriven() const
+	{ return m_poller >= 0; }
+
     /**
      * Add a RTP processor to this group
      * @param proc Pointer to the RTP processor to add
@@ -240,9 +266,16 @@ public:
     void part(RTPProcessor* proc);
 
 private:
+    friend class RTPTransport;
+    void runEvents();
+    void watchSocket(Socket& sock, RTPTransport* trans, bool rtcp, bool watch);
+    bool queueSend(RTPTransport* trans, bool rtcp, const void* data, int len);
+    void flushSend();
     ObjList m_processors;
     bool m_listChanged;
     unsigned long m_sleep;
+    int m_poller;
+    RTPBatch* m_batch;
 };
 
 /**
@@ -251,6 +284,8 @@ private:
  */
 class YRTP_API RTPTransport : public RTPProcessor
 {
+    friend class RTPGroup;
+
 public:
     /**
      * Activation status of the transport
@@ -386,9 +421,22 @@ protected:
      */
     virtual void rtcpData(const void* data, int len);
 
+    /**
+     * Add or remove the sockets from the poller of an event driven group
+     * @param grp RTP group that was joined or left
+     * @param watch True if the group was joined, false if it was left
+     */
+    virtual void watchSockets(RTPGroup* grp, bool watch);
+
 private:
+    void rtpReceive();
+    void rtcpReceive();
+    void rtpPacket(const char* data, int len, SocketAddr& from);
+    bool queueData(const void* data, int len, bool rtcp);
+    void sendBatch(const void* const* data, const int* lengths, int count, bool rtcp);
     bool sendData(Socket& sock, const SocketAddr& to, const void* data, int len,
 	const char* what, bool& flag);
+    void sendFailed(Socket& sock, const SocketAddr& to, const char* what, bool& flag);
     Type m_type;
     RTPProcessor* m_processor;
     RTPProcessor* m_monitor;
@@ -398,8 +446,6 @@ private:
     SocketAddr m_remoteAddr;
     SocketAddr m_remoteRTCP;
     SocketAddr m_remotePref;
-    SocketAddr m_rxAddrRTP;
-    SocketAddr m_rxAddrRTCP;
     bool m_autoRemote;
     bool m_warnSendErrorRtp;
     bool m_warnSendErrorRtcp;
@@ -447,6 +493,41 @@ public:
      */
     void clear();
 
+    /**
+     * Get the RFC 3550 interarrival jitter measured on incoming packets
+     * @return Estimated jitter in microseconds
+     */
+    inline unsigned int jitter() const
+	{ return (unsigned int)(m_jitter >> 4); }
+
+    /**
+     * Get the current buffering delay, adapted to the measured jitter
+     * @return Delay applied to packets in microseconds
+     */
+    inline unsigned int delay() const
+	{ return m_delay; }
+
+    /**
+     * Get the number of packets dropped because they arrived too late
+     * @return Number of late packets
+     */
+    inline unsigned int latePackets() const
+	{ return m_late; }
+
+    /**
+     * Get the number of duplicate packets that were ignored
+     * @return Number of duplicate packets
+     */
+    inline unsigned int duplicatePackets() const
+	{ return m_duplicate; }
+
+    /**
+     * Get the number of packets that were received out of order and reordered
+     * @return Number of reordered packets
+     */
+    inline unsigned int reorderedPackets() const
+	{ return m_reorder; }
+
 protected:
     /**
      * Method called periodically to keep the data flowing
@@ -455,15 +536,26 @@ protected:
     virtual void timerTick(const Time& when);
 
 private:
-    ObjList m_packets;
+    RTPDelayedData& slot(unsigned int index);
+    void updateJitter(unsigned int timestamp, u_int64_t now);
     RTPReceiver* m_receiver;
     unsigned int m_minDelay;
     unsigned int m_maxDelay;
+    unsigned int m_delay;
     unsigned int m_headStamp;
     unsigned int m_tailStamp;
     u_int64_t m_headTime;
     u_int64_t m_sampRate;
     unsigned char m_fastRate;
+    RTPDelayedData* m_ring;
+    unsigned int m_first;
+    unsigned int m_count;
+    u_int64_t m_arrival;
+    unsigned int m_arrivalStamp;
+    int64_t m_jitter;
+    unsigned int m_late;
+    unsigned int m_duplicate;
+    unsigned int m_reorder;
 };
 
 /**
@@ -31,6 +31,43 @@ class ParseNested;
 class JsRunner;
 class JsCodeStats;
 
+// Deepest value stack a typed segment may use
+#define JS_SEG_DEPTH 16
+
+// Entry of the dense instruction array built when linking
+// Operations without a typed implementation are run from their original operation
+class JsInstr
+{
+public:
+    inline JsInstr()
+	: oper(0), op(ExpEvaluator::OpcNone), num(0), seg(0)
+	{ }
+    const ExpOperation* oper;
+    int op;
+    int64_t num;
+    unsigned int seg;
+};
+
+// Tagged value on the stack of a typed segment
+// Values are turned into ExpOperation only when leaving the segment
+class JsValue
+{
+public:
+    enum Type {
+	Int,  // integer held in num
+	Bool, // boolean held in num
+	Ref,  // unresolved field, ref points to the code operation
+	Num,  // resolved integer, num and val set
+	Val   // resolved value of any other kind
+    };
+    Type type;
+    int64_t num;
+    const ExpOperation* ref;
+    // resolved value, if not owned it is the variable itself
+    ExpOperation* val;
+    bool own;
+};
+
 class JsContext : public JsObject, public ScriptMutex
 {
     YCLASS(JsContext,JsObject)
@@ -52,6 +89,7 @@ public:
     virtual bool runField(ObjList& stack, const ExpOperation& oper, GenObject* context);
     virtual bool runAssign(ObjList& stack, const ExpOperation& oper, GenObject* context);
     GenObject* resolve(ObjList& stack, String& name, GenObject* context);
+    const ExpOperation* plainField(ObjList& stack, const String& name, GenObject* context);
     bool runStringFunction(GenObject* obj, const String& name, ObjList& stack, const ExpOperation& oper, GenObject* context);
     bool runStringField(GenObject* obj, const String& name, ObjList& stack, const ExpOperation& oper, GenObject* context);
     void objCreated(GenObject* obj)
@@ -130,12 +168,6 @@ private:
     String m_shortName;
 };
 
-struct JsEntry
-{
-    long int number;
-    unsigned int index;
-};
-
 class JsCode : public ScriptCode, public ExpEvaluator
 {
     friend class TelEngine::JsFunction;
@@ -190,7 +222,8 @@ public:
     };
     inline JsCode()
 	: ExpEvaluator(C),
-	  m_pragmas(""), m_label(0), m_depth(0), m_entries(0), m_traceable(false)
+	  m_pragmas(""), m_label(0), m_depth(0), m_labels(0), m_lblCount(0),
+	  m_code(0), m_traceable(false)
 	{ debugName("JsCode"); }
     ~JsCode();
     virtual void* getObject(const String& name) const
@@ -270,6 +303,10 @@ private:
     bool parseSimple(ParsePoint& expr, bool constOnly, ScriptMutex* mtx = 0);
     bool evalList(ObjList& stack, GenObject* context) const;
     bool evalVector(ObjList& stack, GenObject* context) const;
+    void buildCode(unsigned int len);
+    bool runSegment(ObjList& stack, JsRunner* runner) const;
+    bool resolveValue(JsValue& val, ObjList& stack, GenObject* context, unsigned int line) const;
+    void pushValues(ObjList& stack, JsValue* vals, unsigned int count) const;
     bool jumpToLabel(long int label, GenObject* context) const;
     bool jumpRelative(long int offset, GenObject* context) const;
     bool jumpAbsolute(long int index, GenObject* context) const;
@@ -285,7 +322,9 @@ private:
 	{ return YOBJECT(JsFunction,m_globals[name]); }
     long int m_label;
     int m_depth;
-    JsEntry* m_entries;
+    unsigned int* m_labels;
+    unsigned int m_lblCount;
+    JsInstr* m_code;
     bool m_traceable;
 };
 
@@ -590,6 +629,7 @@ static const TokenDict s_internals[] =
 
 static const ExpNull s_null;
 static const String s_noFile = "[no file]";
+static const unsigned int s_noLabel = (unsigned int)-1;
 static const NativeFields s_nativeFields;
 
 void JsContext::destroyed()
@@ -604,6 +644,9 @@ GenObject* JsContext::resolveTop(ObjList& stack, const String& name, GenObject*
 {
     XDebug(DebugAll,"JsContext::resolveTop '%s'",name.c_str());
     for (ObjList* l = stack.skipNull(); l; l = l->skipNext()) {
+	// call scopes are always pushed as wrappers named "()"
+	if (static_cast<const ExpOperation*>(l->get())->name() != YSTRING("()"))
+	    continue;
 	JsObject* jso = YOBJECT(JsObject,l->get());
 	if (jso && jso->toString() == YSTRING("()") && jso->hasField(stack,name,context))
 	    return jso;
@@ -617,49 +660,65 @@ GenObject* JsContext::resolve(ObjList& stack, String& name, GenObject* context)
     if (name.find('.') < 0)
 	obj = resolveTop(stack,name,context);
     else {
-	ObjList* list = name.split('.',true);
+	// walk the dotted components in place, fields are resolved very often
+	const String path = name;
 	name.clear();
-	for (ObjList* l = list->skipNull(); l; ) {
-	    const String* s = static_cast<const String*>(l->get());
-	    ObjList* l2 = l->skipNext();
-	    if (TelEngine::null(s)) {
+	String s;
+	for (int pos = 0; ; ) {
+	    int dot = path.find('.',pos);
+	    s.assign(path.c_str() + pos,(dot >= 0) ? (dot - pos) : -1);
+	    if (s.null()) {
 		// consecutive dots - not good
 		obj = 0;
 		break;
 	    }
 	    if (!obj)
-		obj = resolveTop(stack,*s,context);
-	    name.append(*s,".");
-	    if (!l2)
+		obj = resolveTop(stack,s,context);
+	    name.append(s,".");
+	    if (dot < 0)
 		break;
+	    pos = dot + 1;
 	    ExpExtender* ext = YOBJECT(ExpExtender,obj);
 	    if (ext) {
 		GenObject* adv = ext->getField(stack,name,context);
 		XDebug(DebugAll,"JsContext::resolve advanced to '%s' of %p for '%s'",
-		    (adv ? adv->toString().c_str() : ""),ext,s->c_str());
+		    (adv ? adv->toString().c_str() : ""),ext,s.c_str());
 		if (adv) {
 		    if (YOBJECT(ExpExtender,adv)) {
 			obj = adv;
 			name.clear();
 		    }
-		    else if (l->count() == 2) { // there is only one other field after this one
-			s = static_cast<const String*>(l2->get());
-			if (!TelEngine::null(s) && s_nativeFields.find(*s)) {
+		    else if (path.find('.',pos) < 0) { // there is only one other field after this one
+			const String next(path.c_str() + pos);
+			if (next && s_nativeFields.find(next)) {
 			    obj = adv;
 			    name.clear();
 			}
 		    }
 		}
 	    }
-	    l = l2;
 	}
-	TelEngine::destruct(list);
     }
     DDebug(DebugAll,"JsContext::resolve got '%s' %p for '%s'",
 	(obj ? obj->toString().c_str() : 0),obj,name.c_str());
     return obj;
 }
 
+// Find the value of a global or call scope variable without copying it
+// Only plain values that JsObject::runField() would copy are returned
+const ExpOperation* JsContext::plainField(ObjList& stack, const String& name, GenObject* context)
+{
+    if (name.find('.') >= 0)
+	return 0;
+    GenObject* o = resolveTop(stack,name,context);
+    JsObject* jso = (o == this) ? this : YOBJECT(JsObject,o);
+    if (!jso)
+	return 0;
+    ExpOperation* op = YOBJECT(ExpOperation,jso->getField(stack,name,context));
+    // wrappers and functions never hold an integer
+    return (op && (op->opcode() == ExpEvaluator::OpcPush) && op->isInteger()) ? op : 0;
+}
+
 bool JsContext::runFunction(ObjList& stack, const ExpOperation& oper, GenObject* context)
 {
     XDebug(DebugAll,"JsContext::runFunction '%s' line=0x%08x [%p]",oper.name().c_str(),oper.lineNumber(),this);
@@ -1054,7 +1113,8 @@ ObjList* JsContext::countAllocations()
 
 JsCode::~JsCode()
 {
-    delete[] m_entries;
+    delete[] m_labels;
+    delete[] m_code;
 }
 
 // Initialize standard globals in the execution context
@@ -1092,63 +1152,294 @@ bool JsCode::evaluate(ScriptRun& runner, ObjList& results) const
     return true;
 }
 
-// Convert list to vector and fix label relocations
+// Track stack depth over operations that only consume and produce values
+static bool simpleOperation(const ExpOperation& oper, int& depth)
+{
+    int need = 2;
+    int delta = -1;
+    switch ((int)oper.opcode()) {
+	case ExpEvaluator::OpcPush:
+	case ExpEvaluator::OpcField:
+	    depth++;
+	    return true;
+	case ExpEvaluator::OpcNeg:
+	case ExpEvaluator::OpcNot:
+	case ExpEvaluator::OpcLNot:
+	case ExpEvaluator::OpcIncPre:
+	case ExpEvaluator::OpcDecPre:
+	case ExpEvaluator::OpcIncPost:
+	case ExpEvaluator::OpcDecPost:
+	    need = 1;
+	    delta = 0;
+	    break;
+	case ExpEvaluator::OpcAssign:
+	case ExpEvaluator::OpcAdd:
+	case ExpEvaluator::OpcSub:
+	case ExpEvaluator::OpcMul:
+	case ExpEvaluator::OpcDiv:
+	case ExpEvaluator::OpcMod:
+	case ExpEvaluator::OpcAnd:
+	case ExpEvaluator::OpcOr:
+	case ExpEvaluator::OpcXor:
+	case ExpEvaluator::OpcShl:
+	case ExpEvaluator::OpcShr:
+	case ExpEvaluator::OpcLAnd:
+	case ExpEvaluator::OpcLOr:
+	case ExpEvaluator::OpcCat:
+	case ExpEvaluator::OpcEq:
+	case ExpEvaluator::OpcNe:
+	case ExpEvaluator::OpcGt:
+	case ExpEvaluator::OpcLt:
+	case ExpEvaluator::OpcGe:
+	case ExpEvaluator::OpcLe:
+	case ExpEvaluator::OpcAssign | ExpEvaluator::OpcAdd:
+	case ExpEvaluator::OpcAssign | ExpEvaluator::OpcSub:
+	case ExpEvaluator::OpcAssign | ExpEvaluator::OpcMul:
+	case ExpEvaluator::OpcAssign | ExpEvaluator::OpcDiv:
+	case ExpEvaluator::OpcAssign | ExpEvaluator::OpcMod:
+	case JsCode::OpcEqIdentity:
+	case JsCode::OpcNeIdentity:
+	    break;
+	default:
+	    return false;
+    }
+    if (depth < need)
+	return false;
+    depth += delta;
+    return true;
+}
+
+// Remove Begin/End and Begin/Flush pairs around expressions with known stack effect
+static void dropSimpleBlocks(ObjList& opcodes)
+{
+    ObjList* l = opcodes.skipNull();
+    while (l) {
+	const ExpOperation* o = static_cast<const ExpOperation*>(l->get());
+	ObjList* e = 0;
+	int depth = 0;
+	if (o->opcode() == (ExpEvaluator::Opcode)JsCode::OpcBegin) {
+	    for (e = l->skipNext(); e; e = e->skipNext()) {
+		if (!simpleOperation(*static_cast<const ExpOperation*>(e->get()),depth))
+		    break;
+	    }
+	}
+	const ExpOperation* end = e ? static_cast<const ExpOperation*>(e->get()) : 0;
+	if (end && (end->opcode() == (ExpEvaluator::Opcode)JsCode::OpcEnd) && (depth == 1))
+	    e->remove();
+	else if (end && (end->opcode() == (ExpEvaluator::Opcode)JsCode::OpcFlush) && (depth <= 1)) {
+	    if (depth) {
+		ExpOperation* drop = new ExpOperation(ExpEvaluator::OpcDrop);
+		drop->lineNumber(end->lineNumber());
+		e->set(drop);
+	    }
+	    else
+		e->remove();
+	}
+	else {
+	    l = l->skipNext();
+	    continue;
+	}
+	// next operation moves into this list item so check it too
+	l->remove();
+	l = l->skipNull();
+    }
+}
+
+// Convert list to vector, drop plain labels and fix label relocations
 bool JsCode::link()
 {
     if (!m_opcodes.skipNull())
 	return false;
+    dropSimpleBlocks(m_opcodes);
+    delete[] m_labels;
+    m_labels = 0;
+    m_lblCount = 0;
+    delete[] m_code;
+    m_code = 0;
+    long int maxLbl = -1;
+    for (ObjList* l = m_opcodes.skipNull(); l; l = l->skipNext()) {
+	const ExpOperation* o = static_cast<const ExpOperation*>(l->get());
+	if (o->opcode() == OpcLabel && o->number() > maxLbl)
+	    maxLbl = (long int)o->number();
+    }
+    if (maxLbl >= 0) {
+	m_lblCount = maxLbl + 1;
+	m_labels = new unsigned int[m_lblCount];
+	for (unsigned int i = 0; i < m_lblCount; i++)
+	    m_labels[i] = s_noLabel;
+    }
+    // Remember where each label points, keep only function entry labels
+    unsigned int n = 0;
+    for (ObjList* l = m_opcodes.skipNull(); l; ) {
+	const ExpOperation* o = static_cast<const ExpOperation*>(l->get());
+	if (o->opcode() == OpcLabel && o->number() >= 0) {
+	    unsigned int& idx = m_labels[(long int)o->number()];
+	    if (idx == s_noLabel)
+		idx = n;
+	    if (!o->barrier()) {
+		l->remove();
+		l = l->skipNull();
+		continue;
+	    }
+	}
+	n++;
+	l = l->skipNext();
+    }
     m_linked.assign(m_opcodes);
-    delete[] m_entries;
-    m_entries = 0;
-    unsigned int n = m_linked.count();
     if (!n)
 	return false;
-    unsigned int entries = 0;
-    for (unsigned int i = 0; i < n; i++) {
-	const ExpOperation* l = static_cast<const ExpOperation*>(m_linked[i]);
-	if (!l || l->opcode() != OpcLabel)
+    for (unsigned int j = 0; j < n; j++) {
+	const ExpOperation* jmp = static_cast<const ExpOperation*>(m_linked[j]);
+	if (!jmp)
 	    continue;
-	long int lbl = (long int)l->number();
-	if (lbl >= 0 && l->barrier())
-	    entries++;
-	for (unsigned int j = 0; j < n; j++) {
-	    const ExpOperation* jmp = static_cast<const ExpOperation*>(m_linked[j]);
-	    if (!jmp || jmp->number() != lbl)
+	Opcode op = OpcNone;
+	switch ((int)jmp->opcode()) {
+	    case OpcJump:
+		op = (Opcode)OpcJRel;
+		break;
+	    case OpcJumpTrue:
+		op = (Opcode)OpcJRelTrue;
+		break;
+	    case OpcJumpFalse:
+		op = (Opcode)OpcJRelFalse;
+		break;
+	    default:
 		continue;
-	    Opcode op = OpcNone;
-	    switch ((int)jmp->opcode()) {
-		case OpcJump:
-		    op = (Opcode)OpcJRel;
-		    break;
-		case OpcJumpTrue:
-		    op = (Opcode)OpcJRelTrue;
-		    break;
-		case OpcJumpFalse:
-		    op = (Opcode)OpcJRelFalse;
-		    break;
-		default:
+	}
+	long int lbl = (long int)jmp->number();
+	if (lbl < 0 || lbl >= (long int)m_lblCount || m_labels[lbl] == s_noLabel)
+	    continue;
+	long int offs = (long int)m_labels[lbl] - j - 1;
+	ExpOperation* newJump = new ExpOperation(op,0,offs,jmp->barrier());
+	newJump->lineNumber(jmp->lineNumber());
+	m_linked.set(newJump,j);
+    }
+    // Jumps landing on an unconditional jump can go straight to its target
+    for (unsigned int j = 0; j < n; j++) {
+	const ExpOperation* jmp = static_cast<const ExpOperation*>(m_linked[j]);
+	if (!jmp)
+	    continue;
+	switch ((int)jmp->opcode()) {
+	    case OpcJRel:
+	    case OpcJRelTrue:
+	    case OpcJRelFalse:
+		break;
+	    default:
+		continue;
+	}
+	// relative jumps are applied after the index moved past the jump
+	long int dest = j + 1 + (long int)jmp->number();
+	for (unsigned int hops = 0; hops < n && dest >= 0 && dest < (long int)n; hops++) {
+	    const ExpOperation* o = static_cast<const ExpOperation*>(m_linked[(unsigned int)dest]);
+	    if (!o || (o->opcode() != (Opcode)OpcJRel) || (o->number() == -1))
+		break;
+	    dest += 1 + (long int)o->number();
+	}
+	if (dest == (long int)(j + 1 + jmp->number()))
+	    continue;
+	ExpOperation* newJump = new ExpOperation(jmp->opcode(),0,dest - (long int)j - 1,jmp->barrier());
+	newJump->lineNumber(jmp->lineNumber());
+	m_linked.set(newJump,j);
+    }
+    buildCode(n);
+    return true;
+}
+
+// Check if a pushed constant is a plain integer that can be held untyped
+static inline bool plainInteger(const ExpOperation& oper)
+{
+    return (oper.opcode() == ExpEvaluator::OpcPush) && oper.isInteger()
+	&& oper.isNumber() && !oper.isBoolean();
+}
+
+// Build the dense instruction array and find the typed segments
+// A segment is a run of integer constants, fields and binary operators,
+//  optionally ending with a conditional jump, that no jump lands inside
+void JsCode::buildCode(unsigned int len)
+{
+    m_code = new JsInstr[len];
+    bool* target = new bool[len + 1];
+    for (unsigned int i = 0; i <= len; i++)
+	target[i] = false;
+    for (unsigned int i = 0; i < m_lblCount; i++)
+	if (m_labels[i] <= len)
+	    target[m_labels[i]] = true;
+    for (unsigned int i = 0; i < len; i++) {
+	JsInstr& ins = m_code[i];
+	ins.oper = static_cast<const ExpOperation*>(m_linked[i]);
+	if (!ins.oper)
+	    continue;
+	switch ((int)ins.oper->opcode()) {
+	    case OpcPush:
+		if (!plainInteger(*ins.oper))
 		    continue;
-	    }
-	    long int offs = (long int)i - j;
-	    ExpOperation* newJump = new ExpOperation(op,0,offs,jmp->barrier());
-	    newJump->lineNumber(jmp->lineNumber());
-	    m_linked.set(newJump,j);
+		break;
+	    case OpcJRel:
+	    case OpcJRelTrue:
+	    case OpcJRelFalse:
+		{
+		    long int dest = i + 1 + (long int)ins.oper->number();
+		    if ((dest >= 0) && (dest <= (long int)len))
+			target[dest] = true;
+		}
+		break;
+	    case OpcField:
+	    case OpcAdd:
+	    case OpcSub:
+	    case OpcMul:
+	    case OpcDiv:
+	    case OpcMod:
+	    case OpcAnd:
+	    case OpcOr:
+	    case OpcXor:
+	    case OpcShl:
+	    case OpcShr:
+	    case OpcEq:
+	    case OpcNe:
+	    case OpcLt:
+	    case OpcGt:
+	    case OpcLe:
+	    case OpcGe:
+		break;
+	    default:
+		continue;
 	}
+	ins.op = ins.oper->opcode();
+	ins.num = ins.oper->number();
     }
-    if (entries) {
-	m_entries = new JsEntry[entries+1];
-	unsigned int e = 0;
-	for (unsigned int j = 0; j < n; j++) {
-	    const ExpOperation* l = static_cast<const ExpOperation*>(m_linked[j]);
-	    if (l && l->barrier() && l->opcode() == OpcLabel && l->number() >= 0) {
-		m_entries[e].number = (long int)l->number();
-		m_entries[e++].index = j;
+    unsigned int segs = 0;
+    for (unsigned int i = 0; i < len; ) {
+	unsigned int end = i;
+	unsigned int depth = 0;
+	for (unsigned int k = i; k < len; k++) {
+	    if ((k > i) && target[k])
+		break;
+	    int op = m_code[k].op;
+	    if ((op == OpcPush) || (op == OpcField)) {
+		if (++depth > JS_SEG_DEPTH)
+		    break;
+		continue;
 	    }
+	    if ((op == OpcJRelTrue) || (op == OpcJRelFalse)) {
+		if ((depth == 1) && (end || (k > i)))
+		    end = k + 1;
+		break;
+	    }
+	    if ((op == OpcNone) || (op == OpcJRel) || (depth < 2))
+		break;
+	    depth--;
+	    end = k + 1;
 	}
-	m_entries[entries].number = -1;
-	m_entries[entries].index = 0;
+	if (end > i) {
+	    m_code[i].seg = end - i;
+	    segs++;
+	    i = end;
+	}
+	else
+	    i++;
     }
-    return true;
+    delete[] target;
+    DDebug(this,DebugAll,"Built %u instructions with %u typed segments",len,segs);
 }
 
 const String& JsCode::getFileAt(unsigned int index, bool wholePath) const
@@ -2848,9 +3139,27 @@ bool JsCode::evalVector(ObjList& stack, GenObject* context) const
     XDebug(this,DebugInfo,"JsCode::evalVector(%p,%p)",&stack,context);
     JsRunner* runner = static_cast<JsRunner*>(context);
     unsigned int& index = runner->m_index;
-    while (index < m_linked.length()) {
-	const ExpOperation* o = static_cast<const ExpOperation*>(m_linked[index++]);
-	if (o && !runOperation(stack,*o,context))
+    unsigned int len = m_linked.length();
+    while (index < len) {
+	const JsInstr& ins = m_code[index];
+	if (!runner->m_tracing) {
+	    if (ins.seg) {
+		if (!runSegment(stack,runner))
+		    return false;
+		if (runner->m_paused)
+		    break;
+		continue;
+	    }
+	    if (ins.op == OpcJRel) {
+		long int i = index + 1 + (long int)ins.num;
+		if (i < 0 || i > (long int)len)
+		    return gotError("Relative jump failed",ins.oper->lineNumber());
+		index = i;
+		continue;
+	    }
+	}
+	index++;
+	if (ins.oper && !runOperation(stack,*ins.oper,context))
 	    return false;
 	if (runner->m_paused)
 	    break;
@@ -2858,6 +3167,238 @@ bool JsCode::evalVector(ObjList& stack, GenObject* context) const
     return true;
 }
 
+// Resolve a field value of a typed segment, keep it typed if it's a plain integer
+bool JsCode::resolveValue(JsValue& val, ObjList& stack, GenObject* context, unsigned int line) const
+{
+    if (val.type != JsValue::Ref)
+	return true;
+    // the field is resolved against the real stack as it holds the scopes
+    // segments hold no assignments or calls so a variable can be used in place
+    JsContext* ctx = YOBJECT(JsContext,static_cast<ScriptRun*>(context)->context());
+    ExpOperation* op = ctx ? const_cast<ExpOperation*>(ctx->plainField(stack,val.ref->name(),context)) : 0;
+    val.own = !op;
+    if (!op) {
+	op = runField(stack,*val.ref,context) ? popOne(stack) : 0;
+	if (!op)
+	    return gotError("ExpEvaluator stack underflow",line);
+    }
+    val.val = op;
+    if (plainInteger(*op)) {
+	val.type = JsValue::Num;
+	val.num = op->number();
+    }
+    else
+	val.type = JsValue::Val;
+    return true;
+}
+
+// Turn typed values into stack operations for the generic evaluator
+void JsCode::pushValues(ObjList& stack, JsValue* vals, unsigned int count) const
+{
+    for (unsigned int i = 0; i < count; i++) {
+	JsValue& v = vals[i];
+	switch (v.type) {
+	    case JsValue::Int:
+		pushOne(stack,new ExpOperation(v.num));
+		break;
+	    case JsValue::Bool:
+		pushOne(stack,new ExpOperation(v.num != 0));
+		break;
+	    case JsValue::Ref:
+		pushOne(stack,v.ref->clone());
+		break;
+	    default:
+		// a variable used in place is copied the way JsObject::runField() does
+		pushOne(stack,v.own ? v.val : new ExpOperation(*v.val,v.ref->name(),false));
+	}
+    }
+}
+
+static inline void releaseValues(JsValue* vals, unsigned int count)
+{
+    for (unsigned int i = 0; i < count; i++)
+	if (vals[i].own)
+	    TelEngine::destruct(vals[i].val);
+}
+
+// Compare two integers the way the generic evaluator compares their text
+static inline bool sameText(const JsValue& v1, const JsValue& v2)
+{
+    if (v1.type == JsValue::Int && v2.type == JsValue::Int)
+	return v1.num == v2.num;
+    String s1;
+    String s2;
+    if (v1.type == JsValue::Int)
+	s1 = v1.num;
+    if (v2.type == JsValue::Int)
+	s2 = v2.num;
+    return (v1.val ? *v1.val : s1) == (v2.val ? *v2.val : s2);
+}
+
+// Run a typed segment on a stack of tagged values
+// Values that are not plain integers send the rest of the segment to the
+//  generic evaluator, the same way as if the segment never existed
+bool JsCode::runSegment(ObjList& stack, JsRunner* runner) const
+{
+    unsigned int& index = runner->m_index;
+    unsigned int end = index + m_code[index].seg;
+    JsValue vals[JS_SEG_DEPTH];
+    unsigned int sp = 0;
+    while (index < end) {
+	const JsInstr& ins = m_code[index++];
+	switch (ins.op) {
+	    case OpcPush:
+		vals[sp].type = JsValue::Int;
+		vals[sp].num = ins.num;
+		vals[sp].val = 0;
+		vals[sp++].own = false;
+		continue;
+	    case OpcField:
+		vals[sp].type = JsValue::Ref;
+		vals[sp].ref = ins.oper;
+		vals[sp].val = 0;
+		vals[sp++].own = false;
+		continue;
+	    case OpcJRelTrue:
+	    case OpcJRelFalse:
+		{
+		    JsValue& v = vals[--sp];
+		    if (!resolveValue(v,stack,runner,ins.oper->lineNumber()))
+			return false;
+		    bool cond = false;
+		    switch (v.type) {
+			case JsValue::Int:
+			case JsValue::Bool:
+			    cond = (v.num != 0);
+			    break;
+			default:
+			    cond = v.val->valBoolean();
+			    if (v.own)
+				TelEngine::destruct(v.val);
+		    }
+		    if (cond != (ins.op == OpcJRelTrue))
+			continue;
+		    long int i = index + (long int)ins.num;
+		    if (i < 0 || i > (long int)m_linked.length())
+			return gotError("Relative jump failed",ins.oper->lineNumber());
+		    index = i;
+		}
+		continue;
+	    default:
+		break;
+	}
+	// binary operators, operands are resolved right to left like popValue() does
+	JsValue& v2 = vals[sp - 1];
+	JsValue& v1 = vals[sp - 2];
+	unsigned int line = ins.oper->lineNumber();
+	bool typed = resolveValue(v2,stack,runner,line);
+	if (!typed) {
+	    releaseValues(vals,sp);
+	    return false;
+	}
+	typed = (v2.type == JsValue::Int) || (v2.type == JsValue::Num);
+	if (typed) {
+	    if (!resolveValue(v1,stack,runner,line)) {
+		releaseValues(vals,sp);
+		return false;
+	    }
+	    typed = (v1.type == JsValue::Int) || (v1.type == JsValue::Num);
+	}
+	if (!typed) {
+	    // hand over to the generic evaluator from this operation on
+	    pushValues(stack,vals,sp);
+	    if (!runOperation(stack,*ins.oper,runner))
+		return false;
+	    while (index < end && !runner->m_paused) {
+		const ExpOperation* o = m_code[index++].oper;
+		if (o && !runOperation(stack,*o,runner))
+		    return false;
+	    }
+	    return true;
+	}
+	int64_t a = v1.num;
+	int64_t b = v2.num;
+	int64_t val = 0;
+	bool boolRes = false;
+	switch (ins.op) {
+	    case OpcAdd:
+		val = a + b;
+		break;
+	    case OpcSub:
+		val = a - b;
+		break;
+	    case OpcMul:
+		val = a * b;
+		break;
+	    case OpcDiv:
+	    case OpcMod:
+		if (!b) {
+		    releaseValues(vals,sp);
+		    return gotError("Division by zero",line);
+		}
+		val = (ins.op == OpcDiv) ? (a / b) : (a % b);
+		break;
+	    case OpcAnd:
+		val = a & b;
+		break;
+	    case OpcOr:
+		val = a | b;
+		break;
+	    case OpcXor:
+		val = a ^ b;
+		break;
+	    case OpcShl:
+		val = a << b;
+		break;
+	    case OpcShr:
+		val = a >> b;
+		break;
+	    case OpcEq:
+		val = sameText(v1,v2) ? 1 : 0;
+		boolRes = true;
+		break;
+	    case OpcNe:
+		val = sameText(v1,v2) ? 0 : 1;
+		boolRes = true;
+		break;
+	    case OpcLt:
+		val = (a < b) ? 1 : 0;
+		boolRes = true;
+		break;
+	    case OpcGt:
+		val = (a > b) ? 1 : 0;
+		boolRes = true;
+		break;
+	    case OpcLe:
+		val = (a <= b) ? 1 : 0;
+		boolRes = true;
+		break;
+	    case OpcGe:
+		val = (a >= b) ? 1 : 0;
+		boolRes = true;
+		break;
+	}
+	releaseValues(vals + sp - 2,2);
+	sp--;
+	JsValue& res = vals[sp - 1];
+	res.val = 0;
+	res.own = false;
+	if (boolRes)
+	    res.type = JsValue::Bool;
+	else if (val == ExpOperation::nonInteger()) {
+	    // same as the generic evaluator, a result that can't be an integer is NaN
+	    res.type = JsValue::Val;
+	    res.val = new ExpOperation(val);
+	    res.own = true;
+	}
+	else
+	    res.type = JsValue::Int;
+	res.num = val;
+    }
+    pushValues(stack,vals,sp);
+    return true;
+}
+
 bool JsCode::jumpToLabel(long int label, GenObject* context) const
 {
     if (!context)
@@ -2873,27 +3414,10 @@ bool JsCode::jumpToLabel(long int label, GenObject* context) const
 	    }
 	}
     }
-    else {
-	if (m_entries) {
-	    for (const JsEntry* e = m_entries; e->number >= 0; e++) {
-		if (e->number == label) {
-		    runner->m_index = e->index;
-		    XDebug(this,DebugInfo,"Fast jumped to index %u",e->index);
-		    return true;
-		}
-	    }
-	}
-	unsigned int n = m_linked.length();
-	if (!n)
-	    return false;
-	for (unsigned int i = 0; i < n; i++) {
-	    const ExpOperation* o = static_cast<const ExpOperation*>(m_linked[i]);
-	    if (o && o->opcode() == OpcLabel && o->number() == label) {
-		runner->m_index = i;
-		XDebug(this,DebugInfo,"Jumped to index %u",i);
-		return true;
-	    }
-	}
+    else if (label >= 0 && label < (long int)m_lblCount && m_labels[label] != s_noLabel) {
+	runner->m_index = m_labels[label];
+	XDebug(this,DebugInfo,"Jumped to index %u",runner->m_index);
+	return true;
     }
     return false;
 }
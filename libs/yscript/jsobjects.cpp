@@ -667,8 +667,9 @@ static bool internalResolveReferences(ExpOperation* root, ExpWrapper* wrap, Recu
 	}
     }
     else if (jso) {
-	for (ObjList* o = jso->params().paramList()->skipNull(); o; o = o->skipNext()) {
-	    wrap = YOBJECT(ExpWrapper,o->get());
+	NamedIterator iter(jso->params());
+	while (const NamedString* ns = iter.get()) {
+	    wrap = YOBJECT(ExpWrapper,ns);
 	    if (!wrap)
 		continue;
 	    const String& name = wrap->name();
@@ -720,7 +721,7 @@ ExpOperation* JsObject::find(ExpOperation* oper, const JPath& path)
 // Utility: retrieve a JSON candidate from given list item
 // Advance the list
 // Return pointer to candidate, NULL if not found
-static inline GenObject* nextJSONCandidate(ObjList*& crt, bool isNs = true, bool undef = false)
+static inline GenObject* nextJSONCandidate(const ObjList*& crt, bool isNs = true, bool undef = false)
 {
     if (!crt)
 	return 0;
@@ -747,7 +748,7 @@ static inline GenObject* nextJSONCandidate(ObjList*& crt, bool isNs = true, bool
 // Utility: retrieve a JSON candidate from given hash list
 // Advance the list
 // Return pointer to candidate, NULL if not found
-static inline GenObject* nextJSONCandidate(const HashList& hash, unsigned int& idx, ObjList*& crt,
+static inline GenObject* nextJSONCandidate(const HashList& hash, unsigned int& idx, const ObjList*& crt,
     bool undef = false)
 {
     GenObject* gen = nextJSONCandidate(crt,false);
@@ -861,7 +862,7 @@ void JsObject::internalToJSON(const GenObject* obj, bool isStr, String& buf, int
 	    return;
 	const HashList* hash = jso->getHashListParams();
 	if (hash) {
-	    ObjList* crt = hash->getList(0);
+	    const ObjList* crt = hash->getList(0);
 	    unsigned int idx = 0;
 	    GenObject* gen = nextJSONCandidate(*hash,idx,crt);
 	    if (!gen) {
@@ -892,7 +893,7 @@ void JsObject::internalToJSON(const GenObject* obj, bool isStr, String& buf, int
 		buf << "{}";
 		return;
 	}
-	ObjList* l = jso->params().paramList()->skipNull();
+	const ObjList* l = static_cast<const JsObject*>(jso)->params().paramList()->skipNull();
 	String li(' ',indent);
 	String ci(' ',indent + spaces);
 	const char* sep = spaces ? ": " : ":";
@@ -1373,7 +1374,7 @@ int JsObject::internalAssignProps(JsObject* dest, JsObject* src, unsigned int fl
 	if (!getObjParams(src,params,native ? 0 : &hash))
 	    break;
 	unsigned int idx = 0;
-	ObjList* crt = hash ? hash->getList(0) : params->paramList()->skipNull();
+	const ObjList* crt = hash ? hash->getList(0) : params->paramList()->skipNull();
 #ifdef DEBUG_JsObject_assignProps
 	Debug(DebugInfo,"JsObject::assign src=(%p) processing %s (%p) crt=(%p) [%p]",
 	    src,(hash ? "hashlist" : (native ? "native params" : "params")),
@@ -1709,6 +1710,8 @@ JsObject* JsObject::copy(int& res, JsObject* src, unsigned int flags, GenObject*
 JsArray::JsArray(ScriptMutex* mtx)
     : JsObject("Array",mtx), m_length(0)
 {
+    // array items are renamed in place by push, sort, shift and others
+    params().disableIndex();
     params().addParam(new ExpFunction("push"));
     params().addParam(new ExpFunction("pop"));
     params().addParam(new ExpFunction("concat"));
@@ -1728,6 +1731,7 @@ JsArray::JsArray(ScriptMutex* mtx)
 JsArray::JsArray(GenObject* context, unsigned int line, ScriptMutex* mtx)
     : JsObject(mtx,"[object Array]",line), m_length(0)
 {
+    params().disableIndex();
     setPrototype(context,YSTRING("Array"));
 }
 
@@ -3196,7 +3196,7 @@ public:
      */
     inline JsArray(ScriptMutex* mtx, const char* name, unsigned int line, bool frozen = false)
 	: JsObject(mtx,name,line,frozen), m_length(0)
-	{ }
+	{ params().disableIndex(); }
 
     /**
      * Retrieve the length of the array
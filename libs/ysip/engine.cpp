@@ -162,12 +162,16 @@ SIPEvent::~SIPEvent()
 
 SIPEngine::SIPEngine(const char* userAgent)
     : Mutex(true,"SIPEngine"),
+      m_transByBranch(1021), m_transByCallId(1021),
       m_t1(500000), m_t4(5000000), m_reqTransCount(5), m_rspTransCount(6),
       m_maxForwards(70),
       m_flags(0), m_lazyTrying(false),
       m_userAgent(userAgent), m_nc(0), m_nonce_time(0),
       m_nonce_mutex(false,"SIPEngine::nonce"),
-      m_autoChangeParty(false)
+      m_autoChangeParty(false), m_transFirst(0), m_transLast(0),
+      m_listFirst(0), m_listLast(0), m_listCount(0),
+      m_readyFirst(0), m_readyLast(0),
+      m_timers(0), m_timersCount(0), m_timersAlloc(0)
 {
     debugName("sipengine");
     DDebug(this,DebugInfo,"SIPEngine::SIPEngine() [%p]",this);
@@ -184,6 +188,9 @@ SIPEngine::SIPEngine(const char* userAgent)
 SIPEngine::~SIPEngine()
 {
     DDebug(this,DebugInfo,"SIPEngine::~SIPEngine() [%p]",this);
+    // released transactions unschedule themselves from the timers heap
+    clearTransactions();
+    delete[] m_timers;
 }
 
 SIPTransaction* SIPEngine::addMessage(SIPParty* ep, const char* buf, int len)
@@ -220,13 +227,35 @@ SIPTransaction* SIPEngine::addMessage(SIPMessage* message, bool* autoChangeParty
     String branch;
     if (br && br->startsWith("z9hG4bK"))
 	branch = *br;
+    // messages without branch and ACKs to 2xx (which have a new branch)
+    //  can only match transactions with the same Call-ID
+    const String* callid = 0;
+    if (branch.null() || message->isACK())
+	callid = &message->getHeaderValue("Call-ID");
     Lock lock(this);
     SIPTransaction* forked = 0;
-    ObjList* l = &m_transList;
-    for (; l; l = l->next()) {
-	SIPTransaction* t = static_cast<SIPTransaction*>(l->get());
-	if (!t)
-	    continue;
+    ObjList* lb = branch ? m_transByBranch.getHashList(branch) : 0;
+    ObjList* lc = callid ? m_transByCallId.getHashList(*callid) : 0;
+    lb = lb ? lb->skipNull() : 0;
+    lc = lc ? lc->skipNull() : 0;
+    // walk both candidate lists merged in the transaction list order
+    for (;;) {
+	while (lb && (static_cast<SIPTransaction*>(lb->get())->m_branch != branch))
+	    lb = lb->skipNext();
+	while (lc && (static_cast<SIPTransaction*>(lc->get())->m_callid != *callid))
+	    lc = lc->skipNext();
+	SIPTransaction* t = lb ? static_cast<SIPTransaction*>(lb->get()) : 0;
+	SIPTransaction* tc = lc ? static_cast<SIPTransaction*>(lc->get()) : 0;
+	if (!(t && tc && (t == tc))) {
+	    if (!t || (tc && (tc->m_order < t->m_order)))
+		t = tc;
+	    if (!t)
+		break;
+	}
+	if (lb && (t == lb->get()))
+	    lb = lb->skipNext();
+	if (lc && (t == lc->get()))
+	    lc = lc->skipNext();
 	switch (t->processMessage(message,branch)) {
 	    case SIPTransaction::Matched:
 		return t;
@@ -273,36 +302,273 @@ bool SIPEngine::process()
 SIPEvent* SIPEngine::getEvent()
 {
     Lock lock(this);
-    ObjList* l = m_transList.skipNull();
-    if (!l)
-	return 0;
     u_int64_t time = Time::now();
-    for (; l; l = l->skipNext()) {
-	SIPTransaction* t = static_cast<SIPTransaction*>(l->get());
-	SIPEvent* e = t->getEvent(true,time);
-	if (e) {
-	    DDebug(this,DebugInfo,"Got pending event %p (state %s) from transaction %p [%p]",
-		e,SIPTransaction::stateName(e->getState()),t,this);
-	    if (t->getState() == SIPTransaction::Invalid)
-		m_transList.remove(t);
-	    return e;
-	}
+    // transactions whose timer expired must be checked for events
+    while (m_timersCount && (m_timers[0]->m_timeout <= time)) {
+	SIPTransaction* t = m_timers[0];
+	timerRemove(0);
+	transReady(t);
     }
-    time = Time::now();
-    for (l = m_transList.skipNull(); l; l = l->skipNext()) {
-	SIPTransaction* t = static_cast<SIPTransaction*>(l->get());
+    while (SIPTransaction* t = m_readyFirst) {
+	m_readyFirst = t->m_readyNext;
+	if (m_readyFirst)
+	    m_readyFirst->m_readyPrev = 0;
+	else
+	    m_readyLast = 0;
+	t->m_ready = false;
+	t->m_readyNext = 0;
 	SIPEvent* e = t->getEvent(false,time);
-	if (e) {
-	    DDebug(this,DebugInfo,"Got event %p (state %s) from transaction %p [%p]",
-		e,SIPTransaction::stateName(e->getState()),t,this);
-	    if (t->getState() == SIPTransaction::Invalid)
-		m_transList.remove(t);
-	    return e;
+	if (!e) {
+	    // nothing to do until the next timer or state change
+	    transSchedule(t);
+	    continue;
+	}
+	DDebug(this,DebugInfo,"Got event %p (state %s) from transaction %p [%p]",
+	    e,SIPTransaction::stateName(e->getState()),t,this);
+	if (t->getState() == SIPTransaction::Invalid) {
+	    transUnschedule(t);
+	    if (transUnlink(t)) {
+		unindexTransaction(t);
+		// release the reference held by the list
+		t->deref();
+	    }
 	}
+	else {
+	    // there may be more events, check it again after the others
+	    transSchedule(t);
+	    transReady(t);
+	}
+	return e;
     }
     return 0;
 }
 
+void SIPEngine::remove(SIPTransaction* transaction)
+{
+    Lock mylock(this);
+    transUnschedule(transaction);
+    if (transUnlink(transaction))
+	unindexTransaction(transaction);
+}
+
+void SIPEngine::append(SIPTransaction* transaction)
+{
+    if (!transaction)
+	return;
+    Lock mylock(this);
+    transaction->m_order = ++m_transLast;
+    transaction->m_listPrev = m_listLast;
+    transaction->m_listNext = 0;
+    if (m_listLast)
+	m_listLast->m_listNext = transaction;
+    else
+	m_listFirst = transaction;
+    m_listLast = transaction;
+    m_listCount++;
+    indexTransaction(transaction);
+    transReady(transaction);
+}
+
+void SIPEngine::insert(SIPTransaction* transaction)
+{
+    if (!transaction)
+	return;
+    Lock mylock(this);
+    transaction->m_order = --m_transFirst;
+    transaction->m_listPrev = 0;
+    transaction->m_listNext = m_listFirst;
+    if (m_listFirst)
+	m_listFirst->m_listPrev = transaction;
+    else
+	m_listLast = transaction;
+    m_listFirst = transaction;
+    m_listCount++;
+    indexTransaction(transaction);
+    transReady(transaction);
+}
+
+void SIPEngine::clearTransactions()
+{
+    Lock mylock(this);
+    m_transByBranch.clear();
+    m_transByCallId.clear();
+    while (SIPTransaction* t = m_listFirst) {
+	transUnschedule(t);
+	transUnlink(t);
+	t->deref();
+    }
+}
+
+// Remove a transaction from the list of all transactions
+// Returns true if the transaction was in the list
+bool SIPEngine::transUnlink(SIPTransaction* transaction)
+{
+    if (!(transaction->m_listPrev || (m_listFirst == transaction)))
+	return false;
+    if (transaction->m_listPrev)
+	transaction->m_listPrev->m_listNext = transaction->m_listNext;
+    else
+	m_listFirst = transaction->m_listNext;
+    if (transaction->m_listNext)
+	transaction->m_listNext->m_listPrev = transaction->m_listPrev;
+    else
+	m_listLast = transaction->m_listPrev;
+    transaction->m_listPrev = 0;
+    transaction->m_listNext = 0;
+    m_listCount--;
+    return true;
+}
+
+// Append a transaction to the list of those to be checked for events
+void SIPEngine::transReady(SIPTransaction* transaction)
+{
+    Lock mylock(this);
+    if (transaction->m_ready || (transaction->m_state == SIPTransaction::Invalid))
+	return;
+    transaction->m_ready = true;
+    transaction->m_readyNext = 0;
+    transaction->m_readyPrev = m_readyLast;
+    if (m_readyLast)
+	m_readyLast->m_readyNext = transaction;
+    else
+	m_readyFirst = transaction;
+    m_readyLast = transaction;
+}
+
+// Update the position of a transaction in the timers heap
+void SIPEngine::transSchedule(SIPTransaction* transaction)
+{
+    Lock mylock(this);
+    int pos = transaction->m_timerPos;
+    if (!transaction->m_timeout || (transaction->m_state == SIPTransaction::Invalid)) {
+	if (pos >= 0)
+	    timerRemove(pos);
+	return;
+    }
+    if (pos < 0) {
+	if (m_timersCount >= m_timersAlloc) {
+	    unsigned int alloc = m_timersAlloc ? 2 * m_timersAlloc : 64;
+	    SIPTransaction** timers = new SIPTransaction*[alloc];
+	    for (unsigned int i = 0; i < m_timersCount; i++)
+		timers[i] = m_timers[i];
+	    delete[] m_timers;
+	    m_timers = timers;
+	    m_timersAlloc = alloc;
+	}
+	pos = m_timersCount++;
+	m_timers[pos] = transaction;
+	transaction->m_timerPos = pos;
+    }
+    timerUp(pos);
+    timerDown(transaction->m_timerPos);
+}
+
+// Remove a transaction from both the ready list and timers heap
+void SIPEngine::transUnschedule(SIPTransaction* transaction)
+{
+    Lock mylock(this);
+    if (transaction->m_timerPos >= 0)
+	timerRemove(transaction->m_timerPos);
+    if (!transaction->m_ready)
+	return;
+    if (transaction->m_readyPrev)
+	transaction->m_readyPrev->m_readyNext = transaction->m_readyNext;
+    else
+	m_readyFirst = transaction->m_readyNext;
+    if (transaction->m_readyNext)
+	transaction->m_readyNext->m_readyPrev = transaction->m_readyPrev;
+    else
+	m_readyLast = transaction->m_readyPrev;
+    transaction->m_ready = false;
+    transaction->m_readyPrev = 0;
+    transaction->m_readyNext = 0;
+}
+
+// Move a heap entry toward the root while it expires earlier than its parent
+void SIPEngine::timerUp(unsigned int pos)
+{
+    SIPTransaction* t = m_timers[pos];
+    while (pos) {
+	unsigned int parent = (pos - 1) / 2;
+	if (m_timers[parent]->m_timeout <= t->m_timeout)
+	    break;
+	m_timers[pos] = m_timers[parent];
+	m_timers[pos]->m_timerPos = pos;
+	pos = parent;
+    }
+    m_timers[pos] = t;
+    t->m_timerPos = pos;
+}
+
+// Move a heap entry toward the leaves while it expires later than a child
+void SIPEngine::timerDown(unsigned int pos)
+{
+    SIPTransaction* t = m_timers[pos];
+    for (;;) {
+	unsigned int child = 2 * pos + 1;
+	if (child >= m_timersCount)
+	    break;
+	if ((child + 1 < m_timersCount) &&
+		(m_timers[child + 1]->m_timeout < m_timers[child]->m_timeout))
+	    child++;
+	if (t->m_timeout <= m_timers[child]->m_timeout)
+	    break;
+	m_timers[pos] = m_timers[child];
+	m_timers[pos]->m_timerPos = pos;
+	pos = child;
+    }
+    m_timers[pos] = t;
+    t->m_timerPos = pos;
+}
+
+void SIPEngine::timerRemove(unsigned int pos)
+{
+    m_timers[pos]->m_timerPos = -1;
+    if (--m_timersCount == pos)
+	return;
+    m_timers[pos] = m_timers[m_timersCount];
+    timerUp(pos);
+    timerDown(m_timers[pos]->m_timerPos);
+}
+
+// Keep each index bucket in the same order as the transaction list
+void SIPEngine::indexAdd(HashList& index, const String& key, SIPTransaction* transaction)
+{
+    int64_t order = transaction->m_order;
+    unsigned int i = key.hash() % index.length();
+    ObjList* l = index.getList(i);
+    if (!l) {
+	index.append(transaction,i)->setDelete(false);
+	return;
+    }
+    for (; l; l = l->next()) {
+	SIPTransaction* t = static_cast<SIPTransaction*>(l->get());
+	if (t && (t->m_order > order))
+	    break;
+    }
+    if (l)
+	l->insert(transaction)->setDelete(false);
+    else
+	index.getList(i)->append(transaction)->setDelete(false);
+}
+
+void SIPEngine::indexTransaction(SIPTransaction* transaction)
+{
+    if (transaction->m_branch)
+	indexAdd(m_transByBranch,transaction->m_branch,transaction);
+    indexAdd(m_transByCallId,transaction->m_callid,transaction);
+}
+
+void SIPEngine::unindexTransaction(SIPTransaction* transaction)
+{
+    ObjList* l = transaction->m_branch ? m_transByBranch.getHashList(transaction->m_branch) : 0;
+    if (l)
+	l->remove(transaction,false);
+    l = m_transByCallId.getHashList(transaction->m_callid);
+    if (l)
+	l->remove(transaction,false);
+}
+
 void SIPEngine::processEvent(SIPEvent *event)
 {
     if (!event)
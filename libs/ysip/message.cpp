@@ -29,6 +29,142 @@ using namespace TelEngine;
 
 static Regexp s_angled("<\\([^>]\\+\\)>");
 
+// Header names that get special handling while parsing
+enum {
+    HdrOther = 0,
+    HdrAuth,
+    HdrContentLength,
+    HdrCSeq,
+};
+
+struct KnownHeader {
+    const char* name;
+    unsigned int len;
+    int id;
+};
+
+// Most often seen header names, received ones that match exactly reuse these
+static const KnownHeader s_knownHeaders[] = {
+    { "Via", 3, HdrOther },
+    { "From", 4, HdrOther },
+    { "To", 2, HdrOther },
+    { "Call-ID", 7, HdrOther },
+    { "CSeq", 4, HdrCSeq },
+    { "Contact", 7, HdrOther },
+    { "Max-Forwards", 12, HdrOther },
+    { "Content-Length", 14, HdrContentLength },
+    { "Content-Type", 12, HdrOther },
+    { "Route", 5, HdrOther },
+    { "Record-Route", 12, HdrOther },
+    { "Allow", 5, HdrOther },
+    { "Supported", 9, HdrOther },
+    { "User-Agent", 10, HdrOther },
+    { "Server", 6, HdrOther },
+    { "Expires", 7, HdrOther },
+    { "Event", 5, HdrOther },
+    { "Authorization", 13, HdrAuth },
+    { "Proxy-Authorization", 19, HdrAuth },
+    { "WWW-Authenticate", 16, HdrAuth },
+    { "Proxy-Authenticate", 18, HdrAuth },
+    { 0, 0, HdrOther }
+};
+
+static inline bool isBlank(char c)
+{
+    return (c == ' ') || (c == '\t');
+}
+
+static inline bool isSpace(char c)
+{
+    return isBlank(c) || (c == '\r') || (c == '\n') || (c == '\v') || (c == '\f');
+}
+
+static inline bool isDigit(char c)
+{
+    return (c >= '0') && (c <= '9');
+}
+
+static inline const char* skipSpaces(const char* s)
+{
+    while (isSpace(*s))
+	s++;
+    return s;
+}
+
+// Length of a SIP/<digit>.<digits> protocol version, 0 if there is none
+static int versionLength(const char* s)
+{
+    if (!((s[0] == 'S' || s[0] == 's') && (s[1] == 'I' || s[1] == 'i') &&
+	(s[2] == 'P' || s[2] == 'p') && (s[3] == '/') &&
+	isDigit(s[4]) && (s[5] == '.') && isDigit(s[6])))
+	return 0;
+    int len = 7;
+    while (isDigit(s[len]))
+	len++;
+    return len;
+}
+
+// Find the next header line in place, skip over its terminator
+// Return false if the line is folded or has NULs and must be unfolded
+static bool headerLine(const char*& buf, int& len, const char*& line, int& lineLen)
+{
+    const char* b = buf;
+    int l = len;
+    while ((l > 0) && (*b != '\r') && (*b != '\n')) {
+	if (!*b)
+	    return false;
+	b++;
+	l--;
+    }
+    lineLen = b - buf;
+    if (l > 0) {
+	// CR is optional but skip over it if exists
+	if ((*b == '\r') && (l > 1) && (b[1] == '\n')) {
+	    b++;
+	    l--;
+	}
+	b++;
+	l--;
+	if (lineLen && (l > 0) && isBlank(*b))
+	    return false;
+    }
+    line = buf;
+    while (lineLen && isBlank(*line)) {
+	line++;
+	lineLen--;
+    }
+    while (lineLen && isBlank(line[lineLen - 1]))
+	lineLen--;
+    buf = b;
+    len = l;
+    return true;
+}
+
+// Classify a header name, return a static copy of it if it's a known one
+//  or the full form of a compact one
+static const char* knownHeader(const char* name, unsigned int len, int& id)
+{
+    id = HdrOther;
+    const char* res = 0;
+    if (len == 1) {
+	char tmp[2] = { name[0], 0 };
+	res = uncompactForm(tmp);
+	if (res == tmp)
+	    return 0;
+	name = res;
+	len = ::strlen(res);
+    }
+    for (const KnownHeader* h = s_knownHeaders; h->name; h++) {
+	if ((h->len != len) || ::strncasecmp(h->name,name,len))
+	    continue;
+	id = h->id;
+	if (!(res || ::strncmp(h->name,name,len)))
+	    res = h->name;
+	break;
+    }
+    return res;
+}
+
 SIPMessage::SIPMessage(const SIPMessage& original)
     : RefObject(),
       version(original.version), method(original.method), uri(original.uri),
@@ -391,35 +527,48 @@ bool SIPMessage::parseFirst(String& line)
     XDebug(DebugAll,"SIPMessage::parse firstline= '%s'",line.c_str());
     if (line.null())
 	return false;
-    static Regexp r("^\\([Ss][Ii][Pp]/[0-9]\\.[0-9]\\+\\)[[:space:]]\\+\\([0-9][0-9][0-9]\\)[[:space:]]\\+\\(.*\\)$");
-    if (line.matches(r)) {
-	// Answer: <version> <code> <reason-phrase>
-	m_answer = true;
-	version = line.matchString(1).toUpper();
-	code = line.matchString(2).toInteger();
-	reason = line.matchString(3);
-	DDebug(DebugAll,"got answer version='%s' code=%d reason='%s'",
-	    version.c_str(),code,reason.c_str());
-    }
-    else {
-	static Regexp r2("^\\([[:alpha:]]\\+\\)[[:space:]]\\+\\([^[:space:]]\\+\\)[[:space:]]\\+\\([Ss][Ii][Pp]/[0-9]\\.[0-9]\\+\\)$");
-	if (line.matches(r2)) {
-	    // Request: <method> <uri> <version>
-	    m_answer = false;
-	    method = line.matchString(1).toUpper();
-	    uri = line.matchString(2);
-	    version = line.matchString(3).toUpper();
-	    DDebug(DebugAll,"got request method='%s' uri='%s' version='%s'",
-		method.c_str(),uri.c_str(),version.c_str());
-	    if (method == YSTRING("ACK"))
-		m_ack = true;
+    const char* s = line.c_str();
+    // Answer: <version> <code> <reason-phrase>
+    int vlen = versionLength(s);
+    if (vlen && isSpace(s[vlen])) {
+	const char* c = skipSpaces(s + vlen);
+	if (isDigit(c[0]) && isDigit(c[1]) && isDigit(c[2]) && isSpace(c[3])) {
+	    m_answer = true;
+	    version.assign(s,vlen).toUpper();
+	    code = 100 * (c[0] - '0') + 10 * (c[1] - '0') + (c[2] - '0');
+	    reason = skipSpaces(c + 3);
+	    DDebug(DebugAll,"got answer version='%s' code=%d reason='%s'",
+		version.c_str(),code,reason.c_str());
+	    return true;
 	}
-	else {
-	    TraceDebug(msgTraceId,DebugAll,"Invalid SIP line '%s'",line.c_str());
-	    return false;
+    }
+    // Request: <method> <uri> <version>
+    const char* m = s;
+    while ((*m >= 'A' && *m <= 'Z') || (*m >= 'a' && *m <= 'z'))
+	m++;
+    if ((m > s) && isSpace(*m)) {
+	const char* u = skipSpaces(m);
+	const char* e = u;
+	while (*e && !isSpace(*e))
+	    e++;
+	if ((e > u) && isSpace(*e)) {
+	    const char* v = skipSpaces(e);
+	    vlen = versionLength(v);
+	    if (vlen && !v[vlen]) {
+		m_answer = false;
+		method.assign(s,m - s).toUpper();
+		uri.assign(u,e - u);
+		version.assign(v,vlen).toUpper();
+		DDebug(DebugAll,"got request method='%s' uri='%s' version='%s'",
+		    method.c_str(),uri.c_str(),version.c_str());
+		if (method == YSTRING("ACK"))
+		    m_ack = true;
+		return true;
+	    }
 	}
     }
-    return true;
+    TraceDebug(msgTraceId,DebugAll,"Invalid SIP line '%s'",line.c_str());
+    return false;
 }
 
 bool SIPMessage::parse(const char* buf, int len, unsigned int* bodyLen)
@@ -441,50 +590,63 @@ bool SIPMessage::parse(const char* buf, int len, unsigned int* bodyLen)
     }
     line->destruct();
     int clen = -1;
+    ObjList* last = &header;
     while (len > 0) {
-	line = MimeBody::getUnfoldedLine(buf,len);
-	if (line->null()) {
+	// Headers are sliced from the buffer, only folded lines are copied
+	const char* hdr = 0;
+	int hlen = 0;
+	String* folded = 0;
+	if (!headerLine(buf,len,hdr,hlen)) {
+	    folded = MimeBody::getUnfoldedLine(buf,len);
+	    hdr = folded->c_str();
+	    hlen = folded->length();
+	}
+	if (!hlen) {
 	    // Found end of headers
-	    line->destruct();
+	    TelEngine::destruct(folded);
 	    break;
 	}
-	int col = line->find(':');
-	if (col <= 0) {
-	    line->destruct();
+	const char* col = (const char*)::memchr(hdr,':',hlen);
+	int nlen = col ? col - hdr : 0;
+	while (nlen && isBlank(hdr[nlen - 1]))
+	    nlen--;
+	if (nlen <= 0) {
+	    TelEngine::destruct(folded);
 	    return false;
 	}
-	String name = line->substr(0,col);
-	name.trimBlanks();
-	if (name.null()) {
-	    line->destruct();
-	    return false;
+	const char* val = col + 1;
+	int vlen = hlen - (val - hdr);
+	while (vlen && isBlank(*val)) {
+	    val++;
+	    vlen--;
 	}
-	name = uncompactForm(name);
-	*line >> ":";
-	line->trimBlanks();
-	XDebug(DebugAll,"SIPMessage::parse header='%s' value='%s'",name.c_str(),line->c_str());
-
-	if ((name &= "WWW-Authenticate") ||
-	    (name &= "Proxy-Authenticate") ||
-	    (name &= "Authorization") ||
-	    (name &= "Proxy-Authorization"))
-	    header.append(new MimeAuthLine(name,*line));
+	int id = HdrOther;
+	const char* known = knownHeader(hdr,nlen,id);
+	String name;
+	if (!known)
+	    name.assign(hdr,nlen);
+	String value(val,vlen);
+	TelEngine::destruct(folded);
+	XDebug(DebugAll,"SIPMessage::parse header='%s' value='%s'",
+	    known ? known : name.c_str(),value.c_str());
+
+	if (id == HdrAuth)
+	    last = last->append(new MimeAuthLine(known ? known : name.c_str(),value));
 	else
-	    header.append(new MimeHeaderLine(name,*line));
+	    last = last->append(new MimeHeaderLine(known ? known : name.c_str(),value));
 
-	if ((clen < 0) && (name &= "Content-Length"))
-	    clen = line->toInteger(-1,10);
-	else if ((m_cseq < 0) && (name &= "CSeq")) {
-	    int sep = line->find(' ');
+	if ((clen < 0) && (id == HdrContentLength))
+	    clen = value.toInteger(-1,10);
+	else if ((m_cseq < 0) && (id == HdrCSeq)) {
+	    int sep = value.find(' ');
 	    if (sep > 0) {
-		m_cseq = line->substr(0,sep).toInteger(-1,10);
+		m_cseq = value.substr(0,sep).toInteger(-1,10);
 		if (m_answer) {
-		    method = line->substr(sep + 1);
+		    method = value.substr(sep + 1);
 		    method.trimBlanks().toUpper();
 		}
 	    }
 	}
-	line->destruct();
     }
     if (!bodyLen) {
 	if (clen >= 0) {
@@ -33,7 +33,9 @@ SIPTransaction::SIPTransaction(SIPMessage* message, SIPEngine* engine, bool outg
       m_response(0), m_timeouts(0), m_timeout(0),
       m_firstMessage(message), m_lastMessage(0), m_pending(0), m_engine(engine), m_private(0),
       m_autoChangeParty(autoChangeParty ? *autoChangeParty : engine->autoChangeParty()),
-      m_autoAck(true), m_silent(false)
+      m_autoAck(true), m_silent(false),
+      m_order(0), m_timerPos(-1), m_ready(false), m_readyPrev(0), m_readyNext(0),
+      m_listPrev(0), m_listNext(0)
 {
     DDebug(getEngine(),DebugAll,"SIPTransaction::SIPTransaction(%p,%p,%d) [%p]",
 	message,engine,outgoing,this);
@@ -88,7 +90,9 @@ SIPTransaction::SIPTransaction(SIPTransaction& original, SIPMessage* answer)
       m_pending(0), m_engine(original.m_engine),
       m_branch(original.m_branch), m_callid(original.m_callid), m_tag(original.m_tag),
       m_private(0), m_autoChangeParty(original.m_autoChangeParty),
-      m_autoAck(original.m_autoAck), m_silent(original.m_silent), m_traceId(original.traceId())
+      m_autoAck(original.m_autoAck), m_silent(original.m_silent), m_traceId(original.traceId()),
+      m_order(0), m_timerPos(-1), m_ready(false), m_readyPrev(0), m_readyNext(0),
+      m_listPrev(0), m_listNext(0)
 {
     DDebug(getEngine(),DebugAll,"SIPTransaction::SIPTransaction(&%p,%p) [%p]",
 	&original,answer,this);
@@ -98,6 +102,9 @@ SIPTransaction::SIPTransaction(SIPTransaction& original, SIPMessage* answer)
     m_firstMessage->setAutoAuth();
     msg->complete(m_engine);
     msg->addHeader(auth);
+    // the original transaction changes branch so it must be indexed again
+    Lock lck(m_engine);
+    m_engine->unindexTransaction(&original);
     const NamedString* ns = msg->getParam("Via","branch",true);
     if (ns)
 	original.m_branch = *ns;
@@ -110,6 +117,8 @@ SIPTransaction::SIPTransaction(SIPTransaction& original, SIPMessage* answer)
 	original.m_tag.clear();
     original.m_firstMessage = msg;
     original.m_lastMessage = 0;
+    m_engine->indexTransaction(&original);
+    lck.drop();
 
 #ifdef SIP_ACK_AFTER_NEW_INVITE
     // if this transaction is an INVITE and we append it to the list its
@@ -134,7 +143,9 @@ SIPTransaction::SIPTransaction(const SIPTransaction& original, const String& tag
       m_pending(0), m_engine(original.m_engine),
       m_branch(original.m_branch), m_callid(original.m_callid), m_tag(tag),
       m_private(0), m_autoChangeParty(original.m_autoChangeParty),
-      m_autoAck(original.m_autoAck), m_silent(original.m_silent), m_traceId(original.traceId())
+      m_autoAck(original.m_autoAck), m_silent(original.m_silent), m_traceId(original.traceId()),
+      m_order(0), m_timerPos(-1), m_ready(false), m_readyPrev(0), m_readyNext(0),
+      m_listPrev(0), m_listNext(0)
 {
     if (m_firstMessage)
 	m_firstMessage->ref();
@@ -199,9 +210,17 @@ bool SIPTransaction::changeState(int newstate)
     DDebug(getEngine(),DebugAll,"SIPTransaction state changed from %s to %s [%p]",
 	stateName(m_state),stateName(newstate),this);
     m_state = newstate;
+    // a new state may produce an event without waiting for a timer
+    m_engine->transReady(this);
     return true;
 }
 
+void SIPTransaction::setTransmit()
+{
+    m_transmit = true;
+    m_engine->transReady(this);
+}
+
 void SIPTransaction::setDialogTag(const char* tag)
 {
     if (null(tag)) {
@@ -245,6 +264,8 @@ void SIPTransaction::setPendingEvent(SIPEvent* event, bool replace)
 	    delete event;
     else
 	m_pending = event;
+    if (m_pending)
+	m_engine->transReady(this);
 }
 
 void SIPTransaction::setTransCount(int count)
@@ -264,6 +285,7 @@ void SIPTransaction::setTimeout(u_int64_t delay, unsigned int count)
     m_timeouts = count;
     m_delay = delay;
     m_timeout = (count && delay) ? Time::now() + delay : 0;
+    m_engine->transSchedule(this);
 #ifdef DEBUG
     if (m_timeout)
 	TraceDebugObj(this,getEngine(),DebugAll,"SIPTransaction new %d timeouts initially " FMT64U " usec apart [%p]",
@@ -779,6 +779,7 @@ protected:
  */
 class YSIP_API SIPTransaction : public RefObject
 {
+    friend class SIPEngine;
 public:
     /**
      * Current state of the transaction
@@ -957,8 +958,7 @@ public:
      * Set the (re)transmission flag that allows the latest outgoing message
      *  to be send over the wire
      */
-    inline void setTransmit()
-	{ m_transmit = true; }
+    void setTransmit();
 
     /**
      * Change transaction status to Cleared
@@ -1213,6 +1213,14 @@ protected:
     bool m_autoAck;
     bool m_silent;
     String m_traceId;
+private:
+    int64_t m_order;
+    int m_timerPos;
+    bool m_ready;
+    SIPTransaction* m_readyPrev;
+    SIPTransaction* m_readyNext;
+    SIPTransaction* m_listPrev;
+    SIPTransaction* m_listNext;
 };
 
 /**
@@ -1311,6 +1319,7 @@ protected:
  */
 class YSIP_API SIPEngine : public DebugEnabler, public Mutex
 {
+    friend class SIPTransaction;
 public:
     /**
      * Create the SIP Engine
@@ -1403,9 +1412,9 @@ public:
 
     /**
      * Get a SIPEvent from the queue.
-     * This method mainly looks into the transaction list and get all kind of
-     * events, like an incoming request (INVITE, REGISTRATION), a timer, an
-     * outgoing message.
+     * This method looks only at the transactions that were marked ready or
+     * whose timer expired and gets all kind of events, like an incoming
+     * request (INVITE, REGISTRATION), a timer, an outgoing message.
      * This method is thread safe
      */
     SIPEvent *getEvent();
@@ -1588,35 +1597,71 @@ public:
      * Remove a transaction from the list without dereferencing it
      * @param transaction Pointer to transaction to remove
      */
-    inline void remove(SIPTransaction* transaction)
-	{ lock(); m_transList.remove(transaction,false); unlock(); }
+    void remove(SIPTransaction* transaction);
 
     /**
      * Append a transaction to the end of the list
      * @param transaction Pointer to transaction to append
      */
-    inline void append(SIPTransaction* transaction)
-	{ lock(); m_transList.append(transaction); unlock(); }
+    void append(SIPTransaction* transaction);
 
     /**
      * Insert a transaction at the start of the list
      * @param transaction Pointer to transaction to insert
      */
-    inline void insert(SIPTransaction* transaction)
-	{ lock(); m_transList.insert(transaction); unlock(); }
+    void insert(SIPTransaction* transaction);
+
+    /**
+     * Remove and dereference all transactions
+     */
+    void clearTransactions();
 
     /**
      * Get the number of active SIP transactions
      * @return Count of transactions in the list
      */
     inline unsigned int transactionCount()
-	{ Lock mylock(this); return m_transList.count(); }
+	{ Lock mylock(this); return m_listCount; }
 
 protected:
     /**
-     * The list that holds all the SIP transactions.
+     * Get the first transaction in the list of all transactions,
+     *  must be called with the engine locked
+     * @return Pointer to the first transaction, NULL if the list is empty
+     */
+    inline SIPTransaction* firstTransaction() const
+	{ return m_listFirst; }
+
+    /**
+     * Get the transaction following another in the list of all transactions,
+     *  must be called with the engine locked
+     * @param transaction Pointer to a transaction in the list
+     * @return Pointer to the next transaction, NULL if it was the last one
+     */
+    static inline SIPTransaction* nextTransaction(const SIPTransaction* transaction)
+	{ return transaction->m_listNext; }
+
+    /**
+     * Index of the transactions by RFC 3261 Via branch
      */
-    ObjList m_transList;
+    HashList m_transByBranch;
+
+    /**
+     * Index of the transactions by Call-ID
+     */
+    HashList m_transByCallId;
+
+    /**
+     * Add a transaction to the indexes, must be called with the engine locked
+     * @param transaction Pointer to transaction to index
+     */
+    void indexTransaction(SIPTransaction* transaction);
+
+    /**
+     * Remove a transaction from the indexes, must be called with the engine locked
+     * @param transaction Pointer to transaction to remove from indexes
+     */
+    void unindexTransaction(SIPTransaction* transaction);
 
     u_int64_t m_t1;
     u_int64_t m_t4;
@@ -1634,6 +1679,25 @@ protected:
     u_int32_t m_nonce_time;
     Mutex m_nonce_mutex;
     bool m_autoChangeParty;
+    int64_t m_transFirst;
+    int64_t m_transLast;
+private:
+    static void indexAdd(HashList& index, const String& key, SIPTransaction* transaction);
+    void transReady(SIPTransaction* transaction);
+    void transSchedule(SIPTransaction* transaction);
+    void transUnschedule(SIPTransaction* transaction);
+    bool transUnlink(SIPTransaction* transaction);
+    void timerUp(unsigned int pos);
+    void timerDown(unsigned int pos);
+    void timerRemove(unsigned int pos);
+    SIPTransaction* m_listFirst;
+    SIPTransaction* m_listLast;
+    unsigned int m_listCount;
+    SIPTransaction* m_readyFirst;
+    SIPTransaction* m_readyLast;
+    SIPTransaction** m_timers;
+    unsigned int m_timersCount;
+    unsigned int m_timersAlloc;
 };
 
 }
@@ -649,8 +649,12 @@ void AnalyzerChan::checkTimers(Message& msg, const Time& tmr)
 {
     if (m_stopTime && (m_stopTime < tmr))
 	msgDrop(msg,"finished");
-    else
+    else {
 	Channel::checkTimers(msg,tmr);
+	// our own timer is not known to the driver, keep it scheduled
+	if (m_stopTime)
+	    scheduleTimers(m_stopTime);
+    }
 }
 
 void AnalyzerChan::startChannel(NamedList& params)
@@ -678,8 +682,10 @@ void AnalyzerChan::startChannel(NamedList& params)
 void AnalyzerChan::setDuration(NamedList& params)
 {
     int t = params.getIntValue("duration",120000);
-    if (t > 0)
+    if (t > 0) {
 	m_stopTime = Time::now() + 1000 * (uint64_t)t;
+	scheduleTimers(m_stopTime);
+    }
 }
 
 void AnalyzerChan::addSource()
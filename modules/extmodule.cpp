@@ -31,6 +31,7 @@
 
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <poll.h>
 #endif
 
 #include <string.h>
@@ -57,9 +58,15 @@ namespace { // anonymous
 // Default message timeout in milliseconds
 #define MSG_TIMEOUT 10000
 
+// Size of the hash of messages waiting for an answer
+#define WAITING_HASH 31
+
 // Safety wait time after we flushed watchers, relays or messages (in ms)
 #define WAIT_FLUSH 5
 
+// Maximum number of parameter names interned per direction in binary framing
+#define MAX_INTERNED 4096
+
 static Configuration s_cfg;
 static ObjList s_chans;
 static ObjList s_modules;
@@ -76,6 +83,10 @@ static bool s_execPrintf = false;
 static AtomicUInt s_recvCleanupWaitPid;
 static AtomicUInt s_recvDieWaitPid;
 
+// Upper limits (in ms) of message answer latency histogram buckets
+static const unsigned int s_latency[] = { 1, 10, 100, 1000 };
+#define LATENCY_BUCKETS (sizeof(s_latency) / sizeof(s_latency[0]) + 1)
+
 static const char* s_cmds[] = {
     "info",
     "start",
@@ -96,6 +107,71 @@ static inline unsigned int idleIntervals(unsigned int ms)
     return Thread::idleMsec() ? ((ms + Thread::idleMsec() - 1) / Thread::idleMsec()) : 0;
 }
 
+// Binary framing, negotiated by the script with %%>setlocal:framing:binary
+// Each frame is a 4 octet network order length followed by the payload
+// The first octet of the payload selects its type:
+//  'T' - a text protocol line without the line terminator
+//  '>' - message: id, time, name, retvalue, parameters
+//  '<' - answer: id, processed octet, name, retvalue, parameters
+// Numbers are sent in groups of 7 bits, least significant first, with the
+//  high bit set if more groups follow. Strings are a length number followed
+//  by the raw, unescaped octets
+// Parameters are a count followed by a name reference and a value for each
+//  of them. Name reference 0 is followed by the name string which also gets
+//  the next free index (starting from 1) while the table is not full
+// Value 0 clears the parameter, value N+1 is followed by N octets
+
+static inline void putNumber(DataBlock& buf, unsigned int val)
+{
+    while (val >= 0x80) {
+	buf.append1((uint8_t)(val | 0x80));
+	val >>= 7;
+    }
+    buf.append1((uint8_t)val);
+}
+
+static inline void putString(DataBlock& buf, const String& str)
+{
+    putNumber(buf,str.length());
+    buf.append(str);
+}
+
+// Parameter name interned in the table of an outgoing direction
+class ExtName : public String
+{
+public:
+    inline ExtName(const String& name, unsigned int index)
+	: String(name), m_index(index)
+	{ }
+    inline unsigned int index() const
+	{ return m_index; }
+private:
+    unsigned int m_index;
+};
+
+// Bounds checked reader of a binary frame payload
+class ExtFrameReader
+{
+public:
+    inline ExtFrameReader(const unsigned char* data, unsigned int len)
+	: m_data(data), m_len(len), m_pos(0), m_ok(true)
+	{ }
+    inline bool ok() const
+	{ return m_ok; }
+    inline bool atEnd() const
+	{ return m_pos >= m_len; }
+    unsigned int getByte();
+    unsigned int getNumber();
+    bool getData(String& str, unsigned int len);
+    inline bool getString(String& str)
+	{ return getData(str,getNumber()); }
+private:
+    const unsigned char* m_data;
+    unsigned int m_len;
+    unsigned int m_pos;
+    bool m_ok;
+};
+
 class ExtModSource : public ThreadedSource
 {
 public:
@@ -182,6 +258,8 @@ public:
 	{ return m_receiver == recv; }
     inline int decode(const char* str)
 	{ return Message::decode(str,m_id); }
+    inline void setId(const String& id)
+	{ m_id = id; }
     inline const String& id() const
 	{ return m_id; }
 private:
@@ -197,9 +275,12 @@ public:
     Message &m_msg;
     bool m_ret;
     String m_id;
+    u_int64_t m_sent;
     bool decode(const char *s);
     inline const Message* msg() const
 	{ return &m_msg; }
+    virtual const String& toString() const
+	{ return m_id; }
 };
 
 // Yet Another of Maciek's ideas
@@ -231,13 +312,15 @@ public:
     };
     static ExtModReceiver* build(const char *script, const char *args, bool ref = false,
 	File* ain = 0, File* aout = 0, ExtModChan *chan = 0);
-    static ExtModReceiver* build(const char* name, Stream* io, ExtModChan* chan = 0,
+    static ExtModReceiver* build(const char* name, Socket* io, ExtModChan* chan = 0,
 	int role = RoleUnknown, const char* conn = 0);
     static ExtModReceiver* find(const String& script, const String& arg);
     virtual void destruct();
     virtual bool received(Message& msg, int id);
     bool processLine(const char* line);
-    bool outputLine(const char* line);
+    bool processFrame(const unsigned char* data, unsigned int len);
+    bool outputLine(const char* line, bool binAfter = false);
+    bool outputMessage(const Message& msg, const char* id, bool answer = false, bool accepted = false);
     void reportError(const char* line);
     void returnMsg(const Message* msg, const char* id, bool accepted);
     bool addWatched(const String& name);
@@ -266,27 +349,42 @@ public:
     inline const char* desc() const
 	{ return m_desc; }
     void describe(String& rval) const;
+    void statusDetail(String& str) const;
 
 private:
     ExtModReceiver(const char* script, const char* args,
 	File* ain, File* aout, ExtModChan* chan);
-    ExtModReceiver(const char* name, Stream* io, ExtModChan* chan,
+    ExtModReceiver(const char* name, Socket* io, ExtModChan* chan,
 	int role, const char* conn);
     bool create(const char* script, const char* args);
     void closeIn();
     void closeOut();
     void closeAudio();
+    bool output(const char* line, const Message* msg, const char* id,
+	bool answer, bool accepted, bool binAfter);
     bool outputLineInternal(const char* line, int len);
+    bool outputData(const char* data, int len);
+    void encodeFrame(DataBlock& buf, const Message& msg, const char* id, bool answer, bool accepted);
+    bool decodeParams(ExtFrameReader& rd, NamedList& params, ObjList* cleared = 0);
+    void answered(MsgHolder* msg);
+    void enqueue(ExtMessage* m);
     void debugMsgInstResult(bool ok, const char* oper, const char* name, const char* extra = 0);
+    void releaseWaiting();
+    void waitInput();
 
     int m_role;
     bool m_dead;
     bool m_quit;
     int m_use;
     int m_qLength;
+    int m_qPeak;
+    unsigned int m_answered;
+    unsigned int m_timedOut;
+    unsigned int m_latency[LATENCY_BUCKETS];
     pid_t m_pid;
     Stream* m_in;
     Stream* m_out;
+    int m_inHandle;
     File* m_ain;
     File* m_aout;
     ExtModChan* m_chan;
@@ -296,6 +394,8 @@ private:
     bool m_setdata;
     bool m_settime;
     bool m_writing;
+    bool m_binIn;
+    bool m_binOut;
     int m_maxQueue;
     int m_timeout;
     bool m_timebomb;
@@ -303,7 +403,10 @@ private:
     bool m_scripted;
     DataBlock m_buffer;
     String m_script, m_args;
-    ObjList m_waiting;
+    HashList m_waiting;
+    HashList m_outNames;
+    unsigned int m_outCount;
+    ObjVector m_inNames;
     ObjList m_relays;
     String m_trackName;
     String m_reason;
@@ -339,6 +442,7 @@ protected:
     virtual bool commandExecute(String& retVal, const String& line);
     virtual bool commandComplete(Message& msg, const String& partLine, const String& partWord);
     virtual void statusParams(String& str);
+    virtual void statusDetail(String& str);
     virtual bool received(Message& msg, int id);
     void cleanup(bool fromDestruct = false);
 
@@ -642,7 +746,8 @@ void ExtModChan::disconnected(bool final, const char *reason)
 
 
 MsgHolder::MsgHolder(Message &msg)
-    : m_msg(msg), m_ret(false)
+    : Semaphore(1,"ExtModMsg",0),
+      m_msg(msg), m_ret(false), m_sent(0)
 {
     // the address of this object should be unique
     char buf[64];
@@ -656,6 +761,40 @@ bool MsgHolder::decode(const char *s)
 }
 
 
+unsigned int ExtFrameReader::getByte()
+{
+    if (m_pos < m_len)
+	return m_data[m_pos++];
+    m_ok = false;
+    return 0;
+}
+
+unsigned int ExtFrameReader::getNumber()
+{
+    unsigned int val = 0;
+    for (unsigned int shift = 0; shift < 32; shift += 7) {
+	unsigned int b = getByte();
+	val |= (b & 0x7f) << shift;
+	if (!(b & 0x80))
+	    return val;
+    }
+    m_ok = false;
+    return 0;
+}
+
+bool ExtFrameReader::getData(String& str, unsigned int len)
+{
+    if (!m_ok || (len > m_len - m_pos)) {
+	m_ok = false;
+	str.clear();
+	return false;
+    }
+    str.assign((const char*)m_data + m_pos,len);
+    m_pos += len;
+    return true;
+}
+
+
 ExtMessage::~ExtMessage()
 {
     if (m_receiver) {
@@ -769,7 +908,7 @@ ExtModReceiver* ExtModReceiver::build(const char* script, const char* args, bool
     return recv->start() ? recv : 0;
 }
 
-ExtModReceiver* ExtModReceiver::build(const char* name, Stream* io, ExtModChan* chan,
+ExtModReceiver* ExtModReceiver::build(const char* name, Socket* io, ExtModChan* chan,
     int role, const char* conn)
 {
     ExtModReceiver* recv = new ExtModReceiver(name,io,chan,role,conn);
@@ -812,13 +951,18 @@ bool ExtModReceiver::unuse()
 
 ExtModReceiver::ExtModReceiver(const char* script, const char* args, File* ain, File* aout, ExtModChan* chan)
     : Mutex(true,"ExtModReceiver"),
-      m_role(RoleUnknown), m_dead(false), m_quit(false), m_use(1), m_qLength(0), m_pid(-1),
-      m_in(0), m_out(0), m_ain(ain), m_aout(aout),
+      m_role(RoleUnknown), m_dead(false), m_quit(false), m_use(1),
+      m_qLength(0), m_qPeak(0), m_answered(0), m_timedOut(0), m_pid(-1),
+      m_in(0), m_out(0), m_inHandle(-1), m_ain(ain), m_aout(aout),
       m_chan(chan), m_watcher(0),
       m_selfWatch(false), m_reenter(false), m_setdata(true), m_settime(s_settime), m_writing(false),
+      m_binIn(false), m_binOut(false),
       m_maxQueue(s_maxQueue), m_timeout(s_timeout), m_timebomb(s_timebomb), m_restart(false), m_scripted(false),
-      m_buffer(0,DEF_INCOMING_LINE), m_script(script), m_args(args), m_trackName(s_trackName)
+      m_buffer(0,DEF_INCOMING_LINE), m_script(script), m_args(args),
+      m_waiting(WAITING_HASH), m_outNames(WAITING_HASH), m_outCount(0),
+      m_inNames(true,64), m_trackName(s_trackName)
 {
+    ::memset(m_latency,0,sizeof(m_latency));
     debugChain(&__plugin);
     debugName(m_script);
     m_script.trimBlanks();
@@ -831,15 +975,20 @@ ExtModReceiver::ExtModReceiver(const char* script, const char* args, File* ain,
     s_mutex.unlock();
 }
 
-ExtModReceiver::ExtModReceiver(const char* name, Stream* io, ExtModChan* chan, int role, const char* conn)
+ExtModReceiver::ExtModReceiver(const char* name, Socket* io, ExtModChan* chan, int role, const char* conn)
     : Mutex(true,"ExtModReceiver"),
-      m_role(role), m_dead(false), m_quit(false), m_use(1), m_qLength(0), m_pid(-1),
-      m_in(io), m_out(io), m_ain(0), m_aout(0),
+      m_role(role), m_dead(false), m_quit(false), m_use(1),
+      m_qLength(0), m_qPeak(0), m_answered(0), m_timedOut(0), m_pid(-1),
+      m_in(io), m_out(io), m_inHandle(io ? (int)io->handle() : -1), m_ain(0), m_aout(0),
       m_chan(chan), m_watcher(0),
       m_selfWatch(false), m_reenter(false), m_setdata(true), m_settime(s_settime), m_writing(false),
+      m_binIn(false), m_binOut(false),
       m_maxQueue(s_maxQueue), m_timeout(s_timeout), m_timebomb(s_timebomb), m_restart(false), m_scripted(false),
-      m_buffer(0,DEF_INCOMING_LINE), m_script(name), m_args(conn), m_trackName(s_trackName)
+      m_buffer(0,DEF_INCOMING_LINE), m_script(name), m_args(conn),
+      m_waiting(WAITING_HASH), m_outNames(WAITING_HASH), m_outCount(0),
+      m_inNames(true,64), m_trackName(s_trackName)
 {
+    ::memset(m_latency,0,sizeof(m_latency));
     debugChain(&__plugin);
     debugName(m_script);
     m_script.trimBlanks();
@@ -946,9 +1095,9 @@ bool ExtModReceiver::flush()
 	    p->setDelete(false);
     }
     bool flushed = false;
-    if (m_waiting.get()) {
+    if (m_waiting.count()) {
 	Debug(&__plugin,DebugInfo,"%s releasing %u pending messages [%p]",desc(),m_qLength,this);
-	m_waiting.clear();
+	releaseWaiting();
 	m_qLength = 0;
 	needWait = flushed = true;
     }
@@ -1024,6 +1173,37 @@ void ExtModReceiver::die(bool clearChan)
     unuse();
 }
 
+// Wake up all threads waiting for answers, they will find their message is gone
+// Must be called with the receiver locked
+void ExtModReceiver::releaseWaiting()
+{
+    for (unsigned int i = 0; i < m_waiting.length(); i++) {
+	ObjList* l = m_waiting.getList(i);
+	if (!l)
+	    continue;
+	for (l = l->skipNull(); l; l = l->skipNext())
+	    static_cast<MsgHolder*>(l->get())->unlock();
+    }
+    m_waiting.clear();
+}
+
+// Sleep until the script sends something but no longer than an idle interval
+// Answers are picked up as soon as they arrive instead of on the next idle tick
+void ExtModReceiver::waitInput()
+{
+#ifndef _WINDOWS
+    if (m_inHandle >= 0) {
+	struct pollfd pfd;
+	pfd.fd = m_inHandle;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	if (::poll(&pfd,1,Thread::idleMsec()) >= 0)
+	    return;
+    }
+#endif
+    Thread::idle();
+}
+
 bool ExtModReceiver::received(Message &msg, int id)
 {
     if (m_dead || m_quit)
@@ -1055,8 +1235,11 @@ bool ExtModReceiver::received(Message &msg, int id)
     bool fail = false;
     u_int64_t tout = (m_timeout > 0) ? Time::now() + 1000 * m_timeout : 0;
     MsgHolder h(msg);
-    if (outputLine(msg.encode(h.m_id))) {
+    h.m_sent = Time::now();
+    if (outputMessage(msg,h.m_id)) {
 	m_qLength++;
+	if (m_qPeak < m_qLength)
+	    m_qPeak = m_qLength;
 	m_waiting.append(&h)->setDelete(false);
 	DDebug(&__plugin,DebugAll,"%s queued message #%u %p '%s' [%p]",desc(),m_qLength,&msg,msg.c_str(),this);
     }
@@ -1066,19 +1249,24 @@ bool ExtModReceiver::received(Message &msg, int id)
 	fail = true;
     }
     unlock();
-    // would be nice to lock the MsgHolder and wait for it to unlock from some
-    //  other thread - unfortunately this does not work with all mutexes
-    // sorry, Maciek - have to do it work in Windows too :-(
+    // The holder is a semaphore created locked, whoever removes it from the
+    //  waiting list unlocks it so sleep until then or until the timeout
     while (ok) {
-	h.lock(Thread::idleUsec());
+	long maxwait = -1;
+	if (tout) {
+	    u_int64_t now = Time::now();
+	    maxwait = (tout > now) ? (long)(tout - now) : 0;
+	}
+	h.lock(maxwait);
 	lock();
-	ok = (m_waiting.find(&h) != 0);
+	ok = (m_waiting.find(h.m_id) != 0);
 	if (ok && tout && (Time::now() > tout)) {
 	    Alarm(&__plugin,"performance",DebugWarn,
 		"%s message %p '%s' did not return in %d msec [%p]"
 		,desc(),&msg,msg.c_str(),m_timeout,this);
-	    if (m_waiting.remove(&h,false) && (m_qLength > 0))
+	    if (m_waiting.remove(&h,false,true) && (m_qLength > 0))
 		m_qLength--;
+	    m_timedOut++;
 	    ok = false;
 	    fail = true;
 	}
@@ -1165,6 +1353,7 @@ bool ExtModReceiver::create(const char *script, const char *args)
 	Debug(&__plugin,DebugInfo,"Launched external script %s",info.safe());
     m_in = new File(ext2yate[0]);
     m_out = new File(yate2ext[1]);
+    m_inHandle = ext2yate[0];
 
     // close what we're not using in the parent
     close(ext2yate[1]);
@@ -1262,7 +1451,7 @@ void ExtModReceiver::run()
 	    Lock mylock(this);
 	    if (m_in && m_in->canRetry()) {
 		mylock.drop();
-		Thread::idle();
+		waitInput();
 		continue;
 	    }
 	    if (!m_quit)
@@ -1278,20 +1467,23 @@ void ExtModReceiver::run()
 	}
 	buffer[totalsize] = 0;
 	for (;;) {
-	    char *eoline = ::strchr(buffer,'\n');
-	    if (!eoline && ((int)::strlen(buffer) < totalsize))
-		eoline=buffer+::strlen(buffer);
-	    if (!eoline)
-		break;
-	    *eoline = 0;
-	    if ((eoline > buffer) && (eoline[-1] == '\r'))
-		eoline[-1] = 0;
-	    readsize = eoline-buffer+1;
-	    if (buffer[0]) {
-		invalid = invalid && (buffer[0] != '%' || buffer[1] != '%');
+	    if (m_binIn) {
+		// binary framing, wait for the length and the entire payload
+		if (totalsize < 4)
+		    break;
+		unsigned int flen = DataBlock::ntoh4((const uint8_t*)buffer);
+		if (!flen || (flen >= m_buffer.length() - 4)) {
+		    Debug(&__plugin,DebugWarn,"%s invalid frame length %u for buffer of length %u, closing [%p]",
+			desc(),flen,m_buffer.length(),this);
+		    return;
+		}
+		if (flen + 4 > (unsigned int)totalsize)
+		    break;
+		readsize = flen + 4;
+		invalid = false;
 		if (!use())
 		    return;
-		bool goOut = processLine(buffer);
+		bool goOut = processFrame((const unsigned char*)buffer + 4,flen);
 		if (unuse() || goOut)
 		    return;
 		if (totalsize >= (int)m_buffer.length()) {
@@ -1300,6 +1492,30 @@ void ExtModReceiver::run()
 		    return;
 		}
 	    }
+	    else {
+		char *eoline = ::strchr(buffer,'\n');
+		if (!eoline && ((int)::strlen(buffer) < totalsize))
+		    eoline=buffer+::strlen(buffer);
+		if (!eoline)
+		    break;
+		*eoline = 0;
+		if ((eoline > buffer) && (eoline[-1] == '\r'))
+		    eoline[-1] = 0;
+		readsize = eoline-buffer+1;
+		if (buffer[0]) {
+		    invalid = invalid && (buffer[0] != '%' || buffer[1] != '%');
+		    if (!use())
+			return;
+		    bool goOut = processLine(buffer);
+		    if (unuse() || goOut)
+			return;
+		    if (totalsize >= (int)m_buffer.length()) {
+			Debug(&__plugin,DebugWarn,"%s lost data shrinking read buffer to %u, closing [%p]",
+			    desc(),m_buffer.length(),this);
+			return;
+		    }
+		}
+	    }
 	    totalsize -= readsize;
 	    buffer = static_cast<char*>(m_buffer.data());
 	    ::memmove(buffer,buffer+readsize,totalsize+1);
@@ -1308,11 +1524,24 @@ void ExtModReceiver::run()
     }
 }
 
-bool ExtModReceiver::outputLine(const char* line)
+bool ExtModReceiver::outputLine(const char* line, bool binAfter)
 {
     if (TelEngine::null(line))
 	return true;
-    int len = ::strlen(line);
+    return output(line,0,0,false,false,binAfter);
+}
+
+bool ExtModReceiver::outputMessage(const Message& msg, const char* id, bool answer, bool accepted)
+{
+    return output(0,&msg,id,answer,accepted,false);
+}
+
+// Write either a protocol line or a message in the current framing mode
+// Encoding is done while owning the output so interned names stay in order
+bool ExtModReceiver::output(const char* line, const Message* msg, const char* id,
+    bool answer, bool accepted, bool binAfter)
+{
+    int len = line ? ::strlen(line) : 0;
     if (m_dead || !m_out || !m_out->valid() || !use())
 	return false;
     uint64_t tout = (m_timeout > 0) ? (Time::now() + 1000 * (uint64_t)m_timeout) : 0;
@@ -1329,36 +1558,75 @@ bool ExtModReceiver::outputLine(const char* line)
 	if (tout && tout < Time::now()) {
 	    if (!m_quit)
 		Alarm(&__plugin,"performance",DebugWarn,"%s timeout %d msec for %d characters [%p]",
-		    desc(),m_timeout,len,this);
+		    desc(),m_timeout,(line ? len : (int)msg->length()),this);
 	    unuse();
 	    return false;
 	}
 	mylock.drop();
 	Thread::idle();
     }
-    bool ok = outputLineInternal(line,len);
+    bool ok = false;
+    if (m_binOut) {
+	DataBlock buf(256);
+	if (line) {
+	    buf.append4hton(len + 1);
+	    buf.append1('T');
+	    buf.append(line,len,false);
+	}
+	else
+	    encodeFrame(buf,*msg,id,answer,accepted);
+	ok = outputData((const char*)buf.data(),buf.length());
+    }
+    else if (line)
+	ok = outputLineInternal(line,len);
+    else {
+	String tmp(answer ? msg->encode(accepted,id) : msg->encode(id));
+	ok = outputLineInternal(tmp,tmp.length());
+    }
+    // switch output framing only after the line that negotiated it
+    if (ok && binAfter)
+	m_binOut = true;
     m_writing = false;
     unuse();
     return ok;
 }
 
-bool ExtModReceiver::outputLineInternal(const char* line, int len)
+// Build a binary message or answer frame, intern new parameter names
+void ExtModReceiver::encodeFrame(DataBlock& buf, const Message& msg, const char* id,
+    bool answer, bool accepted)
 {
-    DDebug(&__plugin,DebugAll,"%s outputLine len=%d '%s' [%p]",desc(),len,line,this);
-    // since m_out can be non-blocking (the socket) we have to loop
-    while (m_out && m_out->valid() && (len > 0) && !m_dead) {
-	int w = m_out->writeData(line,len);
-	if (w < 0) {
-	    if (m_dead || !m_out || !m_out->canRetry())
-		return false;
-	}
+    buf.append4hton(0);
+    buf.append1(answer ? '<' : '>');
+    putString(buf,id);
+    if (answer)
+	buf.append1(accepted ? 1 : 0);
+    else
+	putNumber(buf,(unsigned int)msg.msgTime().sec());
+    putString(buf,msg);
+    putString(buf,msg.retValue());
+    putNumber(buf,msg.count());
+    for (const ObjList* l = msg.paramList()->skipNull(); l; l = l->skipNext()) {
+	const NamedString* ns = static_cast<const NamedString*>(l->get());
+	const ExtName* name = static_cast<const ExtName*>(m_outNames[ns->name()]);
+	if (name)
+	    putNumber(buf,name->index());
 	else {
-	    line += w;
-	    len -= w;
+	    putNumber(buf,0);
+	    putString(buf,ns->name());
+	    if (m_outCount < MAX_INTERNED)
+		m_outNames.append(new ExtName(ns->name(),++m_outCount));
 	}
-	if (len > 0)
-	    Thread::idle();
+	putNumber(buf,ns->length() + 1);
+	buf.append(*ns);
     }
+    DataBlock::hton4(buf.data(0,4),buf.length() - 4);
+}
+
+bool ExtModReceiver::outputLineInternal(const char* line, int len)
+{
+    DDebug(&__plugin,DebugAll,"%s outputLine len=%d '%s' [%p]",desc(),len,line,this);
+    if (!outputData(line,len))
+	return false;
     char nl = '\n';
     for (;;) {
 	if (m_dead || !m_out)
@@ -1374,6 +1642,25 @@ bool ExtModReceiver::outputLineInternal(const char* line, int len)
     }
 }
 
+bool ExtModReceiver::outputData(const char* data, int len)
+{
+    // since m_out can be non-blocking (the socket) we have to loop
+    while (m_out && m_out->valid() && (len > 0) && !m_dead) {
+	int w = m_out->writeData(data,len);
+	if (w < 0) {
+	    if (m_dead || !m_out || !m_out->canRetry())
+		return false;
+	}
+	else {
+	    data += w;
+	    len -= w;
+	}
+	if (len > 0)
+	    Thread::idle();
+    }
+    return (len <= 0);
+}
+
 void ExtModReceiver::reportError(const char* line)
 {
     Debug(&__plugin,DebugWarn,"%s error: '%s' [%p]",desc(),line,this);
@@ -1382,8 +1669,7 @@ void ExtModReceiver::reportError(const char* line)
 
 void ExtModReceiver::returnMsg(const Message* msg, const char* id, bool accepted)
 {
-    String ret(msg->encode(accepted,id));
-    if (!outputLine(ret) && m_timebomb)
+    if (!outputMessage(*msg,id,true,accepted) && m_timebomb)
 	die();
 }
 
@@ -1451,24 +1737,16 @@ bool ExtModReceiver::processLine(const char* line)
 		desc(),id.c_str(),this);
 	return true;
     }
-    else if (id.startsWith("%%<message:")) {
+    else if (id.startSkip("%%<message:",false)) {
+	// The answer carries the id we generated, use it to find the message
+	int sep = id.find(':');
+	if (sep >= 0)
+	    id.assign(id.c_str(),sep);
 	Lock mylock(this);
-	ObjList *p = &m_waiting;
-	for (; p; p=p->next()) {
-	    MsgHolder *msg = static_cast<MsgHolder *>(p->get());
-	    if (msg && msg->decode(line)) {
-		DDebug(&__plugin,DebugInfo,"%s matched message %p [%p]",desc(),msg->msg(),this);
-		if (m_chan && (m_chan->waitMsg() == msg->msg())) {
-		    DDebug(&__plugin,DebugNote,"%s entering wait mode on channel %p [%p]",
-			desc(),m_chan,this);
-		    m_chan->waitMsg(0);
-		    m_chan->waiting(true);
-		}
-		msg->unlock();
-		if (p->remove(false) && (m_qLength > 0))
-		    m_qLength--;
-		return false;
-	    }
+	MsgHolder* msg = static_cast<MsgHolder*>(m_waiting[id]);
+	if (msg && msg->decode(line)) {
+	    answered(msg);
+	    return false;
 	}
 	Debug(&__plugin,(m_dead ? DebugInfo : DebugWarn),
 	    "%s unmatched%s message: %s [%p]",desc(),(m_dead ? " dead" : ""),line,this);
@@ -1566,6 +1844,7 @@ bool ExtModReceiver::processLine(const char* line)
 	    val.trimBlanks();
 	    id = id.substr(0,col);
 	    bool ok = false;
+	    bool binary = false;
 	    Lock mylock(this);
 	    if (m_dead)
 		return false;
@@ -1642,6 +1921,14 @@ bool ExtModReceiver::processLine(const char* line)
 		val = m_selfWatch;
 		ok = true;
 	    }
+	    else if (id == "framing") {
+		// switching back to text framing is not supported
+		if (val == YSTRING("binary"))
+		    binary = ok = true;
+		else
+		    ok = val.null() || (!m_binIn && (val == YSTRING("text")));
+		val = (m_binIn || binary) ? "binary" : "text";
+	    }
 	    else if (id.startsWith("engine.")) {
 		// keep the index in substr in sync with length of "engine."
 		const NamedString* param = Engine::runParams().getParam(id.substr(7));
@@ -1696,7 +1983,10 @@ bool ExtModReceiver::processLine(const char* line)
 		desc(),id.c_str(),val.c_str(),ok ? "ok" : "failed",this);
 	    String out("%%<setlocal:");
 	    out << id << ":" << val << ":" << ok;
-	    outputLine(out);
+	    // the answer is the last text line, both directions are binary after it
+	    outputLine(out,binary);
+	    if (binary)
+		m_binIn = true;
 	    return false;
 	}
     }
@@ -1708,63 +1998,203 @@ bool ExtModReceiver::processLine(const char* line)
     else {
 	ExtMessage* m = new ExtMessage;
 	if (m->decode(line) == -2) {
-	    DDebug(&__plugin,DebugAll,"%s created message %p '%s' [%p]",desc(),m,m->c_str(),this);
-	    lock();
-	    bool note = true;
-	    while (!m_dead && m_chan && m_chan->waiting()) {
-		if (note) {
-		    note = false;
-		    Debug(&__plugin,DebugNote,
-			"%s waiting before enqueueing new message %p '%s' [%p]",
-			desc(),m,m->c_str(),this);
-		}
-		unlock();
-		Thread::yield();
-		if (m_dead) {
-		    m->destruct();
+	    enqueue(m);
+	    return false;
+	}
+	m->destruct();
+    }
+    reportError(line);
+    return false;
+}
+
+// Process a complete binary frame, dispatch text lines to processLine
+bool ExtModReceiver::processFrame(const unsigned char* data, unsigned int len)
+{
+    if (m_dead)
+	return false;
+    if (m_quit)
+	return true;
+    ExtFrameReader rd(data,len);
+    unsigned int type = rd.getByte();
+    if (type == 'T') {
+	String line((const char*)data + 1,len - 1);
+	return processLine(line);
+    }
+    if (type == '<' || type == '>') {
+	String id;
+	rd.getString(id);
+	bool processed = false;
+	unsigned int tm = 0;
+	if (type == '<')
+	    processed = (rd.getByte() != 0);
+	else
+	    tm = rd.getNumber();
+	String name;
+	String retVal;
+	rd.getString(name);
+	rd.getString(retVal);
+	if (type == '<') {
+	    Lock mylock(this);
+	    MsgHolder* msg = static_cast<MsgHolder*>(m_waiting[id]);
+	    // decode even unmatched answers to keep the name table in sync
+	    // changes are applied only after the whole frame was decoded
+	    NamedList params("");
+	    ObjList cleared;
+	    if (decodeParams(rd,params,&cleared)) {
+		if (msg) {
+		    Message& m = msg->m_msg;
+		    for (ObjList* l = cleared.skipNull(); l; l = l->skipNext())
+			m.clearParam(*static_cast<String*>(l->get()));
+		    NamedIterator iter(params);
+		    while (const NamedString* ns = iter.get())
+			m.setParam(ns->name(),*ns);
+		    if (name)
+			m = name;
+		    m.retValue() = retVal;
+		    msg->m_ret = processed;
+		    answered(msg);
 		    return false;
 		}
-		lock();
-	    }
-	    ExtModChan* chan = 0;
-	    if ((m_role == RoleChannel) && !m_chan && m_setdata && (*m == "call.execute")) {
-		// we delayed channel creation as there was nothing to ref() it
-		chan = new ExtModChan(this);
-		m_chan = chan;
-		m->setParam("id",chan->id());
+		Debug(&__plugin,(m_dead ? DebugInfo : DebugWarn),
+		    "%s unmatched%s message: '%s' [%p]",desc(),(m_dead ? " dead" : ""),id.c_str(),this);
+		return false;
 	    }
-	    if (m_setdata)
-		m->userData(m_chan);
-	    // now the newly created channel is referenced by the message
-	    if (chan)
-		chan->deref();
-	    id = m->id();
-	    if (id && !chan) {
-		// Copy the user data pointer from waiting message with same id
-		ObjList *p = &m_waiting;
-		for (; p; p=p->next()) {
-		    MsgHolder *h = static_cast<MsgHolder *>(p->get());
-		    if (h && (h->m_id == id)) {
-			RefObject* ud = h->m_msg.userData();
-			Debug(&__plugin,DebugAll,"%s copying data pointer %p from %p '%s' [%p]",
-			    desc(),ud,h->msg(),h->msg()->c_str(),this);
-			m->userData(ud);
-			break;
-		    }
-		}
+	}
+	else {
+	    ExtMessage* m = new ExtMessage;
+	    if (rd.ok() && name && decodeParams(rd,*m)) {
+		m->setId(id);
+		m->assign(name);
+		m->retValue() = retVal;
+		m->msgTime() = tm ? ((u_int64_t)1000000) * tm : Time::now();
+		enqueue(m);
+		return false;
 	    }
-	    if (m_settime || !m->msgTime())
-		m->msgTime() = Time::now();
-	    m->startup(this);
-	    unlock();
-	    return false;
+	    m->destruct();
 	}
-	m->destruct();
     }
-    reportError(line);
+    Debug(&__plugin,DebugWarn,"%s invalid frame type 0x%02x length %u [%p]",desc(),type,len,this);
+    outputLine("Error in: invalid frame");
     return false;
 }
 
+// Decode binary parameters, updating the interned names table
+// If a cleared list is given removals are collected there instead of applied
+bool ExtModReceiver::decodeParams(ExtFrameReader& rd, NamedList& params, ObjList* cleared)
+{
+    unsigned int n = rd.getNumber();
+    String tmp;
+    String val;
+    while (rd.ok() && n--) {
+	unsigned int ref = rd.getNumber();
+	const String* name = &tmp;
+	if (ref) {
+	    name = static_cast<const String*>(m_inNames.at(ref - 1));
+	    if (!name)
+		return false;
+	}
+	else {
+	    if (!rd.getString(tmp) || tmp.null())
+		return false;
+	    if (m_inNames.length() < MAX_INTERNED)
+		m_inNames.appendObj(new String(tmp));
+	}
+	unsigned int vlen = rd.getNumber();
+	if (!vlen) {
+	    params.clearParam(*name);
+	    if (cleared && !cleared->find(*name))
+		cleared->append(new String(*name));
+	}
+	else if (rd.getData(val,vlen - 1))
+	    params.setParam(*name,val);
+    }
+    return rd.ok() && rd.atEnd();
+}
+
+// Answer matched a waiting message, wake up its dispatcher
+void ExtModReceiver::answered(MsgHolder* msg)
+{
+    DDebug(&__plugin,DebugInfo,"%s matched message %p [%p]",desc(),msg->msg(),this);
+    if (m_chan && (m_chan->waitMsg() == msg->msg())) {
+	DDebug(&__plugin,DebugNote,"%s entering wait mode on channel %p [%p]",
+	    desc(),m_chan,this);
+	m_chan->waitMsg(0);
+	m_chan->waiting(true);
+    }
+    u_int64_t ms = (Time::now() - msg->m_sent) / 1000;
+    unsigned int b = 0;
+    while (b < LATENCY_BUCKETS - 1 && ms >= s_latency[b])
+	b++;
+    m_latency[b]++;
+    m_answered++;
+    m_waiting.remove(msg,false,true);
+    if (m_qLength > 0)
+	m_qLength--;
+    msg->unlock();
+}
+
+// Enqueue a message decoded from the script
+void ExtModReceiver::enqueue(ExtMessage* m)
+{
+    DDebug(&__plugin,DebugAll,"%s created message %p '%s' [%p]",desc(),m,m->c_str(),this);
+    lock();
+    bool note = true;
+    while (!m_dead && m_chan && m_chan->waiting()) {
+	if (note) {
+	    note = false;
+	    Debug(&__plugin,DebugNote,
+		"%s waiting before enqueueing new message %p '%s' [%p]",
+		desc(),m,m->c_str(),this);
+	}
+	unlock();
+	Thread::yield();
+	if (m_dead) {
+	    m->destruct();
+	    return;
+	}
+	lock();
+    }
+    ExtModChan* chan = 0;
+    if ((m_role == RoleChannel) && !m_chan && m_setdata && (*m == "call.execute")) {
+	// we delayed channel creation as there was nothing to ref() it
+	chan = new ExtModChan(this);
+	m_chan = chan;
+	m->setParam("id",chan->id());
+    }
+    if (m_setdata)
+	m->userData(m_chan);
+    // now the newly created channel is referenced by the message
+    if (chan)
+	chan->deref();
+    if (m->id() && !chan) {
+	// Copy the user data pointer from waiting message with same id
+	MsgHolder* h = static_cast<MsgHolder*>(m_waiting[m->id()]);
+	if (h) {
+	    RefObject* ud = h->m_msg.userData();
+	    Debug(&__plugin,DebugAll,"%s copying data pointer %p from %p '%s' [%p]",
+		desc(),ud,h->msg(),h->msg()->c_str(),this);
+	    m->userData(ud);
+	}
+    }
+    if (m_settime || !m->msgTime())
+	m->msgTime() = Time::now();
+    m->startup(this);
+    unlock();
+}
+
+// Append pipelining and answer latency statistics
+// Latency is a histogram of answers under 1, 10, 100, 1000 ms and above
+void ExtModReceiver::statusDetail(String& str) const
+{
+    str.append(m_desc,",") << "=" << m_qLength << "|" << m_maxQueue << "|" << m_qPeak
+	<< "|" << m_answered << "|" << m_timedOut << "|";
+    for (unsigned int i = 0; i < LATENCY_BUCKETS; i++) {
+	if (i)
+	    str << "/";
+	str << m_latency[i];
+    }
+}
+
 void ExtModReceiver::describe(String& rval) const
 {
     rval << "\t";
@@ -2187,6 +2617,14 @@ void ExtModulePlugin::statusParams(String& str)
 {
     Lock lck(s_mutex);
     str << "scripts=" << s_modules.count() << ",chans=" << s_chans.count();
+    str << ",format=Queued|MaxQueue|PeakQueue|Answered|TimedOut|Latency";
+}
+
+void ExtModulePlugin::statusDetail(String& str)
+{
+    Lock lck(s_mutex);
+    for (ObjList* o = s_modules.skipNull(); o; o = o->skipNext())
+	static_cast<ExtModReceiver*>(o->get())->statusDetail(str);
 }
 
 bool ExtModulePlugin::received(Message& msg, int id)
@@ -177,8 +177,11 @@ class ScriptInfo;
 class JsEngineWorker;
 class JsEngine;
 
+class JsWarmWorker;
+
 class JsModule : public ChanAssistList
 {
+    friend class JsWarmWorker;
 public:
     enum {
 	Preroute = AssistPrivate,
@@ -189,6 +192,7 @@ public:
     virtual void initialize();
     virtual void init(int priority);
     virtual ChanAssist* create(Message& msg, const String& id);
+    virtual void msgTimer(Message& msg);
     bool unload();
     virtual bool received(Message& msg, int id);
     virtual bool received(Message& msg, int id, ChanAssist* assist);
@@ -202,7 +206,15 @@ protected:
 private:
     bool evalContext(String& retVal, const String& cmd, ScriptContext* context = 0, ScriptInfo* si = 0);
     void clearPostHook();
+    ScriptRun* warmRunner(int& warm);
+    void warmFill();
+    void warmClear();
+    void warmWake();
+    void warmStop();
+    void warmDone(JsWarmWorker* worker);
     JsParser m_assistCode;
+    ObjList m_warm;
+    JsWarmWorker* m_warmWorker;
     MessagePostHook* m_postHook;
     bool m_started;
 };
@@ -364,6 +376,52 @@ protected:
 
 class JsMessage;
 
+// How much of a routing context was built in advance by the warm pool
+enum JsWarmState {
+    WarmNone = 0,                        // Nothing, build it all on call setup
+    WarmObjects,                         // Built-in objects are present
+    WarmGlobals,                         // Script globals are present too
+};
+
+// Maximum age in msec of a warm context, older ones are rebuilt
+#define WARM_MAX_AGE 10000
+
+// Routing script runner prepared ahead of call setup
+class JsWarmContext : public GenObject
+{
+public:
+    inline JsWarmContext(ScriptRun* runner, int warm)
+	: m_runner(runner), m_warm(warm), m_expire(Time::msecNow() + WARM_MAX_AGE)
+	{ }
+    virtual ~JsWarmContext()
+	{ destroy(m_runner); }
+    inline ScriptRun* take(int& warm)
+	{ ScriptRun* r = m_runner; m_runner = 0; warm = m_warm; return r; }
+    inline bool expired(u_int64_t now) const
+	{ return now > m_expire; }
+    static void destroy(ScriptRun*& runner);
+private:
+    ScriptRun* m_runner;
+    int m_warm;
+    u_int64_t m_expire;
+};
+
+// Thread refilling the warm pool as soon as contexts are taken from it
+class JsWarmWorker : public Thread
+{
+public:
+    inline JsWarmWorker()
+	: Thread("JsWarmPool"), m_wake(1,"JsWarmPool")
+	{ }
+    virtual ~JsWarmWorker();
+    inline void wake()
+	{ m_wake.unlock(); }
+protected:
+    virtual void run();
+private:
+    Semaphore m_wake;
+};
+
 class JsAssist : public ChanAssist, public ScriptInfoHolder
 {
 public:
@@ -388,7 +446,7 @@ public:
     virtual bool msgRoute(Message& msg);
     virtual bool msgDisconnect(Message& msg, const String& reason);
     void msgPostExecute(const Message& msg, bool handled);
-    bool init();
+    bool init(int warm = WarmNone);
     bool evalAllocations(String& retVal, unsigned int top);
     inline State state() const
 	{ return m_state; }
@@ -1071,10 +1129,7 @@ public:
 	: JsObject("Engine",mtx,true),
 	  m_worker(0), m_debugName("javascript")
 	{
-	    if (TelEngine::null(name))
-		m_id.printf("(%p)",this);
-	    else
-		m_id.printf("%s(%p)",name,this);
+	    setName(name);
 	    debugName(m_debugName);
 	    debugChain(&__plugin);
 	    MKDEBUG(Fail);
@@ -1181,6 +1236,13 @@ public:
 	    params().addParam(new ExpFunction("scriptInfo"));
 	}
     static void initialize(ScriptContext* context, const char* name = 0);
+    inline void setName(const char* name)
+	{
+	    if (TelEngine::null(name))
+		m_id.printf("(%p)",this);
+	    else
+		m_id.printf("%s(%p)",name,this);
+	}
     inline void resetWorker()
 	{ m_worker = 0; }
     inline const String& id() const
@@ -2018,6 +2080,8 @@ public:
 	    params().addParam(new ExpFunction("recFile"));
 	}
     static void initialize(ScriptContext* context, JsAssist* assist);
+    inline void setAssist(JsAssist* assist)
+	{ m_assist = assist; }
 protected:
     bool runNative(ObjList& stack, const ExpOperation& oper, GenObject* context);
     void callToRoute(ObjList& stack, const ExpOperation& oper, GenObject* context, const NamedList* params);
@@ -2122,6 +2186,7 @@ static bool s_trackObj = false;
 static unsigned int s_trackCreation = 0;
 static bool s_autoExt = true;
 static unsigned int s_maxFile = 500000;
+static unsigned int s_warmContexts = 0;
 
 const TokenDict ScriptInfo::s_type[] = {
     {"static",  Static},
@@ -2185,7 +2250,8 @@ static bool contextLoad(ScriptRun* runner, const char* name, const char* libs =
 }
 
 // Initialize a script context, populate global objects
-static void contextInit(ScriptRun* runner, const char* name = 0, bool autoExt = s_autoExt, JsAssist* assist = 0)
+static void contextInit(ScriptRun* runner, const char* name = 0, bool autoExt = s_autoExt,
+    JsAssist* assist = 0, bool channel = false)
 {
     if (!runner)
 	return;
@@ -2199,7 +2265,7 @@ static void contextInit(ScriptRun* runner, const char* name = 0, bool autoExt =
 #endif
     JsObject::initialize(ctx);
     JsEngine::initialize(ctx,name);
-    if (assist)
+    if (assist || channel)
 	JsChannel::initialize(ctx,assist);
     // Allow installing singleton handlers for static/dynamic scripts
     // Allow it for the first instance only only if multiple instances are not used or called in the first instance
@@ -2218,6 +2284,22 @@ static void contextInit(ScriptRun* runner, const char* name = 0, bool autoExt =
 	contextLoad(ctx,name);
 }
 
+// Attach a context built by the warm pool to its name and channel assistant
+static void contextBind(ScriptRun* runner, const char* name, JsAssist* assist)
+{
+    ScriptContext* ctx = runner ? runner->context() : 0;
+    if (!ctx)
+	return;
+    Lock mylock(ctx->mutex());
+    NamedList& params = ctx->params();
+    JsEngine* eng = YOBJECT(JsEngine,params.getParam(YSTRING("Engine")));
+    if (eng)
+	eng->setName(name);
+    JsChannel* chan = YOBJECT(JsChannel,params.getParam(YSTRING("Channel")));
+    if (chan)
+	chan->setAssist(assist);
+}
+
 // sort list of object allocations descending
 static int counterSort(GenObject* obj1, GenObject* obj2, void* context)
 {
@@ -5741,7 +5823,7 @@ bool JsConfigFile::runNative(ObjList& stack, const ExpOperation& oper, GenObject
 	if (sect) {
 	    JsArray* jsa = new JsArray(context,oper.lineNumber(),mutex());
 	    int32_t len = 0;
-	    for (const ObjList* l = sect->paramList()->skipNull(); l; l = l->skipNext()) {
+	    for (const ObjList* l = static_cast<const NamedList*>(sect)->paramList()->skipNull(); l; l = l->skipNext()) {
 		jsa->push(new ExpOperation(static_cast<const NamedString*>(l->get())->name()));
 		len++;
 	    }
@@ -5914,7 +5996,7 @@ bool JsConfigSection::runNative(ObjList& stack, const ExpOperation& oper, GenObj
 	if (sect) {
 	    JsArray* jsa = new JsArray(context,oper.lineNumber(),mutex());
 	    int32_t len = 0;
-	    for (const ObjList* l = sect->paramList()->skipNull(); l; l = l->skipNext()) {
+	    for (const ObjList* l = static_cast<const NamedList*>(sect)->paramList()->skipNull(); l; l = l->skipNext()) {
 		jsa->push(new ExpOperation(static_cast<const NamedString*>(l->get())->name()));
 		len++;
 	    }
@@ -6267,7 +6349,7 @@ bool JsXML::runNative(ObjList& stack, const ExpOperation& oper, GenObject* conte
 	    JsObject* jso = YOBJECT(JsObject,name);
 	    if (!jso)
 		return false;
-	    const ObjList* o = jso->params().paramList()->skipNull();
+	    const ObjList* o = static_cast<const JsObject*>(jso)->params().paramList()->skipNull();
 	    for (; o; o = o->skipNext()) {
 		const NamedString* ns = static_cast<const NamedString*>(o->get());
 		if (ns->name() != JsObject::protoName())
@@ -7490,7 +7572,7 @@ void JsJSON::replaceParams(GenObject* obj, const NamedList& params, bool sqlEsc,
     }
     else if (jso) {
 	NamedString* proto = jso->params().getParam(protoName());
-	for (ObjList* o = jso->params().paramList()->skipNull(); o; o = o->skipNext()) {
+	for (ObjList* o = static_cast<const JsObject*>(jso)->params().paramList()->skipNull(); o; o = o->skipNext()) {
 	    NamedString* p = static_cast<NamedString*>(o->get());
 	    if (p != proto)
 		replaceParams(p,params,sqlEsc,extraEsc);
@@ -8158,6 +8240,33 @@ static const TokenDict s_states[] = {
     { 0, 0 }
 };
 
+JsWarmWorker::~JsWarmWorker()
+{
+    __plugin.warmDone(this);
+}
+
+void JsWarmWorker::run()
+{
+    while (!Thread::check(false)) {
+	__plugin.warmFill();
+	// The timer wakes us at least once a second, the wait is bounded anyway
+	m_wake.lock(100000);
+    }
+}
+
+// Release a runner that was never attached to a call, break context references
+void JsWarmContext::destroy(ScriptRun*& runner)
+{
+    if (!runner)
+	return;
+    ScriptContext* context = runner->context();
+    if (context) {
+	Lock mylock(context->mutex());
+	context->params().clearParams();
+    }
+    TelEngine::destruct(runner);
+}
+
 JsAssist::~JsAssist()
 {
     if (m_runner) {
@@ -8187,12 +8296,19 @@ const char* JsAssist::stateName(State st)
     return lookup(st,s_states,"???");
 }
 
-bool JsAssist::init()
+bool JsAssist::init(int warm)
 {
     if (!m_runner)
 	return false;
-    contextInit(m_runner,id(),s_autoExt,this);
-    if (ScriptRun::Invalid == m_runner->reset(true))
+    if (WarmNone == warm)
+	contextInit(m_runner,id(),s_autoExt,this);
+    else {
+	contextBind(m_runner,id(),this);
+	if (WarmObjects == warm && s_autoExt)
+	    contextLoad(m_runner,id());
+    }
+    // Script globals of a fully warmed context are already in place
+    if (ScriptRun::Invalid == m_runner->reset(WarmGlobals != warm))
 	return false;
     ScriptContext* ctx = m_runner->context();
     ctx->trackObjs(s_trackCreation);
@@ -8937,7 +9053,7 @@ static const char* s_cmdsLine = "  javascript {info|eval[=context] instructions.
 
 JsModule::JsModule()
     : ChanAssistList("javascript",true),
-      m_postHook(0), m_started(Engine::started())
+      m_warmWorker(0), m_postHook(0), m_started(Engine::started())
 {
     Output("Loaded module Javascript");
 }
@@ -9332,6 +9448,7 @@ bool JsModule::received(Message& msg, int id)
 	    break;
 	case Halt:
 	    s_engineStop = true;
+	    warmStop();
 	    clearPostHook();
 	    JsGlobal::unloadAll();
 	    return false;
@@ -9355,23 +9472,147 @@ ChanAssist* JsModule::create(Message& msg, const String& id)
 {
     if ((msg == YSTRING("chan.startup")) && (msg[YSTRING("direction")] == YSTRING("outgoing")))
 	return 0;
+    int warm = WarmNone;
     Lock lck(JsGlobal::s_mutex);
-    ScriptRun* runner = m_assistCode.createRunner(0,NATIVE_TITLE);
+    ScriptRun* runner = warmRunner(warm);
     lck.drop();
+    // Replace the taken context right away, a timer refill would not keep up with bursts
+    warmWake();
     if (!runner)
 	return 0;
-    DDebug(this,DebugInfo,"Creating Javascript for '%s'",id.c_str());
+    DDebug(this,DebugInfo,"Creating Javascript for '%s' warm=%d",id.c_str(),warm);
     JsAssist* ca = new JsAssist(this,id,runner);
-    if (ca->init())
+    if (ca->init(warm))
 	return ca;
     TelEngine::destruct(ca);
     return 0;
 }
 
+// Retrieve a routing runner, prefer one from the warm pool
+// Must be called with the global script mutex locked
+ScriptRun* JsModule::warmRunner(int& warm)
+{
+    ScriptCode* code = m_assistCode.code();
+    u_int64_t now = Time::msecNow();
+    for (ObjList* o = m_warm.skipNull(); o; o = m_warm.skipNull()) {
+	JsWarmContext* w = static_cast<JsWarmContext*>(o->remove(false));
+	bool expired = w->expired(now);
+	ScriptRun* runner = w->take(warm);
+	TelEngine::destruct(w);
+	if (runner && code && runner->code() == code && !expired)
+	    return runner;
+	// Routing script was replaced or context is too old
+	JsWarmContext::destroy(runner);
+    }
+    warm = WarmNone;
+    return m_assistCode.createRunner(0,NATIVE_TITLE);
+}
+
+// Build routing contexts in advance up to the configured pool size
+// Called only from the warm pool worker thread
+void JsModule::warmFill()
+{
+    // Drop contexts holding globals from too long ago, destroy them unlocked
+    ObjList old;
+    Lock lck(JsGlobal::s_mutex);
+    u_int64_t now = Time::msecNow();
+    for (ObjList* o = m_warm.skipNull(); o; ) {
+	if (static_cast<JsWarmContext*>(o->get())->expired(now)) {
+	    old.append(o->remove(false));
+	    o = o->skipNull();
+	}
+	else
+	    o = o->skipNext();
+    }
+    lck.drop();
+    old.clear();
+    while (!Thread::check(false)) {
+	lck.acquire(JsGlobal::s_mutex);
+	if (m_warm.count() >= s_warmContexts || !m_assistCode.code())
+	    return;
+	ScriptRun* runner = m_assistCode.createRunner(0,NATIVE_TITLE);
+	bool autoExt = s_autoExt;
+	lck.drop();
+	if (!runner)
+	    return;
+	contextInit(runner,0,false,0,true);
+	int warm = WarmObjects;
+	// Extensions are loaded per instance so they must precede script globals
+	if (!autoExt) {
+	    if (ScriptRun::Invalid == runner->reset(true)) {
+		JsWarmContext::destroy(runner);
+		return;
+	    }
+	    warm = WarmGlobals;
+	}
+	lck.acquire(JsGlobal::s_mutex);
+	m_warm.append(new JsWarmContext(runner,warm));
+	lck.drop();
+    }
+}
+
+// Signal the worker that the pool needs refilling, start it if needed
+void JsModule::warmWake()
+{
+    Lock lck(JsGlobal::s_mutex);
+    if (s_engineStop || !s_warmContexts || !m_assistCode.code())
+	return;
+    if (m_warmWorker) {
+	m_warmWorker->wake();
+	return;
+    }
+    JsWarmWorker* worker = new JsWarmWorker;
+    if (worker->startup()) {
+	m_warmWorker = worker;
+	return;
+    }
+    lck.drop();
+    Debug(this,DebugWarn,"Failed to start warm context worker thread");
+    delete worker;
+}
+
+// Stop the worker and wait for it to exit
+void JsModule::warmStop()
+{
+    Lock lck(JsGlobal::s_mutex);
+    if (!m_warmWorker)
+	return;
+    m_warmWorker->cancel(false);
+    m_warmWorker->wake();
+    lck.drop();
+    while (m_warmWorker)
+	Thread::idle();
+}
+
+// Called by the worker when it is destroyed
+void JsModule::warmDone(JsWarmWorker* worker)
+{
+    Lock lck(JsGlobal::s_mutex);
+    if (m_warmWorker == worker)
+	m_warmWorker = 0;
+}
+
+void JsModule::warmClear()
+{
+    ObjList tmp;
+    Lock lck(JsGlobal::s_mutex);
+    for (ObjList* o = m_warm.skipNull(); o; o = m_warm.skipNull())
+	tmp.append(o->remove(false));
+    lck.drop();
+}
+
+void JsModule::msgTimer(Message& msg)
+{
+    ChanAssistList::msgTimer(msg);
+    warmWake();
+}
+
 bool JsModule::unload()
 {
     clearPostHook();
     uninstallRelays();
+    warmStop();
+    warmClear();
     return true;
 }
 
@@ -9398,6 +9639,7 @@ void JsModule::initialize()
     s_libsPath = tmp;
     s_maxFile = cfg.getIntValue("general","max_length",500000,32768,2097152);
     s_autoExt = cfg.getBoolValue("general","auto_extensions",true);
+    s_warmContexts = cfg.getIntValue("general","warm_contexts",0,0,256);
     s_allowAbort = cfg.getBoolValue("general","allow_abort");
     s_trackObj = cfg.getBoolValue("general","track_objects");
     s_trackCreation = cfg.getIntValue("general","track_obj_life",s_trackCreation,0);
@@ -9428,6 +9670,8 @@ void JsModule::initialize()
     }
     JsGlobal::markUnused();
     lck.drop();
+    // Settings or routing script may have changed, rebuild warm contexts on timer
+    warmClear();
     JsGlobal::loadHandlers(cfg.getSection(YSTRING("handlers")),true);
     JsGlobal::loadHandlers(cfg.getSection(YSTRING("posthooks")),false);
     JsGlobal::loadScripts(cfg.getSection("scripts"),cfg.getSection("instances"));
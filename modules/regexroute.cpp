@@ -30,6 +30,10 @@ namespace { // anonymous
 #define DEFAULT_RULE "^\\(false\\|no\\|off\\|disable\\|f\\|0*\\)$^"
 #define BLOCK_STACK 10
 #define MAX_VAR_LEN 8100
+// Maximum length of an indexed rule prefix
+#define INDEX_DEPTH 32
+// Minimum number of rules in a context to build an index for it
+#define INDEX_MIN 16
 
 class RegexConfig;
 class GenericHandler;
@@ -49,6 +53,8 @@ static NamedCounter s_dispatching("dispatching");
 static NamedCounter s_processing("processing");
 static NamedCounter s_serial("serial_number");
 
+static Regexp s_blockStart("^\\(.*=[[:space:]]*\\)\\?{$");
+
 PrerouteHandler* s_preroute = 0;
 RouteHandler* s_route = 0;
 
@@ -97,6 +103,95 @@ public:
     virtual bool received(Message &msg);
 };
 
+// Ascending list of rule numbers
+class RuleSet
+{
+public:
+    inline RuleSet()
+	: m_rules(0), m_count(0), m_alloc(0)
+	{ }
+    inline ~RuleSet()
+	{ delete[] m_rules; }
+    void append(unsigned int rule);
+    unsigned int lowerBound(unsigned int rule, unsigned int pos) const;
+    inline unsigned int count() const
+	{ return m_count; }
+    inline unsigned int at(unsigned int pos) const
+	{ return m_rules[pos]; }
+private:
+    unsigned int* m_rules;
+    unsigned int m_count;
+    unsigned int m_alloc;
+};
+
+// Node of the literal prefix tree of a context
+class PrefixNode
+{
+public:
+    inline PrefixNode(char c = 0)
+	: m_char(c), m_child(0), m_next(0)
+	{ }
+    inline ~PrefixNode()
+	{ delete m_child; delete m_next; }
+    PrefixNode* find(char c) const;
+    PrefixNode* add(char c);
+    inline RuleSet& rules()
+	{ return m_rules; }
+    inline const RuleSet& rules() const
+	{ return m_rules; }
+private:
+    char m_char;
+    PrefixNode* m_child;
+    PrefixNode* m_next;
+    RuleSet m_rules;
+};
+
+// Compiled index of the rules of one context
+// Rules anchored to a literal prefix are stored in the node of their prefix,
+//  all other rules are kept in the root node and are always evaluated
+class RegexContext : public GenObject
+{
+public:
+    RegexContext(const NamedList& sect, bool letters);
+    virtual ~RegexContext();
+    virtual const String& toString() const
+	{ return m_name; }
+    inline unsigned int count() const
+	{ return m_count; }
+    inline const NamedString* rule(unsigned int index) const
+	{ return (index < m_count) ? m_rules[index] : 0; }
+    inline const PrefixNode& root() const
+	{ return m_root; }
+    inline unsigned int indexed() const
+	{ return m_indexed; }
+    const Regexp* regexp(unsigned int index, bool extended, bool insensitive) const;
+    static bool rulePrefix(const String& rule, String& prefix, bool letters);
+private:
+    String m_name;
+    PrefixNode m_root;
+    const NamedString** m_rules;
+    Regexp** m_regexps;
+    mutable Mutex m_mutex;
+    unsigned int m_count;
+    unsigned int m_indexed;
+};
+
+// Iterator over the rules of a context that can match a string
+class RuleCursor
+{
+public:
+    RuleCursor(const RegexContext* ctx, const String& str);
+    inline const RegexContext* context() const
+	{ return m_ctx; }
+    void reset(const String& str);
+    unsigned int from(unsigned int rule);
+private:
+    const RegexContext* m_ctx;
+    const RuleSet* m_sets[INDEX_DEPTH + 1];
+    unsigned int m_pos[INDEX_DEPTH + 1];
+    unsigned int m_count;
+};
+
 class RegexConfig: public RefObject
 {
 public:
@@ -117,7 +212,9 @@ public:
 	{ return m_cfg.count(); }
 
 private:
+    void buildIndex();
     Configuration m_cfg;
+    HashList m_contexts;
     bool m_extended;
     bool m_insensitive;
     int m_maxDepth;
@@ -438,7 +535,7 @@ static void evalFunc(String& str, Message& msg)
 		if (par.null())
 		    par = ",";
 		str.clear();
-		for (const ObjList* l = msg.paramList()->skipNull(); l; l = l->skipNext())
+		for (const ObjList* l = static_cast<const NamedList&>(msg).paramList()->skipNull(); l; l = l->skipNext())
 		    str.append(static_cast<const NamedString*>(l->get())->name(),par);
 	    }
 	    else
@@ -461,7 +558,7 @@ static void evalFunc(String& str, Message& msg)
 		    par = ",";
 		str.clear();
 		Lock l(s_varsMtx);
-		for (const ObjList* l = s_vars.paramList()->skipNull(); l; l = l->skipNext()) {
+		for (const ObjList* l = static_cast<const NamedList&>(s_vars).paramList()->skipNull(); l; l = l->skipNext()) {
 		    if (str.length() > MAX_VAR_LEN) {
 			Debug(&__plugin,DebugWarn,"Truncating output of $(variables,list)");
 			str.append("...",par);
@@ -605,6 +702,187 @@ static GenericHandler* findHandler(unsigned int hash)
     return 0;
 }
 
+void RuleSet::append(unsigned int rule)
+{
+    if (m_count >= m_alloc) {
+	m_alloc = m_alloc ? 2 * m_alloc : 4;
+	unsigned int* tmp = new unsigned int[m_alloc];
+	if (m_count)
+	    ::memcpy(tmp,m_rules,m_count * sizeof(unsigned int));
+	delete[] m_rules;
+	m_rules = tmp;
+    }
+    m_rules[m_count++] = rule;
+}
+
+// find the first position at or after pos holding a rule number not less than rule
+unsigned int RuleSet::lowerBound(unsigned int rule, unsigned int pos) const
+{
+    unsigned int end = m_count;
+    while (pos < end) {
+	unsigned int mid = (pos + end) / 2;
+	if (m_rules[mid] < rule)
+	    pos = mid + 1;
+	else
+	    end = mid;
+    }
+    return pos;
+}
+
+PrefixNode* PrefixNode::find(char c) const
+{
+    for (PrefixNode* n = m_child; n; n = n->m_next)
+	if (n->m_char == c)
+	    return n;
+    return 0;
+}
+
+PrefixNode* PrefixNode::add(char c)
+{
+    PrefixNode* n = find(c);
+    if (!n) {
+	n = new PrefixNode(c);
+	n->m_next = m_child;
+	m_child = n;
+    }
+    return n;
+}
+
+RegexContext::RegexContext(const NamedList& sect, bool letters)
+    : m_name(sect), m_rules(0), m_regexps(0), m_mutex(false,"RegexContext"),
+      m_count(sect.length()), m_indexed(0)
+{
+    // keep rules by their number, walking the list for each rule is slow
+    m_rules = new const NamedString*[m_count];
+    m_regexps = new Regexp*[m_count];
+    const ObjList* o = sect.paramList();
+    for (unsigned int i = 0; i < m_count; i++, o = o->next()) {
+	const NamedString* n = static_cast<const NamedString*>(o->get());
+	m_rules[i] = n;
+	m_regexps[i] = 0;
+	if (!n)
+	    continue;
+	PrefixNode* node = &m_root;
+	String prefix;
+	// block markers and 'or' rules must be seen even if they don't match
+	if (!(n->name().startsWith("}") || n->startsWith("or") || s_blockStart.matches(*n))
+		&& rulePrefix(n->name(),prefix,letters)) {
+	    for (unsigned int p = 0; p < prefix.length(); p++)
+		node = node->add(prefix.at(p));
+	    m_indexed++;
+	}
+	node->rules().append(i);
+    }
+}
+
+RegexContext::~RegexContext()
+{
+    for (unsigned int i = 0; i < m_count; i++)
+	delete m_regexps[i];
+    delete[] m_regexps;
+    delete[] m_rules;
+}
+
+// Retrieve the compiled expression of a plain rule, compile it on first use
+const Regexp* RegexContext::regexp(unsigned int index, bool extended, bool insensitive) const
+{
+    const NamedString* n = rule(index);
+    if (!n)
+	return 0;
+    const String& name = n->name();
+    // block ends, parameter, function and reverse matches are handled by oneMatch()
+    if (name.startsWith("}") || name.startsWith("${") || name.startsWith("$(") || name.endsWith("^"))
+	return 0;
+    Lock lock(m_mutex);
+    if (!m_regexps[index]) {
+	Regexp* r = new Regexp(name,extended,insensitive);
+	r->compile();
+	m_regexps[index] = r;
+    }
+    return m_regexps[index];
+}
+
+// Retrieve the literal characters that start any string matched by a rule
+bool RegexContext::rulePrefix(const String& rule, String& prefix, bool letters)
+{
+    // rules need to be anchored, alternatives and reverse matches can't be indexed
+    if (!rule.startsWith("^") || rule.endsWith("^") || (rule.find('|') >= 0))
+	return false;
+    const char* s = rule.c_str() + 1;
+    unsigned int len = 0;
+    for (; len < INDEX_DEPTH; len++) {
+	char c = s[len];
+	if (('0' <= c && c <= '9') || (letters && (('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z'))))
+	    continue;
+	break;
+    }
+    // last literal may be optional or repeated
+    char q = s[len];
+    if (q == '\\')
+	q = s[len + 1];
+    switch (q) {
+	case '*':
+	case '?':
+	case '+':
+	case '{':
+	    if (len)
+		len--;
+	    break;
+    }
+    if (!len)
+	return false;
+    prefix.assign(s,len);
+    return true;
+}
+
+RuleCursor::RuleCursor(const RegexContext* ctx, const String& str)
+    : m_ctx(ctx), m_count(0)
+{
+    reset(str);
+}
+
+// build the list of prefix tree nodes matched by the start of the string
+void RuleCursor::reset(const String& str)
+{
+    if (!m_ctx)
+	return;
+    const PrefixNode* node = &m_ctx->root();
+    m_sets[0] = &node->rules();
+    m_pos[0] = 0;
+    m_count = 1;
+    // rules match the string with leading blanks trimmed
+    const char* s = str.safe();
+    while (*s == ' ' || *s == '\t')
+	s++;
+    for (; *s && (m_count <= INDEX_DEPTH); s++) {
+	node = node->find(*s);
+	if (!node)
+	    break;
+	if (!node->rules().count())
+	    continue;
+	m_sets[m_count] = &node->rules();
+	m_pos[m_count] = 0;
+	m_count++;
+    }
+}
+
+// retrieve the first candidate rule number not less than rule
+unsigned int RuleCursor::from(unsigned int rule)
+{
+    if (!m_ctx)
+	return rule;
+    unsigned int ret = (unsigned int)-1;
+    for (unsigned int i = 0; i < m_count; i++) {
+	const RuleSet& set = *m_sets[i];
+	unsigned int pos = m_pos[i];
+	if (pos < set.count() && set.at(pos) < rule)
+	    m_pos[i] = pos = set.lowerBound(rule,pos + 1);
+	if (pos < set.count() && set.at(pos) < ret)
+	    ret = set.at(pos);
+    }
+    return ret;
+}
+
 RegexConfig::RegexConfig(const String& confName)
     : m_extended(false), m_insensitive(false),
     m_maxDepth(5)
@@ -630,6 +908,8 @@ void RegexConfig::initialize(bool first)
 	depth = 100;
     m_maxDepth = depth;
     m_defRule = m_cfg.getValue("priorities","defaultrule",DEFAULT_RULE);
+    if (m_cfg.getBoolValue("priorities","indexrules",true))
+	buildIndex();
 
     const char* trackName = m_cfg.getBoolValue("priorities","trackparam",true) ?
 	__plugin.name().c_str() : (const char*)0;
@@ -698,6 +978,24 @@ void RegexConfig::initialize(bool first)
 
 #undef CHECK_HANDLER
 
+// build the literal prefix index of all large enough sections
+void RegexConfig::buildIndex()
+{
+    unsigned int sects = m_cfg.sections();
+    for (unsigned int i = 0; i < sects; i++) {
+	const NamedList* sect = m_cfg.getSection(i);
+	if (!sect || (sect->length() < INDEX_MIN) || m_contexts[*sect])
+	    continue;
+	RegexContext* ctx = new RegexContext(*sect,!m_insensitive);
+	DDebug(&__plugin,DebugAll,"Indexed %u of %u rules in context '%s'",
+	    ctx->indexed(),sect->length(),sect->c_str());
+	if (ctx->indexed())
+	    m_contexts.append(ctx);
+	else
+	    TelEngine::destruct(ctx);
+    }
+}
+
 // helper function to set the default regexp
 void RegexConfig::setDefault(Regexp& reg)
 {
@@ -827,9 +1125,12 @@ bool RegexConfig::oneContext(Message &msg, String &str, const String &context, S
     if (l) {
 	unsigned int blockDepth = 0;
 	BlockState blockStack[BLOCK_STACK];
-	unsigned int len = l->length();
-	for (unsigned int i = 0; i < len; i++) {
-	    const NamedString* n = l->getParam(i);
+	// evaluate only rules that may match, unless tracing all of them
+	RuleCursor cursor((trace || traceLst) ? 0 :
+	    static_cast<const RegexContext*>(m_contexts[context]),str);
+	unsigned int len = cursor.context() ? cursor.context()->count() : l->length();
+	for (unsigned int i = cursor.from(0); i < len; i = cursor.from(i + 1)) {
+	    const NamedString* n = cursor.context() ? cursor.context()->rule(i) : l->getParam(i);
 	    if (!n)
 		continue;
 	    BlockState blockThis = (blockDepth > 0) ? blockStack[blockDepth-1] : BlockRun;
@@ -847,7 +1148,6 @@ bool RegexConfig::oneContext(Message &msg, String &str, const String &context, S
 		blockLast = blockThis;
 		blockThis = (blockDepth > 0) ? blockStack[blockDepth-1] : BlockRun;
 	    }
-	    static Regexp s_blockStart("^\\(.*=[[:space:]]*\\)\\?{$");
 	    if (s_blockStart.matches(*n)) {
 		// start of a new block
 		if (blockDepth >= BLOCK_STACK) {
@@ -877,9 +1177,18 @@ bool RegexConfig::oneContext(Message &msg, String &str, const String &context, S
 	    String val(*n);
 	    String match;
 	    bool ok;
+	    // primary match of indexed contexts uses the cached expression
+	    const Regexp* rex = cursor.context() ?
+		cursor.context()->regexp(i,m_extended,m_insensitive) : 0;
 	    do {
 		match = str;
-		ok = oneMatch(msg,reg,match,context,i+1,trace,traceLst);
+		if (rex) {
+		    match.trimBlanks();
+		    ok = match.matches(*rex);
+		    rex = 0;
+		}
+		else
+		    ok = oneMatch(msg,reg,match,context,i+1,trace,traceLst);
 		if (ok) {
 		    if (val.startSkip("or")) {
 			do {
@@ -1008,12 +1317,15 @@ bool RegexConfig::oneContext(Message &msg, String &str, const String &context, S
 		    DDebug(&__plugin,DebugAll,"Returning true from context '%s'", context.c_str());
 		    return true;
 		}
+		// included context may have changed the match string
+		cursor.reset(str);
 	    }
 	    else if (val.startSkip("match") || val.startSkip("newmatch")) {
 		if (!val.null()) {
 		    NDebug(&__plugin,DebugAll,"Setting match string '%s' by rule #%u '%s' in context '%s'",
 			val.c_str(),i+1,n->name().c_str(),context.c_str());
 		    str = val;
+		    cursor.reset(str);
 		}
 	    }
 	    else if (val.startSkip("rename")) {
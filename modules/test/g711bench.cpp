@@ -0,0 +1,207 @@
+/**
+ * g711bench.cpp
+ * This file is part of the YATE Project http://YATE.null.ro
+ *
+ * G.711 conversion checks and speed measurements
+ *
+ * Yet Another Telephony Engine - a fully featured software PBX and IVR
+ * Copyright (C) 2004-2023 Null Team
+ *
+ * This software is distributed under multiple licenses;
+ * see the COPYING file in the main directory for licensing
+ * information for this specific distribution.
+ *
+ * This use of this software may be subject to additional restrictions.
+ * See the LEGAL file in the main directory for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <yatephone.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+using namespace TelEngine;
+
+// Consumer that just counts the translated samples
+class BenchConsumer : public DataConsumer
+{
+public:
+    BenchConsumer(const char* format)
+	: DataConsumer(format), m_bytes(0)
+	{ }
+    virtual unsigned long Consume(const DataBlock& data, unsigned long tStamp, unsigned long flags)
+	{ m_bytes += data.length(); return data.length(); }
+    u_int64_t m_bytes;
+};
+
+class TestG711 : public Plugin
+{
+public:
+    TestG711();
+    virtual void initialize();
+private:
+    bool check(const char* sFormat, const char* dFormat, unsigned int sBytes, unsigned int dBytes);
+    void bench(const char* sFormat, const char* dFormat, unsigned int sBytes, unsigned int dBytes,
+	unsigned int samples, unsigned int count);
+    bool m_first;
+    // table built one sample at a time, the plain lookup path
+    DataBlock m_table;
+    DataBlock m_input;
+};
+
+TestG711::TestG711()
+    : Plugin("testg711"),
+      m_first(true)
+{
+    Output("Hello, I am module TestG711");
+}
+
+// Build the reference table and compare it with block conversions
+bool TestG711::check(const char* sFormat, const char* dFormat, unsigned int sBytes, unsigned int dBytes)
+{
+    unsigned int entries = (sBytes == 2) ? 65536 : 256;
+    m_table.assign(0,entries * dBytes);
+    DataBlock out;
+    for (unsigned int i = 0; i < entries; i++) {
+	unsigned char in[2] = { (unsigned char)i, (unsigned char)(i >> 8) };
+	DataBlock one(in,sBytes);
+	out.convert(one,sFormat,dFormat);
+	if (out.length() != dBytes) {
+	    Debug("g711",DebugWarn,"Single %s -> %s conversion failed",sFormat,dFormat);
+	    return false;
+	}
+	::memcpy(m_table.data(i * dBytes,dBytes),out.data(),dBytes);
+    }
+    // random input with lengths that are not multiple of the block sizes
+    unsigned int n = 4096 + 13;
+    m_input.assign(0,n * sBytes);
+    unsigned char* p = (unsigned char*)m_input.data();
+    for (unsigned int i = 0; i < m_input.length(); i++)
+	p[i] = (unsigned char)::random();
+    for (unsigned int offs = 0; offs < 40; offs += 7) {
+	DataBlock part(p + offs * sBytes,(n - offs) * sBytes);
+	out.convert(part,sFormat,dFormat);
+	for (unsigned int i = 0; i < n - offs; i++) {
+	    unsigned int idx = p[(offs + i) * sBytes];
+	    if (sBytes == 2)
+		idx |= ((unsigned int)p[(offs + i) * sBytes + 1]) << 8;
+	    if (::memcmp(out.data(i * dBytes,dBytes),m_table.data(idx * dBytes,dBytes),dBytes)) {
+		Debug("g711",DebugWarn,"Mismatch %s -> %s at sample %u input 0x%x",
+		    sFormat,dFormat,offs + i,idx);
+		return false;
+	    }
+	}
+    }
+    Debug("g711",DebugInfo,"Checked %s -> %s against the lookup table",sFormat,dFormat);
+    return true;
+}
+
+// Run packets through the plain table loop, DataBlock::convert() and a translator
+void TestG711::bench(const char* sFormat, const char* dFormat, unsigned int sBytes, unsigned int dBytes,
+    unsigned int samples, unsigned int count)
+{
+    DataFormat sFmt(sFormat);
+    DataFormat dFmt(dFormat);
+    if (!sFmt.getInfo())
+	return;
+    samples *= sFmt.getInfo()->numChannels;
+    DataBlock packet(0,samples * sBytes);
+    unsigned char* p = (unsigned char*)packet.data();
+    for (unsigned int i = 0; i < packet.length(); i++)
+	p[i] = (unsigned char)::random();
+
+    u_int64_t tTable = Time::now();
+    DataBlock out(0,samples * dBytes);
+    if (dBytes == 2) {
+	unsigned short* t = (unsigned short*)m_table.data();
+	for (unsigned int n = 0; n < count; n++) {
+	    const unsigned char* s = p;
+	    unsigned short* d = (unsigned short*)out.data();
+	    for (unsigned int i = samples; i; i--)
+		*d++ = t[*s++];
+	}
+    }
+    else if (sBytes == 2) {
+	unsigned char* t = (unsigned char*)m_table.data();
+	for (unsigned int n = 0; n < count; n++) {
+	    const unsigned short* s = (const unsigned short*)p;
+	    unsigned char* d = (unsigned char*)out.data();
+	    for (unsigned int i = samples; i; i--)
+		*d++ = t[*s++];
+	}
+    }
+    else {
+	unsigned char* t = (unsigned char*)m_table.data();
+	for (unsigned int n = 0; n < count; n++) {
+	    const unsigned char* s = p;
+	    unsigned char* d = (unsigned char*)out.data();
+	    for (unsigned int i = samples; i; i--)
+		*d++ = t[*s++];
+	}
+    }
+    tTable = Time::now() - tTable;
+
+    // convert() works on the formats without the channels prefix
+    String sBase(sFormat);
+    String dBase(dFormat);
+    if (sFmt.getInfo()->numChannels > 1) {
+	sBase >> "*";
+	dBase >> "*";
+    }
+    u_int64_t tBlock = Time::now();
+    for (unsigned int n = 0; n < count; n++)
+	out.convert(packet,sBase,dBase);
+    tBlock = Time::now() - tBlock;
+
+    DataTranslator* trans = DataTranslator::create(sFmt,dFmt);
+    if (!trans) {
+	Debug("g711",DebugWarn,"Could not create translator %s -> %s",sFormat,dFormat);
+	return;
+    }
+    BenchConsumer* cons = new BenchConsumer(dFormat);
+    trans->getTransSource()->attach(cons);
+    u_int64_t tConv = Time::now();
+    for (unsigned int n = 0; n < count; n++)
+	trans->Consume(packet,n * samples,0);
+    tConv = Time::now() - tConv;
+    trans->getTransSource()->detach(cons);
+    TelEngine::destruct(cons);
+    TelEngine::destruct(trans);
+
+    double total = (double)samples * count;
+    Output("%s -> %s: %u samples x %u, Msamples/s: table %.1f, convert %.1f, translator %.1f",
+	sFormat,dFormat,samples,count,tTable ? (total / tTable) : 0.0,
+	tBlock ? (total / tBlock) : 0.0,tConv ? (total / tConv) : 0.0);
+}
+
+void TestG711::initialize()
+{
+    Output("Initializing module TestG711");
+    if (!m_first)
+	return;
+    m_first = false;
+    static const char* s_convs[][4] = {
+	{ "slin", "alaw", "2*slin", "2*alaw" },
+	{ "slin", "mulaw", "2*slin", "2*mulaw" },
+	{ "alaw", "slin", "2*alaw", "2*slin" },
+	{ "mulaw", "slin", "2*mulaw", "2*slin" },
+	{ "alaw", "mulaw", "2*alaw", "2*mulaw" },
+	{ "mulaw", "alaw", "2*mulaw", "2*alaw" },
+    };
+    for (unsigned int i = 0; i < sizeof(s_convs) / sizeof(s_convs[0]); i++) {
+	unsigned int sBytes = ::strcmp(s_convs[i][0],"slin") ? 1 : 2;
+	unsigned int dBytes = ::strcmp(s_convs[i][1],"slin") ? 1 : 2;
+	if (!check(s_convs[i][0],s_convs[i][1],sBytes,dBytes))
+	    continue;
+	bench(s_convs[i][0],s_convs[i][1],sBytes,dBytes,160,100000);
+	bench(s_convs[i][2],s_convs[i][3],sBytes,dBytes,160,100000);
+    }
+}
+
+INIT_PLUGIN(TestG711);
+
+/* vi: set ts=8 sw=4 sts=4 noet: */
@@ -0,0 +1,221 @@
+/**
+ * jsbench.cpp
+ * This file is part of the YATE Project http://YATE.null.ro
+ *
+ * Benchmark of script field access and of the linked script evaluator
+ *
+ * Yet Another Telephony Engine - a fully featured software PBX and IVR
+ * Copyright (C) 2004-2023 Null Team
+ *
+ * This software is distributed under multiple licenses;
+ * see the COPYING file in the main directory for licensing
+ * information for this specific distribution.
+ *
+ * This use of this software may be subject to additional restrictions.
+ * See the LEGAL file in the main directory for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <yatengine.h>
+#include <yatescript.h>
+
+using namespace TelEngine;
+
+// Parameters usually found in a call.route message of a SIP call
+static const char* s_fields[] = {
+    "called", "caller", "callername", "billid", "id", "module", "address",
+    "format", "formats", "line", "domain", "username", "realm", "ip_host",
+    "ip_port", "connection_id", "connection_reliable", "sip_uri", "sip_from",
+    "sip_to", "sip_callid", "sip_contact", "sip_user-agent", "sip_allow",
+    "sip_supported", "sip_p-asserted-identity", "rtp_addr", "rtp_port",
+    "sdp_raw", "media", "rtp_forward", "antiloop", "copyparams", "osip_x-custom",
+    0
+};
+
+// Scripts run with the linked and with the list evaluator, they set a total
+static const char* s_scripts[][2] = {
+    { "numeric loop",
+	"var x = 0;\n"
+	"for (var i = 0; i < 4000; i++)\n"
+	"    x = x + i * 2 - (i % 7);\n"
+	"var total = x;\n" },
+    { "function calls",
+	"function add(a,b)\n{\n    return a + b;\n}\n"
+	"var total = 0;\n"
+	"for (var i = 0; i < 1000; i++)\n"
+	"    total = add(total,i);\n" },
+    { "mixed statements",
+	"function fib(n)\n{\n    if (n < 2)\n\treturn n;\n    return fib(n - 1) + fib(n - 2);\n}\n"
+	"var o = { a: 1, b: \"x\" };\n"
+	"var arr = [];\n"
+	"for (var i = 0; i < 300; i++) {\n"
+	"    switch (i % 4) {\n"
+	"\tcase 0:\n\t    o.a = o.a + i;\n\t    break;\n"
+	"\tcase 1:\n\t    arr.push(i);\n\t    break;\n"
+	"\tcase 2:\n\t    o.b = o.b + \"y\";\n\t    break;\n"
+	"\tdefault:\n\t    o.a--;\n"
+	"    }\n"
+	"}\n"
+	"var total = fib(15) + o.a + arr.length + o.b.length;\n" },
+    { "typed edge cases",
+	"var s = \"5\"; var e = \"\"; var n = parseInt(\"12\"); var b = 3 < 4; var u; var t = \"\";\n"
+	"t = t + (s + 1) + \",\" + (s == 5) + \",\" + (s * 2) + \",\" + (n == 12) + \",\" + (n + 1 == 13);\n"
+	"t = t + \",\" + (7 / 2) + \",\" + (0 - 7 % 3) + \",\" + (1 << 4) + \",\" + (b == true) + \",\" + (b + 1);\n"
+	"t = t + \",\" + (true == 1) + \",\" + (NaN + 1) + \",\" + (u + 1) + \",\" + (u == 0) + \",\" + (n < \"13\");\n"
+	"if (u)\n    t = t + \",u\";\nelse\n    t = t + \",nu\";\n"
+	"if (s)\n    t = t + \",s\";\n"
+	"if (e)\n    t = t + \",e\";\n"
+	"if (n - 12)\n    t = t + \",n\";\n"
+	"if (b)\n    t = t + \",b\";\n"
+	"var k = 0;\nwhile (k < 10)\n    k = k + 3;\n"
+	"for (var i = 0; i < 5 && k > 0; i++)\n    k = k - i * 2;\n"
+	"var total = t + \",\" + k + \",\" + i;\n" },
+    { 0, 0 }
+};
+
+class JsBench : public Plugin
+{
+public:
+    JsBench();
+    virtual void initialize();
+private:
+    u_int64_t run(JsParser& parser, bool index, unsigned int extra, int64_t expect, unsigned int runs);
+    u_int64_t runLinked(const char* script, bool link, unsigned int runs, String& total);
+    bool m_first;
+};
+
+JsBench::JsBench()
+    : Plugin("jsbench"),
+      m_first(true)
+{
+    Output("Hello, I am module JsBench");
+}
+
+// Run the script with a fresh context holding the message object
+// Extra parameters not read by the script can be added before the others
+// Returns the average run time in microseconds, zero on failure
+u_int64_t JsBench::run(JsParser& parser, bool index, unsigned int extra, int64_t expect,
+    unsigned int runs)
+{
+    u_int64_t total = 0;
+    for (unsigned int n = 0; n < runs; n++) {
+	ScriptContext* ctx = parser.createContext();
+	JsObject* msg = new JsObject(ctx->mutex(),"[object Object]",0);
+	if (!index)
+	    msg->params().disableIndex();
+	for (unsigned int i = 0; i < extra; i++)
+	    msg->params().setParam(new ExpOperation("extra","x_extra_" + String(i)));
+	for (unsigned int i = 0; s_fields[i]; i++)
+	    msg->params().setParam(new ExpOperation(String(s_fields[i]) + "_value",s_fields[i]));
+	ctx->params().setParam(new ExpWrapper(msg,"msg"));
+	ScriptRun* runner = parser.createRunner(ctx,"jsbench");
+	TelEngine::destruct(ctx);
+	if (!runner)
+	    return 0;
+	u_int64_t t = Time::now();
+	ScriptRun::Status st = runner->run();
+	total += Time::now() - t;
+	int64_t res = runner->context()->params()[YSTRING("total")].toInt64(-1);
+	TelEngine::destruct(runner);
+	if (st != ScriptRun::Succeeded || res != expect) {
+	    Debug("jsbench",DebugWarn,"Script run returned status %d, total " FMT64 " expected " FMT64,
+		st,res,expect);
+	    return 0;
+	}
+    }
+    return total / runs;
+}
+
+// Parse a script, linked or not, and run it in fresh contexts
+// Returns the best run time in microseconds, zero on failure
+u_int64_t JsBench::runLinked(const char* script, bool link, unsigned int runs, String& total)
+{
+    JsParser parser(link);
+    if (!parser.parse(script)) {
+	Debug("jsbench",DebugWarn,"Failed to parse script");
+	return 0;
+    }
+    u_int64_t best = 0;
+    for (unsigned int n = 0; n < runs; n++) {
+	ScriptRun* runner = parser.createRunner(0,"jsbench");
+	if (!runner)
+	    return 0;
+	u_int64_t t = Time::now();
+	ScriptRun::Status st = runner->run();
+	t = Time::now() - t;
+	total = runner->context()->params()[YSTRING("total")];
+	TelEngine::destruct(runner);
+	if (st != ScriptRun::Succeeded) {
+	    Debug("jsbench",DebugWarn,"Script run returned status %d",st);
+	    return 0;
+	}
+	if (!best || (t < best))
+	    best = t;
+    }
+    return best ? best : 1;
+}
+
+void JsBench::initialize()
+{
+    Output("Initializing module JsBench");
+    if (!m_first)
+	return;
+    m_first = false;
+    // amount of work can be set in yate.conf [jsbench]
+    unsigned int calls = Engine::config().getIntValue("jsbench","calls",2000,1);
+    unsigned int runs = Engine::config().getIntValue("jsbench","runs",10,1);
+    // a routing function reading every parameter of the message twice
+    String script;
+    script << "function route(m)\n{\n    var score = 0;\n";
+    int64_t sum = 0;
+    for (unsigned int i = 0; s_fields[i]; i++) {
+	String name(s_fields[i]);
+	if (name.find('-') >= 0)
+	    script << "    if (m[\"" << name << "\"] != \"\")\n\tscore = score + m[\"" << name << "\"].length;\n";
+	else
+	    script << "    if (m." << name << " != \"\")\n\tscore = score + m." << name << ".length;\n";
+	sum += name.length() + 6;
+    }
+    script << "    m.result = \"sip/\" + m.called + \"@\" + m.domain;\n"
+	"    return score;\n}\nvar total = 0;\n"
+	"for (var i = 0; i < " << calls << "; i++)\n    total = total + route(msg);\n";
+    JsParser parser;
+    if (!parser.parse(script)) {
+	Debug("jsbench",DebugWarn,"Failed to parse the generated script");
+	return;
+    }
+    // the linked code must compute the same as the list evaluator
+    for (unsigned int i = 0; s_scripts[i][0]; i++) {
+	String linked;
+	String list;
+	u_int64_t tLinked = runLinked(s_scripts[i][1],true,runs,linked);
+	u_int64_t tList = runLinked(s_scripts[i][1],false,runs,list);
+	if (!(tLinked && tList))
+	    return;
+	if (linked.null() || (linked != list)) {
+	    Debug("jsbench",DebugWarn,"Script '%s' linked total '%s' expected '%s'",
+		s_scripts[i][0],linked.c_str(),list.c_str());
+	    return;
+	}
+	Output("Script '%s' total %s: %.2f ms linked, %.2f ms list evaluator (%.2fx)",s_scripts[i][0],
+	    linked.c_str(),tLinked / 1000.0,tList / 1000.0,(double)tList / tLinked);
+    }
+    int64_t expect = sum * calls;
+    unsigned int fields = sizeof(s_fields) / sizeof(s_fields[0]) - 1;
+    static const unsigned int s_extra[] = { 0, 100, 500 };
+    for (unsigned int i = 0; i < sizeof(s_extra) / sizeof(s_extra[0]); i++) {
+	u_int64_t tIndex = run(parser,true,s_extra[i],expect,runs);
+	u_int64_t tList = run(parser,false,s_extra[i],expect,runs);
+	if (!(tIndex && tList))
+	    return;
+	Output("Routing %u calls reading %u of %u fields twice: %.2f ms indexed, %.2f ms linear (%.2fx)",
+	    calls,fields,fields + s_extra[i],tIndex / 1000.0,tList / 1000.0,(double)tList / tIndex);
+    }
+}
+
+INIT_PLUGIN(JsBench);
+
+/* vi: set ts=8 sw=4 sts=4 noet: */
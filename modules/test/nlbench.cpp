@@ -0,0 +1,317 @@
+/**
+ * nlbench.cpp
+ * This file is part of the YATE Project http://YATE.null.ro
+ *
+ * Consistency check and benchmark of the NamedList lookup index
+ *
+ * Yet Another Telephony Engine - a fully featured software PBX and IVR
+ * Copyright (C) 2004-2023 Null Team
+ *
+ * This software is distributed under multiple licenses;
+ * see the COPYING file in the main directory for licensing
+ * information for this specific distribution.
+ *
+ * This use of this software may be subject to additional restrictions.
+ * See the LEGAL file in the main directory for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <yatengine.h>
+
+using namespace TelEngine;
+
+// Number of distinct parameter names used by the check
+#define CHECK_NAMES 64
+
+class NamedListBench : public Plugin
+{
+public:
+    NamedListBench();
+    virtual void initialize();
+private:
+    bool check(unsigned int ops, bool dups);
+    bool checkDirect();
+    bool compare(const NamedList& idx, const NamedList& ref, unsigned int op);
+    void bench(unsigned int size, unsigned int count);
+    bool m_first;
+    String m_names[CHECK_NAMES];
+    unsigned int m_value;
+};
+
+NamedListBench::NamedListBench()
+    : Plugin("nlbench"),
+      m_first(true), m_value(0)
+{
+    Output("Hello, I am module NamedListBench");
+}
+
+// Compare the lookups and the whole content of an indexed list with a list
+//  having the index disabled
+bool NamedListBench::compare(const NamedList& idx, const NamedList& ref, unsigned int op)
+{
+    for (unsigned int i = 0; i < CHECK_NAMES; i++) {
+	const NamedString* a = idx.getParam(m_names[i]);
+	const NamedString* b = ref.getParam(m_names[i]);
+	if (!a && !b)
+	    continue;
+	if (a && b && (*a == *b) && (idx.getIndex(a) == ref.getIndex(b)))
+	    continue;
+	Debug("nlbench",DebugWarn,"Operation %u: lookup of '%s' returned '%s' at %d, expected '%s' at %d",
+	    op,m_names[i].c_str(),TelEngine::c_safe(a),idx.getIndex(a),
+	    TelEngine::c_safe(b),ref.getIndex(b));
+	return false;
+    }
+    String da;
+    String db;
+    idx.dump(da,",");
+    ref.dump(db,",");
+    if (da == db)
+	return true;
+    Debug("nlbench",DebugWarn,"Operation %u: content '%s' expected '%s'",op,da.c_str(),db.c_str());
+    return false;
+}
+
+// Apply the same random operations to an indexed and a not indexed list
+// Without dups the lists hold a single parameter of each name as most do
+bool NamedListBench::check(unsigned int ops, bool dups)
+{
+    NamedList idx("list");
+    NamedList ref("list");
+    ref.disableIndex();
+    NamedList src("src");
+    for (unsigned int op = 0; op < ops; op++) {
+	const String& name = m_names[Random::random() % CHECK_NAMES];
+	String value(++m_value);
+	if (idx.count() > 400) {
+	    idx.clearParams();
+	    ref.clearParams();
+	}
+	if (!(op % 50)) {
+	    src.clearParams();
+	    for (int n = Random::random() % 20; n >= 0; n--) {
+		if (dups)
+		    src.addParam(m_names[Random::random() % CHECK_NAMES],String(++m_value));
+		else
+		    src.setParam(m_names[Random::random() % CHECK_NAMES],String(++m_value));
+		if (!(Random::random() % 4))
+		    src.setParam(m_names[Random::random() % CHECK_NAMES] + ".sub",String(++m_value));
+	    }
+	}
+	switch (Random::random() % 14) {
+	    case 0:
+	    case 1:
+	    case 2:
+		if (!dups) {
+		    idx.setParam(name,value);
+		    ref.setParam(name,value);
+		    break;
+		}
+		idx.addParam(name,value);
+		ref.addParam(name,value);
+		break;
+	    case 3:
+	    {
+		// a child parameter removed or copied by the childSep operations
+		String child = name + ".sub";
+		idx.setParam(child,value);
+		ref.setParam(child,value);
+		break;
+	    }
+	    case 4:
+	    {
+		bool clearOther = (0 != (Random::random() % 2));
+		idx.setParam(name,value,clearOther);
+		ref.setParam(name,value,clearOther);
+		break;
+	    }
+	    case 5:
+	    {
+		bool clearOther = (0 != (Random::random() % 2));
+		idx.setParam(new NamedString(name,value),clearOther);
+		ref.setParam(new NamedString(name,value),clearOther);
+		break;
+	    }
+	    case 6:
+		idx.clearParam(name);
+		ref.clearParam(name);
+		break;
+	    case 7:
+		idx.clearParam(name,'.');
+		ref.clearParam(name,'.');
+		break;
+	    case 8:
+	    {
+		// remove one occurence, not necessarily the first one
+		unsigned int pos = Random::random() % (ref.count() + 1);
+		const NamedString* ns = ref.getParam(pos);
+		if (!ns)
+		    break;
+		// the parameter is destroyed while clearing, keep copies
+		String nam(ns->name());
+		String val(*ns);
+		idx.clearParam(nam,0,&val);
+		ref.clearParam(nam,0,&val);
+		break;
+	    }
+	    case 9:
+	    {
+		unsigned int pos = Random::random() % (idx.count() + 1);
+		idx.clearParam(idx.getParam(pos));
+		ref.clearParam(ref.getParam(pos));
+		break;
+	    }
+	    case 10:
+	    {
+		Regexp rex(String("^") + name + "$");
+		idx.clearParamMatch(rex);
+		ref.clearParamMatch(rex);
+		break;
+	    }
+	    case 11:
+	    {
+		bool replace = !dups || (0 != (Random::random() % 2));
+		idx.copyParams(replace,src);
+		ref.copyParams(replace,src);
+		break;
+	    }
+	    case 12:
+	    {
+		bool replace = !dups || (0 != (Random::random() % 2));
+		bool clearMissing = (0 != (Random::random() % 2));
+		char sep = (Random::random() % 2) ? '.' : 0;
+		idx.copyParam(src,name,sep,replace,clearMissing);
+		ref.copyParam(src,name,sep,replace,clearMissing);
+		break;
+	    }
+	    default:
+	    {
+		bool replace = !dups || (0 != (Random::random() % 2));
+		idx.copySubParams(src,name,false,replace);
+		ref.copySubParams(src,name,false,replace);
+		break;
+	    }
+	}
+	if (!compare(idx,ref,op))
+	    return false;
+    }
+    Output("NamedList index checked against %u random operations%s",ops,
+	dups ? " with repeated names" : "");
+    return true;
+}
+
+// Change an indexed list directly through paramList() while it is looked up
+bool NamedListBench::checkDirect()
+{
+    NamedList idx("list");
+    NamedList ref("list");
+    ref.disableIndex();
+    for (unsigned int i = 0; i < CHECK_NAMES; i++) {
+	idx.addParam(m_names[i],String(i));
+	ref.addParam(m_names[i],String(i));
+    }
+    // build the index, then keep the list pointer across lookups and updates
+    if (!compare(idx,ref,0))
+	return false;
+    ObjList* li = idx.paramList();
+    ObjList* lr = ref.paramList();
+    for (unsigned int op = 1; op <= 1000; op++) {
+	const String& name = m_names[Random::random() % CHECK_NAMES];
+	String value(++m_value);
+	switch (Random::random() % 4) {
+	    case 0:
+		if (ref.getParam(name)) {
+		    li->remove(idx.getParam(name));
+		    lr->remove(ref.getParam(name));
+		}
+		break;
+	    case 1:
+		li->insert(new NamedString(name,value));
+		lr->insert(new NamedString(name,value));
+		break;
+	    case 2:
+		idx.setParam(name,value);
+		ref.setParam(name,value);
+		break;
+	    default:
+		li->append(new NamedString(name,value));
+		lr->append(new NamedString(name,value));
+	}
+	if (!compare(idx,ref,op))
+	    return false;
+    }
+    Output("NamedList checked against direct changes of its parameters list");
+    return true;
+}
+
+// Time lookups and updates of an indexed list and the same list without index
+void NamedListBench::bench(unsigned int size, unsigned int count)
+{
+    String* names = new String[size];
+    for (unsigned int i = 0; i < size; i++)
+	names[i] = "param_name_" + String(i);
+    double res[2][4];
+    for (int disable = 0; disable < 2; disable++) {
+	NamedList list("");
+	if (disable)
+	    list.disableIndex();
+	for (unsigned int i = 0; i < size; i++)
+	    list.addParam(names[i],"value");
+	unsigned int found = 0;
+	u_int64_t t = Time::now();
+	for (unsigned int n = 0; n < count; n++) {
+	    if (list.getParam(names[(n * 7) % size]))
+		found++;
+	}
+	res[disable][0] = (Time::now() - t) * 1000.0 / count;
+	t = Time::now();
+	for (unsigned int n = 0; n < count; n++)
+	    list.setParam(names[(n * 7) % size],"other");
+	res[disable][1] = (Time::now() - t) * 1000.0 / count;
+	t = Time::now();
+	for (unsigned int n = 0; n < count; n++)
+	    list.setParam(new NamedString(names[(n * 7) % size],"third"));
+	res[disable][2] = (Time::now() - t) * 1000.0 / count;
+	// removing and adding back a parameter used to drop the whole index
+	t = Time::now();
+	for (unsigned int n = 0; n < count; n++) {
+	    const String& name = names[(n * 7) % size];
+	    list.clearParam(name);
+	    list.addParam(name,"value");
+	    if (list.getParam(names[(n * 13) % size]))
+		found++;
+	}
+	res[disable][3] = (Time::now() - t) * 1000.0 / count;
+	if (found != 2 * count)
+	    Debug("nlbench",DebugWarn,"Found only %u of %u parameters",found,2 * count);
+    }
+    delete[] names;
+    Output("%u params, ns/op indexed (linear): getParam %.1f (%.1f), setParam %.1f (%.1f), "
+	"setParam(NamedString) %.1f (%.1f), clear+add+get %.1f (%.1f)",size,
+	res[0][0],res[1][0],res[0][1],res[1][1],res[0][2],res[1][2],res[0][3],res[1][3]);
+}
+
+void NamedListBench::initialize()
+{
+    Output("Initializing module NamedListBench");
+    if (!m_first)
+	return;
+    m_first = false;
+    for (unsigned int i = 0; i < CHECK_NAMES; i++)
+	m_names[i] = "p" + String(i);
+    // the seed and amount of work can be set in yate.conf [nlbench]
+    Random::srandom(Engine::config().getIntValue("nlbench","seed",1));
+    unsigned int ops = Engine::config().getIntValue("nlbench","operations",100000,1);
+    if (!(check(ops,false) && check(ops,true) && checkDirect()))
+	return;
+    unsigned int count = Engine::config().getIntValue("nlbench","count",200000,1);
+    static const unsigned int s_sizes[] = { 8, 16, 32, 128, 512 };
+    for (unsigned int i = 0; i < sizeof(s_sizes) / sizeof(s_sizes[0]); i++)
+	bench(s_sizes[i],count);
+}
+
+INIT_PLUGIN(NamedListBench);
+
+/* vi: set ts=8 sw=4 sts=4 noet: */
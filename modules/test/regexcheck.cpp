@@ -0,0 +1,201 @@
+/**
+ * regexcheck.cpp
+ * This file is part of the YATE Project http://YATE.null.ro
+ *
+ * Differential check of the Regexp matcher against the system regexec()
+ *
+ * Yet Another Telephony Engine - a fully featured software PBX and IVR
+ * Copyright (C) 2004-2023 Null Team
+ *
+ * This software is distributed under multiple licenses;
+ * see the COPYING file in the main directory for licensing
+ * information for this specific distribution.
+ *
+ * This use of this software may be subject to additional restrictions.
+ * See the LEGAL file in the main directory for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <yatengine.h>
+
+#include <regex.h>
+#include <stdlib.h>
+
+using namespace TelEngine;
+
+// Number of subexpressions reported by String::matches()
+#define CHECK_MATCH 9
+
+class RegexCheck : public Plugin
+{
+public:
+    RegexCheck();
+    virtual void initialize();
+private:
+    int genAtom(String& pat, int depth, bool extended);
+    int genBranch(String& pat, int depth, bool extended);
+    bool check(const String& pat, bool extended, bool icase, const String& subject);
+    bool m_first;
+    unsigned int m_cases;
+    unsigned int m_diffs;
+};
+
+static const char* s_atoms[] = { "a", "b", "c", ".", "[ab]", "[^a]", "[a-c]", "ab", 0 };
+// bounded repeats come first, the unbounded ones after them
+static const char* s_ereRep[] = { "?", "{2}", "{1,2}", "{0,2}", "{0,1}", "*", "+", "{0,}", "{2,}", 0 };
+static const char* s_breRep[] = { "\\?", "\\{2\\}", "\\{1,2\\}", "\\{0,2\\}", "\\{0,1\\}", "*", "\\+", "\\{0,\\}", "\\{2,\\}", 0 };
+#define BOUNDED_REP 5
+
+static int pick(const char** list, int n = 0)
+{
+    if (!n) {
+	while (list[n])
+	    n++;
+    }
+    return (int)(Random::random() % n);
+}
+
+RegexCheck::RegexCheck()
+    : Plugin("regexcheck"),
+      m_first(true), m_cases(0), m_diffs(0)
+{
+    Output("Hello, I am module RegexCheck");
+}
+
+// A character, a bracket or a (possibly alternated) group, maybe repeated
+// Returns the repeat nesting level, regexec() can take exponential time
+//  on repeated groups that hold repeated groups with unbounded repeats
+int RegexCheck::genAtom(String& pat, int depth, bool extended)
+{
+    int level = 0;
+    if ((depth < 2) && !(Random::random() % 3)) {
+	pat << (extended ? "(" : "\\(");
+	level = genBranch(pat,depth + 1,extended);
+	if (!(Random::random() % 3)) {
+	    pat << (extended ? "|" : "\\|");
+	    int l = genBranch(pat,depth + 1,extended);
+	    if (level < l)
+		level = l;
+	}
+	pat << (extended ? ")" : "\\)");
+    }
+    else
+	pat << s_atoms[pick(s_atoms)];
+    if ((level < 2) && (Random::random() % 2)) {
+	const char** rep = extended ? s_ereRep : s_breRep;
+	int idx = pick(rep,level ? BOUNDED_REP : 0);
+	pat << rep[idx];
+	if (level)
+	    level = 2;
+	else if (idx >= BOUNDED_REP)
+	    level = 1;
+    }
+    return level;
+}
+
+int RegexCheck::genBranch(String& pat, int depth, bool extended)
+{
+    int level = 0;
+    for (int n = 1 + Random::random() % 3; n; n--) {
+	int l = genAtom(pat,depth,extended);
+	if (level < l)
+	    level = l;
+    }
+    return level;
+}
+
+// Compare matching and subexpressions of one subject with regexec()
+bool RegexCheck::check(const String& pat, bool extended, bool icase, const String& subject)
+{
+    int flags = (extended ? REG_EXTENDED : 0) | (icase ? REG_ICASE : 0);
+    regex_t posix;
+    if (::regcomp(&posix,pat,flags))
+	return true;
+    // same layout and adjustment as String::matches() does
+    regmatch_t ref[CHECK_MATCH + 1];
+    bool refOk = !::regexec(&posix,subject.safe(),CHECK_MATCH,ref + 1,0);
+    ::regfree(&posix);
+    int count = 0;
+    if (refOk) {
+	ref[0].rm_so = ref[1].rm_so;
+	ref[0].rm_eo = 0;
+	for (int i = 1; i <= CHECK_MATCH; i++) {
+	    if (ref[i].rm_so != -1) {
+		ref[0].rm_eo = ref[i].rm_eo - ref[0].rm_so;
+		ref[i].rm_eo -= ref[i].rm_so;
+		count = i;
+	    }
+	    else
+		ref[i].rm_eo = 0;
+	}
+	if (count > 1) {
+	    for (int i = 0; i < count; i++)
+		ref[i] = ref[i + 1];
+	    ref[count].rm_so = -1;
+	    count--;
+	}
+    }
+    Regexp rex(pat,extended,icase);
+    String str(subject);
+    bool ok = str.matches(rex);
+    m_cases++;
+    bool same = (ok == refOk);
+    if (same && ok) {
+	same = (str.matchCount() == count);
+	for (int i = 0; same && (i <= count); i++)
+	    same = (str.matchOffset(i) == (int)ref[i].rm_so) && (str.matchLength(i) == (int)ref[i].rm_eo);
+    }
+    if (same)
+	return true;
+    m_diffs++;
+    String tmp;
+    for (int i = 0; ok && (i <= str.matchCount()); i++)
+	tmp << " " << str.matchOffset(i) << "+" << str.matchLength(i);
+    tmp << " expected";
+    for (int i = 0; refOk && (i <= count); i++)
+	tmp << " " << (int)ref[i].rm_so << "+" << (int)ref[i].rm_eo;
+    Debug("regexcheck",DebugWarn,"'%s'%s%s on '%s' matched %s:%s",pat.c_str(),
+	extended ? " extended" : "",icase ? " icase" : "",subject.c_str(),
+	String::boolText(ok),tmp.c_str());
+    return false;
+}
+
+void RegexCheck::initialize()
+{
+    Output("Initializing module RegexCheck");
+    if (!m_first)
+	return;
+    m_first = false;
+    // the seed and amount of patterns can be set in yate.conf [regexcheck]
+    Random::srandom(Engine::config().getIntValue("regexcheck","seed",1));
+    unsigned int patterns = Engine::config().getIntValue("regexcheck","patterns",4000,1);
+    static const char s_chars[] = "abcAB";
+    u_int64_t t = Time::now();
+    for (unsigned int n = 0; n < patterns; n++) {
+	bool extended = (0 != (n & 1));
+	bool icase = !(Random::random() % 4);
+	String pat;
+	if (!(Random::random() % 3))
+	    pat << "^";
+	genBranch(pat,0,extended);
+	if (!(Random::random() % 3))
+	    pat << "$";
+	for (unsigned int k = 0; k < 10; k++) {
+	    String subj;
+	    for (int l = Random::random() % 8; l; l--)
+		subj << s_chars[Random::random() % (sizeof(s_chars) - 1)];
+	    if (!check(pat,extended,icase,subj))
+		break;
+	}
+    }
+    t = Time::now() - t;
+    Output("Regexp checked %u cases against regexec() in " FMT64U " ms, %u differences",
+	m_cases,t / 1000,m_diffs);
+}
+
+INIT_PLUGIN(RegexCheck);
+
+/* vi: set ts=8 sw=4 sts=4 noet: */
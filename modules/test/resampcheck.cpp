@@ -0,0 +1,184 @@
+/**
+ * resampcheck.cpp
+ * This file is part of the YATE Project http://YATE.null.ro
+ *
+ * Check of the slin resamplers passband gain and alias rejection
+ *
+ * Yet Another Telephony Engine - a fully featured software PBX and IVR
+ * Copyright (C) 2004-2023 Null Team
+ *
+ * This software is distributed under multiple licenses;
+ * see the COPYING file in the main directory for licensing
+ * information for this specific distribution.
+ *
+ * This use of this software may be subject to additional restrictions.
+ * See the LEGAL file in the main directory for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <yatephone.h>
+
+#include <math.h>
+
+using namespace TelEngine;
+
+// Amplitude of the test tones
+#define TONE_LEVEL 16000.0
+// Output discarded while the filter history fills
+#define SETTLE_MS 50
+
+// A tone fed to a resampler and the frequency to measure in its output
+struct ResampCase {
+    int sRate;
+    int dRate;
+    double tone;
+    double measure;
+    // minimum and maximum gain in dB
+    double minGain;
+    double maxGain;
+    const char* what;
+};
+
+static const ResampCase s_cases[] = {
+    { 8000, 16000, 1000, 1000, -0.5, 0.5, "passband" },
+    { 8000, 16000, 3000, 3000, -1.0, 0.5, "passband edge" },
+    { 8000, 16000, 1000, 7000, -200, -50, "image" },
+    { 16000, 8000, 1000, 1000, -0.5, 0.5, "passband" },
+    { 16000, 8000, 3000, 3000, -1.0, 0.5, "passband edge" },
+    { 16000, 8000, 6000, 2000, -200, -50, "alias" },
+    { 16000, 8000, 5000, 3000, -200, -40, "alias near edge" },
+    { 48000, 8000, 1000, 1000, -0.5, 0.5, "passband" },
+    { 48000, 8000, 11000, 3000, -200, -50, "alias" },
+    { 8000, 48000, 1000, 1000, -0.5, 0.5, "passband" },
+    { 8000, 48000, 1000, 9000, -200, -50, "image" },
+    { 44100, 48000, 1000, 1000, -0.5, 0.5, "passband" },
+    { 48000, 44100, 23000, 21100, -200, -40, "alias near edge" },
+    { 0, 0, 0, 0, 0, 0, 0 }
+};
+
+// Consumer that keeps all the data it receives
+class CaptureConsumer : public DataConsumer
+{
+public:
+    inline CaptureConsumer(const char* format)
+	: DataConsumer(format)
+	{ }
+    virtual unsigned long Consume(const DataBlock& data, unsigned long tStamp, unsigned long flags)
+	{ m_data += data; return invalidStamp(); }
+    DataBlock m_data;
+};
+
+class ResampCheck : public Plugin
+{
+public:
+    ResampCheck();
+    virtual void initialize();
+private:
+    bool run(const ResampCase& test, unsigned int seconds);
+    bool m_first;
+};
+
+// Amplitude of a frequency component in a block of samples, Goertzel algorithm
+static double amplitude(const short* data, unsigned int n, double freq, int rate)
+{
+    double w = 2 * M_PI * freq / rate;
+    double c = 2 * ::cos(w);
+    double s1 = 0;
+    double s2 = 0;
+    for (unsigned int i = 0; i < n; i++) {
+	double s0 = data[i] + c * s1 - s2;
+	s2 = s1;
+	s1 = s0;
+    }
+    double re = s1 - s2 * ::cos(w);
+    double im = s2 * ::sin(w);
+    return 2 * ::sqrt(re * re + im * im) / n;
+}
+
+ResampCheck::ResampCheck()
+    : Plugin("resampcheck"),
+      m_first(true)
+{
+    Output("Hello, I am module ResampCheck");
+}
+
+// Resample a tone in 20ms packets, return true if the gain is in range
+bool ResampCheck::run(const ResampCase& test, unsigned int seconds)
+{
+    String sFmt("slin");
+    if (test.sRate != 8000)
+	sFmt << "/" << test.sRate;
+    String dFmt("slin");
+    if (test.dRate != 8000)
+	dFmt << "/" << test.dRate;
+    DataTranslator* trans = DataTranslator::create(sFmt,dFmt);
+    if (!trans) {
+	Debug("resampcheck",DebugWarn,"No translator from %s to %s",sFmt.c_str(),dFmt.c_str());
+	return false;
+    }
+    CaptureConsumer* cons = new CaptureConsumer(dFmt);
+    trans->getTransSource()->attach(cons);
+    unsigned int samples = test.sRate / 50;
+    DataBlock packet(0,2 * samples);
+    short* s = (short*)packet.data();
+    unsigned long ts = 0;
+    for (unsigned int p = 0; p < 50 * seconds; p++) {
+	for (unsigned int i = 0; i < samples; i++)
+	    s[i] = (short)::floor(TONE_LEVEL * ::sin(2 * M_PI * test.tone * (ts + i) / test.sRate) + 0.5);
+	trans->Consume(packet,ts,0);
+	ts += samples;
+    }
+    trans->getTransSource()->detach(cons);
+    unsigned int skip = test.dRate * SETTLE_MS / 1000;
+    unsigned int n = cons->m_data.length() / 2;
+    bool ok = false;
+    if (n > skip) {
+	const short* d = (const short*)cons->m_data.data() + skip;
+	// measure over a whole number of measured periods
+	n -= skip;
+	unsigned int period = (unsigned int)(test.dRate / 100);
+	n -= n % period;
+	double gain = 20 * ::log10(amplitude(d,n,test.measure,test.dRate) / TONE_LEVEL + 1e-10);
+	ok = (gain >= test.minGain) && (gain <= test.maxGain);
+	// checksum of the whole output, allows comparing builds and CPUs
+	u_int32_t sum = 0;
+	const short* o = (const short*)cons->m_data.data();
+	for (unsigned int i = 0; i < cons->m_data.length() / 2; i++)
+	    sum = sum * 31 + (unsigned short)o[i];
+	Output("%s %d to %d Hz, %.0f Hz tone at %.0f Hz: %.2f dB (%.1f to %.1f), sum %08x",
+	    test.what,test.sRate,test.dRate,test.tone,test.measure,gain,test.minGain,test.maxGain,sum);
+    }
+    if (!ok)
+	Debug("resampcheck",DebugWarn,"Resampling %s to %s: %s out of range",
+	    sFmt.c_str(),dFmt.c_str(),test.what);
+    TelEngine::destruct(cons);
+    TelEngine::destruct(trans);
+    return ok;
+}
+
+void ResampCheck::initialize()
+{
+    Output("Initializing module ResampCheck");
+    if (!m_first)
+	return;
+    m_first = false;
+    // length of the tones can be set in yate.conf [resampcheck]
+    unsigned int seconds = Engine::config().getIntValue("resampcheck","seconds",2,1);
+    unsigned int failed = 0;
+    unsigned int count = 0;
+    for (const ResampCase* c = s_cases; c->what; c++, count++) {
+	if (!run(*c,seconds))
+	    failed++;
+    }
+    if (failed)
+	Debug("resampcheck",DebugWarn,"Resampler checks failed %u of %u",failed,count);
+    else
+	Output("Resampler checks passed %u of %u",count,count);
+}
+
+INIT_PLUGIN(ResampCheck);
+
+/* vi: set ts=8 sw=4 sts=4 noet: */
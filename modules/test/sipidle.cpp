@@ -0,0 +1,151 @@
+/**
+ * sipidle.cpp
+ * This file is part of the YATE Project http://YATE.null.ro
+ *
+ * Benchmark of the SIP engine event polling with many idle transactions
+ *
+ * Yet Another Telephony Engine - a fully featured software PBX and IVR
+ * Copyright (C) 2004-2023 Null Team
+ *
+ * This software is distributed under multiple licenses;
+ * see the COPYING file in the main directory for licensing
+ * information for this specific distribution.
+ *
+ * This use of this software may be subject to additional restrictions.
+ * See the LEGAL file in the main directory for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <yatengine.h>
+#include <yatesip.h>
+
+#include <stdio.h>
+
+using namespace TelEngine;
+
+// Party that drops everything sent to it
+class IdleParty : public SIPParty
+{
+public:
+    inline IdleParty()
+	: SIPParty(false), m_sent(0)
+	{ }
+    virtual bool transmit(SIPEvent* event)
+	{ m_sent++; return true; }
+    virtual const char* getProtoName() const
+	{ return "UDP"; }
+    virtual bool setParty(const URI& uri)
+	{ return true; }
+    virtual void* getTransport()
+	{ return 0; }
+    unsigned int m_sent;
+};
+
+// Engine that leaves incoming requests unanswered, as while routing a call
+class IdleEngine : public SIPEngine
+{
+public:
+    inline IdleEngine()
+	: SIPEngine("YATE/bench"), m_requests(0)
+	{ addAllowed("INVITE"); }
+    virtual bool buildParty(SIPMessage* message)
+	{ return false; }
+    virtual void allocTraceId(String& id)
+	{ }
+    virtual void traceMsg(SIPMessage* message, bool incoming = true)
+	{ }
+    virtual void processEvent(SIPEvent* event);
+    unsigned int m_requests;
+};
+
+class SipIdle : public Plugin
+{
+public:
+    SipIdle();
+    virtual void initialize();
+private:
+    void bench(unsigned int count, unsigned int polls);
+    bool m_first;
+};
+
+void IdleEngine::processEvent(SIPEvent* event)
+{
+    if (event && event->isIncoming() && event->getMessage() &&
+	!event->getMessage()->isAnswer() && (event->getState() == SIPTransaction::Trying)) {
+	m_requests++;
+	delete event;
+	return;
+    }
+    SIPEngine::processEvent(event);
+}
+
+SipIdle::SipIdle()
+    : Plugin("sipidle"),
+      m_first(true)
+{
+    Output("Hello, I am module SipIdle");
+}
+
+// Open transactions for incoming INVITEs then time polls that find no event
+void SipIdle::bench(unsigned int count, unsigned int polls)
+{
+    IdleEngine* engine = new IdleEngine;
+    IdleParty* party = new IdleParty;
+    char buf[512];
+    u_int64_t t = Time::now();
+    for (unsigned int i = 0; i < count; i++) {
+	int len = ::snprintf(buf,sizeof(buf),
+	    "INVITE sip:bench@127.0.0.1 SIP/2.0\r\n"
+	    "Via: SIP/2.0/UDP 127.0.0.1:5070;branch=z9hG4bK-bench-%u\r\n"
+	    "From: <sip:caller@127.0.0.1>;tag=%u\r\n"
+	    "To: <sip:bench@127.0.0.1>\r\n"
+	    "Call-ID: bench-%u@127.0.0.1\r\n"
+	    "CSeq: 1 INVITE\r\n"
+	    "Max-Forwards: 70\r\n"
+	    "Content-Length: 0\r\n\r\n",i,i,i);
+	// the engine consumes a reference to the party
+	if (party->ref())
+	    engine->addMessage(party,buf,len);
+    }
+    while (SIPEvent* e = engine->getEvent())
+	engine->processEvent(e);
+    u_int64_t tSetup = Time::now() - t;
+    unsigned int events = 0;
+    t = Time::now();
+    for (unsigned int i = 0; i < polls; i++) {
+	SIPEvent* e = engine->getEvent();
+	if (e) {
+	    events++;
+	    engine->processEvent(e);
+	}
+    }
+    t = Time::now() - t;
+    unsigned int trans = engine->transactionCount();
+    unsigned int requests = engine->m_requests;
+    u_int64_t tClear = Time::now();
+    delete engine;
+    tClear = Time::now() - tClear;
+    Output("%u transactions (%u requests, %u sent): setup %.1f ms, idle getEvent() %.1f ns, %u events, clear %.1f ms",
+	trans,requests,party->m_sent,tSetup / 1000.0,t * 1000.0 / polls,events,tClear / 1000.0);
+    TelEngine::destruct(party);
+}
+
+void SipIdle::initialize()
+{
+    Output("Initializing module SipIdle");
+    if (!m_first)
+	return;
+    m_first = false;
+    // number of polls can be set in yate.conf [sipidle]
+    unsigned int polls = Engine::config().getIntValue("sipidle","polls",100000,1);
+    static const unsigned int s_counts[] = { 1000, 10000, 100000 };
+    for (unsigned int i = 0; i < sizeof(s_counts) / sizeof(s_counts[0]); i++)
+	bench(s_counts[i],polls);
+}
+
+INIT_PLUGIN(SipIdle);
+
+/* vi: set ts=8 sw=4 sts=4 noet: */
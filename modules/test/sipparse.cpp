@@ -0,0 +1,527 @@
+/**
+ * sipparse.cpp
+ * This file is part of the YATE Project http://YATE.null.ro
+ *
+ * Check and benchmark of the SIP message parser against the previous one
+ *
+ * Yet Another Telephony Engine - a fully featured software PBX and IVR
+ * Copyright (C) 2004-2023 Null Team
+ *
+ * This software is distributed under multiple licenses;
+ * see the COPYING file in the main directory for licensing
+ * information for this specific distribution.
+ *
+ * This use of this software may be subject to additional restrictions.
+ * See the LEGAL file in the main directory for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <yatengine.h>
+#include <yatesip.h>
+#include <util.h>
+
+#include <string.h>
+
+using namespace TelEngine;
+
+// Usual packets, parsed by the benchmark
+static const char* s_corpus[] = {
+    "INVITE sip:bob@biloxi.example.com SIP/2.0\r\n"
+    "Via: SIP/2.0/UDP pc33.atlanta.example.com:5060;branch=z9hG4bK776asdhds;rport\r\n"
+    "Max-Forwards: 70\r\n"
+    "To: Bob <sip:bob@biloxi.example.com>\r\n"
+    "From: Alice <sip:alice@atlanta.example.com>;tag=1928301774\r\n"
+    "Call-ID: a84b4c76e66710@pc33.atlanta.example.com\r\n"
+    "CSeq: 314159 INVITE\r\n"
+    "Contact: <sip:alice@pc33.atlanta.example.com>\r\n"
+    "Allow: INVITE, ACK, CANCEL, OPTIONS, BYE, REFER, NOTIFY, MESSAGE, SUBSCRIBE, INFO\r\n"
+    "Supported: replaces, timer\r\n"
+    "User-Agent: SomePhone/1.2.3\r\n"
+    "Content-Type: application/sdp\r\n"
+    "Content-Length: 142\r\n\r\n"
+    "v=0\r\n"
+    "o=alice 2890844526 2890844526 IN IP4 pc33.atlanta.example.com\r\n"
+    "s=-\r\n"
+    "c=IN IP4 192.0.2.101\r\n"
+    "t=0 0\r\n"
+    "m=audio 49172 RTP/AVP 0\r\n"
+    "a=rtpmap:0 PCMU/8000\r\n",
+    "REGISTER sip:registrar.biloxi.example.com SIP/2.0\r\n"
+    "Via: SIP/2.0/UDP bobspc.biloxi.example.com:5060;branch=z9hG4bKnashds7\r\n"
+    "Max-Forwards: 70\r\n"
+    "To: Bob <sip:bob@biloxi.example.com>\r\n"
+    "From: Bob <sip:bob@biloxi.example.com>;tag=456248\r\n"
+    "Call-ID: 843817637684230@998sdasdh09\r\n"
+    "CSeq: 1826 REGISTER\r\n"
+    "Contact: <sip:bob@192.0.2.4>;expires=7200\r\n"
+    "Authorization: Digest username=\"bob\", realm=\"atlanta.example.com\", "
+    "nonce=\"ea9c8e88df84f1cec4341ae6cbe5a359\", opaque=\"\", "
+    "uri=\"sip:registrar.biloxi.example.com\", response=\"dfe56131d1958046689d83306477ecc\"\r\n"
+    "Expires: 7200\r\n"
+    "Content-Length: 0\r\n\r\n",
+    "SIP/2.0 200 OK\r\n"
+    "Via: SIP/2.0/UDP server10.biloxi.example.com;branch=z9hG4bKnashds8;received=192.0.2.3\r\n"
+    "Via: SIP/2.0/UDP bigbox3.site3.atlanta.example.com;branch=z9hG4bK77ef4c2312983.1;received=192.0.2.2\r\n"
+    "Via: SIP/2.0/UDP pc33.atlanta.example.com;branch=z9hG4bK776asdhds;received=192.0.2.1\r\n"
+    "To: Bob <sip:bob@biloxi.example.com>;tag=a6c85cf\r\n"
+    "From: Alice <sip:alice@atlanta.example.com>;tag=1928301774\r\n"
+    "Call-ID: a84b4c76e66710@pc33.atlanta.example.com\r\n"
+    "CSeq: 314159 INVITE\r\n"
+    "Contact: <sip:bob@192.0.2.4>\r\n"
+    "Content-Type: application/sdp\r\n"
+    "Content-Length: 0\r\n\r\n",
+    0
+};
+
+// Unusual or broken packets, only compared
+static const char* s_edge[] = {
+    "INVITE sip:bob@b.com SIP/2.0\r\n"
+    "Via: SIP/2.0/UDP h:5060 ; branch=z9hG4bK1 ;rport; received = 1.2.3.4 \r\n"
+    "v: SIP/2.0/TCP x;branch=z9hG4bK2\r\n"
+    "max-forwards:70\r\n"
+    "To:  <sip:b@b.com>\r\n"
+    "f: \"A\" <sip:a@a.com>;tag=1\r\n"
+    "i: abc@def\r\n"
+    "CSeq: 1   INVITE\r\n"
+    "Subject: folded\r\n  line here\r\n"
+    "X-Custom : v1 ; p ; q=\r\n"
+    "Proxy-Authorization: Digest username=\"a,b\", realm=\"r\" , nonce=\"n\"\r\n"
+    "k: timer\r\n"
+    "e: gzip\r\n"
+    "c: application/sdp\r\n"
+    "l: 28\r\n\r\n"
+    "v=0\r\no=- 1 1 IN IP4 1.1.1.1\r\n",
+    "SIP/2.0   180  Ringing  \r\nVia: a\r\nCSeq: 2 invite\r\nContent-Length: 0\r\n\r\n",
+    "sip/2.0 200 OK\nVia: a\ncseq: 3 BYE\n\n",
+    "SIP/2.0 2000 OK\r\n\r\n",
+    "SIP/2.0 200\r\n\r\n",
+    "SIP/2.0 200 \r\n\r\n",
+    "OPTIONS  sip:x   SIP/2.0 \r\n\r\n",
+    "OPTIONS sip:x SIP/2.0x\r\n\r\n",
+    "OPTIONS sip:x SIP/2.01\r\nBad header\r\n\r\n",
+    "OPTIONS sip:x SIP/2.0\r\n: v\r\n\r\n",
+    "OPTIONS sip:x SIP/2.0\r\n \t \r\nVia: x\r\n\r\n",
+    "\r\n\r\nACK sip:x SIP/2.0\r\nVia: x\r\n",
+    "OPTIONS sip:x SIP/2.0\rVia: cr\rCSeq: 5 OPTIONS\r\r",
+    "MESSAGE sip:x SIP/2.0\r\nVia: x\r\nContent-Type: text/plain\r\nContent-Length: 5\r\n\r\nhello world",
+    "OPT1ONS sip:x SIP/2.0\r\n\r\n",
+    0
+};
+
+static bool isContinuationBlank(char c)
+{
+    return ((c == ' ') || (c == '\t'));
+}
+
+// MimeBody::getUnfoldedLine() before the parser rewrite
+static String* oldUnfoldedLine(const char*& buf, int& len)
+{
+    String* res = new String;
+    const char* b = buf;
+    const char* s = b;
+    int l = len;
+    int e = 0;
+    for (;(l > 0); ++b, --l) {
+	bool goOut = false;
+	switch (*b) {
+	    case '\r':
+		// CR is optional but skip over it if exists
+		if ((l > 0) && (b[1] == '\n')) {
+		    ++b;
+		    --l;
+		}
+	    case '\n':
+		++b;
+		--l;
+		{
+		    String line(s,e);
+		    *res << line;
+		}
+		// Skip over any continuation characters at start of next line
+		goOut = true;
+		while ((l > 0) && *res && isContinuationBlank(b[0])) {
+		    ++b;
+		    --l;
+		    goOut = false;
+		}
+		s = b;
+		e = 0;
+		if (!goOut) {
+		    --b;
+		    ++l;
+		}
+		break;
+	    case '\0':
+		// Should not happen - but let's accept what we got
+		*res << s;
+		goOut = true;
+		if (l <= 16) {
+		    e = l;
+		    do {
+			++b;
+			--l;
+		    } while (l && !*b);
+		}
+		// End parsing
+		b += l;
+		l = 0;
+		e = 0;
+		break;
+	    default:
+		// Just count this character - we'll pick it later
+		++e;
+	}
+	// Exit without adjusting p and l
+	if (goOut)
+	    break;
+    }
+    buf = b;
+    len = l;
+    // Collect any leftover characters
+    if (e) {
+	String line(s,e);
+	*res << line;
+    }
+    res->trimBlanks();
+    return res;
+}
+
+// MimeHeaderLine parameters parsing before the parser rewrite
+class OldHeaderLine : public MimeHeaderLine
+{
+public:
+    OldHeaderLine(const char* name, const String& value);
+};
+
+// MimeAuthLine parameters parsing before the parser rewrite
+class OldAuthLine : public MimeAuthLine
+{
+public:
+    OldAuthLine(const char* name, const String& value);
+};
+
+// SIPMessage::parse() before the parser rewrite
+class OldSIPMessage : public SIPMessage
+{
+public:
+    OldSIPMessage(const char* buf, int len);
+private:
+    bool oldParseFirst(String& line);
+    bool oldParse(const char* buf, int len);
+};
+
+class SipParse : public Plugin
+{
+public:
+    SipParse();
+    virtual void initialize();
+private:
+    bool check(const char* buf);
+    void bench(const char* buf, unsigned int count);
+    bool m_first;
+};
+
+OldHeaderLine::OldHeaderLine(const char* name, const String& value)
+    : MimeHeaderLine(name,String::empty())
+{
+    if (value.null())
+	return;
+    int sp = findSep(value,m_separator);
+    if (sp < 0) {
+	assign(value);
+	return;
+    }
+    assign(value,sp);
+    trimBlanks();
+    while (sp < (int)value.length()) {
+	int ep = findSep(value,m_separator,sp+1);
+	if (ep <= sp)
+	    ep = value.length();
+	int eq = value.find('=',sp+1);
+	if ((eq > 0) && (eq < ep)) {
+	    String pname(value.substr(sp+1,eq-sp-1));
+	    String pvalue(value.substr(eq+1,ep-eq-1));
+	    pname.trimBlanks();
+	    pvalue.trimBlanks();
+	    if (!pname.null())
+		m_params.append(new NamedString(pname,pvalue));
+	}
+	else {
+	    String pname(value.substr(sp+1,ep-sp-1));
+	    pname.trimBlanks();
+	    if (!pname.null())
+		m_params.append(new NamedString(pname));
+	}
+	sp = ep;
+    }
+}
+
+OldAuthLine::OldAuthLine(const char* name, const String& value)
+    : MimeAuthLine(name,String::empty())
+{
+    if (value.null())
+	return;
+    int sp = value.find(' ');
+    if (sp < 0) {
+	assign(value);
+	return;
+    }
+    assign(value,sp);
+    trimBlanks();
+    while (sp < (int)value.length()) {
+	int ep = value.find(m_separator,sp+1);
+	int quot = value.find('"',sp+1);
+	if ((quot > sp) && (quot < ep)) {
+	    quot = value.find('"',quot+1);
+	    if (quot > sp)
+		ep = value.find(m_separator,quot+1);
+	}
+	if (ep <= sp)
+	    ep = value.length();
+	int eq = value.find('=',sp+1);
+	if ((eq > 0) && (eq < ep)) {
+	    String pname(value.substr(sp+1,eq-sp-1));
+	    String pvalue(value.substr(eq+1,ep-eq-1));
+	    pname.trimBlanks();
+	    pvalue.trimBlanks();
+	    if (!pname.null())
+		m_params.append(new NamedString(pname,pvalue));
+	}
+	else {
+	    String pname(value.substr(sp+1,ep-sp-1));
+	    pname.trimBlanks();
+	    if (!pname.null())
+		m_params.append(new NamedString(pname));
+	}
+	sp = ep;
+    }
+}
+
+OldSIPMessage::OldSIPMessage(const char* buf, int len)
+    : SIPMessage("","","")
+{
+    version.clear();
+    m_outgoing = false;
+    m_valid = buf && *buf && oldParse(buf,len);
+}
+
+bool OldSIPMessage::oldParseFirst(String& line)
+{
+    if (line.null())
+	return false;
+    static Regexp r("^\\([Ss][Ii][Pp]/[0-9]\\.[0-9]\\+\\)[[:space:]]\\+\\([0-9][0-9][0-9]\\)[[:space:]]\\+\\(.*\\)$");
+    if (line.matches(r)) {
+	// Answer: <version> <code> <reason-phrase>
+	m_answer = true;
+	version = line.matchString(1).toUpper();
+	code = line.matchString(2).toInteger();
+	reason = line.matchString(3);
+    }
+    else {
+	static Regexp r2("^\\([[:alpha:]]\\+\\)[[:space:]]\\+\\([^[:space:]]\\+\\)[[:space:]]\\+\\([Ss][Ii][Pp]/[0-9]\\.[0-9]\\+\\)$");
+	if (line.matches(r2)) {
+	    // Request: <method> <uri> <version>
+	    m_answer = false;
+	    method = line.matchString(1).toUpper();
+	    uri = line.matchString(2);
+	    version = line.matchString(3).toUpper();
+	    if (method == YSTRING("ACK"))
+		m_ack = true;
+	}
+	else
+	    return false;
+    }
+    return true;
+}
+
+bool OldSIPMessage::oldParse(const char* buf, int len)
+{
+    String* line = 0;
+    while (len > 0) {
+	line = oldUnfoldedLine(buf,len);
+	if (!line->null())
+	    break;
+	// Skip any initial empty lines
+	TelEngine::destruct(line);
+    }
+    if (!line)
+	return false;
+    if (!oldParseFirst(*line)) {
+	line->destruct();
+	return false;
+    }
+    line->destruct();
+    int clen = -1;
+    while (len > 0) {
+	line = oldUnfoldedLine(buf,len);
+	if (line->null()) {
+	    // Found end of headers
+	    line->destruct();
+	    break;
+	}
+	int col = line->find(':');
+	if (col <= 0) {
+	    line->destruct();
+	    return false;
+	}
+	String name = line->substr(0,col);
+	name.trimBlanks();
+	if (name.null()) {
+	    line->destruct();
+	    return false;
+	}
+	name = uncompactForm(name);
+	*line >> ":";
+	line->trimBlanks();
+	if ((name &= "WWW-Authenticate") ||
+	    (name &= "Proxy-Authenticate") ||
+	    (name &= "Authorization") ||
+	    (name &= "Proxy-Authorization"))
+	    header.append(new OldAuthLine(name,*line));
+	else
+	    header.append(new OldHeaderLine(name,*line));
+
+	if ((clen < 0) && (name &= "Content-Length"))
+	    clen = line->toInteger(-1,10);
+	else if ((m_cseq < 0) && (name &= "CSeq")) {
+	    int sep = line->find(' ');
+	    if (sep > 0) {
+		m_cseq = line->substr(0,sep).toInteger(-1,10);
+		if (m_answer) {
+		    method = line->substr(sep + 1);
+		    method.trimBlanks().toUpper();
+		}
+	    }
+	}
+	line->destruct();
+    }
+    if ((clen >= 0) && (clen < len))
+	len = clen;
+    buildBody(buf,len);
+    return true;
+}
+
+// Append the header lines of a message or body with all their parameters
+static void dumpHeaders(String& dump, const ObjList& headers)
+{
+    for (const ObjList* l = headers.skipNull(); l; l = l->skipNext()) {
+	const MimeHeaderLine* h = static_cast<const MimeHeaderLine*>(l->get());
+	dump << "\r\n'" << h->name() << "'='" << *h << "'";
+	if (YOBJECT(MimeAuthLine,h))
+	    dump << " auth";
+	for (const ObjList* p = h->params().skipNull(); p; p = p->skipNext()) {
+	    const NamedString* ns = static_cast<const NamedString*>(p->get());
+	    dump << " '" << ns->name() << "'='" << *ns << "'";
+	}
+    }
+}
+
+// Describe everything the parser extracted from a packet
+static void dumpMessage(String& dump, const SIPMessage* msg)
+{
+    if (!msg) {
+	dump = "invalid";
+	return;
+    }
+    dump << "answer=" << String::boolText(msg->isAnswer()) <<
+	" ack=" << String::boolText(msg->isACK()) <<
+	" method='" << msg->method << "' uri='" << msg->uri <<
+	"' version='" << msg->version << "' code=" << msg->code <<
+	" reason='" << msg->reason << "' cseq=" << msg->getCSeq();
+    dumpHeaders(dump,msg->header);
+    if (!msg->body)
+	return;
+    const DataBlock& data = msg->body->getBody();
+    dump << "\r\nbody '" << msg->body->getType() << "' '";
+    dump.append((const char*)data.data(),data.length());
+    dump << "'";
+    dumpHeaders(dump,msg->body->headers());
+    const MimeSdpBody* sdp = YOBJECT(MimeSdpBody,msg->body);
+    if (sdp) {
+	for (const ObjList* l = sdp->lines().skipNull(); l; l = l->skipNext()) {
+	    const NamedString* ns = static_cast<const NamedString*>(l->get());
+	    dump << "\r\nsdp '" << ns->name() << "'='" << *ns << "'";
+	}
+    }
+}
+
+SipParse::SipParse()
+    : Plugin("sipparse"),
+      m_first(true)
+{
+    Output("Hello, I am module SipParse");
+}
+
+// Compare the current parser with the previous one on a packet
+bool SipParse::check(const char* buf)
+{
+    int len = ::strlen(buf);
+    SIPMessage* msg = SIPMessage::fromParsing(0,buf,len);
+    OldSIPMessage* old = new OldSIPMessage(buf,len);
+    String got;
+    String expect;
+    dumpMessage(got,msg);
+    dumpMessage(expect,old->isValid() ? old : 0);
+    TelEngine::destruct(msg);
+    TelEngine::destruct(old);
+    if (got == expect)
+	return true;
+    Debug("sipparse",DebugWarn,"Parsing '%.20s' returned:\r\n%s\r\nexpected:\r\n%s",
+	buf,got.c_str(),expect.c_str());
+    return false;
+}
+
+// Time parsing and destroying a packet with the current and previous parser
+void SipParse::bench(const char* buf, unsigned int count)
+{
+    int len = ::strlen(buf);
+    u_int64_t t = Time::now();
+    for (unsigned int i = 0; i < count; i++) {
+	SIPMessage* msg = SIPMessage::fromParsing(0,buf,len);
+	TelEngine::destruct(msg);
+    }
+    u_int64_t tNew = Time::now() - t;
+    t = Time::now();
+    for (unsigned int i = 0; i < count; i++) {
+	SIPMessage* msg = new OldSIPMessage(buf,len);
+	TelEngine::destruct(msg);
+    }
+    u_int64_t tOld = Time::now() - t;
+    String first(buf,::strcspn(buf,"\r\n"));
+    Output("%s: %.0f msg/s, previous parser %.0f msg/s (%.2fx)",first.c_str(),
+	count * 1000000.0 / tNew,count * 1000000.0 / tOld,(double)tOld / tNew);
+}
+
+void SipParse::initialize()
+{
+    Output("Initializing module SipParse");
+    if (!m_first)
+	return;
+    m_first = false;
+    unsigned int checked = 0;
+    unsigned int failed = 0;
+    for (unsigned int i = 0; s_corpus[i]; i++, checked++) {
+	if (!check(s_corpus[i]))
+	    failed++;
+    }
+    for (unsigned int i = 0; s_edge[i]; i++, checked++) {
+	if (!check(s_edge[i]))
+	    failed++;
+    }
+    if (failed) {
+	Debug("sipparse",DebugWarn,"Parser results differ on %u of %u packets",failed,checked);
+	return;
+    }
+    Output("Parser results match the previous parser on %u packets",checked);
+    // amount of work can be set in yate.conf [sipparse]
+    unsigned int count = Engine::config().getIntValue("sipparse","count",100000,1);
+    for (unsigned int i = 0; s_corpus[i]; i++)
+	bench(s_corpus[i],count);
+}
+
+INIT_PLUGIN(SipParse);
+
+/* vi: set ts=8 sw=4 sts=4 noet: */
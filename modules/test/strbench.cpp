@@ -0,0 +1,243 @@
+/**
+ * strbench.cpp
+ * This file is part of the YATE Project http://YATE.null.ro
+ *
+ * Check and benchmark of the String inline buffer and move operations
+ *
+ * Yet Another Telephony Engine - a fully featured software PBX and IVR
+ * Copyright (C) 2004-2023 Null Team
+ *
+ * This software is distributed under multiple licenses;
+ * see the COPYING file in the main directory for licensing
+ * information for this specific distribution.
+ *
+ * This use of this software may be subject to additional restrictions.
+ * See the LEGAL file in the main directory for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <yatengine.h>
+
+#include <string.h>
+
+using namespace TelEngine;
+
+// Parameters of a call.route message with values of usual lengths
+static const char* s_params[][2] = {
+    { "id", "sip/1234" },
+    { "module", "sip" },
+    { "status", "incoming" },
+    { "address", "192.168.168.10:5060" },
+    { "billid", "1700000000-42" },
+    { "answered", "false" },
+    { "direction", "incoming" },
+    { "callid", "sip/6d3b1f0c2a8e4f5b9a7c@192.168.168.10/1a2b3c4d/" },
+    { "caller", "1001" },
+    { "called", "0040212345678" },
+    { "callername", "Front Desk" },
+    { "antiloop", "19" },
+    { "ip_host", "192.168.168.10" },
+    { "ip_port", "5060" },
+    { "ip_transport", "UDP" },
+    { "connection_id", "general" },
+    { "connection_reliable", "false" },
+    { "sip_uri", "sip:0040212345678@pbx.example.com" },
+    { "sip_from", "\"Front Desk\" <sip:1001@pbx.example.com>;tag=8f2d61a0" },
+    { "sip_to", "<sip:0040212345678@pbx.example.com>" },
+    { "sip_callid", "6d3b1f0c2a8e4f5b9a7c@192.168.168.10" },
+    { "sip_contact", "<sip:1001@192.168.168.10:5060>" },
+    { "sip_user-agent", "Yate/6.4.1" },
+    { "sip_allow", "INVITE, ACK, CANCEL, BYE, OPTIONS, INFO, REFER, NOTIFY" },
+    { "sip_supported", "replaces, timer" },
+    { "rtp_addr", "192.168.168.10" },
+    { "rtp_port", "16384" },
+    { "formats", "alaw,mulaw,g729" },
+    { "media", "yes" },
+    { "rtp_forward", "possible" },
+    { 0, 0 }
+};
+
+class StringBench : public Plugin
+{
+public:
+    StringBench();
+    virtual void initialize();
+private:
+    bool check();
+    bool fail(const char* what, const String& got, const char* expect);
+    void benchMessage(unsigned int count);
+    void benchString(unsigned int count);
+    bool m_first;
+};
+
+// Check if the value of a String is held in its inline buffer
+static inline bool isInline(const String& str)
+{
+    const char* p = str.c_str();
+    return p && (p >= (const char*)&str) && (p < (const char*)(&str + 1));
+}
+
+// Count the values and names held outside their String
+static unsigned int heapBuffers(const NamedList& list)
+{
+    unsigned int n = (list.c_str() && !isInline(list)) ? 1 : 0;
+    for (const ObjList* o = list.paramList()->skipNull(); o; o = o->skipNext()) {
+	const NamedString* ns = static_cast<const NamedString*>(o->get());
+	if (ns->c_str() && !isInline(*ns))
+	    n++;
+	if (ns->name().c_str() && !isInline(ns->name()))
+	    n++;
+    }
+    return n;
+}
+
+StringBench::StringBench()
+    : Plugin("strbench"),
+      m_first(true)
+{
+    Output("Hello, I am module StringBench");
+}
+
+bool StringBench::fail(const char* what, const String& got, const char* expect)
+{
+    Debug("strbench",DebugWarn,"%s: got '%s' (%u) expected '%s' (%u)",what,
+	got.safe(),got.length(),TelEngine::c_safe(expect),(unsigned int)::strlen(expect));
+    return false;
+}
+
+#define CHECK(what,str,expect) \
+    if (((str) != (expect)) || ((str).length() != ::strlen(expect)) || \
+	((str).hash() != String::hash(expect))) \
+	return fail(what,str,expect)
+
+// Values crossing the inline buffer size, overlapping sources, moves
+bool StringBench::check()
+{
+    char buf[YSTRING_INLINE * 3];
+    for (unsigned int len = 0; len < sizeof(buf) - 1; len++) {
+	::memset(buf,'a' + (len % 26),len);
+	buf[len] = 0;
+	String s(buf);
+	CHECK("construct",s,buf);
+	if ((len < YSTRING_INLINE) && len && !isInline(s))
+	    return fail("not inline",s,buf);
+	String c(s);
+	CHECK("copy",c,buf);
+	// append to itself, the source is the value being replaced
+	String d(buf);
+	d += d;
+	String dd(buf);
+	dd += buf;
+	CHECK("self append",d,dd.safe());
+	// assign a part of itself
+	String e(buf);
+	e = e.c_str() + len / 2;
+	CHECK("self assign",e,buf + len / 2);
+	String f(buf);
+	f.insert(0,f);
+	CHECK("self insert",f,dd.safe());
+	String g(buf);
+	g.append("xyz").trimBlanks();
+	String gg(buf);
+	gg << "xyz";
+	CHECK("append",g,gg.safe());
+	g.assign(buf,len / 3);
+	CHECK("assign part",g,String(buf,len / 3).safe());
+	g = (int64_t)-1234567890123LL;
+	CHECK("number",g,"-1234567890123");
+#if __cplusplus >= 201103L
+	String m(static_cast<String&&>(c));
+	CHECK("move construct",m,buf);
+	if (!c.null())
+	    return fail("moved from",c,"");
+	String n("previous value of the target string");
+	n = static_cast<String&&>(m);
+	CHECK("move assign",n,buf);
+	if (!m.null())
+	    return fail("moved from",m,"");
+#endif
+    }
+    Output("String checks passed for lengths 0 to %u",(unsigned int)sizeof(buf) - 2);
+    return true;
+}
+
+// Build, copy, update and destroy a call.route like message
+void StringBench::benchMessage(unsigned int count)
+{
+    unsigned int heap = 0;
+    u_int64_t t = Time::now();
+    for (unsigned int n = 0; n < count; n++) {
+	Message* m = new Message("call.route");
+	for (unsigned int i = 0; s_params[i][0]; i++)
+	    m->addParam(s_params[i][0],s_params[i][1]);
+	Message* c = new Message(*m);
+	c->setParam("called","0040212345679");
+	c->setParam("antiloop",(int)18);
+	c->setParam("answered",String::boolText(true));
+	if (!n)
+	    heap = heapBuffers(*m) + heapBuffers(*c);
+	TelEngine::destruct(c);
+	TelEngine::destruct(m);
+    }
+    t = Time::now() - t;
+    Output("Message build, copy, update, destroy: %.2f us per iteration, %u heap string buffers of %u strings",
+	(double)t / count,heap,(unsigned int)(2 * (1 + 2 * (sizeof(s_params) / sizeof(s_params[0]) - 1))));
+}
+
+// Short value assignments and moves of long values
+void StringBench::benchString(unsigned int count)
+{
+    String long1("sip:0040212345678@pbx.example.com;transport=tcp;user=phone");
+    unsigned int total = 0;
+    u_int64_t t = Time::now();
+    for (unsigned int n = 0; n < count; n++) {
+	String s;
+	s = (int)n;
+	s << ",true";
+	total += s.length();
+    }
+    u_int64_t tShort = Time::now() - t;
+    // pass a long value back and forth between two strings
+    String a(long1);
+    String b;
+    t = Time::now();
+    for (unsigned int n = 0; n < count; n++) {
+	b = a;
+	a = b;
+    }
+    total += a.length();
+    u_int64_t tCopy = Time::now() - t;
+#if __cplusplus >= 201103L
+    t = Time::now();
+    for (unsigned int n = 0; n < count; n++) {
+	b = static_cast<String&&>(a);
+	a = static_cast<String&&>(b);
+    }
+    total += a.length();
+    u_int64_t tMove = Time::now() - t;
+#else
+    u_int64_t tMove = 0;
+#endif
+    Output("String ns/op: short number and append %.1f, long copy %.1f, long move %.1f (%u)",
+	tShort * 1000.0 / count,tCopy * 1000.0 / count,tMove * 1000.0 / count,total);
+}
+
+void StringBench::initialize()
+{
+    Output("Initializing module StringBench");
+    if (!m_first)
+	return;
+    m_first = false;
+    if (!check())
+	return;
+    // amount of work can be set in yate.conf [strbench]
+    benchMessage(Engine::config().getIntValue("strbench","messages",100000,1));
+    benchString(Engine::config().getIntValue("strbench","strings",1000000,1));
+}
+
+INIT_PLUGIN(StringBench);
+
+/* vi: set ts=8 sw=4 sts=4 noet: */
@@ -1918,6 +1918,7 @@ void YRTPPlugin::initialize()
     s_monitor = cfg.getBoolValue("general","monitoring",false);
     s_sleep = cfg.getIntValue("general","defsleep",5);
     RTPGroup::setMinSleep(cfg.getIntValue("general","minsleep"));
+    RTPGroup::setEventDriven(cfg.getBoolValue("general","eventdriven"));
     s_priority = Thread::priority(cfg.getValue("general","thread"));
     s_affinity = cfg.getValue("general","affinity");
     s_rtpWarnSeq = cfg.getBoolValue("general","rtp_warn_seq",true);
@@ -42,6 +42,7 @@ class YateTCPParty;                      // A SIP TCP/TLS party
 class YateSIPEngine;                     // The SIP engine
 class YateSIPLine;                       // A line
 class YateSIPEndPoint;                   // Endpoint processor
+class YateSIPWorker;                     // Sharded event processor
 class SIPDriver;
 
 #define EXPIRES_MIN 60
@@ -769,11 +770,6 @@ public:
     bool hasActiveTransaction(YateSIPTransport* trans);
     // Check if the engine has pending transactions
     bool hasInitialTransaction();
-    // Clear transactions
-    inline void clearTransactions() {
-	    Lock lck(this);
-	    m_transList.clear();
-	}
     inline bool update() const
 	{ return m_update; }
     inline bool prack() const
@@ -878,12 +874,19 @@ class YateSIPEndPoint : public Thread
 {
     friend class SIPDriver;
     friend class YateSIPTCPListener;
+    friend class YateSIPWorker;
 public:
     YateSIPEndPoint(Thread::Priority prio = Thread::Normal,
-	unsigned int partyMutexCount = 5);
+	unsigned int partyMutexCount = 5, unsigned int workers = 0,
+	unsigned int workerQueue = 1000);
     ~YateSIPEndPoint();
     bool Init(void);
     void run(void);
+    // Process an event retrieved from engine, consumes the event
+    // With workers this runs concurrently in several threads, events of the same
+    //  Call-ID are never processed in parallel. Anything shared between dialogs
+    //  (counters, lists, other calls) must be protected by a lock
+    void handleEvent(SIPEvent* e);
     bool incoming(SIPEvent* e, SIPTransaction* t);
     void invite(SIPEvent* e, SIPTransaction* t);
     void regReq(SIPEvent* e, SIPTransaction* t);
@@ -937,8 +940,7 @@ public:
 	bool udp = true, bool tcp = true, bool tls = true);
     inline YateSIPEngine* engine() const
 	{ return m_engine; }
-    inline void incFailedAuths()
-	{ m_failedAuths++; }
+    void incFailedAuths();
     inline unsigned int failedAuths()
     {
 	unsigned int tmp = m_failedAuths;
@@ -957,13 +959,24 @@ public:
 	m_timedOutByes = 0;
 	return tmp;
     }
+    // Retrieve the number of event processing workers
+    inline unsigned int workerCount() const
+	{ return m_workerCount; }
+    // Append event processing workers status
+    void workersStatus(String& str);
     RWLockPool m_partyMutexPool;         // SIPParty mutex pool
     // Check if data is allowed to be read from socket(s) and processed
     static bool canRead();
     static int s_evCount;
 private:
+    // Queue an event to the worker handling its Call-ID, return false if not queued
+    bool queueEvent(SIPEvent* e);
+    // Stop the workers and wait for them to process their queued events
+    void stopWorkers();
+    // Worker termination notification
+    void workerTerminated(YateSIPWorker* worker);
     YateSIPEngine *m_engine;
-    Mutex m_mutex;                       // Protect transports and listeners
+    Mutex m_mutex;                       // Protect transports, listeners and workers
     ObjList m_transports;                // All transports (non UDP are not owned)
     YateSIPUDPTransport* m_defTransport; // Default transport (pointer to object in m_transports)
     ObjList m_listeners;                 // Listeners list
@@ -971,6 +984,57 @@ private:
     unsigned int m_failedAuths;
     unsigned int m_timedOutTrs;
     unsigned int m_timedOutByes;
+    Thread::Priority m_prio;             // Priority of the worker threads
+    YateSIPWorker** m_workers;           // Event processing workers
+    unsigned int m_workerCount;          // Number of workers, 0 to process in endpoint
+    unsigned int m_workerQueue;          // Maximum number of events queued to a worker
+};
+
+// SIP event processor for the dialogs whose Call-ID hashes to it
+// Events of the same Call-ID are always handled in order by the same worker
+// The queue is bounded: when full new requests are rejected and other events
+//  make the endpoint wait, which stops it from retrieving more events
+class YateSIPWorker : public Thread
+{
+public:
+    YateSIPWorker(YateSIPEndPoint* ep, unsigned int index, Thread::Priority prio,
+	unsigned int maxQueue);
+    ~YateSIPWorker();
+    virtual void run();
+    // Queue an event, takes ownership of it on success
+    // Fails if the queue is full, unless forced
+    bool enqueue(SIPEvent* e, bool force = false);
+    // Events waiting to be processed
+    inline unsigned int queued() const
+	{ return m_queued; }
+    // New requests rejected because the queue was full
+    inline unsigned int rejected() const
+	{ return m_rejected; }
+    inline void incRejected()
+	{ m_rejected++; }
+    // Times the endpoint had to wait for room in the queue
+    inline unsigned int stalled() const
+	{ return m_stalled; }
+    inline void incStalled()
+	{ m_stalled++; }
+    // Events processed in a row since the queue was last empty
+    inline int evCount() const
+	{ return m_evCount; }
+    inline unsigned int index() const
+	{ return m_index; }
+private:
+    SIPEvent* dequeue();
+    YateSIPEndPoint* m_ep;
+    unsigned int m_index;
+    Mutex m_mutex;
+    Semaphore m_semaphore;
+    ObjList m_events;                    // Queued events as GenPointer<SIPEvent>
+    ObjList* m_last;                     // Last item in queue, used to append
+    unsigned int m_queued;
+    unsigned int m_maxQueue;
+    unsigned int m_rejected;
+    unsigned int m_stalled;
+    int m_evCount;
 };
 
 // Handle transfer requests
@@ -5214,8 +5278,7 @@ void YateSIPEngine::transportChangedStatus(YateSIPTransport* trans, int stat, co
 	return;
     // Clear transactions
     Lock lock(this);
-    for (ObjList* l = m_transList.skipNull(); l; l = l->skipNext()) {
-	SIPTransaction* t = static_cast<SIPTransaction*>(l->get());
+    for (SIPTransaction* t = firstTransaction(); t; t = nextTransaction(t)) {
 	if (t->initialMessage() && t->initialMessage()->getParty() &&
 	    trans == t->initialMessage()->getParty()->getTransport()) {
 	    bool active = t->isActive();
@@ -5233,8 +5296,7 @@ bool YateSIPEngine::hasActiveTransaction(YateSIPTransport* trans)
     if (!trans)
 	return false;
     Lock lock(this);
-    for (ObjList* l = m_transList.skipNull(); l; l = l->skipNext()) {
-	SIPTransaction* t = static_cast<SIPTransaction*>(l->get());
+    for (SIPTransaction* t = firstTransaction(); t; t = nextTransaction(t)) {
 	if (t->isActive() && t->initialMessage() && t->initialMessage()->getParty() &&
 	    trans == t->initialMessage()->getParty()->getTransport())
 	    return true;
@@ -5246,8 +5308,7 @@ bool YateSIPEngine::hasActiveTransaction(YateSIPTransport* trans)
 bool YateSIPEngine::hasInitialTransaction()
 {
     Lock lock(this);
-    for (ObjList* l = m_transList.skipNull(); l; l = l->skipNext()) {
-	SIPTransaction* t = static_cast<SIPTransaction*>(l->get());
+    for (SIPTransaction* t = firstTransaction(); t; t = nextTransaction(t)) {
 	if (t->getState() == SIPTransaction::Initial)
 	    return true;
     }
@@ -5428,14 +5489,23 @@ bool YateSIPEngine::checkUser(String& username, const String& realm, const Strin
 }
 
 
-YateSIPEndPoint::YateSIPEndPoint(Thread::Priority prio, unsigned int partyMutexCount)
+YateSIPEndPoint::YateSIPEndPoint(Thread::Priority prio, unsigned int partyMutexCount,
+    unsigned int workers, unsigned int workerQueue)
     : Thread("YSIP EndPoint",prio),
       m_partyMutexPool(partyMutexCount,"SIPParty"),
       m_engine(0), m_mutex(true,"YateSIPEndPoint"), m_defTransport(0),
-      m_failedAuths(0),m_timedOutTrs(0), m_timedOutByes(0)
+      m_failedAuths(0),m_timedOutTrs(0), m_timedOutByes(0),
+      m_prio(prio), m_workers(0), m_workerCount(workers), m_workerQueue(workerQueue)
+{
+    Debug(&plugin,DebugAll,"YateSIPEndPoint::YateSIPEndPoint(%s,%u) [%p]",
+	Thread::priority(prio),workers,this);
+}
+
+// Authentication may fail in several worker or register threads at once
+void YateSIPEndPoint::incFailedAuths()
 {
-    Debug(&plugin,DebugAll,"YateSIPEndPoint::YateSIPEndPoint(%s) [%p]",
-	Thread::priority(prio),this);
+    Lock lck(plugin);
+    m_failedAuths++;
 }
 
 YateSIPEndPoint::~YateSIPEndPoint()
@@ -5451,6 +5521,7 @@ YateSIPEndPoint::~YateSIPEndPoint()
 	m_engine = 0;
     }
     m_defTransport = 0;
+    delete[] m_workers;
     plugin.epTerminated(this);
 }
 
@@ -5880,6 +5951,15 @@ bool YateSIPEndPoint::Init()
 {
     m_engine = new YateSIPEngine(this);
     m_engine->debugChain(&plugin);
+    if (m_workerCount) {
+	m_workers = new YateSIPWorker*[m_workerCount];
+	for (unsigned int i = 0; i < m_workerCount; i++)
+	    m_workers[i] = new YateSIPWorker(this,i,m_prio,m_workerQueue);
+	for (unsigned int i = 0; i < m_workerCount; i++)
+	    m_workers[i]->startup();
+	Debug(&plugin,DebugInfo,"Processing SIP events in %u workers, queue size %u",
+	    m_workerCount,m_workerQueue);
+    }
     return true;
 }
 
@@ -5891,9 +5971,10 @@ bool YateSIPEndPoint::canRead()
 
 void YateSIPEndPoint::run()
 {
+    int evCount = 0;
     for (;;)
     {
-	if (!canRead()) {
+	if (!m_workerCount && !canRead()) {
 	    if (s_evCount == s_floodEvents)
 	        Debug(&plugin,DebugMild,"Flood detected: %d handled events",s_evCount);
 	    else if ((s_evCount % s_floodEvents) == 0)
@@ -5901,72 +5982,269 @@ void YateSIPEndPoint::run()
 	}
 	SIPEvent* e = m_engine->getEvent();
 	if (e)
-	    s_evCount++;
+	    evCount++;
 	else
-	    s_evCount = 0;
-	// hack: use a loop so we can use break and continue
-	for (; e; m_engine->processEvent(e),e = 0) {
-	    SIPTransaction* t = e->getTransaction();
-	    if (!t)
-		continue;
-	    plugin.lock();
-
-	    if (t->isOutgoing() && t->getResponseCode() == 408) {
-	    	if (t->getMethod() == YSTRING("BYE")) {
-		    DDebug(&plugin,DebugInfo,"BYE for transaction %p has timed out",t);
-		    m_timedOutByes++;
-		    plugin.changed();
-		}
-		if (e->getState() == SIPTransaction::Cleared && e->getUserData()) {
-		    DDebug(&plugin,DebugInfo,"Transaction %p has timed out",t);
-		    m_timedOutTrs++;
-		    plugin.changed();
-		}
+	    evCount = 0;
+	if (m_workerCount) {
+	    // workers detect floods on their own, transports follow the busiest one
+	    int maxCount = 0;
+	    for (unsigned int i = 0; i < m_workerCount; i++) {
+		YateSIPWorker* w = m_workers[i];
+		if (w && w->evCount() > maxCount)
+		    maxCount = w->evCount();
 	    }
+	    s_evCount = maxCount;
+	    if (e && !queueEvent(e))
+		handleEvent(e);
+	}
+	else {
+	    s_evCount = evCount;
+	    if (e)
+		handleEvent(e);
+	}
+	if (evCount || s_engineHalt) {
+	    if (Thread::check(false))
+		break;
+	}
+	else
+	    Thread::usleep(Thread::idleUsec());
+    }
+    stopWorkers();
+    plugin.epTerminated(this);
+}
 
-	    GenObject* obj = static_cast<GenObject*>(t->getUserData());
-	    RefPointer<YateSIPConnection> conn = YOBJECT(YateSIPConnection,obj);
-	    YateSIPLine* line = YOBJECT(YateSIPLine,obj);
-	    YateSIPGenerate* gen = YOBJECT(YateSIPGenerate,obj);
-	    plugin.unlock();
-	    if (conn) {
-		if (conn->process(e)) {
-		    delete e;
-		    break;
-		}
-		else
-		    continue;
+void YateSIPEndPoint::handleEvent(SIPEvent* e)
+{
+    // hack: use a loop so we can use break and continue
+    for (; e; m_engine->processEvent(e),e = 0) {
+	SIPTransaction* t = e->getTransaction();
+	if (!t)
+	    continue;
+	plugin.lock();
+
+	if (t->isOutgoing() && t->getResponseCode() == 408) {
+	    if (t->getMethod() == YSTRING("BYE")) {
+		DDebug(&plugin,DebugInfo,"BYE for transaction %p has timed out",t);
+		m_timedOutByes++;
+		plugin.changed();
 	    }
-	    if (line) {
-		if (line->process(e)) {
-		    delete e;
-		    break;
-		}
-		else
-		    continue;
+	    if (e->getState() == SIPTransaction::Cleared && e->getUserData()) {
+		DDebug(&plugin,DebugInfo,"Transaction %p has timed out",t);
+		m_timedOutTrs++;
+		plugin.changed();
 	    }
-	    if (gen) {
-		if (gen->process(e)) {
-		    delete e;
-		    break;
-		}
-		else
-		    continue;
+	}
+
+	GenObject* obj = static_cast<GenObject*>(t->getUserData());
+	RefPointer<YateSIPConnection> conn = YOBJECT(YateSIPConnection,obj);
+	YateSIPLine* line = YOBJECT(YateSIPLine,obj);
+	YateSIPGenerate* gen = YOBJECT(YateSIPGenerate,obj);
+	plugin.unlock();
+	if (conn) {
+	    if (conn->process(e)) {
+		delete e;
+		break;
 	    }
-	    if ((e->getState() == SIPTransaction::Trying) &&
-		!e->isOutgoing() && incoming(e,e->getTransaction())) {
+	    else
+		continue;
+	}
+	if (line) {
+	    if (line->process(e)) {
 		delete e;
 		break;
 	    }
+	    else
+		continue;
+	}
+	if (gen) {
+	    if (gen->process(e)) {
+		delete e;
+		break;
+	    }
+	    else
+		continue;
+	}
+	if ((e->getState() == SIPTransaction::Trying) &&
+	    !e->isOutgoing() && incoming(e,e->getTransaction())) {
+	    delete e;
+	    break;
+	}
+    }
+}
+
+// Check if an event carries a request that starts a new dialog or transaction
+//  and can be refused without breaking an existing one
+static bool isNewRequest(SIPEvent* e)
+{
+    const SIPMessage* msg = e->getMessage();
+    if (!(msg && e->isIncoming() && !msg->isAnswer() && (e->getState() == SIPTransaction::Trying)))
+	return false;
+    if (msg->isACK() || (msg->method == YSTRING("CANCEL")))
+	return false;
+    return !msg->getParam("To","tag");
+}
+
+bool YateSIPEndPoint::queueEvent(SIPEvent* e)
+{
+    SIPTransaction* t = e->getTransaction();
+    if (!t)
+	return false;
+    unsigned int idx = t->getCallID().hash() % m_workerCount;
+    bool stalled = false;
+    for (;;) {
+	Lock lck(m_mutex);
+	YateSIPWorker* w = m_workers[idx];
+	if (!w)
+	    return false;
+	// never block when asked to stop, the workers drain their queues
+	if (w->enqueue(e,Thread::check(false)))
+	    return true;
+	if (isNewRequest(e)) {
+	    w->incRejected();
+	    lck.drop();
+	    DDebug(&plugin,DebugMild,"Worker %u queue full, rejecting %s",
+		idx,e->getMessage()->method.c_str());
+	    t->setResponse(503);
+	    delete e;
+	    return true;
+	}
+	// events of existing transactions must not be lost, wait for room
+	if (!stalled) {
+	    stalled = true;
+	    w->incStalled();
+	    if ((w->stalled() % 100) == 1)
+		Debug(&plugin,DebugMild,"Worker %u queue full, endpoint waited %u times",
+		    idx,w->stalled());
 	}
-	if (s_evCount || s_engineHalt) {
+	lck.drop();
+	Thread::idle();
+    }
+}
+
+void YateSIPEndPoint::stopWorkers()
+{
+    if (!m_workerCount)
+	return;
+    Lock lck(m_mutex);
+    for (unsigned int i = 0; i < m_workerCount; i++) {
+	if (m_workers[i])
+	    m_workers[i]->cancel(false);
+    }
+    for (;;) {
+	bool running = false;
+	for (unsigned int i = 0; !running && i < m_workerCount; i++)
+	    running = (m_workers[i] != 0);
+	if (!running)
+	    break;
+	lck.drop();
+	Thread::idle();
+	lck.acquire(m_mutex);
+    }
+}
+
+void YateSIPEndPoint::workerTerminated(YateSIPWorker* worker)
+{
+    Lock lck(m_mutex);
+    if (m_workers && worker->index() < m_workerCount && m_workers[worker->index()] == worker)
+	m_workers[worker->index()] = 0;
+}
+
+void YateSIPEndPoint::workersStatus(String& str)
+{
+    if (!m_workerCount)
+	return;
+    unsigned int flooded = 0;
+    unsigned int rejected = 0;
+    unsigned int stalled = 0;
+    String queues;
+    Lock lck(m_mutex);
+    for (unsigned int i = 0; i < m_workerCount; i++) {
+	YateSIPWorker* w = m_workers[i];
+	queues.append(String(w ? w->queued() : 0),"|");
+	if (!w)
+	    continue;
+	if ((s_floodEvents > 1) && (w->evCount() >= s_floodEvents))
+	    flooded++;
+	rejected += w->rejected();
+	stalled += w->stalled();
+    }
+    lck.drop();
+    str.append("workers=",",") << m_workerCount;
+    str << ",workerqueue=" << queues << ",flooded=" << flooded;
+    str << ",rejected=" << rejected << ",stalled=" << stalled;
+}
+
+
+YateSIPWorker::YateSIPWorker(YateSIPEndPoint* ep, unsigned int index, Thread::Priority prio,
+    unsigned int maxQueue)
+    : Thread("YSIP Worker",prio),
+      m_ep(ep), m_index(index), m_mutex(false,"YateSIPWorker"),
+      m_semaphore(1,"YateSIPWorker",0), m_last(&m_events), m_queued(0),
+      m_maxQueue(maxQueue), m_rejected(0), m_stalled(0), m_evCount(0)
+{
+    DDebug(&plugin,DebugAll,"YateSIPWorker::YateSIPWorker(%u) [%p]",index,this);
+}
+
+YateSIPWorker::~YateSIPWorker()
+{
+    DDebug(&plugin,DebugAll,"YateSIPWorker::~YateSIPWorker(%u) [%p]",m_index,this);
+    m_ep->workerTerminated(this);
+    // events left here were never processed, let the engine send them
+    while (SIPEvent* e = dequeue())
+	m_ep->engine()->processEvent(e);
+}
+
+bool YateSIPWorker::enqueue(SIPEvent* e, bool force)
+{
+    Lock lck(m_mutex);
+    if (m_queued >= m_maxQueue && !force)
+	return false;
+    m_last = m_last->append(new GenPointer<SIPEvent>(e));
+    bool wake = !m_queued++;
+    lck.drop();
+    if (wake)
+	m_semaphore.unlock();
+    return true;
+}
+
+SIPEvent* YateSIPWorker::dequeue()
+{
+    Lock lck(m_mutex);
+    GenPointer<SIPEvent>* p = static_cast<GenPointer<SIPEvent>*>(m_events.remove(false));
+    if (!p)
+	return 0;
+    // removing the head moves the next item over it
+    if (!m_events.next())
+	m_last = &m_events;
+    m_queued--;
+    lck.drop();
+    SIPEvent* e = *p;
+    delete p;
+    return e;
+}
+
+void YateSIPWorker::run()
+{
+    for (;;) {
+	SIPEvent* e = dequeue();
+	if (!e) {
+	    m_evCount = 0;
 	    if (Thread::check(false))
 		break;
+	    m_semaphore.lock(Thread::idleUsec());
+	    continue;
 	}
-	else
-	    Thread::usleep(Thread::idleUsec());
+	m_evCount++;
+	if (s_floodEvents > 1 && m_evCount >= s_floodEvents && !Engine::exiting()) {
+	    if (m_evCount == s_floodEvents)
+		Debug(&plugin,DebugMild,"Flood detected in worker %u: %d handled events",
+		    m_index,m_evCount);
+	    else if ((m_evCount % s_floodEvents) == 0)
+		Debug(&plugin,DebugWarn,"Severe flood detected in worker %u: %d events",
+		    m_index,m_evCount);
+	}
+	m_ep->handleEvent(e);
     }
-    plugin.epTerminated(this);
 }
 
 bool YateSIPEndPoint::incoming(SIPEvent* e, SIPTransaction* t)
@@ -8365,6 +8643,7 @@ void YateSIPConnection::doPrack(SIPTransaction* t)
     SIPMessage* msg = static_cast<SIPMessage*>(m_prackQueue.remove(false));
     if (msg) {
 	m_prackTimer = Time::now() + PRACK_TIMER;
+	scheduleTimers(m_prackTimer);
 	m_prackCount = PRACK_TRIES;
 	msg->addHeader("Require","100rel");
 	msg->addHeader("RSeq",String(++m_lastRseq));
@@ -8952,6 +9231,7 @@ void YateSIPConnection::sendProvisional(SIPMessage* msg)
 		return;
 	    }
 	    m_prackTimer = Time::now() + PRACK_TIMER;
+	    scheduleTimers(m_prackTimer);
 	    m_prackCount = PRACK_TRIES;
 	    msg->addHeader("Require","100rel");
 	    msg->addHeader("RSeq",String(++m_lastRseq));
@@ -8969,6 +9249,7 @@ void YateSIPConnection::checkTimers(Message& msg, const Time& tmr)
 	if (m_prackTimer && (m_prackTimer < tmr)) {
 	    if (--m_prackCount > 0) {
 		m_prackTimer += PRACK_TIMER;
+		scheduleTimers(m_prackTimer);
 		RefPointer<SIPTransaction> tr = m_tr;
 		lock.drop();
 		if (tr)
@@ -8987,6 +9268,8 @@ void YateSIPConnection::checkTimers(Message& msg, const Time& tmr)
 		return;
 	    }
 	}
+	else if (m_prackTimer && (m_prackTimer != (uint64_t)-1))
+	    scheduleTimers(m_prackTimer);
     }
 }
 
@@ -10374,7 +10657,9 @@ void SIPDriver::initialize()
     if (!m_endpoint) {
 	Thread::Priority prio = Thread::priority(s_cfg.getValue("general","thread"));
 	unsigned int partyMutexCount = s_cfg.getIntValue("general","party_mutexcount",47,13,101);
-	m_endpoint = new YateSIPEndPoint(prio,partyMutexCount);
+	unsigned int workers = s_cfg.getIntValue("general","workers",0,0,64);
+	unsigned int workerQueue = s_cfg.getIntValue("general","worker_queue",1000,10,100000);
+	m_endpoint = new YateSIPEndPoint(prio,partyMutexCount,workers,workerQueue);
 	if (!(m_endpoint->Init())) {
 	    delete m_endpoint;
 	    m_endpoint = 0;
@@ -10585,6 +10870,8 @@ void SIPDriver::statusParams(String& str)
     Driver::statusParams(str);
     if (m_endpoint && m_endpoint->engine())
 	str.append("transactions=",",") << m_endpoint->engine()->transactionCount();
+    if (m_endpoint)
+	m_endpoint->workersStatus(str);
 }
 
 // Build and dispatch a socket.ssl message
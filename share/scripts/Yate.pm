@@ -35,7 +35,7 @@ BEGIN {
     use Data::Dumper;
 
     # Set version && disable output buffering.
-    our $VERSION = '0.22';
+    our $VERSION = '0.23';
     $ |= 1;
 }
 
@@ -300,7 +300,7 @@ sub uninstall_watcher($$;$) {
 sub listen($) {
     my ($self) = @_;
 
-    while (my $line = <STDIN>) {
+    while (!$self->{'_binary'} && defined(my $line = <STDIN>)) {
 	# Get rid of \n at the end.
 	chomp($line);
 
@@ -309,6 +309,221 @@ sub listen($) {
 	    $self->dispatch();
 	}
     }
+
+    while ($self->{'_binary'} && defined(my $frame = $self->read_frame())) {
+	if ($self->parse_frame($frame) == 1) {
+	    $self->dispatch();
+	}
+    }
+}
+
+# Switch to binary framing. Lines received before the Engine confirmed it
+# are dispatched afterwards so their answers are sent as frames.
+sub binary($) {
+    my ($self) = @_;
+
+    return 1 if ($self->{'_binary'});
+
+    $self->print('%%>setlocal:framing:binary');
+
+    my @pending;
+    while (defined(my $line = <STDIN>)) {
+	chomp($line);
+
+	if ($line =~ /^%%<setlocal:framing:([^:]*):([^:]*)$/) {
+	    if ($1 eq 'binary' && $2 eq 'true') {
+		binmode(STDIN);
+		binmode(STDOUT);
+		$self->{'_binary'} = 1;
+		$self->{'_in_names'} = [];
+		$self->{'_out_names'} = {};
+	    } else {
+		$self->error('Cannot switch to binary framing.');
+	    }
+	    last;
+	}
+
+	push(@pending, $line);
+    }
+
+    foreach (@pending) {
+	if ($self->parse_message($_) == 1) {
+	    $self->dispatch();
+	}
+    }
+
+    return $self->{'_binary'} ? 1 : 0;
+}
+
+# Read one binary frame: 4 octets of length in network order and the payload.
+sub read_frame($) {
+    my ($self) = @_;
+
+    my $len;
+    return undef if (read(STDIN, $len, 4) != 4);
+
+    $len = unpack('N', $len);
+    my $frame = '';
+    while (length($frame) < $len) {
+	return undef unless (read(STDIN, $frame, $len - length($frame), length($frame)));
+    }
+
+    return $frame;
+}
+
+# Read a number sent in groups of 7 bits, least significant first.
+sub _get_number($$) {
+    my ($self, $pos) = @_;
+
+    my ($value, $shift) = (0, 0);
+    while ($$pos < length($self->{'_frame'})) {
+	my $c = ord(substr($self->{'_frame'}, $$pos++, 1));
+	$value |= ($c & 0x7f) << $shift;
+	return $value if ($c < 0x80);
+	$shift += 7;
+    }
+
+    return undef;
+}
+
+# Read a length prefixed string.
+sub _get_string($$) {
+    my ($self, $pos) = @_;
+
+    my $len = $self->_get_number($pos);
+    return undef if (!defined($len) || $$pos + $len > length($self->{'_frame'}));
+
+    my $value = substr($self->{'_frame'}, $$pos, $len);
+    $$pos += $len;
+
+    return $value;
+}
+
+# Parses a binary frame, text protocol lines are passed to parse_message().
+sub parse_frame($$) {
+    my ($self, $frame) = @_;
+
+    my $type = substr($frame, 0, 1);
+    if ($type eq 'T') {
+	return $self->parse_message(substr($frame, 1));
+    }
+
+    if ($type ne '>' && $type ne '<') {
+	$self->error('Got invalid frame type.');
+
+	return 0;
+    }
+
+    $self->{'_frame'} = $frame;
+    my $pos = 1;
+    my ($msg_headers, $msg_params) = ({'keyword' => 'message', 'prefix' => '%%' . $type}, {});
+
+    $msg_headers->{'id'} = $self->_get_string(\$pos);
+    if ($type eq '>') {
+	$msg_headers->{'time'} = $self->_get_number(\$pos);
+    } else {
+	$msg_headers->{'processed'} = ord(substr($frame, $pos++, 1)) ? 'true' : 'false';
+    }
+    $msg_headers->{'name'} = $self->_get_string(\$pos);
+    $msg_headers->{'retvalue'} = $self->_get_string(\$pos);
+
+    # Parameter names are sent once, later only their index in the table.
+    my $count = $self->_get_number(\$pos);
+    while (defined($count) && $count-- > 0) {
+	my $key;
+	my $ref = $self->_get_number(\$pos);
+	if (!defined($ref)) {
+	    $count = undef;
+	    last;
+	} elsif ($ref) {
+	    $key = $self->{'_in_names'}->[$ref - 1];
+	} else {
+	    $key = $self->_get_string(\$pos);
+	    push(@{$self->{'_in_names'}}, $key) if (@{$self->{'_in_names'}} < 4096);
+	}
+
+	my $len = $self->_get_number(\$pos);
+	if (!defined($key) || !defined($len) || $pos + $len - 1 > length($frame)) {
+	    $count = undef;
+	    last;
+	}
+	if ($len) {
+	    $msg_params->{$key} = substr($frame, $pos, $len - 1);
+	    $pos += $len - 1;
+	} else {
+	    $msg_params->{$key} = undef;
+	}
+    }
+
+    if (!defined($count) || !defined($msg_headers->{'retvalue'})) {
+	$self->error('Got invalid frame.');
+
+	return 0;
+    }
+
+    $self->debug('Got frame for: ' . $msg_headers->{'name'} . '.') if ($self->{'Debug'} == 1);
+
+    # Set headers and params in main object.
+    $self->headers($msg_headers);
+    $self->params($msg_params);
+
+    return 1;
+}
+
+# Encode a number in groups of 7 bits, least significant first.
+sub _put_number($$) {
+    my ($self, $value) = @_;
+
+    my $data = '';
+    while ($value >= 0x80) {
+	$data .= chr(($value & 0x7f) | 0x80);
+	$value >>= 7;
+    }
+
+    return $data . chr($value);
+}
+
+# Encode a length prefixed string.
+sub _put_string($$) {
+    my ($self, $value) = @_;
+
+    $value = '' unless defined $value;
+    utf8::encode($value) if (utf8::is_utf8($value));
+
+    return $self->_put_number(length($value)) . $value;
+}
+
+# Encode parameters, each name is sent only once and then by its index.
+sub _put_params($$) {
+    my ($self, $params) = @_;
+
+    my $data = '';
+    my $count = 0;
+    while (my ($key, $value) = each(%{$params})) {
+	next unless ($key);
+	$count++;
+
+	if (exists($self->{'_out_names'}->{$key})) {
+	    $data .= $self->_put_number($self->{'_out_names'}->{$key});
+	} else {
+	    $data .= $self->_put_number(0) . $self->_put_string($key);
+	    my $names = keys(%{$self->{'_out_names'}});
+	    $self->{'_out_names'}->{$key} = $names + 1 if ($names < 4096);
+	}
+
+	$value = '' unless defined $value;
+	utf8::encode($value) if (utf8::is_utf8($value));
+	$data .= $self->_put_number(length($value) + 1) . $value;
+    }
+
+    return $self->_put_number($count) . $data;
+}
+
+# Write one binary frame to the Engine.
+sub print_frame($$) {
+    my ($self, $frame) = @_;
+
+    print STDOUT pack('N', length($frame)) . $frame;
 }
 
 # Parses messages and splits it to parts.
@@ -521,6 +736,16 @@ sub return_message($$$) {
 	return 0;
     }
 
+    if ($self->{'_binary'}) {
+	$self->print_frame('<' . $self->_put_string($self->header('id')) .
+	    ($processed eq 'true' ? "\x01" : "\x00") .
+	    $self->_put_string($self->header('name')) .
+	    $self->_put_string($return_value) .
+	    $self->_put_params(ref($self->params()) eq 'HASH' ? $self->params() : {}));
+
+	return 1;
+    }
+
     my $params = '';
     if (ref($self->params()) eq 'HASH') {
 	while (my ($key, $value) = each(%{$self->params()})) {
@@ -577,7 +802,11 @@ sub print($$) {
     if ($message) {
 	$self->debug('Printing ' . $message) if ($self->{'Debug'} == 1);
 
-	print STDOUT $message . "\n";
+	if ($self->{'_binary'}) {
+	    $self->print_frame('T' . $message);
+	} else {
+	    print STDOUT $message . "\n";
+	}
     }
 }
 
@@ -596,6 +825,14 @@ sub message($$$;$;@) {
 	$id = generate_id();
     }
 
+    if ($self->{'_binary'}) {
+	$self->print_frame('>' . $self->_put_string($id) . $self->_put_number(time()) .
+	    $self->_put_string($name) . $self->_put_string($return_value) .
+	    $self->_put_params(\%params));
+
+	return 1;
+    }
+
     my $params = '';
     while (my ($key, $value) = each(%params)) {
 	if ($key) {
@@ -656,6 +893,13 @@ sub setlocal($$$) {
 
 	    return 0;
 	}
+    } elsif ($name eq 'framing') {
+	# Switching framing must wait for the Engine to confirm it.
+	return $self->binary() if ($value eq 'binary');
+
+	$self->error('Called setlocal with unsupported framing (' . $value . ').');
+
+	return 0;
     } elsif ($name ne 'id') {
 	$self->error('Called setlocal with invalid name (' . $name . ').');
 
@@ -823,6 +1067,15 @@ The methods always return undef.
 Blocks the execution of the script from this point on and starts to
 listen for events from the Engine.
 
+=head2 binary
+
+    $message->binary()
+
+Switches the connection to binary framing: length prefixed frames with
+unescaped values and parameter names sent only once. Blocks until the
+Engine confirms the switch, events received meanwhile are dispatched
+after that. Returns 1 if binary framing is in use.
+
 =head2 message
 
     $message->message($name, $return_value, $id, ParamName => ParamValue, ...)
@@ -978,6 +1231,12 @@ logged by anyone. Only for debugging propose.
 Parses a line received from the Engine and puts the headers and
 parameters into the Yate object.
 
+=head2 read_frame, parse_frame
+
+    $message->parse_frame($message->read_frame())
+
+Reads a binary frame from the Engine and parses it like C<parse_message>.
+
 =head2 dispatch
 
     $message->dispatch()
@@ -39,6 +39,10 @@
 Changelog:
 ----------
 
+version 0.4:
+	- added the negotiated binary framing, call Binary() to enable it.
+	- parse setlocal answers.
+
 version 0.3:
 	- added threading support.
 	- modified test.py example application to do an example of how to use also the threaded version.
@@ -63,10 +67,10 @@ TODO:
 import sys
 
 try:
-	import asyncore, asynchat, random, time, string
+	import asyncore, asynchat, random, time, string, struct
 except:
 	sys.stdout.write("YATE PYTHON LIBRARY:\n\n")
-	sys.stderr.write("You need the following python modules installed:\n\n1- asyncore\n2- asynchat\n3- random\n4- time\n5- string\n6- threading\n")
+	sys.stderr.write("You need the following python modules installed:\n\n1- asyncore\n2- asynchat\n3- random\n4- time\n5- string\n6- struct\n7- threading\n")
 	sys.exit(1)
 
 
@@ -79,9 +83,17 @@ class YateInit(asynchat.async_chat):
 		self.set_terminator("\n")
 		self.in_buffer = ''
 		self._incoming = []
+		self.binary = False
+		self.frame_len = None
 		self.set_file(fd)
 		self.handler = handler
 
+	# switch to binary frames: 4 octets of length then the payload
+	def set_binary(self):
+		self.binary = True
+		self.frame_len = None
+		self.set_terminator(4)
+
 	def set_file(self, fd):
 		self._fileno = fd
 		self.socket = asyncore.file_wrapper(fd)
@@ -98,7 +110,15 @@ class YateInit(asynchat.async_chat):
 		if self._fileno == 0:
 			datain = self.in_buffer
 			self.in_buffer = ''
-			if (datain != '\n') and ( datain != ''):
+			if self.binary:
+				if self.frame_len is None:
+					self.frame_len = struct.unpack("!I", datain)[0]
+					self.set_terminator(self.frame_len)
+				else:
+					self.frame_len = None
+					self.set_terminator(4)
+					self.handler.NotifyFrame(datain)
+			elif (datain != '\n') and ( datain != ''):
 				self.handler(datain)
 
 	def handle_close(self):
@@ -127,6 +147,9 @@ class Yate:
 		self.si = YateInit(0, self)
 		self.so = YateInit(1, self)
 		self.se = YateInit(2, self)
+		# parameter names interned in binary framing, one table per direction
+		self.in_names = []
+		self.out_names = {}
 
 	# static function to intercept incoming message from yate
 	# ( internal use )
@@ -170,6 +193,15 @@ class Yate:
 			self.Yate(self.Unescape(part[2]), "", 0+int(part[1]))
 			self.type = "uninstalled"
 			self.handled = self.Str2bool(part[3])
+		elif part[0] == "%%<setlocal":
+			# local parameter answer str_name:str_value:bool_success
+			self.Yate(self.Unescape(part[1]), self.Unescape(part[2]), "")
+			self.type = "setlocal"
+			self.handled = self.Str2bool(part[3])
+			if (part[1] == "framing") and (part[2] == "binary") and self.handled:
+				# this was the last text line, Yate sends frames from now on
+				self.si.set_binary()
+				self.so.binary = True
 		elif part[0] == "Error in":
 			# We are already in error so better stay quiet
 			pass
@@ -183,6 +215,116 @@ class Yate:
 		udata = self.parse_incoming_data(data)
 		#self.se.write(data + "\n")
 		self.__Yatecall__(udata)
+
+	# function to notify an event received as a binary frame
+	# ( internal use )
+	def NotifyFrame(self, data):
+		if data[0] == "T":
+			self.NotifyEvent(data[1:])
+			return
+		udata = self.parse_incoming_frame(data)
+		self.__Yatecall__(udata)
+
+	# static function to parse a binary message or answer frame
+	# ( internal use )
+	def parse_incoming_frame(self, data):
+		self.frame = data
+		self.frame_pos = 1
+		i = self.GetString()
+		if data[0] == ">":
+			# incoming message str_id:num_time:str_name:str_retval:params
+			t = self.GetNumber()
+			n = self.GetString()
+			self.Yate(n, self.GetString(), i)
+			self.type = "incoming"
+			self.origin = t
+		elif data[0] == "<":
+			# message answer str_id:octet_handled:str_name:str_retval:params
+			k = (data[self.frame_pos] != "\0")
+			self.frame_pos = self.frame_pos + 1
+			n = self.GetString()
+			self.Yate(n, self.GetString(), i)
+			self.type = "answer"
+			self.handled = k
+		else:
+			self.Output("PYTHON parse error: invalid frame")
+			return ''
+		n = self.GetNumber()
+		while n > 0:
+			ref = self.GetNumber()
+			if ref == 0:
+				name = self.GetString()
+				if len(self.in_names) < 4096:
+					self.in_names.append(name)
+			else:
+				name = self.in_names[ref - 1]
+			l = self.GetNumber()
+			if l > 0:
+				self.params.append( [ name, self.frame[self.frame_pos:self.frame_pos + l - 1] ] )
+				self.frame_pos = self.frame_pos + l - 1
+			n = n - 1
+		return self.type
+
+	# read a 7 bit per octet number from the current frame
+	# ( internal use )
+	def GetNumber(self):
+		r = 0
+		shift = 0
+		while True:
+			c = ord(self.frame[self.frame_pos])
+			self.frame_pos = self.frame_pos + 1
+			r = r | ((c & 0x7f) << shift)
+			if c < 0x80:
+				return r
+			shift = shift + 7
+
+	# read a length prefixed string from the current frame
+	# ( internal use )
+	def GetString(self):
+		l = self.GetNumber()
+		r = self.frame[self.frame_pos:self.frame_pos + l]
+		self.frame_pos = self.frame_pos + l
+		return r
+
+	# encode a number in 7 bit groups, least significant first
+	# ( internal use )
+	def PutNumber(self, n):
+		r = ''
+		while n >= 0x80:
+			r = r + chr((n & 0x7f) | 0x80)
+			n = n >> 7
+		return r + chr(n)
+
+	# encode a length prefixed string
+	# ( internal use )
+	def PutString(self, s):
+		s = str(s)
+		return self.PutNumber(len(s)) + s
+
+	# encode parameters, interning their names
+	# ( internal use )
+	def List2frame(self, params = []):
+		r = self.PutNumber(len(params))
+		for p in params:
+			if self.out_names.has_key(p[0]):
+				r = r + self.PutNumber(self.out_names[p[0]])
+			else:
+				r = r + self.PutNumber(0) + self.PutString(p[0])
+				if len(self.out_names) < 4096:
+					self.out_names[p[0]] = len(self.out_names) + 1
+			v = str(p[1])
+			r = r + self.PutNumber(len(v) + 1) + v
+		return r
+
+	# write a protocol line or a binary frame to Yate
+	# ( internal use )
+	def Send(self, data, frame = False):
+		if self.so.binary:
+			if not frame:
+				data = "T" + data
+			self.so.write(struct.pack("!I", len(data)) + data)
+		else:
+			self.so.write(data + "\n")
 	# function to convert params lists to escaped string form ready
 	# to use in a message to engine
 	def List2str(self, params = []):
@@ -340,7 +482,7 @@ class Yate:
 	def Install(self, name, priority = "100"):
 		name = self.Escape(name)
 		initstr = "%%>install"
-		self.so.write("%s:%s:%s\n" % ( initstr, priority, name ))
+		self.Send("%s:%s:%s" % ( initstr, priority, name ))
 		#self.se.write("%s:%s:%s\n" % ( initstr, priority, name ))
 		self.flush()
 
@@ -349,10 +491,24 @@ class Yate:
 	def Uninstall(self, name):
 		initstr = "%%>uninstall"
 		name = self.Escape(name)
-		self.so.write("%s:%s\n" % ( initstr, name))
+		self.Send("%s:%s" % ( initstr, name))
 		#self.se.write("%s:%s\n" % ( initstr, name))
 		self.flush()
 
+   # Set or query a local parameter of the connection, the answer is
+   #  notified as a "setlocal" event
+   # @param $name Name of the parameter
+   # @param $value (optional) New value, empty to query it
+	def SetLocal(self, name, value = ""):
+		self.Send("%%>setlocal:" + self.Escape(name, ':') + ":" + self.Escape(str(value), ':'))
+		self.flush()
+
+   # Request binary framing, it is used in both directions once Yate
+   #  answered with a successful "framing" setlocal event. Nothing else
+   #  may be sent to Yate until that event is received
+	def Binary(self):
+		self.SetLocal("framing", "binary")
+
    # Constructor. Creates a new outgoing message
    # @param $name Name of the new message
    # @param $retval (optional) Default return
@@ -395,6 +551,13 @@ class Yate:
 		if self.type != "outgoing":
 			self.Output("Python bug: attempt to dispatch message type: " + self.type)
 			return
+		if self.so.binary:
+			self.Send('>' + self.PutString(self.id) + self.PutNumber(0 + self.origin) +
+				self.PutString(self.name) + self.PutString(self.retval) +
+				self.List2frame(self.params), True)
+			self.type = "dispatched"
+			self.flush()
+			return
 		i = self.Escape(self.id, ':')
 		t = str(0 + self.origin)
 		n = self.Escape(self.name, ':')
@@ -412,6 +575,15 @@ class Yate:
 		if self.type != "incoming":
 			self.Output("PYTHON bug: attempt to acknowledge message type: " + self.type )
 			return
+		if self.so.binary:
+			k = "\0"
+			if self.handled == True or self.handled == "true":
+				k = "\1"
+			self.Send('<' + self.PutString(self.id) + k + self.PutString(self.name) +
+				self.PutString(self.retval) + self.List2frame(self.params), True)
+			self.type = "acknowledged"
+			self.flush()
+			return
 		i = self.Escape(self.id, ':')
 		k = self.Bool2str(self.handled)
 		n = self.Escape(self.name, ':')
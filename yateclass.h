@@ -242,6 +242,9 @@ namespace TelEngine {
 
 #define YSTRING_INIT_HASH ((unsigned) -1)
 
+// Size of the buffer held inside each String, shorter values are not allocated
+#define YSTRING_INLINE 24
+
 class Lockable;
 class Semaphore;
 class Mutex;
@@ -2102,6 +2105,56 @@ public:
 	{ return *m_pointer; }
 };
 
+/**
+ * Recycler of small memory blocks used by objects that are allocated and
+ *  released at a high rate, like list items and message parameters.
+ * Each thread keeps a small cache of released blocks for every size class,
+ *  the surplus is moved to a shared depot or returned to the heap.
+ * @short Small memory blocks pool
+ */
+class YATE_API MemoryPool
+{
+public:
+    /**
+     * Allocate a memory block
+     * @param size Requested block size in bytes
+     * @return Pointer to the allocated block, NULL if out of memory
+     */
+    static void* alloc(size_t size);
+
+    /**
+     * Release a memory block obtained from alloc()
+     * @param ptr Pointer to the memory block, may be NULL
+     * @param size Size of the block as requested from alloc()
+     */
+    static void release(void* ptr, size_t size);
+
+    /**
+     * Enable or disable recycling of memory blocks.
+     * When disabled blocks go straight to and from the heap which is useful
+     *  when debugging memory problems
+     * @param enable True to recycle blocks, false to use only the heap
+     */
+    static void enable(bool enable);
+
+    /**
+     * Check if memory blocks are recycled
+     * @return True if recycling memory blocks
+     */
+    static bool enabled();
+};
+
+/**
+ * Declare class specific operators that allocate objects from the memory pool.
+ * Objects of derived classes larger than what the pool handles are allocated
+ *  from the heap
+ */
+#define YPOOLED \
+    inline void* operator new(size_t size) \
+	{ return TelEngine::MemoryPool::alloc(size); } \
+    inline void operator delete(void* ptr, size_t size) \
+	{ TelEngine::MemoryPool::release(ptr,size); }
+
 /**
  * A simple single-linked object list handling class
  * @short An object list class
@@ -2110,6 +2163,8 @@ class YATE_API ObjList : public GenObject
 {
     YNOCOPY(ObjList); // no automatic copies please
 public:
+    YPOOLED
+
     /**
      * Creates a new, empty list.
      */
@@ -3204,6 +3259,14 @@ public:
      */
     String(const String& value);
 
+#if __cplusplus >= 201103L
+    /**
+     * Move constructor, takes over the buffer of the original
+     * @param value String to take the value from, left empty
+     */
+    String(String&& value);
+#endif
+
     /**
      * Constructor from String pointer.
      * @param value Initial value of the string
@@ -3603,6 +3666,14 @@ public:
     inline String& operator=(const String& value)
 	{ return operator=(value.c_str()); }
 
+#if __cplusplus >= 201103L
+    /**
+     * Move assignment operator, takes over the buffer of the original
+     * @param value String to take the value from, left empty
+     */
+    String& operator=(String&& value);
+#endif
+
     /**
      * Assignment from String* operator.
      * @param value Value to assign to the string
@@ -4467,13 +4538,16 @@ protected:
      virtual void changed();
 
 private:
-    String& changeStringData(char* data, unsigned int len);
+    char* allocData(unsigned int len, char* tmp);
+    String& changeStringData(char* data, unsigned int len, const char* tmp = 0);
+    void takeData(String& value);
     void clearMatches();
     char* m_string;
     unsigned int m_length;
     // I hope every C++ compiler now knows about mutable...
     mutable unsigned int m_hash;
     StringMatchPrivate* m_matches;
+    char m_inline[YSTRING_INLINE];
 };
 
 /**
@@ -5439,6 +5513,8 @@ class YATE_API NamedString : public String
 {
     YNOCOPY(NamedString); // no automatic copies please
 public:
+    YPOOLED
+
     /**
      * Creates a new named string.
      * @param name Name of this string
@@ -7892,6 +7968,7 @@ public:
 };
 
 class NamedIterator;
+class NamedListIndex;
 
 /**
  * This class holds a named list of named strings
@@ -7901,6 +7978,8 @@ class YATE_API NamedList : public String
 {
     friend class NamedIterator;
 public:
+    YPOOLED
+
     /**
      * List dump flags
      */
@@ -7934,6 +8013,11 @@ public:
      */
     NamedList(const char* name, const NamedList& original, const String& prefix);
 
+    /**
+     * Destructor
+     */
+    virtual ~NamedList();
+
     /**
      * Assignment operator
      * @param value New name and parameters to assign
@@ -7966,7 +8050,7 @@ public:
      * Clear all parameters
      */
     inline void clearParams()
-	{ m_params.clear(); }
+	{ clearIndex(); m_params.clear(); }
 
     /**
      * Add a named string to the parameter list.
@@ -8480,7 +8564,9 @@ public:
     {
 	if (!dest)
 	    dest = new NamedList("");
-	m_params.move(dest->paramList(),lock,maxwait,compact);
+	clearIndex();
+	dest->clearIndex();
+	m_params.move(&dest->m_params,lock,maxwait,compact);
 	return dest;
     }
 
@@ -8525,11 +8611,22 @@ public:
     static const NamedList& empty();
 
     /**
-     * Get the parameters list
+     * Permanently disable the name lookup index of this list.
+     * Must be called for lists whose parameters are renamed in place.
+     */
+    inline void disableIndex()
+	{ clearIndex(); m_noIndex = true; }
+
+    /**
+     * Get the parameters list for modification. The list may be changed
+     *  directly from now on so its name lookup index is permanently disabled.
+     * The index is not freed here as concurrent readers may still use it, the
+     *  next change done through the NamedList methods releases it.
+     * Read-only callers should use the const version that keeps the index.
      * @return Pointer to the parameters list
      */
     inline ObjList* paramList()
-	{ return &m_params; }
+	{ m_noIndex = true; return &m_params; }
 
     /**
      * Get the parameters list
@@ -8540,7 +8637,14 @@ public:
 
 private:
     NamedList(); // no default constructor please
+    NamedString* createParam(const String& name, bool clearOther);
+    void buildIndex() const;
+    void indexAdd(ObjList* node);
+    NamedListIndex* liveIndex();
+    void clearIndex();
     ObjList m_params;
+    mutable NamedListIndex* m_index;
+    bool m_noIndex;
 };
 
 /**
@@ -11555,6 +11659,34 @@ public:
      */
     int recvFrom(void* buffer, int length, SocketAddr& addr, int flags = 0);
 
+    /**
+     * Receive several messages from an unconnected socket in a single operation
+     *  if the platform supports it, falls back to repeated reads otherwise
+     * @param buffer Buffer for data transfer holding count slots of length bytes
+     * @param length Length of each slot in the buffer
+     * @param lengths Array to fill with the length of each received message,
+     *  messages claimed by a socket filter are returned with zero length
+     * @param addrs Array of addresses to fill with the source of each message, may be NULL
+     * @param count Number of slots in the buffer and arrays
+     * @param flags Operating system specific bit flags that change the behaviour
+     * @return Number of messages received, @ref socketError() if an error occurred
+     */
+    virtual int recvFromMulti(void* buffer, int length, int* lengths, SocketAddr* addrs,
+	int count, int flags = 0);
+
+    /**
+     * Send several messages to the same address in a single operation
+     *  if the platform supports it, falls back to repeated writes otherwise
+     * @param buffers Array of pointers to the data of each message
+     * @param lengths Array holding the length of each message
+     * @param count Number of messages to send
+     * @param addr Address to send the messages to
+     * @param flags Operating system specific bit flags that change the behaviour
+     * @return Number of messages sent, @ref socketError() if an error occurred
+     */
+    virtual int sendToMulti(const void* const* buffers, const int* lengths, int count,
+	const SocketAddr& addr, int flags = 0);
+
     /**
      * Receive a message from a connected socket
      * @param buffer Buffer for data transfer
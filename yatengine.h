@@ -370,6 +370,7 @@ private:
 
 class MessageDispatcher;
 class MessageRelay;
+class MessageRing;
 class Engine;
 
 /**
@@ -583,6 +584,7 @@ private:
     RefObject* m_data;
     bool m_notify;
     bool m_broadcast;
+    int m_queued;
     void commonEncode(String& str) const;
     int commonDecode(const char* str, int offs);
 };
@@ -968,9 +970,11 @@ public:
     bool dispatch(Message& msg);
 
     /**
-     * Put a message in the waiting queue for asynchronous dispatching
+     * Put a message in the waiting queue for asynchronous dispatching.
+     * The queue is lock free if atomic operations are available, a locked
+     *  overflow list is used when it fills up
      * @param msg The message to enqueue, will be destroyed after dispatching
-     * @return True if successfully queued, false otherwise
+     * @return True if successfully queued, false if already queued
      */
     bool enqueue(Message* msg);
 
@@ -985,6 +989,21 @@ public:
      */
     bool dequeueOne();
 
+    /**
+     * Account for a message that is kept in a queue other than the dispatcher's.
+     * The message is flagged as queued and included in the queue statistics
+     * @param msg The message being queued elsewhere
+     * @return True if accounted, false if the message is already queued
+     */
+    bool trackQueued(Message* msg);
+
+    /**
+     * Dispatch and destroy a message removed from a queue other than the
+     *  dispatcher's, previously accounted by @ref trackQueued()
+     * @param msg The message to dispatch, will be destroyed after dispatching
+     */
+    void dispatchQueued(Message* msg);
+
     /**
      * Set a limit to generate warning when a message took too long to dispatch
      * @param usec Warning time limit in microseconds, zero to disable
@@ -1030,7 +1049,7 @@ public:
      * @return True if the queue holds at least one message
      */
     inline bool hasMessages() const
-	{ return m_messages.get() || m_messages.next(); }
+	{ return m_enqueueCount.value() != m_dequeueCount.value(); }
 
     /**
      * Check if there is at least one handler installed
@@ -1069,14 +1088,14 @@ public:
      * @return Count of enqueued messages
      */
     u_int64_t enqueueCount() const
-	{ return m_enqueueCount; }
+	{ return m_enqueueCount.value(); }
 
     /**
      * Get the total number of dequeued messages
      * @return Count of dequeued messages
      */
     u_int64_t dequeueCount() const
-	{ return m_dequeueCount; }
+	{ return m_dequeueCount.value(); }
 
     /**
      * Get the total number of dispatched messages
@@ -1165,11 +1184,13 @@ private:
     RWLock m_hooksLock;
     ObjList* m_msgAppend;
     ObjList* m_hookAppend;
+    MessageRing* m_msgRing;
+    volatile unsigned int m_msgOverflow;
     String m_trackParam;
     unsigned int m_changes;
     u_int64_t m_warnTime;
-    u_int64_t m_enqueueCount;
-    u_int64_t m_dequeueCount;
+    AtomicUInt64 m_enqueueCount;
+    AtomicUInt64 m_dequeueCount;
     u_int64_t m_dispatchCount;
     u_int64_t m_queuedMax;
     u_int64_t m_msgAvgAge;
@@ -1177,6 +1198,8 @@ private:
     bool m_traceHandlerTime;
     int m_hookCount;
     bool m_hookHole;
+    HashList m_handlersByName;
+    ObjList m_handlersAny;
 };
 
 /**
@@ -792,6 +792,16 @@ public:
      */
     static void setMaxChain(unsigned int maxChain);
 
+    /**
+     * Retrieve statistics of the cached translator plans
+     * @param formats Set to the number of formats in the conversion cost matrix
+     * @param hits Set to the number of lookups answered from the cached plans
+     * @param misses Set to the number of lookups that found no planned factory
+     * @param builds Set to the number of times the matrix was rebuilt
+     */
+    static void planStats(unsigned int& formats, u_int64_t& hits, u_int64_t& misses,
+	u_int64_t& builds);
+
 protected:
     /**
      * Get access to the list of consumers of the data source
@@ -824,6 +834,7 @@ private:
     static void compose();
     static void compose(TranslatorFactory* factory);
     static bool canConvert(const FormatInfo* fmt1, const FormatInfo* fmt2);
+    static void buildPlans();
     DataSource* m_tsource;
     static Mutex s_mutex;
     static ObjList s_factories;
@@ -1705,6 +1716,7 @@ class YATE_API Channel : public CallEndpoint, public DebugEnabler, public Messag
 {
     friend class Driver;
     friend class Router;
+    friend class RouterPool;
     YNOCOPY(Channel); // no automatic copies please
 private:
     NamedList m_parameters;
@@ -1714,6 +1726,7 @@ private:
     u_int64_t m_timeout;
     u_int64_t m_maxcall;
     u_int64_t m_maxPDD;          // Timeout while waiting for some progress on outgoing calls
+    u_int64_t m_timerDue;        // Time of the entry in driver's timer wheel, zero if none
     u_int64_t m_dtmfTime;
     unsigned int m_toutAns;
     unsigned int m_dtmfSeq;
@@ -1867,7 +1880,10 @@ public:
     virtual bool msgControl(Message& msg);
 
     /**
-     * Timer check method, by default handles channel timeouts
+     * Timer check method, by default handles channel timeouts.
+     * It is called only when a time set by timeout(), maxcall(), maxPDD()
+     *  or scheduleTimers() is due so derived classes that use their own
+     *  timers must schedule them
      * @param msg Timer message
      * @param tmr Current time against which timers are compared
      */
@@ -1999,8 +2015,11 @@ public:
      * Set the time this channel will time out
      * @param tout New timeout time or zero to disable
      */
-    inline void timeout(u_int64_t tout)
-	{ m_timeout = tout; }
+    inline void timeout(u_int64_t tout) {
+	    m_timeout = tout;
+	    if (tout)
+		scheduleTimers(tout);
+	}
 
     /**
      * Get the time this channel will time out on outgoing calls
@@ -2013,8 +2032,11 @@ public:
      * Set the time this channel will time out on outgoing calls
      * @param tout New timeout time or zero to disable
      */
-    inline void maxcall(u_int64_t tout)
-	{ m_maxcall = tout; }
+    inline void maxcall(u_int64_t tout) {
+	    m_maxcall = tout;
+	    if (tout)
+		scheduleTimers(tout);
+	}
 
     /**
      * Set the time this channel will time out on outgoing calls
@@ -2031,6 +2053,13 @@ public:
      */
     void setMaxcall(const Message* msg, int defTout = -1);
 
+    /**
+     * Make sure checkTimers() gets called no later than a given time
+     * @param when Time of the check, zero to use the earliest of the
+     *  timeout, maxcall and maxPDD times
+     */
+    void scheduleTimers(u_int64_t when = 0);
+
     /**
      * Get the time this channel will time out while waiting for some progress
      *  on outgoing calls
@@ -2044,8 +2073,11 @@ public:
      *  on outgoing calls
      * @param tout New timeout time or zero to disable
      */
-    inline void maxPDD(u_int64_t tout)
-	{ m_maxPDD = tout; }
+    inline void maxPDD(u_int64_t tout) {
+	    m_maxPDD = tout;
+	    if (tout)
+		scheduleTimers(tout);
+	}
 
     /**
      * Set the time this channel will time out while waiting for some progress
@@ -2077,10 +2109,10 @@ public:
     void initChan();
 
     /**
-     * Start a routing thread for this channel, dereference dynamic channels
+     * Queue this channel to the routing thread pool, dereference dynamic channels
      * @param msg Pointer to message to route, typically a "call.route", will be
      *  destroyed after routing fails or completes
-     * @return True if routing thread started successfully, false if failed
+     * @return True if routing was queued successfully, false if failed
      */
     bool startRouter(Message* msg);
 
@@ -2301,6 +2333,7 @@ private:
 class YATE_API Driver : public Module
 {
     friend class Router;
+    friend class RouterPool;
     friend class Channel;
 
 private:
@@ -2308,12 +2341,16 @@ private:
     bool m_varchan;
     String m_prefix;
     ObjList m_chans;
+    HashList m_chanIndex;        // Channels hashed by id
+    ObjList* m_timers;           // Timer wheel of channels, one list per second
+    u_int64_t m_timerSec;        // Last second checked in the timer wheel
     int m_routing;
     int m_routed;
     int m_total;
     unsigned int m_nextid;
     int m_timeout;
     int m_maxroute;
+    int m_maxrouters;
     int m_maxchans;
     int m_chanCount;
     bool m_dtmfDups;
@@ -2443,6 +2480,11 @@ protected:
      */
     Driver(const char* name, const char* type = 0);
 
+    /**
+     * Destructor
+     */
+    virtual ~Driver();
+
     /**
      * This method is called to initialize the loaded module
      */
@@ -2560,6 +2602,21 @@ protected:
     inline void maxRoute(int ncalls)
 	{ m_maxroute = ncalls; }
 
+    /**
+     * Set the maximum number of pooled routing threads working for this driver.
+     * Calls exceeding this number wait in the routing queue
+     * @param nthreads Number of calls routed in parallel, zero for no limit
+     */
+    inline void maxRouters(int nthreads)
+	{ m_maxrouters = nthreads; }
+
+    /**
+     * Get the maximum number of pooled routing threads working for this driver
+     * @return Number of calls routed in parallel, zero for no limit
+     */
+    inline int maxRouters() const
+	{ return m_maxrouters; }
+
     /**
      * Set the maximum number of running channels for this driver
      * @param ncalls Number of calls to run simultaneously, zero to accept all
@@ -2579,7 +2636,9 @@ private:
 };
 
 /**
- * Asynchronous call routing thread
+ * Asynchronous call routing thread.
+ * Calls started by Channel::startRouter() are handled by a bounded pool of
+ *  routing threads sharing the same routing logic.
  * @short Call routing thread
  */
 class YATE_API Router : public Thread
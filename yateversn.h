@@ -0,0 +1,45 @@
+/**
+ * yateversn.h
+ * This file is part of the YATE Project http://YATE.null.ro
+ *
+ * This is a generated file. You should never need to modify it.
+ * Take a look at the source file yateversn.h.in instead.
+ *
+ * Yet Another Telephony Engine - a fully featured software PBX and IVR
+ * Copyright (C) 2004-2023 Null Team
+ *
+ * This software is distributed under multiple licenses;
+ * see the COPYING file in the main directory for licensing
+ * information for this specific distribution.
+ *
+ * This use of this software may be subject to additional restrictions.
+ * See the LEGAL file in the main directory for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef __YATEVERSN_H
+#define __YATEVERSN_H
+
+/* Version numbers */
+#define YATE_MAJOR 6
+#define YATE_MINOR 4
+#define YATE_BUILD 1
+
+/* Version strings */
+#define YATE_MAJOR_S "6"
+#define YATE_MINOR_S "4"
+#define YATE_BUILD_S "1"
+#define YATE_VERSION "6.4.1"
+#define YATE_RELEASE "1"
+#define YATE_STATUS  "devel"
+#define YATE_REVISION "550f5ceb5d3f72249b2054694a14c45b2569276f"
+#define YATE_GIT_HASH "550f5ceb5d3f72249b2054694a14c45b2569276f"
+
+/* Windows version resource - file and string style */
+#define YATE_WINVER_F 6,4,1,1
+#define YATE_WINVER_S "6, 4, 1, 1\0"
+
+#endif /* __YATEVERSN_H */